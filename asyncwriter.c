@@ -0,0 +1,486 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code offers other programs files written in the
+ * background, so that the next diagram is drawn while the previous ones are
+ * being written. Under Linux, opens, writes and closes go through io_uring
+ * (raw system calls: no library needed), many files being in flight at once;
+ * elsewhere, or if the kernel refuses it, a writer thread does the work. It is
+ * meant to be used by FEN2SVG.
+ * <p>
+ * Errors are told as soon as they are known, which may be after the file was
+ * handed over: closeAsyncWriter() tells whether every file was written.
+ **/
+
+
+#include<stdlib.h>  /* malloc(), free(), exit() */
+#include<stdio.h>   /* printf(), fprintf(), snprintf() */
+#include<string.h>  /* memset(), strlen() */
+#include "diagramoutput.h"  /* writeBufferToFile() */
+
+#if defined(__linux__) && !defined(FEN2SVG_NO_IO_URING)
+#define ASYNC_WRITER_URING
+#include<errno.h>           /* EINTR */
+#include<fcntl.h>           /* AT_FDCWD, O_CREAT */
+#include<unistd.h>          /* syscall(), close() */
+#include<sys/mman.h>        /* mmap() */
+#include<sys/syscall.h>     /* __NR_io_uring_setup */
+#include<linux/io_uring.h>
+
+#define URING_PROBE_OPERATIONS 256
+#define URING_MAX_WRITE_LENGTH (1U << 30)   /* Longer diagrams take several writes. */
+
+
+/**
+ * Submission and completion queues shared with the kernel (see io_uring_setup(2)). A single
+ * thread at a time uses them (under the mutex of the writer).
+ **/
+typedef struct AsyncRing {
+    int Descriptor;
+    unsigned* SubmissionTail;
+    unsigned* SubmissionMask;
+    unsigned* SubmissionArray;
+    struct io_uring_sqe* Entries;
+    unsigned* CompletionHead;
+    unsigned* CompletionTail;
+    unsigned* CompletionMask;
+    struct io_uring_cqe* Completions;
+    void* SubmissionRing;
+    size_t SubmissionRingSize;
+    void* CompletionRing;
+    size_t CompletionRingSize;
+    size_t EntriesSize;
+    unsigned Pending;                   /* Entries queued, not yet submitted. */
+} AsyncRing;
+
+
+static void closeRing(AsyncRing* rngFiles) {
+
+    if ((*rngFiles).Entries) {
+        munmap((*rngFiles).Entries, (*rngFiles).EntriesSize);
+    }
+    if ((*rngFiles).CompletionRing) {
+        munmap((*rngFiles).CompletionRing, (*rngFiles).CompletionRingSize);
+    }
+    if ((*rngFiles).SubmissionRing) {
+        munmap((*rngFiles).SubmissionRing, (*rngFiles).SubmissionRingSize);
+    }
+    close((*rngFiles).Descriptor);
+    free(rngFiles);
+}
+
+
+/**
+ * Set up the queues, if the kernel offers io_uring with the operations needed (opening,
+ * writing and closing files: Linux 5.6 and later).
+ *
+ * @return  NULL if io_uring cannot be used (e.g. forbidden in a container)
+ **/
+static AsyncRing* openRing(void) {
+
+    struct io_uring_params prmRing;
+    memset(&prmRing, 0, sizeof(prmRing));
+    int nDescriptor = (int) syscall(__NR_io_uring_setup, ASYNC_WRITER_DEPTH, &prmRing);
+    if (nDescriptor < 0) {
+        return NULL;
+    }
+
+    AsyncRing* rngReturnValue = (AsyncRing*) calloc(1, sizeof(AsyncRing));
+    if (!rngReturnValue) {
+        printf("Unsuccessful calloc() in openRing(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*rngReturnValue).Descriptor = nDescriptor;
+
+    /* OPERATIONS SUPPORTED? */
+    size_t nProbeSize = sizeof(struct io_uring_probe)
+        + URING_PROBE_OPERATIONS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* prbRing = (struct io_uring_probe*) calloc(1, nProbeSize);
+    if (!prbRing) {
+        printf("Unsuccessful calloc() in openRing(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    bool bSupported = syscall(__NR_io_uring_register, nDescriptor, IORING_REGISTER_PROBE, prbRing,
+        URING_PROBE_OPERATIONS) >= 0;
+    int anOperations[3] = { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE };
+    for (int nOperation = 0; bSupported && nOperation < 3; nOperation++) {
+        bSupported = anOperations[nOperation] <= (*prbRing).last_op
+            && ((*prbRing).ops[anOperations[nOperation]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(prbRing);
+    if (!bSupported) {
+        closeRing(rngReturnValue);
+        return NULL;
+    }
+
+    /* MAP THE QUEUES */
+    (*rngReturnValue).SubmissionRingSize = prmRing.sq_off.array
+        + prmRing.sq_entries * sizeof(unsigned);
+    (*rngReturnValue).CompletionRingSize = prmRing.cq_off.cqes
+        + prmRing.cq_entries * sizeof(struct io_uring_cqe);
+    (*rngReturnValue).EntriesSize = prmRing.sq_entries * sizeof(struct io_uring_sqe);
+    void* pSubmissionRing = mmap(NULL, (*rngReturnValue).SubmissionRingSize,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, nDescriptor, IORING_OFF_SQ_RING);
+    void* pCompletionRing = mmap(NULL, (*rngReturnValue).CompletionRingSize,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, nDescriptor, IORING_OFF_CQ_RING);
+    void* pEntries = mmap(NULL, (*rngReturnValue).EntriesSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, nDescriptor, IORING_OFF_SQES);
+    (*rngReturnValue).SubmissionRing = (pSubmissionRing == MAP_FAILED) ? NULL : pSubmissionRing;
+    (*rngReturnValue).CompletionRing = (pCompletionRing == MAP_FAILED) ? NULL : pCompletionRing;
+    (*rngReturnValue).Entries = (pEntries == MAP_FAILED) ? NULL : pEntries;
+    if (!(*rngReturnValue).SubmissionRing || !(*rngReturnValue).CompletionRing
+        || !(*rngReturnValue).Entries) {
+        closeRing(rngReturnValue);
+        return NULL;
+    }
+
+    char* pSubmission = (char*) pSubmissionRing;
+    char* pCompletion = (char*) pCompletionRing;
+    (*rngReturnValue).SubmissionTail = (unsigned*) (pSubmission + prmRing.sq_off.tail);
+    (*rngReturnValue).SubmissionMask = (unsigned*) (pSubmission + prmRing.sq_off.ring_mask);
+    (*rngReturnValue).SubmissionArray = (unsigned*) (pSubmission + prmRing.sq_off.array);
+    (*rngReturnValue).CompletionHead = (unsigned*) (pCompletion + prmRing.cq_off.head);
+    (*rngReturnValue).CompletionTail = (unsigned*) (pCompletion + prmRing.cq_off.tail);
+    (*rngReturnValue).CompletionMask = (unsigned*) (pCompletion + prmRing.cq_off.ring_mask);
+    (*rngReturnValue).Completions = (struct io_uring_cqe*) (pCompletion + prmRing.cq_off.cqes);
+
+    return rngReturnValue;
+}
+
+
+/**
+ * Queue the next operation of a file (it is submitted with the next call to
+ * submitToRing()). A file has one operation at a time in flight, so the queue, as deep as
+ * the number of files, never overflows.
+ **/
+static void queueFileOperation(AsyncRing* rngFiles, AsyncFile* filWritten, int nFile) {
+
+    unsigned nTail = *(*rngFiles).SubmissionTail;
+    unsigned nIndex = nTail & *(*rngFiles).SubmissionMask;
+    struct io_uring_sqe* sqeNext = &(*rngFiles).Entries[nIndex];
+    memset(sqeNext, 0, sizeof(struct io_uring_sqe));
+    (*sqeNext).user_data = (unsigned long long) nFile;
+
+    if ((*filWritten).State == OPENING_FILE) {
+        (*sqeNext).opcode = IORING_OP_OPENAT;
+        (*sqeNext).fd = AT_FDCWD;
+        (*sqeNext).addr = (unsigned long long) (size_t) (*filWritten).Name;
+        (*sqeNext).len = 0666;          /* Mode, as fopen(..., "w") would create it. */
+        (*sqeNext).open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    }
+    else if ((*filWritten).State == WRITING_FILE) {
+        size_t nRemaining = (*(*filWritten).Data).Length - (*filWritten).Written;
+        (*sqeNext).opcode = IORING_OP_WRITE;
+        (*sqeNext).fd = (*filWritten).Descriptor;
+        (*sqeNext).addr = (unsigned long long) (size_t) ((*(*filWritten).Data).Data
+            + (*filWritten).Written);
+        (*sqeNext).len = nRemaining < URING_MAX_WRITE_LENGTH ?
+            (unsigned) nRemaining : URING_MAX_WRITE_LENGTH;
+        (*sqeNext).off = (unsigned long long) (*filWritten).Written;
+    }
+    else {
+        (*sqeNext).opcode = IORING_OP_CLOSE;
+        (*sqeNext).fd = (*filWritten).Descriptor;
+    }
+
+    (*rngFiles).SubmissionArray[nIndex] = nIndex;
+    __atomic_store_n((*rngFiles).SubmissionTail, nTail + 1, __ATOMIC_RELEASE);
+    (*rngFiles).Pending++;
+}
+
+
+/**
+ * Submit the queued operations and, if asked, wait for at least one of them to complete.
+ **/
+static void submitToRing(AsyncRing* rngFiles, bool bWait) {
+
+    for (;;) {
+        long nSubmitted = syscall(__NR_io_uring_enter, (*rngFiles).Descriptor,
+            (*rngFiles).Pending, bWait ? 1 : 0, bWait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (nSubmitted >= 0) {
+            (*rngFiles).Pending -= (unsigned) nSubmitted;
+            return;
+        }
+        if (errno != EINTR) {
+            printf("Unsuccessful io_uring_enter() in submitToRing(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+/**
+ * Go on with every file whose operation completed: open, then write (again, if short),
+ * then close, then the slot is free.
+ **/
+static void reapCompletions(AsyncWriter* wrtFiles) {
+
+    AsyncRing* rngFiles = (*wrtFiles).Ring;
+    unsigned nHead = *(*rngFiles).CompletionHead;
+    while (nHead != __atomic_load_n((*rngFiles).CompletionTail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqeDone =
+            &(*rngFiles).Completions[nHead & *(*rngFiles).CompletionMask];
+        int nFile = (int) (*cqeDone).user_data;
+        int nResult = (*cqeDone).res;
+        AsyncFile* filWritten = &(*wrtFiles).Files[nFile];
+        nHead++;
+
+        if ((*filWritten).State == OPENING_FILE) {
+            if (nResult < 0) {
+                fprintf(stderr, "Error: cannot open output file (%s).\n", (*filWritten).Name);
+                (*wrtFiles).Failed = true;
+                (*filWritten).State = FREE_FILE;
+                (*wrtFiles).FreeFiles[(*wrtFiles).FreeCount++] = nFile;
+                continue;
+            }
+            (*filWritten).Descriptor = nResult;
+            (*filWritten).State = ((*(*filWritten).Data).Length > 0) ? WRITING_FILE : CLOSING_FILE;
+        }
+        else if ((*filWritten).State == WRITING_FILE) {
+            if (nResult <= 0) {
+                fprintf(stderr, "Error: cannot write to output file (%s).\n",
+                    (*filWritten).Name);
+                (*wrtFiles).Failed = true;
+                (*filWritten).Failed = true;
+            }
+            else {
+                (*filWritten).Written += (size_t) nResult;
+            }
+            if ((*filWritten).Failed
+                || (*filWritten).Written == (*(*filWritten).Data).Length) {
+                (*filWritten).State = CLOSING_FILE;
+            }
+        }
+        else {
+            if (nResult < 0 && !(*filWritten).Failed) {
+                fprintf(stderr, "Error: cannot close output file (%s).\n", (*filWritten).Name);
+                (*wrtFiles).Failed = true;
+            }
+            (*filWritten).State = FREE_FILE;
+            (*wrtFiles).FreeFiles[(*wrtFiles).FreeCount++] = nFile;
+            continue;
+        }
+        queueFileOperation(rngFiles, filWritten, nFile);
+    }
+    __atomic_store_n((*rngFiles).CompletionHead, nHead, __ATOMIC_RELEASE);
+}
+#endif
+
+
+/**
+ * Body of the writer thread (without io_uring): write queued files in order, until the
+ * writer is closed and the queue empty.
+ **/
+static void* runFileWriter(void* pAsyncWriter) {
+
+    AsyncWriter* wrtFiles = (AsyncWriter*) pAsyncWriter;
+
+    pthread_mutex_lock(&(*wrtFiles).Mutex);
+    for (;;) {
+        while ((*wrtFiles).Count == 0 && !(*wrtFiles).Closed) {
+            pthread_cond_wait(&(*wrtFiles).Changed, &(*wrtFiles).Mutex);
+        }
+        if ((*wrtFiles).Count == 0) {
+            break;
+        }
+        int nFile = (*wrtFiles).Queue[(*wrtFiles).First];
+        (*wrtFiles).First = ((*wrtFiles).First + 1) % ASYNC_WRITER_DEPTH;
+        (*wrtFiles).Count--;
+        AsyncFile* filWritten = &(*wrtFiles).Files[nFile];
+
+        /* WRITE WITHOUT THE LOCK: the next files can be queued meanwhile. */
+        pthread_mutex_unlock(&(*wrtFiles).Mutex);
+        bool bWritten = writeBufferToFile((*filWritten).Name, (*(*filWritten).Data).Data,
+            (*(*filWritten).Data).Length);
+        pthread_mutex_lock(&(*wrtFiles).Mutex);
+
+        (*wrtFiles).Failed = (*wrtFiles).Failed || !bWritten;
+        (*filWritten).State = FREE_FILE;
+        (*wrtFiles).FreeFiles[(*wrtFiles).FreeCount++] = nFile;
+        pthread_cond_broadcast(&(*wrtFiles).Changed);
+    }
+    pthread_mutex_unlock(&(*wrtFiles).Mutex);
+
+    return NULL;
+}
+
+
+/**
+ * Start writing files in the background: io_uring if available, else a writer thread.
+ *
+ * @see     closeAsyncWriter()
+ **/
+AsyncWriter* createAsyncWriter(void) {
+
+    AsyncWriter* wrtReturnValue = (AsyncWriter*) malloc(sizeof(AsyncWriter));
+    if (!wrtReturnValue) {
+        printf("Unsuccessful malloc() in createAsyncWriter(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int nFile = 0; nFile < ASYNC_WRITER_DEPTH; nFile++) {
+        (*wrtReturnValue).Files[nFile].State = FREE_FILE;
+        (*wrtReturnValue).Files[nFile].Data = createEmptyBuffer();
+        (*wrtReturnValue).FreeFiles[nFile] = ASYNC_WRITER_DEPTH - 1 - nFile;
+    }
+    (*wrtReturnValue).FreeCount = ASYNC_WRITER_DEPTH;
+    (*wrtReturnValue).First = 0;
+    (*wrtReturnValue).Count = 0;
+    (*wrtReturnValue).Closed = false;
+    (*wrtReturnValue).Failed = false;
+    pthread_mutex_init(&(*wrtReturnValue).Mutex, NULL);
+    pthread_cond_init(&(*wrtReturnValue).Changed, NULL);
+
+#ifdef ASYNC_WRITER_URING
+    (*wrtReturnValue).Ring = openRing();
+#else
+    (*wrtReturnValue).Ring = NULL;
+#endif
+    if (!(*wrtReturnValue).Ring
+        && pthread_create(&(*wrtReturnValue).Thread, NULL, runFileWriter, wrtReturnValue) != 0) {
+        printf("Unsuccessful pthread_create() in createAsyncWriter(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return wrtReturnValue;
+}
+
+
+/**
+ * Hand a file over (its data is copied): it is written in the background, once a slot is
+ * free (at most ASYNC_WRITER_DEPTH files are in flight). Any thread can call it.
+ *
+ * @return  false if the file name is too long (errors of the writing itself are told
+ *          later, see closeAsyncWriter())
+ **/
+bool writeFileAsynchronously(AsyncWriter* wrtFiles, const char* sFileName, const char* pData,
+    size_t nLength) {
+
+    if (strlen(sFileName) >= ASYNC_FILE_NAME_MAX_SIZE) {
+        fprintf(stderr, "Error: cannot open output file (%s).\n", sFileName);
+        return false;
+    }
+
+    pthread_mutex_lock(&(*wrtFiles).Mutex);
+
+    /* 1 - GO ON WITH COMPLETED OPERATIONS, WAIT FOR A FREE SLOT IF NEEDED */
+#ifdef ASYNC_WRITER_URING
+    if ((*wrtFiles).Ring) {
+        reapCompletions(wrtFiles);
+        while ((*wrtFiles).FreeCount == 0) {
+            submitToRing((*wrtFiles).Ring, true);
+            reapCompletions(wrtFiles);
+        }
+    }
+#endif
+    while ((*wrtFiles).FreeCount == 0) {
+        pthread_cond_wait(&(*wrtFiles).Changed, &(*wrtFiles).Mutex);
+    }
+
+    /* 2 - COPY THE FILE */
+    int nFile = (*wrtFiles).FreeFiles[--(*wrtFiles).FreeCount];
+    AsyncFile* filWritten = &(*wrtFiles).Files[nFile];
+    memcpy((*filWritten).Name, sFileName, strlen(sFileName) + 1);
+    clearBuffer((*filWritten).Data);
+    appendToBuffer((*filWritten).Data, pData, nLength);
+    (*filWritten).Written = 0;
+    (*filWritten).Failed = false;
+
+    /* 3 - START WRITING IT (submitted with the operations queued above) */
+#ifdef ASYNC_WRITER_URING
+    if ((*wrtFiles).Ring) {
+        (*filWritten).State = OPENING_FILE;
+        queueFileOperation((*wrtFiles).Ring, filWritten, nFile);
+        submitToRing((*wrtFiles).Ring, false);
+        pthread_mutex_unlock(&(*wrtFiles).Mutex);
+        return true;
+    }
+#endif
+    (*filWritten).State = QUEUED_FILE;
+    (*wrtFiles).Queue[((*wrtFiles).First + (*wrtFiles).Count) % ASYNC_WRITER_DEPTH] = nFile;
+    (*wrtFiles).Count++;
+    pthread_cond_broadcast(&(*wrtFiles).Changed);
+    pthread_mutex_unlock(&(*wrtFiles).Mutex);
+
+    return true;
+}
+
+
+/**
+ * Wait for every file handed over so far to be written (e.g. before saving a checkpoint).
+ *
+ * @return  false if a file could not be written
+ **/
+bool flushAsyncWriter(AsyncWriter* wrtFiles) {
+
+    pthread_mutex_lock(&(*wrtFiles).Mutex);
+#ifdef ASYNC_WRITER_URING
+    if ((*wrtFiles).Ring) {
+        reapCompletions(wrtFiles);
+        while ((*wrtFiles).FreeCount < ASYNC_WRITER_DEPTH) {
+            submitToRing((*wrtFiles).Ring, true);
+            reapCompletions(wrtFiles);
+        }
+    }
+#endif
+    while ((*wrtFiles).FreeCount < ASYNC_WRITER_DEPTH) {
+        pthread_cond_wait(&(*wrtFiles).Changed, &(*wrtFiles).Mutex);
+    }
+    bool bReturnValue = !(*wrtFiles).Failed;
+    pthread_mutex_unlock(&(*wrtFiles).Mutex);
+
+    return bReturnValue;
+}
+
+
+/**
+ * Wait for every file to be written, then release the writer.
+ *
+ * @return  false if a file could not be written
+ **/
+bool closeAsyncWriter(AsyncWriter** wrtFiles) {
+
+    /* WAIT FOR EVERY FILE */
+    flushAsyncWriter(*wrtFiles);
+#ifdef ASYNC_WRITER_URING
+    if ((**wrtFiles).Ring) {
+        closeRing((**wrtFiles).Ring);
+    }
+#endif
+    if (!(**wrtFiles).Ring) {
+        pthread_mutex_lock(&(**wrtFiles).Mutex);
+        (**wrtFiles).Closed = true;
+        pthread_cond_broadcast(&(**wrtFiles).Changed);
+        pthread_mutex_unlock(&(**wrtFiles).Mutex);
+        pthread_join((**wrtFiles).Thread, NULL);
+    }
+
+    bool bReturnValue = !(**wrtFiles).Failed;
+    for (int nFile = 0; nFile < ASYNC_WRITER_DEPTH; nFile++) {
+        freeBuffer(&(**wrtFiles).Files[nFile].Data);
+    }
+    pthread_mutex_destroy(&(**wrtFiles).Mutex);
+    pthread_cond_destroy(&(**wrtFiles).Changed);
+    free(*wrtFiles);
+    *wrtFiles = NULL;
+
+    return bReturnValue;
+}
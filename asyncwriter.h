@@ -0,0 +1,84 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for asyncwriter.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <stddef.h>                         /* size_t */
+#include <pthread.h>
+#include "bytebuffer.h"
+
+#define ASYNC_WRITER_DEPTH 64               /* Files being written at a time. */
+#define ASYNC_FILE_NAME_MAX_SIZE 1024
+
+
+/* Variables */
+enum AsyncFileState {
+   FREE_FILE,
+   QUEUED_FILE,            /* Waiting for the writer thread. */
+   OPENING_FILE,           /* io_uring operations, one at a time per file. */
+   WRITING_FILE,
+   CLOSING_FILE
+};
+
+/**
+ * A file being written. Its buffer is kept from one file to the next: once every slot has
+ * held a diagram, no more allocation is made.
+ **/
+typedef struct AsyncFile {
+   int State;              /* E.g. WRITING_FILE. */
+   char Name[ASYNC_FILE_NAME_MAX_SIZE];
+   ByteBuffer* Data;       /* Copy of the diagram: the caller reuses its buffer at once. */
+   size_t Written;         /* Bytes already written (a write may be short). */
+   int Descriptor;
+   bool Failed;
+} AsyncFile;
+
+struct AsyncRing;          /* io_uring queues, see asyncwriter.c. */
+
+/**
+ * Writes files in the background: through io_uring when the kernel offers it (opens,
+ * writes and closes of up to ASYNC_WRITER_DEPTH files in flight), else with a writer
+ * thread fed by a bounded queue.
+ **/
+typedef struct AsyncWriter {
+   AsyncFile Files[ASYNC_WRITER_DEPTH];
+   int FreeFiles[ASYNC_WRITER_DEPTH];      /* Stack of free slots. */
+   int FreeCount;
+   struct AsyncRing* Ring;                 /* NULL: writer thread. */
+   int Queue[ASYNC_WRITER_DEPTH];          /* Writer thread: slots waiting, in order. */
+   int First;
+   int Count;
+   bool Closed;
+   bool Failed;                            /* A file could not be written. */
+   pthread_t Thread;
+   pthread_mutex_t Mutex;
+   pthread_cond_t Changed;
+} AsyncWriter;
+
+/* Methods */
+AsyncWriter* createAsyncWriter(void);
+bool writeFileAsynchronously(AsyncWriter* wrtFiles, const char* sFileName, const char* pData,
+    size_t nLength);
+bool flushAsyncWriter(AsyncWriter* wrtFiles);
+bool closeAsyncWriter(AsyncWriter** wrtFiles);
@@ -0,0 +1,303 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Microbenchmark harness for the render path of FEN2SVG: times reading FEN files,
+ * parseFEN(), createPieces(), generateEmptyBoard(), renderFEN() against renderGameFrame(),
+ * rasterizeDiagram() and writing files separately, then a whole run
+ * (lucas.fen scaled up to 1M positions by default) written as an archive to /dev/null.
+ * <p>
+ * Built and run by "make bench". Usage: fen2svg_bench [positions] [threads]
+ * (must be run from the directory holding lucas.fen; the template is built into it).
+ * <p>
+ * It compiles fen2svg.c with FEN2SVG_NO_MAIN:
+ * gcc -O2 -pthread -DFEN2SVG_NO_MAIN bench.c fen2svg.c libfen2svg.c embeddedtemplate.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c diagramcompressor.c svgraster.c diagramraster.c stringset.c -lz -lm -o fen2svg_bench
+ **/
+
+
+#define _GNU_SOURCE                         /* mkdtemp() */
+#include <time.h>                           /* clock_gettime() */
+#include "fen2svg.h"                        /* Own work */
+
+
+#define BENCH_SOURCE_FILE "lucas.fen"
+#define BENCH_DEFAULT_POSITIONS 1000000
+#define BENCH_EMPTY_BOARDS 20000
+#define BENCH_WRITTEN_FILES 2000
+#define BENCH_PNG_DIAGRAMS 20000
+#define BENCH_PNG_SQUARE_SIZE 24            /* Thumbnails (see --png). */
+
+
+/** Self-explanatory. **/
+double getSeconds(void) {
+
+    struct timespec tmsNow;
+    clock_gettime(CLOCK_MONOTONIC, &tmsNow);
+    return tmsNow.tv_sec + tmsNow.tv_nsec / 1e9;
+}
+
+
+/** One line of results: items per second and, if bytes are given, MB/s. **/
+void printResult(char* sStage, long nItems, double nSeconds, size_t nBytes) {
+
+    printf("%-22s %9ld in %7.3f s  %12.0f /s", sStage, nItems, nSeconds, nItems / nSeconds);
+    if (nBytes > 0) {
+        printf("  %9.1f MB/s", nBytes / nSeconds / 1e6);
+    }
+    printf("\n");
+}
+
+
+/**
+ * Read the positions of the source file in memory (first column only), so that they can
+ * be replayed as many times as needed.
+ *
+ * @return  number of positions read, 0 on error
+ **/
+int loadPositions(char* sFileName, char sPositions[][FEN_EXCERPT_LENGTH+1], int nMaxPositions) {
+
+    FILE* fInputFile = fopen(sFileName, "rt");
+    if (fInputFile == NULL) {
+        fprintf(stderr, "Error: cannot open input file (%s).\n", sFileName);
+        return 0;
+    }
+    int nPositions = 0;
+    int nOptions;
+    while (nPositions < nMaxPositions
+        && readFENLine(fInputFile, sPositions[nPositions], 0, &nOptions)) {
+        sPositions[nPositions][strcspn(sPositions[nPositions], "\t")] = '\0';
+        nPositions++;
+    }
+    fclose(fInputFile);
+
+    return nPositions;
+}
+
+
+/**
+ * Write nPositions lines (the source positions over and over) to a new temporary file.
+ *
+ * @param   sFileName   receives the name of the file (at least "/tmp/fen2svg_benchXXXXXX")
+ * @return  number of bytes written, 0 on error
+ **/
+size_t writeScaledFile(char* sFileName, char sPositions[][FEN_EXCERPT_LENGTH+1],
+    int nSourcePositions, int nPositions) {
+
+    strcpy(sFileName, "/tmp/fen2svg_benchXXXXXX");
+    int nDescriptor = mkstemp(sFileName);
+    if (nDescriptor < 0) {
+        return 0;
+    }
+    FILE* fOutputFile = fdopen(nDescriptor, "wt");
+    size_t nBytes = 0;
+    for (int i = 0; i < nPositions; i++) {
+        nBytes += fprintf(fOutputFile, "%s\n", sPositions[i % nSourcePositions]);
+    }
+    if (fclose(fOutputFile) != 0) {
+        return 0;
+    }
+
+    return nBytes;
+}
+
+
+/**
+ * Time every stage of the render path, then a whole run.
+ **/
+int main(int argc, char* argv[]) {
+
+    /* 1 - ARGUMENTS */
+    int nPositions = (argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_POSITIONS;
+    int nThreads = (argc > 2) ? atoi(argv[2]) : 1;
+    if (nPositions < 1 || nThreads < 1 || nThreads > MAX_WORKER_THREADS) {
+        printf("Usage: %s [positions] [threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* 2 - SOURCE POSITIONS AND SCALED INPUT FILE */
+    static char sPositions[1024][FEN_EXCERPT_LENGTH+1];
+    int nSourcePositions = loadPositions(BENCH_SOURCE_FILE, sPositions, 1024);
+    if (nSourcePositions == 0) {
+        return EXIT_FAILURE;
+    }
+    char sScaledFile[FILE_NAME_MAX_SIZE];
+    size_t nScaledBytes = writeScaledFile(sScaledFile, sPositions, nSourcePositions, nPositions);
+    if (nScaledBytes == 0) {
+        printf("Error: cannot write scaled input file.\n");
+        return EXIT_FAILURE;
+    }
+    printf("%d positions (%s x %d), %d thread(s)\n", nPositions, BENCH_SOURCE_FILE,
+        (nPositions + nSourcePositions - 1) / nSourcePositions, nThreads);
+
+    DiagramWriter wrtDiagram;
+    if (!setUpDiagramWriter(&wrtDiagram, NULL, true, true, true, false, false, false,
+        NULL, SQUARE_WIDTH)) {
+        remove(sScaledFile);
+        return EXIT_FAILURE;
+    }
+
+    /* 3 - READING FEN FILE (no rendering) */
+    double nStart = getSeconds();
+    FILE* fInputFile = fopen(sScaledFile, "rt");
+    char sFENExcerpt[FEN_EXCERPT_LENGTH+1];
+    long nRead = 0;
+    int nOptions;
+    while (readFENLine(fInputFile, sFENExcerpt, wrtDiagram.DefaultOptions, &nOptions)) {
+        nRead++;
+    }
+    fclose(fInputFile);
+    printResult("readFENFile (read)", nRead, getSeconds() - nStart, nScaledBytes);
+
+    /* 4 - EMPTY BOARDS */
+    nStart = getSeconds();
+    size_t nBoardBytes = 0;
+    BoardGeometry geoBoard;
+    computeBoardGeometry(&geoBoard, true, true, SQUARE_WIDTH);
+    for (int i = 0; i < BENCH_EMPTY_BOARDS; i++) {
+        ByteBuffer* bufBoard = generateEmptyBoard(&geoBoard, i % 2 == 0, false, NULL);
+        nBoardBytes += (*bufBoard).Length;
+        freeBuffer(&bufBoard);
+    }
+    printResult("generateEmptyBoard", BENCH_EMPTY_BOARDS, getSeconds() - nStart, nBoardBytes);
+
+    /* 4 BIS - PARSING (every later stage reads the boards) */
+    static ChessBoard aBoards[1024];
+    nStart = getSeconds();
+    long nValid = 0;
+    for (int i = 0; i < nPositions; i++) {
+        const char* sPosition = sPositions[i % nSourcePositions];
+        nValid += (parseFEN(sPosition, strlen(sPosition), &aBoards[i % nSourcePositions],
+            NULL) == FEN_OK);
+    }
+    printResult("parseFEN", nPositions, getSeconds() - nStart, 0);
+    if (nValid < nPositions) {
+        printf("Error: invalid position in %s.\n", BENCH_SOURCE_FILE);
+    }
+
+    /* 5 - PIECES */
+    ByteBuffer* bufPieces = createEmptyBuffer();
+    nStart = getSeconds();
+    size_t nPieceBytes = 0;
+    for (int i = 0; i < nPositions; i++) {
+        clearBuffer(bufPieces);
+        createPieces(getRenderContext(wrtDiagram.Renderers, wrtDiagram.DefaultOptions)->Pieces,
+            &aBoards[i % nSourcePositions], true, false, bufPieces);
+        nPieceBytes += (*bufPieces).Length;
+    }
+    printResult("createPieces", nPositions, getSeconds() - nStart, nPieceBytes);
+    freeBuffer(&bufPieces);
+
+    /* 5 BIS - GAME FRAMES (whole diagrams, only changed squares redrawn, see -g) */
+    const RenderContext* ctxRender = getRenderContext(wrtDiagram.Renderers,
+        wrtDiagram.DefaultOptions);
+    ByteBuffer* bufDiagram = createEmptyBuffer();
+    reserveBuffer(bufDiagram, getMaxDiagramLength(ctxRender));
+    nStart = getSeconds();
+    size_t nDiagramBytes = 0;
+    for (int i = 0; i < nPositions; i++) {
+        const char* sPosition = sPositions[i % nSourcePositions];
+        nDiagramBytes += (size_t) renderFEN(ctxRender, sPosition, strlen(sPosition),
+            (*bufDiagram).Data, (*bufDiagram).Capacity);
+    }
+    printResult("renderFEN", nPositions, getSeconds() - nStart, nDiagramBytes);
+    freeBuffer(&bufDiagram);
+    GameFrame* frmGame = createGameFrame();
+    nStart = getSeconds();
+    size_t nFrameBytes = 0;
+    for (int i = 0; i < nPositions; i++) {
+        nFrameBytes += (size_t) renderGameFrame(frmGame, ctxRender,
+            &aBoards[i % nSourcePositions]);
+    }
+    printResult("renderGameFrame", nPositions, getSeconds() - nStart, nFrameBytes);
+    freeGameFrame(&frmGame);
+
+    /* 5 TER - PNG THUMBNAILS (atlas built by the first one, see --png) */
+    ByteBuffer* bufTemplate = buildTemplateBlob(*(*wrtDiagram.Renderers).Template);
+    DiagramRasterizer* rstDiagram = createDiagramRasterizer(bufTemplate, BENCH_PNG_SQUARE_SIZE);
+    freeBuffer(&bufTemplate);
+    if (rstDiagram) {
+        ByteBuffer* bufCanvas = createEmptyBuffer();
+        ByteBuffer* bufPNG = createEmptyBuffer();
+        nStart = getSeconds();
+        size_t nPNGBytes = 0;
+        for (int i = 0; i < BENCH_PNG_DIAGRAMS; i++) {
+            long nLength = rasterizeDiagram(rstDiagram, ctxRender, wrtDiagram.DefaultOptions,
+                &aBoards[i % nSourcePositions], bufCanvas, bufPNG);
+            nPNGBytes += (nLength > 0) ? (size_t) nLength : 0;
+        }
+        printResult("rasterizeDiagram (PNG)", BENCH_PNG_DIAGRAMS, getSeconds() - nStart, nPNGBytes);
+        freeBuffer(&bufCanvas);
+        freeBuffer(&bufPNG);
+        freeDiagramRasterizer(&rstDiagram);
+    }
+
+    /* 6 - WRITING FILES (one rendered diagram, to a temporary directory) */
+    char sDirectory[] = "/tmp/fen2svg_benchXXXXXX";
+    if (mkdtemp(sDirectory)) {
+        renderDiagram(ctxRender, &aBoards[0], wrtDiagram.Diagram);
+        char sOutputFile[FILE_NAME_MAX_SIZE + sizeof(sDirectory)];
+        nStart = getSeconds();
+        for (int i = 0; i < BENCH_WRITTEN_FILES; i++) {
+            snprintf(sOutputFile, sizeof(sOutputFile), "%s/" NUMBERED_FILE_NAME_FORMAT,
+                sDirectory, i);
+            writeBufferToFile(sOutputFile, (*wrtDiagram.Diagram).Data,
+                (*wrtDiagram.Diagram).Length);
+        }
+        printResult("writeBufferToFile", BENCH_WRITTEN_FILES, getSeconds() - nStart,
+            BENCH_WRITTEN_FILES * (*wrtDiagram.Diagram).Length);
+        for (int i = 0; i < BENCH_WRITTEN_FILES; i++) {
+            snprintf(sOutputFile, sizeof(sOutputFile), "%s/" NUMBERED_FILE_NAME_FORMAT,
+                sDirectory, i);
+            remove(sOutputFile);
+        }
+        rmdir(sDirectory);
+    }
+
+    /* 7 - END TO END (read, render and write as an archive to /dev/null) */
+    wrtDiagram.Output = openDiagramOutput(TAR_OUTPUT, "/dev/null", wrtDiagram.DiagramNumber,
+        false, false);
+    pthread_t thrWorkers[MAX_WORKER_THREADS];
+    if (nThreads > 1) {
+        wrtDiagram.Queue = createDiagramQueue();
+        for (int i = 0; i < nThreads; i++) {
+            pthread_create(&thrWorkers[i], NULL, runDiagramWorker, &wrtDiagram);
+        }
+    }
+    nStart = getSeconds();
+    readFENFile(sScaledFile, &wrtDiagram);
+    if (wrtDiagram.Queue) {
+        closeDiagramQueue(wrtDiagram.Queue);
+        for (int i = 0; i < nThreads; i++) {
+            pthread_join(thrWorkers[i], NULL);
+        }
+        freeDiagramQueue(&wrtDiagram.Queue);
+    }
+    double nSeconds = getSeconds() - nStart;
+    /* Diagrams are all about the same size: estimate the output from the last one. */
+    printResult("end to end", wrtDiagram.DiagramNumber - 1, nSeconds,
+        (size_t) (wrtDiagram.DiagramNumber - 1) * (*wrtDiagram.Diagram).Length);
+    closeDiagramOutput(&wrtDiagram.Output);
+
+    /* 8 - FREE MEMORY AND REMOVE SCALED FILE */
+    tearDownDiagramWriter(&wrtDiagram);
+    remove(sScaledFile);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * As the name suggests, this code offers other programs a growable array of
+ * bytes. Contrary to a linked list, its content can be written down with a
+ * single call. It is meant to be used by FEN2SVG.
+ **/
+
+
+#include<stdlib.h>  /* malloc(), realloc(), free(), exit() */
+#include<stdio.h>   /* printf() */
+#include<string.h>  /* strlen(), memcpy() */
+#include "bytebuffer.h"
+
+#define INITIAL_CAPACITY 256
+
+/* Buffers created or grown so far, by every thread (see countBufferAllocations()). */
+static long nBufferAllocations = 0;
+
+
+ByteBuffer* createEmptyBuffer(void) {
+
+    ByteBuffer* bufBuffer = NULL;
+    bufBuffer = (ByteBuffer*) malloc(1 * sizeof(ByteBuffer));
+    if (!bufBuffer) {
+        printf("Unsuccessful malloc() in createEmptyBuffer(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    __atomic_fetch_add(&nBufferAllocations, 1, __ATOMIC_RELAXED);
+
+    (*bufBuffer).Data = NULL;
+    (*bufBuffer).Length = 0;
+    (*bufBuffer).Capacity = 0;
+
+    return bufBuffer;
+}
+
+
+/**
+ * Make sure that nExtraLength bytes can be appended without any further allocation.
+ * Capacity is doubled when needed, so that appending costs a constant time on average.
+ **/
+void reserveBuffer(ByteBuffer* bufBuffer, size_t nExtraLength) {
+
+    if ((*bufBuffer).Length + nExtraLength > (*bufBuffer).Capacity) {
+        size_t nNewCapacity = (*bufBuffer).Capacity ? (*bufBuffer).Capacity : INITIAL_CAPACITY;
+        while ((*bufBuffer).Length + nExtraLength > nNewCapacity) {
+            nNewCapacity *= 2;
+        }
+        char* pNewData = (char*) realloc((*bufBuffer).Data, nNewCapacity);
+        if (!pNewData) {
+            printf("Unsuccessful realloc() in reserveBuffer(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        (*bufBuffer).Data = pNewData;
+        (*bufBuffer).Capacity = nNewCapacity;
+        __atomic_fetch_add(&nBufferAllocations, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * Number of allocations made by buffers so far (creations and growths), whatever the
+ * thread: once buffers have reached their working size, it should not grow with the number
+ * of positions.
+ **/
+long countBufferAllocations(void) {
+
+    return __atomic_load_n(&nBufferAllocations, __ATOMIC_RELAXED);
+}
+
+
+void appendToBuffer(ByteBuffer* bufBuffer, const char* pData, size_t nLength) {
+
+    /* GROW THE BUFFER IF NEEDED */
+    reserveBuffer(bufBuffer, nLength);
+
+    /* COPY BYTES AT THE END OF THE BUFFER */
+    if (nLength > 0) {
+        memcpy((*bufBuffer).Data + (*bufBuffer).Length, pData, nLength);
+        (*bufBuffer).Length += nLength;
+    }
+}
+
+
+void appendStringToBuffer(ByteBuffer* bufBuffer, const char* sValue) {
+    appendToBuffer(bufBuffer, sValue, strlen(sValue));
+}
+
+
+/* Same as appendStringToBuffer(), followed by '\n'. */
+void appendLineToBuffer(ByteBuffer* bufBuffer, const char* sValue) {
+    appendToBuffer(bufBuffer, sValue, strlen(sValue));
+    appendToBuffer(bufBuffer, "\n", 1);
+}
+
+
+/* Memory is kept, so that the buffer can be filled again without any allocation. */
+void clearBuffer(ByteBuffer* bufBuffer) {
+    (*bufBuffer).Length = 0;
+}
+
+
+void freeBuffer(ByteBuffer** bufBuffer) {
+
+    if ((**bufBuffer).Data) {
+        free((**bufBuffer).Data);
+        (**bufBuffer).Data = NULL;
+    }
+    (**bufBuffer).Length = 0;
+    (**bufBuffer).Capacity = 0;
+
+    free(*bufBuffer);
+    *bufBuffer = NULL;
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * As the name suggests, this code is the header file for bytebuffer.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#ifndef BYTEBUFFER_H                        /* Also included by other helper headers. */
+#define BYTEBUFFER_H
+
+#include <stddef.h>                         /* size_t */
+
+
+/* Variables */
+typedef struct ByteBuffer {
+   char* Data;             /* Contiguous bytes, not necessarily '\0' terminated. */
+   size_t Length;          /* Bytes in use. */
+   size_t Capacity;        /* Bytes allocated. */
+} ByteBuffer;
+
+/* Methods */
+ByteBuffer* createEmptyBuffer(void);
+void appendToBuffer(ByteBuffer* bufBuffer, const char* pData, size_t nLength);
+void appendStringToBuffer(ByteBuffer* bufBuffer, const char* sValue);
+void appendLineToBuffer(ByteBuffer* bufBuffer, const char* sValue);
+void reserveBuffer(ByteBuffer* bufBuffer, size_t nExtraLength);
+void clearBuffer(ByteBuffer* bufBuffer);
+void freeBuffer(ByteBuffer** bufBuffer);
+long countBufferAllocations(void);
+
+#endif
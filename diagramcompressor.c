@@ -0,0 +1,190 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code compresses the diagrams produced by FEN2SVG, as gzip
+ * data (i.e. SVGZ files).
+ * <p>
+ * Every diagram starts with the same bytes (template and empty board): those are
+ * compressed only once. The state of zlib after them is kept, and copied for every diagram,
+ * so that only the pieces remain to be compressed. Output is the same as compressing the
+ * whole diagram at once.
+ **/
+
+
+#include<stdio.h>   /* printf() */
+#include<stdlib.h>  /* malloc(), free(), exit() */
+#include<string.h>  /* memcmp() */
+#include "diagramcompressor.h"
+
+#define GZIP_WINDOW_BITS (15+16)            /* Largest window, gzip header and trailer. */
+#define GZIP_MEMORY_LEVEL 8                 /* zlib default. */
+
+
+DiagramCompressor* createDiagramCompressor(int nLevel) {
+
+    DiagramCompressor* cmpReturnValue = (DiagramCompressor*) malloc(1 *
+        sizeof(DiagramCompressor));
+    if (!cmpReturnValue) {
+        printf("Unsuccessful malloc() in createDiagramCompressor(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*cmpReturnValue).Level = nLevel;
+    for (int nPrefix = 0; nPrefix < COMPRESSOR_MAX_PREFIXES; nPrefix++) {
+        (*cmpReturnValue).Streams[nPrefix] = NULL;
+    }
+    pthread_mutex_init(&(*cmpReturnValue).Mutex, NULL);
+
+    return cmpReturnValue;
+}
+
+
+/**
+ * Run deflate() over the input of a stream, appending what it produces to a buffer.
+ *
+ * @param   nFlush  Z_NO_FLUSH (more input to come) or Z_FINISH
+ * @return  false on zlib error
+ **/
+static bool deflateToBuffer(z_stream* strCompressed, int nFlush, ByteBuffer* bufOutput) {
+
+    int nStatus;
+    do {
+        reserveBuffer(bufOutput, COMPRESSOR_CHUNK_SIZE);
+        (*strCompressed).next_out = (Bytef*) ((*bufOutput).Data + (*bufOutput).Length);
+        (*strCompressed).avail_out = (uInt) ((*bufOutput).Capacity - (*bufOutput).Length);
+        nStatus = deflate(strCompressed, nFlush);
+        (*bufOutput).Length = (size_t) ((char*) (*strCompressed).next_out - (*bufOutput).Data);
+        if (nStatus == Z_STREAM_ERROR) {
+            return false;
+        }
+    } while ((nFlush == Z_FINISH) ? (nStatus != Z_STREAM_END) : ((*strCompressed).avail_in > 0
+        || (*strCompressed).avail_out == 0));
+
+    return true;
+}
+
+
+/**
+ * Compress a prefix once and for all (built under the compressor mutex).
+ **/
+static PrimedStream* createPrimedStream(int nLevel, const ByteBuffer* bufPrefix) {
+
+    PrimedStream* strReturnValue = (PrimedStream*) malloc(1 * sizeof(PrimedStream));
+    if (!strReturnValue) {
+        printf("Unsuccessful malloc() in createPrimedStream(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*strReturnValue).Stream.zalloc = Z_NULL;
+    (*strReturnValue).Stream.zfree = Z_NULL;
+    (*strReturnValue).Stream.opaque = Z_NULL;
+    if (deflateInit2(&(*strReturnValue).Stream, nLevel, Z_DEFLATED, GZIP_WINDOW_BITS,
+        GZIP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(strReturnValue);
+        return NULL;
+    }
+    (*strReturnValue).Output = createEmptyBuffer();
+    (*strReturnValue).PrefixLength = (*bufPrefix).Length;
+
+    /* Whatever zlib keeps pending is part of the state, and so is copied with it. */
+    (*strReturnValue).Stream.next_in = (Bytef*) (*bufPrefix).Data;
+    (*strReturnValue).Stream.avail_in = (uInt) (*bufPrefix).Length;
+    if (!deflateToBuffer(&(*strReturnValue).Stream, Z_NO_FLUSH, (*strReturnValue).Output)) {
+        deflateEnd(&(*strReturnValue).Stream);
+        freeBuffer(&(*strReturnValue).Output);
+        free(strReturnValue);
+        return NULL;
+    }
+
+    return strReturnValue;
+}
+
+
+/**
+ * Compress a whole diagram as gzip data.
+ * <p>
+ * Any thread can call it at once, as long as each one has its own output buffer: primed
+ * streams are only read once built.
+ *
+ * @param   cmpDiagram      compressor shared by every diagram
+ * @param   nPrefix         index of the prefix, from 0 to COMPRESSOR_MAX_PREFIXES-1 (the
+ *                          same index must always come with the same prefix)
+ * @param   bufPrefix       bytes every diagram of this index starts with (e.g. empty board)
+ * @param   pData           the diagram
+ * @param   nLength         size of the diagram
+ * @param   bufCompressed   emptied, then filled with the gzip data
+ * @return  false if the diagram could not be compressed
+ **/
+bool compressDiagram(DiagramCompressor* cmpDiagram, int nPrefix, const ByteBuffer* bufPrefix,
+    const char* pData, size_t nLength, ByteBuffer* bufCompressed) {
+
+    if (nPrefix < 0 || nPrefix >= COMPRESSOR_MAX_PREFIXES || nLength < (*bufPrefix).Length
+        || memcmp(pData, (*bufPrefix).Data, (*bufPrefix).Length) != 0) {
+        return false;
+    }
+
+    /* PRIMED STREAM (no lock needed once published, see getRenderContext()) */
+    PrimedStream* strPrimed = __atomic_load_n(&(*cmpDiagram).Streams[nPrefix],
+        __ATOMIC_ACQUIRE);
+    if (!strPrimed) {
+        pthread_mutex_lock(&(*cmpDiagram).Mutex);
+        strPrimed = (*cmpDiagram).Streams[nPrefix];
+        if (!strPrimed) {
+            strPrimed = createPrimedStream((*cmpDiagram).Level, bufPrefix);
+            __atomic_store_n(&(*cmpDiagram).Streams[nPrefix], strPrimed, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&(*cmpDiagram).Mutex);
+        if (!strPrimed) {
+            return false;
+        }
+    }
+
+    /* COPY ITS STATE, THEN COMPRESS WHAT FOLLOWS THE PREFIX. */
+    z_stream strDiagram;
+    if (deflateCopy(&strDiagram, &(*strPrimed).Stream) != Z_OK) {
+        return false;
+    }
+    clearBuffer(bufCompressed);
+    appendToBuffer(bufCompressed, (*(*strPrimed).Output).Data, (*(*strPrimed).Output).Length);
+    strDiagram.next_in = (Bytef*) (pData + (*strPrimed).PrefixLength);
+    strDiagram.avail_in = (uInt) (nLength - (*strPrimed).PrefixLength);
+    bool bReturnValue = deflateToBuffer(&strDiagram, Z_FINISH, bufCompressed);
+    deflateEnd(&strDiagram);
+
+    return bReturnValue;
+}
+
+
+/* Free a compressor and every primed stream it built. */
+void freeDiagramCompressor(DiagramCompressor** cmpDiagram) {
+
+    for (int nPrefix = 0; nPrefix < COMPRESSOR_MAX_PREFIXES; nPrefix++) {
+        PrimedStream* strPrimed = (**cmpDiagram).Streams[nPrefix];
+        if (strPrimed) {
+            deflateEnd(&(*strPrimed).Stream);
+            freeBuffer(&(*strPrimed).Output);
+            free(strPrimed);
+        }
+    }
+    pthread_mutex_destroy(&(**cmpDiagram).Mutex);
+    free(*cmpDiagram);
+    *cmpDiagram = NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for diagramcompressor.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <zlib.h>                           /* deflate() */
+#include "bytebuffer.h"
+
+#define COMPRESSOR_MAX_PREFIXES 64          /* Options combinations x board orientations. */
+#define COMPRESSOR_CHUNK_SIZE 16384         /* Room added to the output at a time. */
+
+
+/* Variables */
+typedef struct PrimedStream {
+   z_stream Stream;        /* State once the prefix is compressed: copied for every diagram. */
+   ByteBuffer* Output;     /* Bytes deflate() already produced for the prefix. */
+   size_t PrefixLength;
+} PrimedStream;
+
+typedef struct DiagramCompressor {
+   int Level;              /* zlib compression level (e.g. Z_BEST_COMPRESSION). */
+   PrimedStream* Streams[COMPRESSOR_MAX_PREFIXES]; /* Built when first needed. */
+   pthread_mutex_t Mutex;
+} DiagramCompressor;
+
+/* Methods */
+DiagramCompressor* createDiagramCompressor(int nLevel);
+bool compressDiagram(DiagramCompressor* cmpDiagram, int nPrefix, const ByteBuffer* bufPrefix,
+    const char* pData, size_t nLength, ByteBuffer* bufCompressed);
+void freeDiagramCompressor(DiagramCompressor** cmpDiagram);
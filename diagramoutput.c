@@ -0,0 +1,394 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code writes down the diagrams produced by FEN2SVG:
+ * either one file per diagram, or every diagram in a single archive (tar) or
+ * stream, so that millions of small files do not have to be created.
+ * <p>
+ * In archive and stream modes, entries are appended in the order of their diagram
+ * numbers, whatever the thread that produced them: the output of a run does not
+ * depend on the number of worker threads.
+ **/
+
+
+#include<stdio.h>   /* fopen(), fwrite(), fprintf() */
+#include<stdlib.h>  /* malloc(), free(), exit() */
+#include<string.h>  /* strlen(), memset(), memcpy() */
+#include<time.h>    /* time() */
+#include<unistd.h>  /* dup() */
+#include "diagramoutput.h"
+
+#define TAR_BLOCK_SIZE 512
+#define TAR_NAME_MAX_LENGTH 99              /* ustar name field, '\0' excluded. */
+
+
+/**
+ * Write a whole diagram (SVG definitions, empty board and chess pieces) to a file, in a
+ * single call.
+ **/
+bool writeBufferToFile(const char* sOutputFile, const char* pData, size_t nLength) {
+
+    FILE* fOutputFile;
+
+    /* OPEN FILE */
+    fOutputFile = fopen(sOutputFile, "w");
+    if (fOutputFile  ==  NULL) {
+        fprintf(stderr, "Error: cannot open output file (%s).\n", sOutputFile);
+        return false;
+    }
+
+    /* WRITE DIAGRAM TO FILE (a single block). */
+    if (fwrite(pData, 1, nLength, fOutputFile) != nLength) {
+        fprintf(stderr, "Error: cannot write to output file (%s).\n", sOutputFile);
+        fclose(fOutputFile);
+        return false;
+    }
+
+    /* CLOSE FILE */
+    if (fclose(fOutputFile) != 0) {
+        fprintf(stderr, "Error: cannot close output file (%s).\n", sOutputFile);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Open the output of a run.
+ *
+ * @param   enuMode             files, tar archive or stream
+ * @param   sArchiveName        tar archive ("-" for standard output), ignored otherwise
+ * @param   nFirstDiagramNumber number of the first diagram to be appended
+ * @param   bCompressedStream   in stream mode, gzip the whole stream (compressed entries
+ *                              could not be split anymore); ignored otherwise
+ * @param   bAsynchronousFiles  in files mode, write files in the background (see
+ *                              AsyncWriter); ignored otherwise
+ * @return  NULL if the archive cannot be created
+ **/
+DiagramOutput* openDiagramOutput(enum OutputMode enuMode, const char* sArchiveName,
+    int nFirstDiagramNumber, bool bCompressedStream, bool bAsynchronousFiles) {
+
+    DiagramOutput* outReturnValue = (DiagramOutput*) malloc(1 * sizeof(DiagramOutput));
+    if (!outReturnValue) {
+        printf("Unsuccessful malloc() in openDiagramOutput(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*outReturnValue).Mode = enuMode;
+    (*outReturnValue).File = NULL;
+    (*outReturnValue).StandardOutput = false;
+    (*outReturnValue).CompressedFile = NULL;
+    (*outReturnValue).Timestamp = (long) time(NULL);
+    (*outReturnValue).NextDiagramNumber = nFirstDiagramNumber;
+    (*outReturnValue).Writer = (enuMode == FILES_OUTPUT && bAsynchronousFiles) ?
+        createAsyncWriter() : NULL;
+
+    /* OPEN ARCHIVE OR STREAM */
+    if (enuMode == STREAM_OUTPUT || (enuMode == TAR_OUTPUT && strcmp(sArchiveName, "-") == 0)) {
+        (*outReturnValue).File = stdout;
+        (*outReturnValue).StandardOutput = true;
+    }
+    else if (enuMode == TAR_OUTPUT) {
+        (*outReturnValue).File = fopen(sArchiveName, "wb");
+        if (!(*outReturnValue).File) {
+            fprintf(stderr, "Error: cannot open output archive (%s).\n", sArchiveName);
+            free(outReturnValue);
+            return NULL;
+        }
+    }
+    if (enuMode == STREAM_OUTPUT && bCompressedStream) {
+        /* gzclose() closes its own descriptor, not the standard output. */
+        (*outReturnValue).CompressedFile = gzdopen(dup(fileno(stdout)), "wb9");
+        if (!(*outReturnValue).CompressedFile) {
+            fprintf(stderr, "Error: cannot open compressed output stream.\n");
+            free(outReturnValue);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&(*outReturnValue).Mutex, NULL);
+    pthread_cond_init(&(*outReturnValue).Turn, NULL);
+
+    return outReturnValue;
+}
+
+
+/* Store an unsigned value as a '\0' terminated octal number, as tar expects it. */
+static void writeTarOctal(char* sField, size_t nFieldSize, unsigned long nValue) {
+
+    sField[nFieldSize-1] = '\0';
+    for (size_t nPos = nFieldSize-1; nPos > 0; nPos--) {
+        sField[nPos-1] = (char) ('0' + (nValue & 7));
+        nValue >>= 3;
+    }
+}
+
+
+/* Append a ustar header, the data and the padding to the next block. */
+static bool appendTarEntry(DiagramOutput* outDiagram, const char* sFileName, const char* pData,
+    size_t nLength) {
+
+    unsigned char acHeader[TAR_BLOCK_SIZE];
+    static const char acPadding[TAR_BLOCK_SIZE];
+    size_t nNameLength = strlen(sFileName);
+
+    if (nNameLength > TAR_NAME_MAX_LENGTH) {
+        fprintf(stderr, "Error: file name too long for the archive (%s).\n", sFileName);
+        return false;
+    }
+
+    /* HEADER (see POSIX ustar format) */
+    memset(acHeader, 0, TAR_BLOCK_SIZE);
+    memcpy(acHeader, sFileName, nNameLength);                             /* name */
+    writeTarOctal((char*) acHeader+100, 8, 0644);                           /* mode */
+    writeTarOctal((char*) acHeader+108, 8, 0);                              /* uid */
+    writeTarOctal((char*) acHeader+116, 8, 0);                              /* gid */
+    writeTarOctal((char*) acHeader+124, 12, (unsigned long) nLength);       /* size */
+    writeTarOctal((char*) acHeader+136, 12, (unsigned long) (*outDiagram).Timestamp); /* mtime */
+    acHeader[156] = '0';                                                    /* regular file */
+    memcpy(acHeader+257, "ustar", 6);                                       /* magic */
+    memcpy(acHeader+263, "00", 2);                                          /* version */
+
+    /* Checksum: sum of the header bytes, the checksum field counting as blanks. */
+    unsigned long nChecksum = 0;
+    memset(acHeader+148, ' ', 8);
+    for (int nPos = 0; nPos < TAR_BLOCK_SIZE; nPos++) {
+        nChecksum += acHeader[nPos];
+    }
+    writeTarOctal((char*) acHeader+148, 7, nChecksum);
+
+    /* HEADER, DATA, PADDING */
+    size_t nPadding = (TAR_BLOCK_SIZE - nLength % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    if (fwrite(acHeader, 1, TAR_BLOCK_SIZE, (*outDiagram).File) != TAR_BLOCK_SIZE
+        || fwrite(pData, 1, nLength, (*outDiagram).File) != nLength
+        || fwrite(acPadding, 1, nPadding, (*outDiagram).File) != nPadding) {
+        fprintf(stderr, "Error: cannot write to output archive (%s).\n", sFileName);
+        return false;
+    }
+
+    return true;
+}
+
+
+/* Append a "name\0svg\0" entry. SVG never contains '\0', so entries are easy to split. */
+static bool appendStreamEntry(DiagramOutput* outDiagram, const char* sFileName,
+    const char* pData, size_t nLength) {
+
+    size_t nNameLength = strlen(sFileName) + 1;
+
+    if ((*outDiagram).CompressedFile) {
+        if (gzwrite((*outDiagram).CompressedFile, sFileName, (unsigned) nNameLength)
+            != (int) nNameLength
+            || gzwrite((*outDiagram).CompressedFile, pData, (unsigned) nLength) != (int) nLength
+            || gzputc((*outDiagram).CompressedFile, '\0') == -1) {
+            fprintf(stderr, "Error: cannot write to output stream (%s).\n", sFileName);
+            return false;
+        }
+        return true;
+    }
+    if (fwrite(sFileName, 1, nNameLength, (*outDiagram).File) != nNameLength
+        || fwrite(pData, 1, nLength, (*outDiagram).File) != nLength
+        || fputc('\0', (*outDiagram).File) == EOF) {
+        fprintf(stderr, "Error: cannot write to output stream (%s).\n", sFileName);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Write down a diagram: as a file, or appended to the archive or stream once every diagram
+ * with a lower number has been.
+ * <p>
+ * A diagram number must be given to every position, and each number must be handed in
+ * exactly once (with NULL data if the position could not be converted), otherwise the
+ * following diagrams would wait forever.
+ *
+ * @param   outDiagram      where diagrams go
+ * @param   nDiagramNumber  rank of the position in the input
+ * @param   sFileName       file (or entry) name
+ * @param   pData           the diagram, NULL to give up the turn
+ * @param   nLength         size of the diagram
+ * @return  false if the diagram could not be written
+ * @see     writeDiagramEntry()
+ **/
+bool writeDiagramOutput(DiagramOutput* outDiagram, int nDiagramNumber, const char* sFileName,
+    const char* pData, size_t nLength) {
+
+    return writeDiagramEntry(outDiagram, nDiagramNumber, sFileName, pData, nLength, true);
+}
+
+
+/**
+ * Write down one of the diagrams of a position (e.g. its variants, see --variants): they
+ * share its turn, which only the last one gives up (see writeDiagramOutput()). Diagrams of
+ * a position must be handed in one after the other, by the same thread.
+ *
+ * @param   bLastEntry      last diagram of the position (a NULL pData always should be)
+ * @return  false if the diagram could not be written
+ **/
+bool writeDiagramEntry(DiagramOutput* outDiagram, int nDiagramNumber, const char* sFileName,
+    const char* pData, size_t nLength, bool bLastEntry) {
+
+    bool bReturnValue = true;
+
+    /* ONE FILE PER DIAGRAM: no ordering needed (nor waiting, in the background). */
+    if ((*outDiagram).Mode == FILES_OUTPUT) {
+        if (!pData) {
+            return false;
+        }
+        return (*outDiagram).Writer ?
+            writeFileAsynchronously((*outDiagram).Writer, sFileName, pData, nLength) :
+            writeBufferToFile(sFileName, pData, nLength);
+    }
+
+    /* SINGLE ARCHIVE OR STREAM: wait for this diagram's turn. */
+    pthread_mutex_lock(&(*outDiagram).Mutex);
+    while ((*outDiagram).NextDiagramNumber != nDiagramNumber) {
+        pthread_cond_wait(&(*outDiagram).Turn, &(*outDiagram).Mutex);
+    }
+
+    if (!pData) {
+        bReturnValue = false;
+    }
+    else if ((*outDiagram).Mode == TAR_OUTPUT) {
+        bReturnValue = appendTarEntry(outDiagram, sFileName, pData, nLength);
+    }
+    else {
+        bReturnValue = appendStreamEntry(outDiagram, sFileName, pData, nLength);
+    }
+
+    if (bLastEntry) {
+        (*outDiagram).NextDiagramNumber++;
+        pthread_cond_broadcast(&(*outDiagram).Turn);
+    }
+    pthread_mutex_unlock(&(*outDiagram).Mutex);
+
+    return bReturnValue;
+}
+
+
+/**
+ * Give up the turns of nCount diagrams at once, from nDiagramNumber on (e.g. positions left
+ * to other runs, see --range): the next diagrams of an archive or stream do not wait for
+ * them. Nothing to do in files mode.
+ **/
+void skipDiagramOutput(DiagramOutput* outDiagram, int nDiagramNumber, int nCount) {
+
+    if ((*outDiagram).Mode == FILES_OUTPUT || nCount == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&(*outDiagram).Mutex);
+    while ((*outDiagram).NextDiagramNumber != nDiagramNumber) {
+        pthread_cond_wait(&(*outDiagram).Turn, &(*outDiagram).Mutex);
+    }
+    (*outDiagram).NextDiagramNumber += nCount;
+    pthread_cond_broadcast(&(*outDiagram).Turn);
+    pthread_mutex_unlock(&(*outDiagram).Mutex);
+}
+
+
+/**
+ * Write down a file shared by every diagram (e.g. a sprite file): as a file, or as the first
+ * entry of the archive or stream. It must be written before any diagram.
+ *
+ * @param   sFileName       file (or entry) name
+ * @return  false if the file could not be written
+ **/
+bool writeSharedOutput(DiagramOutput* outDiagram, const char* sFileName, const char* pData,
+    size_t nLength) {
+
+    if ((*outDiagram).Mode == FILES_OUTPUT) {
+        return writeBufferToFile(sFileName, pData, nLength);
+    }
+    else if ((*outDiagram).Mode == TAR_OUTPUT) {
+        return appendTarEntry(outDiagram, sFileName, pData, nLength);
+    }
+
+    return appendStreamEntry(outDiagram, sFileName, pData, nLength);
+}
+
+
+/**
+ * Wait for the files written in the background so far (nothing to wait for otherwise:
+ * other writes are done when writeDiagramOutput() returns).
+ *
+ * @return  false if a file could not be written
+ **/
+bool flushDiagramOutput(DiagramOutput* outDiagram) {
+
+    if ((*outDiagram).Writer) {
+        return flushAsyncWriter((*outDiagram).Writer);
+    }
+    if ((*outDiagram).File && !(*outDiagram).CompressedFile) {
+        return fflush((*outDiagram).File) == 0;
+    }
+
+    return true;
+}
+
+
+/**
+ * Close the archive (two empty blocks end a tar archive), or wait for the files written in
+ * the background, and release the output.
+ *
+ * @return  false if the archive could not be completed
+ **/
+bool closeDiagramOutput(DiagramOutput** outDiagram) {
+
+    static const char acEndOfArchive[2*TAR_BLOCK_SIZE];
+    bool bReturnValue = true;
+
+    if ((**outDiagram).Writer) {
+        /* Files that could not be written were told one by one, as without a writer. */
+        closeAsyncWriter(&(**outDiagram).Writer);
+    }
+    if ((**outDiagram).Mode == TAR_OUTPUT) {
+        if (fwrite(acEndOfArchive, 1, 2*TAR_BLOCK_SIZE, (**outDiagram).File)
+            != 2*TAR_BLOCK_SIZE) {
+            bReturnValue = false;
+        }
+    }
+    if ((**outDiagram).CompressedFile) {
+        bReturnValue = (gzclose((**outDiagram).CompressedFile) == Z_OK) && bReturnValue;
+    }
+    if ((**outDiagram).File) {
+        if ((**outDiagram).StandardOutput) {
+            bReturnValue = (fflush((**outDiagram).File) == 0) && bReturnValue;
+        }
+        else {
+            bReturnValue = (fclose((**outDiagram).File) == 0) && bReturnValue;
+        }
+    }
+    if (!bReturnValue && (**outDiagram).Mode != FILES_OUTPUT) {
+        fprintf(stderr, "Error: cannot complete output archive.\n");
+    }
+
+    pthread_mutex_destroy(&(**outDiagram).Mutex);
+    pthread_cond_destroy(&(**outDiagram).Turn);
+    free(*outDiagram);
+    *outDiagram = NULL;
+
+    return bReturnValue;
+}
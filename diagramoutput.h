@@ -0,0 +1,65 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for diagramoutput.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdio.h>                          /* FILE */
+#include <stdbool.h>
+#include <stddef.h>                         /* size_t */
+#include <pthread.h>
+#include <zlib.h>                           /* gzFile */
+#include "asyncwriter.h"                    /* Own work */
+
+
+/* Variables */
+enum OutputMode {
+   FILES_OUTPUT,           /* One file per diagram (default). */
+   TAR_OUTPUT,             /* Every diagram in a single tar archive. */
+   STREAM_OUTPUT           /* "name\0svg\0" entries on the standard output. */
+};
+
+typedef struct DiagramOutput {
+   enum OutputMode Mode;
+   FILE* File;             /* Archive or standard output (NULL in FILES_OUTPUT mode). */
+   bool StandardOutput;    /* File must not be closed. */
+   gzFile CompressedFile;  /* Compressed stream (-z -0), written instead of File. */
+   long Timestamp;         /* Modification time of archive entries. */
+   int NextDiagramNumber;  /* Entries are appended in the order of their numbers. */
+   AsyncWriter* Writer;    /* FILES_OUTPUT: written in the background, else NULL. */
+   pthread_mutex_t Mutex;
+   pthread_cond_t Turn;
+} DiagramOutput;
+
+/* Methods */
+bool writeBufferToFile(const char* sOutputFile, const char* pData, size_t nLength);
+DiagramOutput* openDiagramOutput(enum OutputMode enuMode, const char* sArchiveName,
+    int nFirstDiagramNumber, bool bCompressedStream, bool bAsynchronousFiles);
+bool writeDiagramOutput(DiagramOutput* outDiagram, int nDiagramNumber, const char* sFileName,
+    const char* pData, size_t nLength);
+bool writeDiagramEntry(DiagramOutput* outDiagram, int nDiagramNumber, const char* sFileName,
+    const char* pData, size_t nLength, bool bLastEntry);
+void skipDiagramOutput(DiagramOutput* outDiagram, int nDiagramNumber, int nCount);
+bool writeSharedOutput(DiagramOutput* outDiagram, const char* sFileName, const char* pData,
+    size_t nLength);
+bool flushDiagramOutput(DiagramOutput* outDiagram);
+bool closeDiagramOutput(DiagramOutput** outDiagram);
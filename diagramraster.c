@@ -0,0 +1,739 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code turns positions into bitmaps (PNG files) rather than
+ * SVG, for FEN2SVG.
+ * <p>
+ * The template is drawn (see svgraster.c) once per options: both empty boards, and a
+ * sprite per piece and move indicator. A diagram is then the copy of an empty board, over
+ * which the sprites are blended where the ready-made lines of the position (placePieces(),
+ * as for SVG) put them, then PNG encoding (with a single-pass deflate, zlib only computing
+ * checksums).
+ **/
+
+
+#include <stdio.h>      /* printf() */
+#include <stdlib.h>     /* malloc(), free(), exit() */
+#include <string.h>     /* memcpy(), strncmp() */
+#include <math.h>       /* roundf() */
+#include <zlib.h>       /* crc32() */
+#ifdef __SSE2__
+#include <emmintrin.h>  /* _mm_mullo_epi16() */
+#endif
+#include "diagramraster.h"
+
+
+DiagramRasterizer* createDiagramRasterizer(const ByteBuffer* bufTemplate, int nSquareSize) {
+
+    RasterDefinitions* defTemplate = parseRasterDefinitions((*bufTemplate).Data,
+        (*bufTemplate).Length);
+    if (!defTemplate) {
+        return NULL;
+    }
+
+    DiagramRasterizer* rstReturnValue = (DiagramRasterizer*) malloc(1 *
+        sizeof(DiagramRasterizer));
+    if (!rstReturnValue) {
+        printf("Unsuccessful malloc() in createDiagramRasterizer(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*rstReturnValue).SquareSize = nSquareSize;
+    (*rstReturnValue).Scale = (float) nSquareSize / SQUARE_WIDTH;
+    (*rstReturnValue).Definitions = defTemplate;
+    for (int nOptions = 0; nOptions < OPTION_COMBINATIONS; nOptions++) {
+        (*rstReturnValue).Atlases[nOptions] = NULL;
+    }
+    pthread_mutex_init(&(*rstReturnValue).Mutex, NULL);
+
+    return rstReturnValue;
+}
+
+
+/** Free an atlas (built partly or wholly). **/
+static void freeRasterAtlas(RasterAtlas** atlRaster) {
+
+    for (int nOrientation = 0; nOrientation < 2; nOrientation++) {
+        if ((**atlRaster).EmptyBoards[nOrientation]) {
+            freeRasterImage(&(**atlRaster).EmptyBoards[nOrientation]);
+        }
+    }
+    for (int i = 0; i < (**atlRaster).SpriteCount; i++) {
+        freeRasterImage(&(**atlRaster).Sprites[i].Image);
+    }
+    free((**atlRaster).Pieces);
+    free(*atlRaster);
+    *atlRaster = NULL;
+}
+
+
+/** Draw the definition a ready-made line uses, as a sprite of the atlas. **/
+static bool addSprite(DiagramRasterizer* rstDiagram, RasterAtlas* atlTarget,
+    const SVGLine* lnLine) {
+
+    const char* pId;
+    size_t nIdLength;
+    float nX;
+    float nY;
+    unsigned int nFill;
+    if (!readUseElement((*lnLine).Text, (*lnLine).Text + (*lnLine).Length, &pId, &nIdLength,
+        &nX, &nY, &nFill)) {
+        return false;
+    }
+    int nSymbol = findRasterSymbol((*rstDiagram).Definitions, pId, nIdLength);
+    if (nSymbol < 0 || (*atlTarget).SpriteCount >= RASTER_ATLAS_SPRITES) {
+        return false;
+    }
+
+    RasterSprite* sprNew = &(*atlTarget).Sprites[(*atlTarget).SpriteCount++];
+    (*sprNew).Symbol = &(*(*rstDiagram).Definitions).Symbols[nSymbol];
+    (*sprNew).Fill = nFill;
+    (*sprNew).Image = createRasterImage((*rstDiagram).SquareSize, (*rstDiagram).SquareSize);
+    drawRasterSymbol((*sprNew).Image, (*sprNew).Symbol, 0, 0, (*rstDiagram).Scale, nFill);
+
+    /* ROWS HOLDING ANYTHING */
+    const RasterImage* imgSprite = (*sprNew).Image;
+    (*sprNew).FirstRow = (*imgSprite).Height;
+    (*sprNew).LastRow = -1;
+    for (int y = 0; y < (*imgSprite).Height; y++) {
+        for (int x = 0; x < (*imgSprite).Width; x++) {
+            if ((*imgSprite).Pixels[((size_t) y * (*imgSprite).Width + x) * 4 + 3]) {
+                if ((*sprNew).FirstRow > y) {
+                    (*sprNew).FirstRow = y;
+                }
+                (*sprNew).LastRow = y;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Draw everything the bitmaps of a context are made of (built under the rasterizer mutex).
+ *
+ * @return  the atlas, NULL if the template lacks a definition
+ **/
+static RasterAtlas* createRasterAtlas(DiagramRasterizer* rstDiagram,
+    const RenderContext* ctxRender) {
+
+    RasterAtlas* atlReturnValue = (RasterAtlas*) malloc(1 * sizeof(RasterAtlas));
+    if (!atlReturnValue) {
+        printf("Unsuccessful malloc() in createRasterAtlas(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*atlReturnValue).SpriteCount = 0;
+    (*atlReturnValue).Pieces = createPieceTable(&(*ctxRender).Geometry, false, NULL);
+
+    /* EMPTY BOARDS */
+    int nWidth = (int) roundf(computeWholeDrawingWidth((*ctxRender).Coordinates,
+        (*ctxRender).Border, (*ctxRender).MoveIndicator) * (*rstDiagram).Scale);
+    int nHeight = (int) roundf(computeWholeDrawingHeight((*ctxRender).Coordinates,
+        (*ctxRender).Border) * (*rstDiagram).Scale);
+    bool bValid = true;
+    for (int nOrientation = 0; nOrientation < 2; nOrientation++) {
+        (*atlReturnValue).EmptyBoards[nOrientation] = createRasterImage(nWidth, nHeight);
+        ByteBuffer* bufEmptyBoard = generateEmptyBoard(&(*ctxRender).Geometry,
+            nOrientation == WHITE_AT_BOTTOM_INDEX, false, NULL);
+        bValid = bValid && drawUseElements((*atlReturnValue).EmptyBoards[nOrientation],
+            (*rstDiagram).Definitions, (*bufEmptyBoard).Data, (*bufEmptyBoard).Length,
+            (*rstDiagram).Scale);
+        freeBuffer(&bufEmptyBoard);
+    }
+
+    /* SPRITES (any square will do: they are drawn from the origin) */
+    for (int nPiece = 0; nPiece < PIECE_KINDS; nPiece++) {
+        bValid = bValid && addSprite(rstDiagram, atlReturnValue,
+            &(*(*atlReturnValue).Pieces).Pieces[nPiece][0][WHITE_AT_BOTTOM_INDEX]);
+    }
+    bValid = bValid && addSprite(rstDiagram, atlReturnValue,
+        &(*(*atlReturnValue).Pieces).MoveIndicators[WHITE_TO_PLAY_INDEX]);
+    bValid = bValid && addSprite(rstDiagram, atlReturnValue,
+        &(*(*atlReturnValue).Pieces).MoveIndicators[BLACK_TO_PLAY_INDEX]);
+
+    if (!bValid) {
+        freeRasterAtlas(&atlReturnValue);
+    }
+
+    return atlReturnValue;
+}
+
+
+/**
+ * Blend a row of premultiplied pixels over another (source over):
+ * destination = source + destination * (255 - source alpha) / 255.
+ * Four pixels at a time with SSE2, as 16-bit integers; fully transparent ones are skipped.
+ **/
+static void blendRow(unsigned char* pDestination, const unsigned char* pSource, int nPixels) {
+
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i v255 = _mm_set1_epi16(255);
+    const __m128i v128 = _mm_set1_epi16(128);
+    for (; i + 4 <= nPixels; i += 4) {
+        __m128i vSource = _mm_loadu_si128((const __m128i*) (pSource + 4 * i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(vSource, vZero)) == 0xFFFF) {
+            continue;
+        }
+        __m128i vDestination = _mm_loadu_si128((const __m128i*) (pDestination + 4 * i));
+        __m128i aResults[2];
+        for (int nHalf = 0; nHalf < 2; nHalf++) {
+            __m128i vS = nHalf ? _mm_unpackhi_epi8(vSource, vZero) :
+                _mm_unpacklo_epi8(vSource, vZero);
+            __m128i vD = nHalf ? _mm_unpackhi_epi8(vDestination, vZero) :
+                _mm_unpacklo_epi8(vDestination, vZero);
+            /* Alpha of each pixel in its four channels. */
+            __m128i vAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(vS, 0xFF), 0xFF);
+            __m128i vProduct = _mm_add_epi16(_mm_mullo_epi16(vD, _mm_sub_epi16(v255, vAlpha)),
+                v128);
+            /* x / 255, rounded: (x + 128 + ((x + 128) >> 8)) >> 8 */
+            vProduct = _mm_srli_epi16(_mm_add_epi16(vProduct, _mm_srli_epi16(vProduct, 8)), 8);
+            aResults[nHalf] = _mm_add_epi16(vS, vProduct);
+        }
+        _mm_storeu_si128((__m128i*) (pDestination + 4 * i),
+            _mm_packus_epi16(aResults[0], aResults[1]));
+    }
+#endif
+    for (; i < nPixels; i++) {
+        const unsigned char* pS = pSource + 4 * i;
+        unsigned char* pD = pDestination + 4 * i;
+        unsigned int nInverse = 255u - pS[3];
+        if (pS[3] == 0 && !(pS[0] | pS[1] | pS[2])) {
+            continue;
+        }
+        for (int c = 0; c < 4; c++) {
+            unsigned int t = pD[c] * nInverse + 128;
+            unsigned int nValue = pS[c] + ((t + (t >> 8)) >> 8);
+            pD[c] = (unsigned char) (nValue > 255 ? 255 : nValue);
+        }
+    }
+}
+
+
+/** Blend a sprite over an image, its origin at (nX, nY), clipped to the image. **/
+static void blitSprite(RasterImage* imgTarget, const RasterSprite* sprDrawn, int nX, int nY) {
+
+    const RasterImage* imgSprite = (*sprDrawn).Image;
+    int nFirstColumn = (nX < 0) ? -nX : 0;
+    int nLastColumn = (*imgSprite).Width - 1;
+    if (nX + nLastColumn >= (*imgTarget).Width) {
+        nLastColumn = (*imgTarget).Width - 1 - nX;
+    }
+    if (nFirstColumn > nLastColumn) {
+        return;
+    }
+    for (int y = (*sprDrawn).FirstRow; y <= (*sprDrawn).LastRow; y++) {
+        if (nY + y < 0 || nY + y >= (*imgTarget).Height) {
+            continue;
+        }
+        blendRow((*imgTarget).Pixels + ((size_t) (nY + y) * (*imgTarget).Width + nX
+            + nFirstColumn) * 4, (*imgSprite).Pixels + ((size_t) y * (*imgSprite).Width
+            + nFirstColumn) * 4, nLastColumn - nFirstColumn + 1);
+    }
+}
+
+
+/**
+ * Deflate codes (RFC 1951) of the fixed Huffman tables, bits reversed so that they can be
+ * written least significant bit first. Filled once, by initFixedCodes().
+ **/
+static unsigned short anLiteralCodes[288];      /* [literal or length symbol] */
+static unsigned char anLiteralBits[288];
+static unsigned short anLengthSymbols[259];     /* [match length] -> symbol, from 257 */
+static unsigned char anLengthExtraBits[259];
+static unsigned short anLengthExtraValues[259];
+static pthread_once_t onceFixedCodes = PTHREAD_ONCE_INIT;
+
+
+/** Reverse the nBits lowest bits of a code. **/
+static unsigned int reverseBits(unsigned int nCode, int nBits) {
+
+    unsigned int nReturnValue = 0;
+    for (int i = 0; i < nBits; i++) {
+        nReturnValue = (nReturnValue << 1) | ((nCode >> i) & 1);
+    }
+
+    return nReturnValue;
+}
+
+
+static void initFixedCodes(void) {
+
+    for (int nSymbol = 0; nSymbol < 288; nSymbol++) {
+        unsigned int nCode;
+        int nBits;
+        if (nSymbol < 144) {
+            nCode = 0x30 + nSymbol;
+            nBits = 8;
+        }
+        else if (nSymbol < 256) {
+            nCode = 0x190 + (nSymbol - 144);
+            nBits = 9;
+        }
+        else if (nSymbol < 280) {
+            nCode = nSymbol - 256;
+            nBits = 7;
+        }
+        else {
+            nCode = 0xC0 + (nSymbol - 280);
+            nBits = 8;
+        }
+        anLiteralCodes[nSymbol] = (unsigned short) reverseBits(nCode, nBits);
+        anLiteralBits[nSymbol] = (unsigned char) nBits;
+    }
+
+    /* Lengths 3 to 258: symbols 257 to 285, with extra bits. */
+    static const unsigned short anBases[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19,
+        23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const unsigned char anExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+        2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    for (int nLength = 3; nLength <= 258; nLength++) {
+        int i = 28;
+        while (anBases[i] > nLength) {
+            i--;
+        }
+        anLengthSymbols[nLength] = (unsigned short) (257 + i);
+        anLengthExtraBits[nLength] = anExtraBits[i];
+        anLengthExtraValues[nLength] = (unsigned short) (nLength - anBases[i]);
+    }
+}
+
+
+/** Bits waiting to be written, least significant first. **/
+typedef struct BitWriter {
+   unsigned long long Bits;
+   int Count;
+   unsigned char* Output;  /* Next byte to write (room is reserved beforehand). */
+} BitWriter;
+
+
+static inline void writeBits(BitWriter* btwOutput, unsigned int nValue, int nBits) {
+
+    (*btwOutput).Bits |= (unsigned long long) nValue << (*btwOutput).Count;
+    (*btwOutput).Count += nBits;
+    if ((*btwOutput).Count >= 32) {
+        for (int i = 0; i < 4; i++) {
+            (*btwOutput).Output[i] = (unsigned char) ((*btwOutput).Bits >> (8 * i));
+        }
+        (*btwOutput).Output += 4;
+        (*btwOutput).Bits >>= 32;
+        (*btwOutput).Count -= 32;
+    }
+}
+
+
+/** Write the literals of two bytes at once (at most 18 bits). **/
+static inline void writeLiteralPair(BitWriter* btwOutput, const unsigned char* pBytes) {
+
+    writeBits(btwOutput, anLiteralCodes[pBytes[0]]
+        | ((unsigned int) anLiteralCodes[pBytes[1]] << anLiteralBits[pBytes[0]]),
+        anLiteralBits[pBytes[0]] + anLiteralBits[pBytes[1]]);
+}
+
+
+/** Write the bits left, the last byte being padded with zeros. **/
+static void flushBits(BitWriter* btwOutput) {
+
+    while ((*btwOutput).Count > 0) {
+        *(*btwOutput).Output++ = (unsigned char) (*btwOutput).Bits;
+        (*btwOutput).Bits >>= 8;
+        (*btwOutput).Count -= 8;
+    }
+    (*btwOutput).Count = 0;
+}
+
+
+/**
+ * Bits of a match distance (1 to 32768): its 5-bit code followed by its extra bits, to be
+ * written in one go.
+ **/
+static void getDistanceCode(int nDistance, unsigned int* nCode, int* nBits) {
+
+    int nSymbol = nDistance - 1;
+    int nBase = nDistance;
+    int nExtraBits = 0;
+    if (nDistance > 4) {
+        /* Two symbols per power of two, from 5 (symbols 4 and 5: 1 extra bit). */
+        while ((2 << (nExtraBits + 1)) < nDistance) {
+            nExtraBits++;
+        }
+        nBase = (2 << nExtraBits) + 1;
+        nSymbol = 2 + 2 * nExtraBits;
+        if (nDistance >= nBase + (1 << nExtraBits)) {
+            nBase += 1 << nExtraBits;
+            nSymbol++;
+        }
+    }
+    *nCode = reverseBits((unsigned int) nSymbol, 5) | ((unsigned int) (nDistance - nBase) << 5);
+    *nBits = 5 + nExtraBits;
+}
+
+
+/** Number of equal bytes at the start of two blocks, at most nMaximum. **/
+static inline int getMatchLength(const unsigned char* pA, const unsigned char* pB, int nMaximum) {
+
+    int nLength = 0;
+#ifdef __SSE2__
+    while (nLength + 16 <= nMaximum) {
+        int nMask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*) (pA + nLength)),
+            _mm_loadu_si128((const __m128i*) (pB + nLength))));
+        if (nMask != 0xFFFF) {
+            return nLength + __builtin_ctz(~nMask);
+        }
+        nLength += 16;
+    }
+#endif
+    while (nLength + 8 <= nMaximum) {
+        unsigned long long nA;
+        unsigned long long nB;
+        memcpy(&nA, pA + nLength, 8);
+        memcpy(&nB, pB + nLength, 8);
+        if (nA != nB) {
+            return nLength + __builtin_ctzll(nA ^ nB) / 8;
+        }
+        nLength += 8;
+    }
+    while (nLength < nMaximum && pA[nLength] == pB[nLength]) {
+        nLength++;
+    }
+
+    return nLength;
+}
+
+
+/**
+ * Adler-32 (as adler32() of zlib) of more bytes. With SSE2, 16 bytes at a time: a block adds
+ * the sum of its bytes to s1 and, to s2, 16 times s1 before it plus its bytes weighted 16
+ * down to 1.
+ **/
+static unsigned long updateAdler32(unsigned long nAdler, const unsigned char* pData,
+    size_t nLength) {
+
+    unsigned long long s1 = nAdler & 0xFFFF;
+    unsigned long long s2 = nAdler >> 16;
+    while (nLength > 0) {
+        /* Sums cannot overflow before the modulo. */
+        size_t nChunk = (nLength < ADLER32_CHUNK_LENGTH) ? nLength : ADLER32_CHUNK_LENGTH;
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i vZero = _mm_setzero_si128();
+        const __m128i vHighWeights = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+        const __m128i vLowWeights = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+        __m128i vSum = vZero;           /* s1 of the chunk so far. */
+        __m128i vPreviousSums = vZero;  /* Sum of vSum before each block. */
+        __m128i vWeighted = vZero;
+        for (; i + 16 <= nChunk; i += 16) {
+            __m128i vBytes = _mm_loadu_si128((const __m128i*) (pData + i));
+            vPreviousSums = _mm_add_epi32(vPreviousSums, vSum);
+            vSum = _mm_add_epi32(vSum, _mm_sad_epu8(vBytes, vZero));
+            vWeighted = _mm_add_epi32(vWeighted, _mm_madd_epi16(
+                _mm_unpacklo_epi8(vBytes, vZero), vHighWeights));
+            vWeighted = _mm_add_epi32(vWeighted, _mm_madd_epi16(
+                _mm_unpackhi_epi8(vBytes, vZero), vLowWeights));
+        }
+        unsigned int aSum[4];
+        unsigned int aPreviousSums[4];
+        unsigned int aWeighted[4];
+        _mm_storeu_si128((__m128i*) aSum, vSum);
+        _mm_storeu_si128((__m128i*) aPreviousSums, vPreviousSums);
+        _mm_storeu_si128((__m128i*) aWeighted, vWeighted);
+        s2 += 16 * (s1 * (i / 16) + aPreviousSums[0] + aPreviousSums[2])
+            + (unsigned long long) aWeighted[0] + aWeighted[1] + aWeighted[2] + aWeighted[3];
+        s1 += aSum[0] + aSum[2];
+#endif
+        for (; i < nChunk; i++) {
+            s1 += pData[i];
+            s2 += s1;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+        pData += nChunk;
+        nLength -= nChunk;
+    }
+
+    return (unsigned long) ((s2 << 16) | s1);
+}
+
+
+/** Append a PNG chunk header; its length and CRC are set by endPNGChunk(). **/
+static size_t startPNGChunk(ByteBuffer* bufPNG, const char* sType) {
+
+    size_t nStart = (*bufPNG).Length;
+    appendToBuffer(bufPNG, "\0\0\0\0", 4);
+    appendToBuffer(bufPNG, sType, 4);
+
+    return nStart;
+}
+
+
+static void appendBigEndian(unsigned char* pOutput, unsigned long nValue) {
+
+    pOutput[0] = (unsigned char) (nValue >> 24);
+    pOutput[1] = (unsigned char) (nValue >> 16);
+    pOutput[2] = (unsigned char) (nValue >> 8);
+    pOutput[3] = (unsigned char) nValue;
+}
+
+
+static void endPNGChunk(ByteBuffer* bufPNG, size_t nStart) {
+
+    unsigned char* pChunk = (unsigned char*) (*bufPNG).Data + nStart;
+    size_t nDataLength = (*bufPNG).Length - nStart - 8;
+    appendBigEndian(pChunk, (unsigned long) nDataLength);
+    unsigned char aCRC[4];
+    appendBigEndian(aCRC, crc32(0, pChunk + 4, (uInt) (nDataLength + 4)));
+    appendToBuffer(bufPNG, (const char*) aCRC, 4);
+}
+
+
+/**
+ * Encode an image as PNG (RGBA, alpha no longer premultiplied, rows unfiltered).
+ * <p>
+ * Rather than searching for matches as zlib does, the deflate data only copies from the
+ * same bytes one row above (most of an empty board) or one pixel to the left (inside
+ * squares and pieces), using the fixed Huffman codes: encoding is a single pass, several
+ * times faster than zlib at its fastest level, for files hardly larger.
+ *
+ * @param   pRows       room for two rows of the image
+ * @param   bufPNG      emptied, then filled with the PNG file
+ **/
+static void encodePNG(const RasterImage* imgEncoded, unsigned char* pRows, ByteBuffer* bufPNG) {
+
+    pthread_once(&onceFixedCodes, initFixedCodes);
+    int nStride = 1 + 4 * (*imgEncoded).Width;          /* Filter byte, then pixels. */
+
+    /* SIGNATURE AND HEADER */
+    clearBuffer(bufPNG);
+    appendToBuffer(bufPNG, "\x89PNG\r\n\x1a\n", 8);
+    size_t nChunk = startPNGChunk(bufPNG, "IHDR");
+    unsigned char aHeader[13] = {0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0};  /* 8-bit RGBA. */
+    appendBigEndian(aHeader, (unsigned long) (*imgEncoded).Width);
+    appendBigEndian(aHeader + 4, (unsigned long) (*imgEncoded).Height);
+    appendToBuffer(bufPNG, (const char*) aHeader, 13);
+    endPNGChunk(bufPNG, nChunk);
+
+    /* IMAGE DATA: zlib header, a single fixed Huffman block, Adler-32 */
+    nChunk = startPNGChunk(bufPNG, "IDAT");
+    appendToBuffer(bufPNG, "\x78\x01", 2);
+    unsigned int nUpCode;
+    int nUpBits;
+    getDistanceCode(nStride, &nUpCode, &nUpBits);
+    unsigned int nLeftCode;
+    int nLeftBits;
+    getDistanceCode(4, &nLeftCode, &nLeftBits);
+    unsigned long nAdler = 1;
+    BitWriter btwOutput = {0, 0, NULL};
+    unsigned char* pPrevious = NULL;
+    for (int y = 0; y < (*imgEncoded).Height; y++) {
+        /* ROW, AS PNG HOLDS IT */
+        unsigned char* pRow = pRows + (size_t) (y % 2) * nStride;
+        const unsigned char* pPixel = (*imgEncoded).Pixels + (size_t) y * (*imgEncoded).Width * 4;
+        pRow[0] = 0;
+        memcpy(pRow + 1, pPixel, (size_t) (*imgEncoded).Width * 4);
+        for (int x = 0; x < 4 * (*imgEncoded).Width; x += 4) {
+            if (x % 8 == 0 && x + 8 <= 4 * (*imgEncoded).Width) {
+                /* Two opaque or transparent pixels (as almost all are) are left as they are. */
+                unsigned long long nAlphas;
+                memcpy(&nAlphas, pPixel + x, 8);
+                nAlphas &= 0xFF000000FF000000ull;
+                if (nAlphas == 0xFF000000FF000000ull || nAlphas == 0) {
+                    x += 4;
+                    continue;
+                }
+            }
+            unsigned int nAlpha = pPixel[x + 3];
+            if (nAlpha == 255 || nAlpha == 0) {
+                continue;
+            }
+            for (int c = 0; c < 3; c++) {
+                unsigned int nValue = (pPixel[x + c] * 255u + nAlpha / 2) / nAlpha;
+                pRow[1 + x + c] = (unsigned char) (nValue > 255 ? 255 : nValue);
+            }
+        }
+        nAdler = updateAdler32(nAdler, pRow, (size_t) nStride);
+
+        /* DEFLATE IT (a literal takes at most 9 bits) */
+        size_t nOffset = (*bufPNG).Length;
+        reserveBuffer(bufPNG, (size_t) nStride * 9 / 8 + 16);
+        btwOutput.Output = (unsigned char*) (*bufPNG).Data + nOffset;
+        if (y == 0) {
+            writeBits(&btwOutput, 3, 3);                /* Last block, fixed codes. */
+        }
+        for (int i = 0; i < nStride; ) {
+            int nMaximum = (nStride - i < 258) ? nStride - i : 258;
+            int nUp = pPrevious ? getMatchLength(pRow + i, pPrevious + i, nMaximum) : 0;
+            int nLeft = (i >= 5 && nUp < PNG_SHORT_MATCH_LENGTH)
+                ? getMatchLength(pRow + i, pRow + i - 4, nMaximum) : 0;
+            int nLength = (nUp >= nLeft) ? nUp : nLeft;
+            if (nLength < 3 && i % 4 == 1) {
+                /* The whole pixel: its other bytes seldom start a match. */
+                writeLiteralPair(&btwOutput, pRow + i);
+                writeLiteralPair(&btwOutput, pRow + i + 2);
+                i += 4;
+                continue;
+            }
+            if (nLength < 3) {
+                /* Up to the next pixel. */
+                do {
+                    writeBits(&btwOutput, anLiteralCodes[pRow[i]], anLiteralBits[pRow[i]]);
+                    i++;
+                } while (i % 4 != 1 && i < nStride);
+                continue;
+            }
+            int nSymbol = anLengthSymbols[nLength];
+            writeBits(&btwOutput, anLiteralCodes[nSymbol], anLiteralBits[nSymbol]);
+            writeBits(&btwOutput, anLengthExtraValues[nLength], anLengthExtraBits[nLength]);
+            if (nUp >= nLeft) {
+                writeBits(&btwOutput, nUpCode, nUpBits);
+            }
+            else {
+                writeBits(&btwOutput, nLeftCode, nLeftBits);
+            }
+            i += nLength;
+        }
+        (*bufPNG).Length = (size_t) ((char*) btwOutput.Output - (*bufPNG).Data);
+        pPrevious = pRow;
+    }
+    reserveBuffer(bufPNG, 16);
+    btwOutput.Output = (unsigned char*) (*bufPNG).Data + (*bufPNG).Length;
+    writeBits(&btwOutput, anLiteralCodes[256], anLiteralBits[256]);     /* End of block. */
+    flushBits(&btwOutput);
+    (*bufPNG).Length = (size_t) ((char*) btwOutput.Output - (*bufPNG).Data);
+    unsigned char aAdler[4];
+    appendBigEndian(aAdler, nAdler);
+    appendToBuffer(bufPNG, (const char*) aAdler, 4);
+    endPNGChunk(bufPNG, nChunk);
+
+    /* END */
+    nChunk = startPNGChunk(bufPNG, "IEND");
+    endPNGChunk(bufPNG, nChunk);
+}
+
+
+/**
+ * Turn one position into a PNG file, in a buffer:
+ * 1. Copy the empty board matching the orientation.
+ * 2. Blend the sprite of every piece where its ready-made line puts it (see placePieces()).
+ * 3. Encode the bitmap.
+ * <p>
+ * Any thread can call it at once, as long as each one has its own buffers: atlases are only
+ * read once built.
+ *
+ * @param   rstDiagram      rasterizer shared by every diagram
+ * @param   ctxRender       context of the options of the diagram
+ * @param   nOptions        those options (index of the atlas)
+ * @param   brdPosition     chess position (see parseFEN())
+ * @param   bufCanvas       holds the bitmap while it is drawn
+ * @param   bufPNG          emptied, then filled with the PNG file
+ * @return  length of the PNG file, or RENDER_INVALID_TEMPLATE
+ **/
+long rasterizeDiagram(DiagramRasterizer* rstDiagram, const RenderContext* ctxRender,
+    int nOptions, const ChessBoard* brdPosition, ByteBuffer* bufCanvas, ByteBuffer* bufPNG) {
+
+    if (nOptions < 0 || nOptions >= OPTION_COMBINATIONS) {
+        return RENDER_INVALID_TEMPLATE;
+    }
+
+    /* ATLAS (no lock needed once published, see getRenderContext()) */
+    RasterAtlas* atlRaster = __atomic_load_n(&(*rstDiagram).Atlases[nOptions],
+        __ATOMIC_ACQUIRE);
+    if (!atlRaster) {
+        pthread_mutex_lock(&(*rstDiagram).Mutex);
+        atlRaster = (*rstDiagram).Atlases[nOptions];
+        if (!atlRaster) {
+            atlRaster = createRasterAtlas(rstDiagram, ctxRender);
+            __atomic_store_n(&(*rstDiagram).Atlases[nOptions], atlRaster, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&(*rstDiagram).Mutex);
+        if (!atlRaster) {
+            return RENDER_INVALID_TEMPLATE;
+        }
+    }
+
+    /* PIECE LINES, AS FOR SVG */
+    char sLines[(64+1) * SVG_LINE_MAX_LENGTH];
+    long nLinesLength = placePieces((*atlRaster).Pieces, brdPosition, (*ctxRender).MoveIndicator,
+        (*ctxRender).RotateBoard, sLines, sizeof(sLines));
+    if (nLinesLength < 0) {
+        return nLinesLength;
+    }
+
+    /* EMPTY BOARD (two rows of room are kept after the bitmap, for encoding) */
+    const RasterImage* imgEmptyBoard = (*atlRaster).EmptyBoards[
+        (getEmptyDiagram(ctxRender, brdPosition) == (*ctxRender).NormalEmptyDiagram) ?
+        WHITE_AT_BOTTOM_INDEX : BLACK_AT_BOTTOM_INDEX];
+    size_t nBitmapLength = (size_t) (*imgEmptyBoard).Width * (*imgEmptyBoard).Height * 4;
+    clearBuffer(bufCanvas);
+    reserveBuffer(bufCanvas, nBitmapLength + 2 * (1 + (size_t) (*imgEmptyBoard).Width * 4));
+    memcpy((*bufCanvas).Data, (*imgEmptyBoard).Pixels, nBitmapLength);
+    RasterImage imgDiagram = {(*imgEmptyBoard).Width, (*imgEmptyBoard).Height,
+        (unsigned char*) (*bufCanvas).Data};
+
+    /* PIECES */
+    const char* pEnd = sLines + nLinesLength;
+    for (const char* p = sLines; p < pEnd; ) {
+        const char* pLineEnd = memchr(p, '\n', (size_t) (pEnd - p));
+        if (!pLineEnd) {
+            pLineEnd = pEnd;
+        }
+        const char* pId;
+        size_t nIdLength;
+        float nX;
+        float nY;
+        unsigned int nFill;
+        if (readUseElement(p, pLineEnd, &pId, &nIdLength, &nX, &nY, &nFill)) {
+            for (int i = 0; i < (*atlRaster).SpriteCount; i++) {
+                const RasterSprite* sprCurrent = &(*atlRaster).Sprites[i];
+                if ((*sprCurrent).Fill == nFill
+                    && strncmp((*(*sprCurrent).Symbol).Id, pId, nIdLength) == 0
+                    && (*(*sprCurrent).Symbol).Id[nIdLength] == '\0') {
+                    blitSprite(&imgDiagram, sprCurrent, (int) roundf(nX * (*rstDiagram).Scale),
+                        (int) roundf(nY * (*rstDiagram).Scale));
+                    break;
+                }
+            }
+        }
+        p = pLineEnd + 1;
+    }
+
+    /* PNG */
+    encodePNG(&imgDiagram, (unsigned char*) (*bufCanvas).Data + nBitmapLength, bufPNG);
+
+    return (long) (*bufPNG).Length;
+}
+
+
+/* Free a rasterizer and every atlas it built. */
+void freeDiagramRasterizer(DiagramRasterizer** rstDiagram) {
+
+    for (int nOptions = 0; nOptions < OPTION_COMBINATIONS; nOptions++) {
+        if ((**rstDiagram).Atlases[nOptions]) {
+            freeRasterAtlas(&(**rstDiagram).Atlases[nOptions]);
+        }
+    }
+    freeRasterDefinitions(&(**rstDiagram).Definitions);
+    pthread_mutex_destroy(&(**rstDiagram).Mutex);
+    free(*rstDiagram);
+    *rstDiagram = NULL;
+}
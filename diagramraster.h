@@ -0,0 +1,71 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for diagramraster.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "libfen2svg.h"
+#include "svgraster.h"
+
+#define RASTER_MIN_SQUARE_SIZE 8            /* Pixels per square (--png). */
+#define RASTER_MAX_SQUARE_SIZE 288
+#define RASTER_ATLAS_SPRITES (PIECE_KINDS + 2)  /* Pieces and move indicators. */
+#define PNG_SHORT_MATCH_LENGTH 16           /* Shorter copies from above: try the left too. */
+#define ADLER32_CHUNK_LENGTH 5552           /* Bytes summed between two modulos (16 x 347). */
+
+
+/* Variables */
+typedef struct RasterSprite {
+   const RasterSymbol* Symbol;
+   unsigned int Fill;      /* Given by the use line (move indicator), else RASTER_NO_COLOUR. */
+   RasterImage* Image;     /* Drawn once, from the origin of the square. */
+   int FirstRow;           /* Rows holding anything: the others are not blended. */
+   int LastRow;
+} RasterSprite;
+
+/**
+ * What every bitmap of given options is made of: both empty boards, then a sprite per
+ * piece, blended where the piece lines of the diagram put them.
+ **/
+typedef struct RasterAtlas {
+   RasterImage* EmptyBoards[2];            /* [orientation] */
+   PieceTable* Pieces;                     /* Lines as in the template (neither compact ids nor
+                                              sprite file): they are read back. */
+   RasterSprite Sprites[RASTER_ATLAS_SPRITES];
+   int SpriteCount;
+} RasterAtlas;
+
+typedef struct DiagramRasterizer {
+   int SquareSize;         /* Pixels per square. */
+   float Scale;            /* Pixels per template unit. */
+   RasterDefinitions* Definitions;
+   RasterAtlas* Atlases[OPTION_COMBINATIONS]; /* Built when first needed. */
+   pthread_mutex_t Mutex;
+} DiagramRasterizer;
+
+/* Methods */
+DiagramRasterizer* createDiagramRasterizer(const ByteBuffer* bufTemplate, int nSquareSize);
+long rasterizeDiagram(DiagramRasterizer* rstDiagram, const RenderContext* ctxRender,
+    int nOptions, const ChessBoard* brdPosition, ByteBuffer* bufCanvas, ByteBuffer* bufPNG);
+void freeDiagramRasterizer(DiagramRasterizer** rstDiagram);
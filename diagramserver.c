@@ -0,0 +1,357 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code lets FEN2SVG run as a daemon: the template is read once
+ * and the empty boards are built once for every combination of options (when first
+ * requested), then diagrams are served from memory over a Unix socket.
+ * <p>
+ * The protocol is made of lines, the same as in FEN files: a FEN string, then possibly
+ * tab-separated comments and options (e.g. "-bcm"). Each request is answered, in order, with
+ * "OK <length>\n" followed by the diagram, or with "ERROR <reason>\n". Blank lines are
+ * ignored.
+ * <p>
+ * A connection stays open for as many requests as the client wishes (keep-alive), and
+ * requests can be sent without waiting for answers (pipelining): every request received
+ * at once is answered with a single write. Each connection is served by its own thread.
+ **/
+
+
+#include "diagramserver.h"
+
+#ifdef _WIN32                               /* No Unix socket. */
+
+bool runDiagramServer(const char* sSocketPath, char* sTemplateFile, int nDefaultOptions) {
+    (void) sSocketPath;
+    (void) sTemplateFile;
+    (void) nDefaultOptions;
+    fprintf(stderr, "Error: server mode is not available on this system.\n");
+    return false;
+}
+
+#else
+
+#include <stdio.h>          /* printf(), snprintf() */
+#include <stdlib.h>         /* malloc(), free(), exit() */
+#include <string.h>         /* memchr(), memcpy(), strlen() */
+#include <errno.h>
+#include <signal.h>         /* sigaction() */
+#include <unistd.h>         /* read(), close(), unlink() */
+#include <sys/socket.h>
+#include <sys/stat.h>       /* stat(), S_ISSOCK() */
+#include <sys/un.h>         /* struct sockaddr_un */
+
+
+/* Set by SIGINT or SIGTERM: stop accepting connections. */
+static volatile sig_atomic_t bStopRequested = false;
+
+
+/* A client, and the server it is connected to. */
+typedef struct ServerConnection {
+   DiagramServer* Server;
+   int Socket;
+} ServerConnection;
+
+
+static void requestStop(int nSignal) {
+    (void) nSignal;
+    bStopRequested = true;
+}
+
+
+/**
+ * Write a whole block to a socket, however many calls it takes.
+ *
+ * @return  false if the client went away
+ **/
+static bool sendAll(int nSocket, const char* pData, size_t nLength) {
+
+    while (nLength > 0) {
+        ssize_t nSent = send(nSocket, pData, nLength, MSG_NOSIGNAL);
+        if (nSent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        pData += nSent;
+        nLength -= (size_t) nSent;
+    }
+
+    return true;
+}
+
+
+/**
+ * Answer one request line (without its '\n'): the answer is appended to bufAnswers.
+ *
+ * @param   bufDiagram  scratch space (it only grows the first times)
+ **/
+static void answerRequest(DiagramServer* srvDiagram, const char* sLine, size_t nLength,
+    ByteBuffer* bufDiagram, ByteBuffer* bufAnswers) {
+
+    /* REMOVE TRAILING '\r' AND SKIP BLANK LINES. */
+    if (nLength > 0 && sLine[nLength-1] == '\r') {
+        nLength--;
+    }
+    if (nLength == 0) {
+        return;
+    }
+
+    /* OPTIONS, THEN FEN STRING (first column). */
+    const RenderContext* ctxRender = getRenderContext((*srvDiagram).Renderers,
+        getLineOptions(sLine, nLength, (*srvDiagram).DefaultOptions));
+    if (!ctxRender) {
+        appendStringToBuffer(bufAnswers, "ERROR unknown option\n");
+        return;
+    }
+    const char* pTab = memchr(sLine, '\t', nLength);
+    size_t nFENLength = pTab ? (size_t) (pTab - sLine) : nLength;
+
+    /* RENDER. */
+    reserveBuffer(bufDiagram, getMaxDiagramLength(ctxRender));
+    long nDiagramLength = renderFEN(ctxRender, sLine, nFENLength, (*bufDiagram).Data,
+        (*bufDiagram).Capacity);
+    if (nDiagramLength < 0) {
+        appendStringToBuffer(bufAnswers, nDiagramLength == RENDER_INVALID_FEN ?
+            "ERROR invalid FEN string\n" : "ERROR cannot render diagram\n");
+        return;
+    }
+
+    /* HEADER AND DIAGRAM. */
+    char sHeader[SERVER_HEADER_MAX_LENGTH];
+    int nHeaderLength = snprintf(sHeader, SERVER_HEADER_MAX_LENGTH, "OK %ld\n", nDiagramLength);
+    appendToBuffer(bufAnswers, sHeader, (size_t) nHeaderLength);
+    appendToBuffer(bufAnswers, (*bufDiagram).Data, (size_t) nDiagramLength);
+}
+
+
+/**
+ * Body of a connection thread: answer requests until the client closes the connection.
+ **/
+static void* serveConnection(void* pConnection) {
+
+    ServerConnection* cnxClient = (ServerConnection*) pConnection;
+    DiagramServer* srvDiagram = (*cnxClient).Server;
+
+    /* Allocated once per connection: answering a request does not allocate (but the first
+       time answers grow). */
+    char* pRequests = (char*) malloc(SERVER_REQUEST_MAX_LENGTH);
+    if (!pRequests) {
+        printf("Unsuccessful malloc() in serveConnection(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    ByteBuffer* bufAnswers = createEmptyBuffer();
+    ByteBuffer* bufDiagram = createEmptyBuffer();
+    size_t nReceived = 0;                   /* Bytes of requests not answered yet. */
+    bool bDiscarding = false;               /* Skipping the end of a request too long. */
+
+    while (true) {
+        /* RECEIVE WHATEVER WAS SENT. */
+        ssize_t nRead = read((*cnxClient).Socket, pRequests + nReceived,
+            SERVER_REQUEST_MAX_LENGTH - nReceived);
+        if (nRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nRead <= 0) {
+            break;
+        }
+        nReceived += (size_t) nRead;
+
+        /* ANSWER EVERY COMPLETE LINE. */
+        size_t nStart = 0;
+        char* pEnd;
+        while ((pEnd = memchr(pRequests + nStart, '\n', nReceived - nStart))) {
+            size_t nLineLength = (size_t) (pEnd - (pRequests + nStart));
+            if (!bDiscarding) {
+                answerRequest(srvDiagram, pRequests + nStart, nLineLength, bufDiagram,
+                    bufAnswers);
+            }
+            bDiscarding = false;
+            nStart += nLineLength + 1;
+        }
+        memmove(pRequests, pRequests + nStart, nReceived - nStart);
+        nReceived -= nStart;
+
+        /* A REQUEST TOO LONG IS ANSWERED AT ONCE, ITS END IS DISCARDED. */
+        if (nReceived == SERVER_REQUEST_MAX_LENGTH) {
+            if (!bDiscarding) {
+                appendStringToBuffer(bufAnswers, "ERROR request too long\n");
+            }
+            bDiscarding = true;
+            nReceived = 0;
+        }
+
+        /* SEND EVERY ANSWER AT ONCE. */
+        if (!sendAll((*cnxClient).Socket, (*bufAnswers).Data, (*bufAnswers).Length)) {
+            break;
+        }
+        clearBuffer(bufAnswers);
+    }
+
+    /* CLOSE CONNECTION. */
+    close((*cnxClient).Socket);
+    freeBuffer(&bufAnswers);
+    freeBuffer(&bufDiagram);
+    free(pRequests);
+    pthread_mutex_lock(&(*srvDiagram).Mutex);
+    (*srvDiagram).ActiveConnections--;
+    pthread_mutex_unlock(&(*srvDiagram).Mutex);
+    free(cnxClient);
+
+    return NULL;
+}
+
+
+/**
+ * Create the socket, bound to sSocketPath and listening.
+ * A socket file left by a previous run is replaced (any other file is not).
+ *
+ * @return  the socket, -1 on error
+ **/
+static int openServerSocket(const char* sSocketPath) {
+
+    struct sockaddr_un adrServer;
+    memset(&adrServer, 0, sizeof(adrServer));
+    adrServer.sun_family = AF_UNIX;
+    if (strlen(sSocketPath) >= sizeof(adrServer.sun_path)) {
+        fprintf(stderr, "Error: socket path too long (%s).\n", sSocketPath);
+        return -1;
+    }
+    strcpy(adrServer.sun_path, sSocketPath);
+
+    struct stat stsExisting;
+    if (stat(sSocketPath, &stsExisting) == 0 && S_ISSOCK(stsExisting.st_mode)) {
+        unlink(sSocketPath);
+    }
+
+    int nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (nSocket < 0) {
+        fprintf(stderr, "Error: cannot create socket (%s).\n", strerror(errno));
+        return -1;
+    }
+    if (bind(nSocket, (struct sockaddr*) &adrServer, sizeof(adrServer)) != 0
+        || listen(nSocket, SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "Error: cannot listen on %s (%s).\n", sSocketPath, strerror(errno));
+        close(nSocket);
+        return -1;
+    }
+
+    return nSocket;
+}
+
+
+/**
+ * Serve diagrams on a Unix socket until SIGINT or SIGTERM is received.
+ *
+ * @param   sSocketPath     file name of the socket
+ * @param   sTemplateFile   SVG definitions (e.g. SVG_TEMPLATE), NULL for the template built
+ *                          into the program
+ * @param   nDefaultOptions options of requests without options column (e.g. BORDER_OPTION)
+ * @return  false if the template cannot be read or the socket cannot be created
+ **/
+bool runDiagramServer(const char* sSocketPath, char* sTemplateFile, int nDefaultOptions) {
+
+    DiagramServer* srvDiagram = (DiagramServer*) malloc(1 * sizeof(DiagramServer));
+    if (!srvDiagram) {
+        printf("Unsuccessful malloc() in runDiagramServer(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* 1 - READ TEMPLATE (a context per options is built when first requested). */
+    int nStatus = RENDER_OK;
+    (*srvDiagram).Renderers = createRenderCache(sTemplateFile, NULL, &nStatus);
+    if (nStatus != RENDER_OK) {
+        if (nStatus == RENDER_TEMPLATE_NOT_FOUND) {
+            fprintf(stderr, "Error: cannot open input file (%s).\n", sTemplateFile);
+        }
+        free(srvDiagram);
+        return false;
+    }
+    (*srvDiagram).DefaultOptions = nDefaultOptions;
+    (*srvDiagram).ActiveConnections = 0;
+    pthread_mutex_init(&(*srvDiagram).Mutex, NULL);
+
+    /* 2 - LISTEN. */
+    (*srvDiagram).Socket = openServerSocket(sSocketPath);
+    if ((*srvDiagram).Socket < 0) {
+        freeRenderCache(&(*srvDiagram).Renderers);
+        pthread_mutex_destroy(&(*srvDiagram).Mutex);
+        free(srvDiagram);
+        return false;
+    }
+    /* No SA_RESTART: a signal interrupts accept(). */
+    struct sigaction sgaStop;
+    memset(&sgaStop, 0, sizeof(sgaStop));
+    sgaStop.sa_handler = requestStop;
+    sigaction(SIGINT, &sgaStop, NULL);
+    sigaction(SIGTERM, &sgaStop, NULL);
+    fprintf(stderr, "Serving diagrams on %s.\n", sSocketPath);
+
+    /* 3 - ONE THREAD PER CONNECTION (detached: nobody waits for it). */
+    pthread_attr_t attDetached;
+    pthread_attr_init(&attDetached);
+    pthread_attr_setdetachstate(&attDetached, PTHREAD_CREATE_DETACHED);
+    while (!bStopRequested) {
+        int nClientSocket = accept((*srvDiagram).Socket, NULL, NULL);
+        if (nClientSocket < 0) {
+            continue;                       /* Interrupted, or client gone already. */
+        }
+        ServerConnection* cnxClient = (ServerConnection*) malloc(1 * sizeof(ServerConnection));
+        if (!cnxClient) {
+            printf("Unsuccessful malloc() in runDiagramServer(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        (*cnxClient).Server = srvDiagram;
+        (*cnxClient).Socket = nClientSocket;
+        pthread_mutex_lock(&(*srvDiagram).Mutex);
+        (*srvDiagram).ActiveConnections++;
+        pthread_mutex_unlock(&(*srvDiagram).Mutex);
+        pthread_t thrConnection;
+        if (pthread_create(&thrConnection, &attDetached, serveConnection, cnxClient) != 0) {
+            close(nClientSocket);
+            free(cnxClient);
+            pthread_mutex_lock(&(*srvDiagram).Mutex);
+            (*srvDiagram).ActiveConnections--;
+            pthread_mutex_unlock(&(*srvDiagram).Mutex);
+        }
+    }
+    pthread_attr_destroy(&attDetached);
+
+    /* 4 - STOP: NO MORE CONNECTION. */
+    close((*srvDiagram).Socket);
+    unlink(sSocketPath);
+    fprintf(stderr, "Server stopped.\n");
+
+    /* Contexts may still be read by open connections: those are left to the end of the
+       process. */
+    pthread_mutex_lock(&(*srvDiagram).Mutex);
+    bool bIdle = ((*srvDiagram).ActiveConnections == 0);
+    pthread_mutex_unlock(&(*srvDiagram).Mutex);
+    if (bIdle) {
+        freeRenderCache(&(*srvDiagram).Renderers);
+        pthread_mutex_destroy(&(*srvDiagram).Mutex);
+        free(srvDiagram);
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for diagramserver.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "libfen2svg.h"
+
+#define SERVER_REQUEST_MAX_LENGTH 65536     /* Longer requests are answered with an error. */
+#define SERVER_BACKLOG 64                   /* Connections waiting to be accepted. */
+#define SERVER_HEADER_MAX_LENGTH 32         /* "OK <length>\n" */
+
+
+/* Variables */
+typedef struct DiagramServer {
+   RenderCache* Renderers; /* A context per options, built when first requested. */
+   int DefaultOptions;     /* Options of requests without options column. */
+   int Socket;             /* Listening socket. */
+   int ActiveConnections;  /* Contexts are freed only once every connection is closed. */
+   pthread_mutex_t Mutex;
+} DiagramServer;
+
+/* Methods */
+bool runDiagramServer(const char* sSocketPath, char* sTemplateFile, int nDefaultOptions);
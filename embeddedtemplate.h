@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for embeddedtemplate.c, the template
+ * of FEN2SVG built into the program: embeddedtemplate.c is generated from template.svg by
+ * embedtemplate.c (see the Makefile), so that no file is read at start-up.
+ * <p>
+ * An empty diagram is a header (the opening tag, sized for its options), the definitions
+ * and an empty board, joined. Arrays are indexed by the compact flag, then by the options
+ * the text depends on (e.g. BORDER_OPTION | COORDINATES_OPTION for a board).
+ **/
+
+#ifndef EMBEDDEDTEMPLATE_H
+#define EMBEDDEDTEMPLATE_H
+
+#include <stddef.h>                         /* size_t */
+
+#define EMBEDDED_HEADER_VARIANTS 8          /* Border, coordinates, move indicator. */
+#define EMBEDDED_BOARD_VARIANTS 4           /* Border, coordinates. */
+
+
+/* Variables */
+typedef struct EmbeddedText {
+   const char* Data;       /* Not necessarily '\0' terminated. */
+   size_t Length;
+} EmbeddedText;
+
+extern const char* const asEmbeddedTemplate[];  /* Lines, without '\n', NULL terminated. */
+extern const EmbeddedText aEmbeddedHeaders[2][EMBEDDED_HEADER_VARIANTS];
+extern const EmbeddedText aEmbeddedDefinitions[2];
+extern const EmbeddedText aEmbeddedBoards[2][EMBEDDED_BOARD_VARIANTS][2];  /* [orientation] */
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Build step of FEN2SVG: turn the template into C source (embeddedtemplate.c), so that the
+ * program needs neither to read nor to parse it at start-up (see embeddedtemplate.h).
+ * <p>
+ * For both compact and indented SVG, every sized template (see buildSizedTemplate()) is
+ * split into the bytes they all end with (the definitions) and what precedes them (the
+ * header), and every empty board is generated (see generateEmptyBoard()). The lines of the
+ * template are kept too, for the sprite, sheets and bitmaps.
+ * <p>
+ * Run by make. Usage: embedtemplate template.svg > embeddedtemplate.c
+ * It compiles the rendering core without the template it generates:
+ * gcc -pthread -DFEN2SVG_NO_EMBEDDED_TEMPLATE embedtemplate.c libfen2svg.c linkedlist.c bytebuffer.c -o embedtemplate
+ **/
+
+
+#include "libfen2svg.h"                     /* Own work */
+#include "embeddedtemplate.h"               /* What is generated (variants) */
+
+
+/**
+ * Write bytes as C string literals, one per line of the text, quotes, backslashes and
+ * control characters escaped.
+ **/
+void writeCString(FILE* fOutputFile, const char* pData, size_t nLength) {
+
+    fputs("\"", fOutputFile);
+    for (size_t i = 0; i < nLength; i++) {
+        unsigned char cCurrent = (unsigned char) pData[i];
+        if (cCurrent == '\n') {
+            fputs(i + 1 < nLength ? "\\n\"\n        \"" : "\\n", fOutputFile);
+        }
+        else if (cCurrent == '"' || cCurrent == '\\') {
+            fprintf(fOutputFile, "\\%c", cCurrent);
+        }
+        else if (cCurrent < ' ' || cCurrent >= 127) {
+            /* Always three digits: the next character cannot extend the escape. */
+            fprintf(fOutputFile, "\\%03o", cCurrent);
+        }
+        else {
+            fputc(cCurrent, fOutputFile);
+        }
+    }
+    fputs("\"", fOutputFile);
+}
+
+
+/** Write an EmbeddedText initializer: the bytes and their length. **/
+void writeEmbeddedText(FILE* fOutputFile, const char* pData, size_t nLength) {
+
+    fputs("        { ", fOutputFile);
+    writeCString(fOutputFile, pData, nLength);
+    fprintf(fOutputFile, ", %zu },\n", nLength);
+}
+
+
+/**
+ * Generate the template built into FEN2SVG, from the template file given as argument, to
+ * the standard output.
+ **/
+int main(int argc, char* argv[]) {
+
+    /* 1 - ARGUMENTS */
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s template.svg > embeddedtemplate.c\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* 2 - READ TEMPLATE */
+    ListArena* arnTemplate = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    LinkedList* lstTemplate = readTemplate(argv[1], arnTemplate);
+    if (!lstTemplate) {
+        fprintf(stderr, "Error: cannot open input file (%s).\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    /* 3 - LINES */
+    printf("/* Generated from %s by embedtemplate (see embedtemplate.c): do not edit. */\n\n",
+        argv[1]);
+    printf("#include \"embeddedtemplate.h\"\n\n");
+    printf("const char* const asEmbeddedTemplate[] = {\n");
+    for (ListItem* itmCurrent = (*lstTemplate).First; itmCurrent; itmCurrent = itmCurrent->Next) {
+        printf("    ");
+        writeCString(stdout, itmCurrent->Value, strlen(itmCurrent->Value));
+        printf(",\n");
+    }
+    printf("    NULL\n};\n\n");
+
+    /* 4 - SIZED TEMPLATES, SPLIT INTO HEADERS AND DEFINITIONS */
+    ByteBuffer* abufSized[2][EMBEDDED_HEADER_VARIANTS];
+    size_t anDefinitionsLength[2];
+    for (int nCompact = 0; nCompact < 2; nCompact++) {
+        for (int nVariant = 0; nVariant < EMBEDDED_HEADER_VARIANTS; nVariant++) {
+            abufSized[nCompact][nVariant] = buildSizedTemplate(*lstTemplate,
+                nVariant & BORDER_OPTION, nVariant & COORDINATES_OPTION,
+                nVariant & MOVE_INDICATOR_OPTION, nCompact, SQUARE_WIDTH);
+            if (!abufSized[nCompact][nVariant]) {
+                fprintf(stderr, "Error: malformed template (%s).\n", argv[1]);
+                return EXIT_FAILURE;
+            }
+        }
+        /* Definitions: the longest end all sized templates share. */
+        const ByteBuffer* bufFirst = abufSized[nCompact][0];
+        anDefinitionsLength[nCompact] = (*bufFirst).Length;
+        for (int nVariant = 1; nVariant < EMBEDDED_HEADER_VARIANTS; nVariant++) {
+            const ByteBuffer* bufCurrent = abufSized[nCompact][nVariant];
+            size_t nShared = 0;
+            while (nShared < anDefinitionsLength[nCompact] && nShared < (*bufCurrent).Length
+                && (*bufFirst).Data[(*bufFirst).Length - 1 - nShared]
+                == (*bufCurrent).Data[(*bufCurrent).Length - 1 - nShared]) {
+                nShared++;
+            }
+            anDefinitionsLength[nCompact] = nShared;
+        }
+    }
+    printf("const EmbeddedText aEmbeddedHeaders[2][EMBEDDED_HEADER_VARIANTS] = {\n");
+    for (int nCompact = 0; nCompact < 2; nCompact++) {
+        printf("    {\n");
+        for (int nVariant = 0; nVariant < EMBEDDED_HEADER_VARIANTS; nVariant++) {
+            const ByteBuffer* bufSized = abufSized[nCompact][nVariant];
+            writeEmbeddedText(stdout, (*bufSized).Data,
+                (*bufSized).Length - anDefinitionsLength[nCompact]);
+        }
+        printf("    },\n");
+    }
+    printf("};\n\n");
+    printf("const EmbeddedText aEmbeddedDefinitions[2] = {\n");
+    for (int nCompact = 0; nCompact < 2; nCompact++) {
+        const ByteBuffer* bufSized = abufSized[nCompact][0];
+        writeEmbeddedText(stdout, (*bufSized).Data + (*bufSized).Length
+            - anDefinitionsLength[nCompact], anDefinitionsLength[nCompact]);
+        for (int nVariant = 0; nVariant < EMBEDDED_HEADER_VARIANTS; nVariant++) {
+            freeBuffer(&abufSized[nCompact][nVariant]);
+        }
+    }
+    printf("};\n\n");
+
+    /* 5 - EMPTY BOARDS */
+    printf("const EmbeddedText aEmbeddedBoards[2][EMBEDDED_BOARD_VARIANTS][2] = {\n");
+    for (int nCompact = 0; nCompact < 2; nCompact++) {
+        printf("    {\n");
+        for (int nVariant = 0; nVariant < EMBEDDED_BOARD_VARIANTS; nVariant++) {
+            BoardGeometry geoBoard;
+            computeBoardGeometry(&geoBoard, nVariant & BORDER_OPTION,
+                nVariant & COORDINATES_OPTION, SQUARE_WIDTH);
+            printf("    {\n");
+            for (int nOrientation = 0; nOrientation < 2; nOrientation++) {
+                ByteBuffer* bufEmptyBoard = generateEmptyBoard(&geoBoard,
+                    nOrientation == WHITE_AT_BOTTOM_INDEX, nCompact, NULL);
+                writeEmbeddedText(stdout, (*bufEmptyBoard).Data, (*bufEmptyBoard).Length);
+                freeBuffer(&bufEmptyBoard);
+            }
+            printf("    },\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+    freeListArena(&arnTemplate);
+
+    return EXIT_SUCCESS;
+}
@@ -29,789 +29,1486 @@
 
 /**
  * Compile source with
- *      gcc fen2svg.c linkedlist.c -o fen2svg
+ *      gcc -pthread fen2svg.c libfen2svg.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c diagramcompressor.c stringset.c -lz -o fen2svg
  *
  * Check for memory leaks with
- *      gcc -g -o0 linkedlist.c fen2svg.c -o fen2svg
+ *      gcc -g -o0 -pthread libfen2svg.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c diagramcompressor.c stringset.c fen2svg.c -lz -o fen2svg
  *      valgrind -v --leak-check=full ./fen2svg
  *
  * Validate code with
- *      splint linkedlist.c fen2svg.c
+ *      splint libfen2svg.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c stringset.c fen2svg.c
  *
  * Debug code with GDB
  *      gdb --args ./fen2svg -bmrp objectif_2000.tsv
 **/
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
-#include <unistd.h>                         /* POSIX command line arguments parsing (getopt) */
-#include "linkedlist.h"                     /* Own work */
+#ifndef _WIN32
+#include <sys/mman.h>                       /* mmap() */
+#include <sys/stat.h>                       /* fstat() */
+#endif
+#include <ctype.h>                          /* tolower() */
+#include <errno.h>                          /* Missing checkpoint file */
+#include "fen2svg.h"                        /* Own work */
 
-#define BUFFER_SIZE 1024                    /* Holds strings of variable length. */
-#define FILE_NAME_MAX_SIZE 1024
-#define SVG_TEMPLATE "template.svg"
-#define FEN_EXCERPT_LENGTH 75               /* Only the 75st chars of FEN are really useful:
-                                               64 fillable squares + 7 row separators +
-                                               1 blank space + side to move + '\0'.
-                                               Must absolutely be greater than zero. */
-#define WHITE_ON_BOTTOM true
-#define BLACK_ON_BOTTOM false
 
-/* The SVG template must ABSOLUTELY respect following conventions: */
-#define SQUARE_WIDTH 72
-#define SQUARE_HEIGHT 72
-#define BORDER_THICKNESS 1                  /* Around the chessboard */
-#define HORIZONTAL_COORDINATES_HEIGHT 48    /* Horizontal coordinates */
-#define VERTICAL_COORDINATES_WIDTH 48       /* Vertical coordinates */
-#define MOVE_INDICATOR_WIDTH 72
+/**
+ * Generate a file name from a position: its piece placement, written as in FEN strings but
+ * without rank separators, then the side to play ('w' or 'b'), e.g.
+ * "rnbqkbnrpppppppp8888PPPPPPPPRNBQKBNRw.svg".
+ *
+ * @param   brdPosition     chess position (see parseFEN())
+ * @param   sReturnValue    receives the file name (FILE_NAME_MAX_SIZE chars, caller owned)
+ * @return  sReturnValue
+ **/
+char* generateFENFileName(const ChessBoard* brdPosition, char* sReturnValue) {
+
+    /* PIECE PLACEMENT, RUNS OF EMPTY SQUARES AS DIGITS (at most 64 chars) */
+    int nOutputPos = 0;
+    int nEmptySquares = 0;
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        int nPiece = getBoardPiece(brdPosition, nSquare);
+        if (nPiece == NO_PIECE) {
+            nEmptySquares++;
+        }
+        else {
+            if (nEmptySquares > 0) {
+                sReturnValue[nOutputPos++] = (char) ('0' + nEmptySquares);
+                nEmptySquares = 0;
+            }
+            sReturnValue[nOutputPos++] = FEN_PIECES[nPiece];
+        }
+        if (nSquare % 8 == 7 && nEmptySquares > 0) {
+            sReturnValue[nOutputPos++] = (char) ('0' + nEmptySquares);
+            nEmptySquares = 0;
+        }
+    }
+
+    /* APPEND SIDE TO PLAY ('w' or 'b') */
+    sReturnValue[nOutputPos++] = (*brdPosition).WhiteToPlay ? 'w' : 'b';
+
+    /* APPEND FILE EXTENSION */
+    sReturnValue[nOutputPos++] = '.';
+    sReturnValue[nOutputPos++] = 's';
+    sReturnValue[nOutputPos++] = 'v';
+    sReturnValue[nOutputPos++] = 'g';
+    sReturnValue[nOutputPos++] = '\0';
+
+    /* */
+    return sReturnValue;
+}
+
+
+/**
+ * Generate a file name of the form "dia00130.svg" into sReturnValue (FILE_NAME_MAX_SIZE chars,
+ * caller owned).
+ **/
+char* generateNumberedFileName(int nDiagramNumber, char* sReturnValue) {
+
+    /* NUMBER BETWEEN PREFIX AND SUFFIX, WITH AT LEAST NUMBERED_FILE_NAME_DIGITS DIGITS */
+    size_t nLength = strlen(NUMBERED_FILE_NAME_PREFIX);
+    memcpy(sReturnValue, NUMBERED_FILE_NAME_PREFIX, nLength);
+    nLength += (size_t) formatDecimal((unsigned int) nDiagramNumber, NUMBERED_FILE_NAME_DIGITS,
+        sReturnValue + nLength);
+    memcpy(sReturnValue + nLength, NUMBERED_FILE_NAME_SUFFIX, sizeof(NUMBERED_FILE_NAME_SUFFIX));
 
-#define NUMBERED_FILE_NAME_FORMAT   "dia%05d.svg"
+    /* */
+    return sReturnValue;
+}
 
 
 /**
- * Width of the board drawing vary on the presence of coordinates, the width of the border, ...
+ * Generate the file name of a diagram: its position (-p) or its number, with the ".svgz"
+ * extension if diagrams are compressed (-z), ".png" if they are bitmaps (--png).
  **/
-int computeWholeDrawingWidth(bool bCoordinates, bool bBorder, bool bMoveIndicator) {
-        
-    int nDrawingWidth = 0;
+char* generateFileName(DiagramWriter* wrtDiagram, const ChessBoard* brdPosition,
+    int nDiagramNumber, char* sReturnValue) {
 
-    if (bCoordinates) {
-        nDrawingWidth += VERTICAL_COORDINATES_WIDTH;
+    if ((*wrtDiagram).PositionAsFileName) {
+        generateFENFileName(brdPosition, sReturnValue);
     }
-    if (bBorder) {
-        nDrawingWidth += BORDER_THICKNESS;
+    else {
+        generateNumberedFileName(nDiagramNumber, sReturnValue);
     }
-    nDrawingWidth += 8 * SQUARE_WIDTH;
-    if (bBorder) {
-        nDrawingWidth += BORDER_THICKNESS;
+    if ((*wrtDiagram).Compressor && strlen(sReturnValue) < FILE_NAME_MAX_SIZE-1) {
+        strcat(sReturnValue, "z");
     }
-    if (bMoveIndicator) {
-        nDrawingWidth += MOVE_INDICATOR_WIDTH;
+    if ((*wrtDiagram).Rasterizer) {
+        memcpy(sReturnValue + strlen(sReturnValue) - 3, "png", 3);
     }
 
-    return nDrawingWidth;
+    return sReturnValue;
 }
 
 
 /**
- * Height of the board drawing vary on the presence of coordinates, the width of the border, ...
+ * Insert the suffix of a variant (see OutputVariant) before the extension of a file name
+ * (e.g. "dia00001.svg" becomes "dia00001_c.svg").
+ *
+ * @param   sFileName       file name (FILE_NAME_MAX_SIZE chars, caller owned)
+ * @param   sSuffix         suffix, "" for none
+ * @return  sFileName
  **/
-int computeWholeDrawingHeight(bool bCoordinates, bool bBorder) {
-    
-    int nDrawingHeight = 0;
+char* addFileNameSuffix(char* sFileName, const char* sSuffix) {
+
+    size_t nSuffixLength = strlen(sSuffix);
+    char* pExtension = strrchr(sFileName, '.');
+    if (nSuffixLength == 0 || !pExtension
+        || strlen(sFileName) + nSuffixLength >= FILE_NAME_MAX_SIZE) {
+        return sFileName;
+    }
+    memmove(pExtension + nSuffixLength, pExtension, strlen(pExtension) + 1);
+    memcpy(pExtension, sSuffix, nSuffixLength);
+
+    return sFileName;
+}
+
+
+/**
+ * Read the variants drawn from every position (e.g. --variants plain,c,r,m): a comma
+ * separated list of option letters among b, c, m and r, "plain" standing for none. Each
+ * variant must differ from the others.
+ *
+ * @param   sList           list of variants
+ * @param   aVariants       receives the variants (MAX_OUTPUT_VARIANTS at most)
+ * @return  number of variants, 0 if the list is malformed
+ **/
+int parseOutputVariants(const char* sList, OutputVariant* aVariants) {
+
+    static const char sLetters[] = "bcmr";
+    static const int anLetterOptions[] = { BORDER_OPTION, COORDINATES_OPTION,
+        MOVE_INDICATOR_OPTION, ROTATE_BOARD_OPTION };
+
+    int nCount = 0;
+    const char* pToken = sList;
+    while (true) {
+        /* OPTIONS OF ONE VARIANT */
+        size_t nTokenLength = strcspn(pToken, ",");
+        int nOptions = 0;
+        if (nTokenLength == 0) {
+            return 0;
+        }
+        if (nTokenLength != strlen("plain") || strncmp(pToken, "plain", nTokenLength) != 0) {
+            for (size_t nPos = 0; nPos < nTokenLength; nPos++) {
+                const char* pLetter = memchr(sLetters, pToken[nPos], strlen(sLetters));
+                if (!pLetter) {
+                    return 0;
+                }
+                nOptions |= anLetterOptions[pLetter - sLetters];
+            }
+        }
+        for (int nVariant = 0; nVariant < nCount; nVariant++) {
+            if (aVariants[nVariant].Options == nOptions) {
+                return 0;
+            }
+        }
+        if (nCount == MAX_OUTPUT_VARIANTS) {
+            return 0;
+        }
 
-    if (bBorder) {
-        nDrawingHeight += BORDER_THICKNESS;
+        /* SUFFIX, LETTERS IN A FIXED ORDER (e.g. "_cm" for both "cm" and "mc") */
+        int nSuffixLength = 0;
+        if (nOptions != 0) {
+            aVariants[nCount].Suffix[nSuffixLength++] = '_';
+        }
+        for (int nLetter = 0; nLetter < (int) strlen(sLetters); nLetter++) {
+            if (nOptions & anLetterOptions[nLetter]) {
+                aVariants[nCount].Suffix[nSuffixLength++] = sLetters[nLetter];
+            }
+        }
+        aVariants[nCount].Suffix[nSuffixLength] = '\0';
+        aVariants[nCount].Options = nOptions;
+        nCount++;
+
+        if (pToken[nTokenLength] == '\0') {
+            return nCount;
+        }
+        pToken += nTokenLength + 1;
     }
-    nDrawingHeight += 8 * SQUARE_HEIGHT;
-    if (bBorder) {
-        nDrawingHeight += BORDER_THICKNESS;
+}
+
+
+/**
+ * Prepare everything diagrams share: a cache of rendering contexts (see createRenderCache()),
+ * the options given on the command line being the default ones.
+ * <p>
+ * The writer is left single-threaded, without output (files, archive or stream), without
+ * compression, deduplication nor game sequence: those are up to the caller.
+ *
+ * @param   wrtDiagram          writer to set up
+ * @param   sTemplateFile       SVG definitions (e.g. SVG_TEMPLATE), NULL for the template
+ *                              built into the program
+ * @param   bBorder             frame around the board requested?
+ * @param   bCoordinates        coordinates for algebric notation around the board
+ * @param   bMoveIndicator      little picture next to the board telling who is to move
+ * @param   bPositionAsFileName FEN string as file name rather than numbered file names
+ * @param   bRotateBoard        side to move at bottom
+ * @param   bCompact            minified SVG
+ * @param   sSpriteFile         file diagrams reference the definitions in, NULL to embed them
+ * @param   nSquareSize         displayed square size of the diagrams, in pixels (SQUARE_WIDTH:
+ *                              as drawn in the template)
+ * @return  false if the template cannot be read or is malformed
+ * @see     tearDownDiagramWriter()
+ **/
+bool setUpDiagramWriter(DiagramWriter* wrtDiagram, char* sTemplateFile, bool bBorder,
+    bool bCoordinates, bool bMoveIndicator, bool bPositionAsFileName, bool bRotateBoard,
+    bool bCompact, const char* sSpriteFile, int nSquareSize) {
+
+    /* TEMPLATE (empty boards and pieces are built when first needed) */
+    int nStatus = RENDER_OK;
+    (*wrtDiagram).Renderers = createSizedRenderCache(sTemplateFile, sSpriteFile, nSquareSize,
+        &nStatus);
+    if (nStatus == RENDER_TEMPLATE_NOT_FOUND) {
+        printf("Error: cannot open input file (%s).", sTemplateFile);
     }
-    if (bCoordinates) {
-        nDrawingHeight += HORIZONTAL_COORDINATES_HEIGHT;
+    if (nStatus != RENDER_OK) {
+        return false;
     }
 
-    return nDrawingHeight;
+    /* OPTIONS */
+    (*wrtDiagram).DefaultOptions = combineOptions(bBorder, bCoordinates, bMoveIndicator,
+        bRotateBoard, bCompact);
+    (*wrtDiagram).Diagram = createEmptyBuffer();
+    (*wrtDiagram).CompressedDiagram = createEmptyBuffer();
+    (*wrtDiagram).Compressor = NULL;
+    (*wrtDiagram).Rasterizer = NULL;
+    (*wrtDiagram).Frame = NULL;
+    (*wrtDiagram).Sheet = NULL;
+    (*wrtDiagram).PositionAsFileName = bPositionAsFileName;
+    (*wrtDiagram).DiagramNumber = 1;
+    (*wrtDiagram).Queue = NULL;
+    (*wrtDiagram).Output = NULL;
+    (*wrtDiagram).ProducedNames = NULL;
+    (*wrtDiagram).CheckExistingFiles = false;
+    (*wrtDiagram).DuplicateHits = 0;
+    (*wrtDiagram).DuplicateMisses = 0;
+    (*wrtDiagram).PGNInput = false;
+    (*wrtDiagram).Selection.Mode = FINAL_POSITION;
+    (*wrtDiagram).Selection.Plies = 0;
+    (*wrtDiagram).ExtractionThreads = 1;
+    (*wrtDiagram).Stats = NULL;
+    (*wrtDiagram).Checkpoint = NULL;
+    (*wrtDiagram).RangeStart = 0;
+    (*wrtDiagram).RangeEnd = NO_RANGE_END;
+    (*wrtDiagram).ShardIndex = 0;
+    (*wrtDiagram).ShardCount = 1;
+    (*wrtDiagram).VariantCount = 0;
+
+    return true;
+}
+
+
+/* Free what setUpDiagramWriter() allocated. */
+void tearDownDiagramWriter(DiagramWriter* wrtDiagram) {
+
+    freeRenderCache(&(*wrtDiagram).Renderers);
+    freeBuffer(&(*wrtDiagram).Diagram);
+    freeBuffer(&(*wrtDiagram).CompressedDiagram);
+    if ((*wrtDiagram).Compressor) {
+        freeDiagramCompressor(&(*wrtDiagram).Compressor);
+    }
+    if ((*wrtDiagram).Rasterizer) {
+        freeDiagramRasterizer(&(*wrtDiagram).Rasterizer);
+    }
+    if ((*wrtDiagram).Frame) {
+        freeGameFrame(&(*wrtDiagram).Frame);
+    }
+    if ((*wrtDiagram).Sheet) {
+        freeDiagramSheet(&(*wrtDiagram).Sheet);
+    }
 }
 
 
 /**
- * Examine a FEN string to know which side is to play.
- * If side to play is missing, true is returned.
+ * Copy the useful part of a FEN string (its first FEN_EXCERPT_LENGTH characters) to
+ * sFENExcerpt, which must hold FEN_EXCERPT_LENGTH+1 chars, as a '\0' terminated string.
  **/
-bool isWhiteToPlay(char *sFEN) {
+void copyFENExcerpt(const char* pFEN, size_t nFENLength, char* sFENExcerpt) {
 
-    bool bReturnValue = true;
-    int nPos = 0;
-    
-    /* Reach the first blank space. */
-    while (sFEN[nPos] != '\0' && sFEN[nPos]!= ' ') {
-        nPos++;
-    };
-    /* Then reach the first char which is not a blank space. */
-    while (sFEN[nPos] !=  '\0' && sFEN[nPos]  ==  ' ') {
-        nPos++;
-    };
-    /* White or black to play? */
-    if (sFEN[nPos] !=  '\0' && sFEN[nPos]  ==  'b') {
-        bReturnValue = false;
+    if (nFENLength > FEN_EXCERPT_LENGTH) {
+        nFENLength = FEN_EXCERPT_LENGTH;
     }
-    
-    return bReturnValue;
+    memcpy(sFENExcerpt, pFEN, nFENLength);
+    sFENExcerpt[nFENLength] = '\0';
 }
 
 
- /** 
- * Generate a file name with a FEN string as input.
- * Doing so, convert each FEN character to its corresponding SVG item.
- * <p>
- * This empty chessboard is intented to act as a template to create a board filled with chess
- * pieces later.
+/**
+ * Parse a FEN string into a board, once: every later stage (file name, empty board,
+ * pieces) reads the board (see parseFEN()).
  *
- * @param   sFEN            FEN string representing the chess position
- * @param   lstBoardFilling an unsorted linked list of SVG lines   
- * @param   bBorder         frame around the board requested?
- * @param   bCoordinates    coordinates for algebric notation around the board
- * @param   bMoveIndicator  little picture next to the board telling who is to move
- * @param   bRotateBoard    board orientation
- * @return  
- * @see     generateEmptyBoard()
- **/
-char* generateFENFileName(char* sFEN) {
-
-    const char* sAdmittedCharacters = "1pP2348RrkK5bBNn6qQ7";
-
-    /* ALLOCATE MEMORY FOR STRING */
-    char* sReturnValue = (char*) malloc(strlen(sFEN)*sizeof(char)+1+4);
-    if (!sReturnValue) {
-        printf("Unsuccessful malloc() in generateFENFileName(): halting.\n");
-        exit(EXIT_FAILURE);
+ * @param   pFEN            FEN string representing the chess position (need not be '\0'
+ *                          terminated, e.g. a line of a mapped file)
+ * @param   nFENLength      length of pFEN
+ * @param   brdPosition     receives the position
+ * @return  false if the string is not a valid position (what is wrong, and where, is told)
+ **/
+bool readPosition(const char* pFEN, size_t nFENLength, ChessBoard* brdPosition) {
+
+    size_t nErrorOffset = 0;
+    int nStatus = parseFEN(pFEN, nFENLength, brdPosition, &nErrorOffset);
+    if (nStatus != FEN_OK) {
+        fprintf(stderr, "\nERROR: %s of FEN string (%.*s), at character %zu.",
+            describeFENStatus(nStatus), (int) nFENLength, pFEN, nErrorOffset + 1);
+        return false;
     }
 
-    
-    /* PARSE FEN. */
-    char cCurrentChar;
-    int nInputPos = 0;
-    int nOutputPos = 0;
-    while ((cCurrentChar = sFEN[nInputPos]) != '\0' && cCurrentChar != ' ') {
-        if (strchr(sAdmittedCharacters, cCurrentChar)) {
-            sReturnValue[nOutputPos++] = cCurrentChar;
-        }
-        nInputPos++;
+    return true;
+}
+
+
+/**
+ * Turn one position into a whole diagram, in a buffer (see renderBoard()).
+ *
+ * @param   ctxRender       context of the options of this position
+ * @param   brdPosition     chess position (see readPosition())
+ * @param   bufDiagram      emptied, then filled with the diagram (it only grows the first
+ *                          times: later diagrams fit in it)
+ * @return  false if the diagram could not be drawn
+ **/
+bool renderDiagram(const RenderContext* ctxRender, const ChessBoard* brdPosition,
+    ByteBuffer* bufDiagram) {
+
+    clearBuffer(bufDiagram);
+    reserveBuffer(bufDiagram, getMaxDiagramLength(ctxRender));
+
+    long nLength = renderBoard(ctxRender, brdPosition, (*bufDiagram).Data,
+        (*bufDiagram).Capacity);
+    if (nLength < 0) {
+        return false;
     }
+    (*bufDiagram).Length = (size_t) nLength;
 
-    
-    /* APPEND SIDE TO PLAY ('w' or 'b') */
-    /* Reach first non-blank char. */
-    while (sFEN[nInputPos] !=  '\0' && sFEN[nInputPos]  ==  ' ') {
-        nInputPos++;
-    };
-    /* Side to play. */
-    if (sFEN[nInputPos] !=  '\0' && sFEN[nInputPos]  ==  'b') { /* If missing, 'w' is appended). */
-        sReturnValue[nOutputPos++] = 'b';
+    return true;
+}
+
+
+/**
+ * Turn one position into a PNG file, in a buffer (see rasterizeDiagram()).
+ *
+ * @param   nOptions        drawing options of the position (those of ctxRender)
+ * @param   bufCanvas       holds the bitmap while it is drawn
+ * @param   bufPNG          emptied, then filled with the PNG file
+ * @return  false if the bitmap could not be drawn
+ **/
+bool renderBitmap(DiagramWriter* wrtDiagram, const RenderContext* ctxRender, int nOptions,
+    const ChessBoard* brdPosition, ByteBuffer* bufCanvas, ByteBuffer* bufPNG) {
+
+    return rasterizeDiagram((*wrtDiagram).Rasterizer, ctxRender, nOptions, brdPosition,
+        bufCanvas, bufPNG) >= 0;
+}
+
+
+/**
+ * Write down a diagram (see writeDiagramEntry()), timing it and counting its bytes if
+ * statistics are kept.
+ *
+ * @return  false if the diagram could not be written
+ **/
+static bool writeCountedOutput(DiagramWriter* wrtDiagram, int nDiagramNumber,
+    const char* sFileName, const ByteBuffer* bufWritten, bool bLastEntry) {
+
+    StageTimer tmrStage;
+    startStage((*wrtDiagram).Stats, &tmrStage);
+    bool bWritten = writeDiagramEntry((*wrtDiagram).Output, nDiagramNumber, sFileName,
+        (*bufWritten).Data, (*bufWritten).Length, bLastEntry);
+    endStage((*wrtDiagram).Stats, WRITE_STAGE, &tmrStage);
+    if (bWritten) {
+        countInStats((*wrtDiagram).Stats, DIAGRAM_COUNTER, 1);
+        countInStats((*wrtDiagram).Stats, WRITTEN_BYTE_COUNTER, (long long) (*bufWritten).Length);
+    }
+
+    return bWritten;
+}
+
+
+/**
+ * Draw one diagram of a parsed position and write it down (see writeDiagram()). Diagrams of
+ * a position share its turn in an archive or stream: it is given up by the last one, or
+ * by a diagram that cannot be drawn.
+ *
+ * @param   nOptions        drawing options of this diagram
+ * @param   sSuffix         added to the file name (see addFileNameSuffix()), "" for none
+ * @param   bLastEntry      last diagram of the position
+ * @param   bWritten        receives false if the diagram was drawn but not written
+ * @return  false if the diagram could not be drawn (nothing is written, the turn is given
+ *          up: later diagrams of the position must not be written)
+ **/
+static bool writeDiagramVariant(DiagramWriter* wrtDiagram, const char* pFEN,
+    size_t nFENLength, const ChessBoard* brdPosition, int nOptions, const char* sSuffix,
+    int nDiagramNumber, bool bLastEntry, ByteBuffer* bufDiagram, ByteBuffer* bufCompressed,
+    bool* bWritten) {
+
+    /* FIND THE CONTEXT OF ITS OPTIONS */
+    PipelineStats* stsPipeline = (*wrtDiagram).Stats;
+    StageTimer tmrStage;
+    startStage(stsPipeline, &tmrStage);
+    const RenderContext* ctxRender = getRenderContext((*wrtDiagram).Renderers, nOptions);
+    endStage(stsPipeline, BOARD_STAGE, &tmrStage);
+    if (!ctxRender) {
+        fprintf(stderr, "\nERROR: unknown option in options column of FEN string (%.*s).",
+            (int) nFENLength, pFEN);
+        writeDiagramOutput((*wrtDiagram).Output, nDiagramNumber, NULL, NULL, 0);
+        return false;
+    }
+
+    /* TEMPLATE, BOARD AND PIECES (in game sequence mode, only the squares that changed; as
+     * bitmaps, drawn in bufDiagram and encoded in bufCompressed). */
+    const ByteBuffer* bufWritten = bufDiagram;
+    bool bRendered = true;
+    startStage(stsPipeline, &tmrStage);
+    if ((*wrtDiagram).Rasterizer) {
+        bRendered = renderBitmap(wrtDiagram, ctxRender, nOptions, brdPosition, bufDiagram,
+            bufCompressed);
+        bufWritten = bufCompressed;
+    }
+    else if ((*wrtDiagram).Frame) {
+        renderGameFrame((*wrtDiagram).Frame, ctxRender, brdPosition);
+        bufWritten = (*(*wrtDiagram).Frame).Output;
     }
     else {
-        sReturnValue[nOutputPos++] = 'w';
+        bRendered = renderDiagram(ctxRender, brdPosition, bufDiagram);
+    }
+    endStage(stsPipeline, PIECES_STAGE, &tmrStage);
+    if (!bRendered) {
+        fprintf(stderr, "\nERROR: cannot draw diagram of FEN string (%.*s).",
+            (int) nFENLength, pFEN);
+        writeDiagramOutput((*wrtDiagram).Output, nDiagramNumber, NULL, NULL, 0);
+        return false;
     }
 
-    /* APPEND FILE EXTENSION */
-    sReturnValue[nOutputPos++] = '.';
-    sReturnValue[nOutputPos++] = 's';
-    sReturnValue[nOutputPos++] = 'v';
-    sReturnValue[nOutputPos++] = 'g';
-    sReturnValue[nOutputPos++] = '\0';
-    
+    /* COMPRESS (the empty board is compressed once per options and orientation). */
+    if ((*wrtDiagram).Compressor) {
+        const ByteBuffer* bufEmptyDiagram = getEmptyDiagram(ctxRender, brdPosition);
+        int nPrefix = 2 * nOptions + (bufEmptyDiagram == (*ctxRender).ReversedEmptyDiagram);
+        startStage(stsPipeline, &tmrStage);
+        bool bCompressed = compressDiagram((*wrtDiagram).Compressor, nPrefix, bufEmptyDiagram,
+            (*bufWritten).Data, (*bufWritten).Length, bufCompressed);
+        endStage(stsPipeline, COMPRESSION_STAGE, &tmrStage);
+        if (!bCompressed) {
+            fprintf(stderr, "\nERROR: cannot compress diagram of FEN string (%.*s).",
+                (int) nFENLength, pFEN);
+            writeDiagramOutput((*wrtDiagram).Output, nDiagramNumber, NULL, NULL, 0);
+            return false;
+        }
+        bufWritten = bufCompressed;
+    }
 
-    /* */
-    return sReturnValue;
+    /* GENERATE FILE NAME */
+    char sFileName[FILE_NAME_MAX_SIZE];
+    startStage(stsPipeline, &tmrStage);
+    generateFileName(wrtDiagram, brdPosition, nDiagramNumber, sFileName);
+    addFileNameSuffix(sFileName, sSuffix);
+    endStage(stsPipeline, FILE_NAME_STAGE, &tmrStage);
+
+    /* WRITE BOARD AND PIECES TO FILE (OR ARCHIVE). */
+    *bWritten = writeCountedOutput(wrtDiagram, nDiagramNumber, sFileName, bufWritten,
+        bLastEntry);
+
+    return true;
 }
 
 
 /**
- * Generate a file name of the form "dia00130.svg"
+ * Turn one FEN string into one diagram file (or archive entry), or with variants
+ * (--variants), into one per variant: the position is parsed once, then drawn with the
+ * context of each.
+ * <p>
+ * Nothing is kept from one position to the next, so memory use does not depend on the
+ * number of positions processed. Only the shared data is read: any thread can call it, as
+ * long as each one has its own buffer.
+ *
+ * @param   wrtDiagram      template, empty boards and options shared by every diagram
+ * @param   pFEN            FEN string representing the chess position (need not be '\0'
+ *                          terminated)
+ * @param   nFENLength      length of pFEN
+ * @param   nOptions        drawing options of this position (e.g. BORDER_OPTION)
+ * @param   nDiagramNumber  used for the file name, unless the position is
+ * @param   bufDiagram      holds the diagram while it is written
+ * @param   bufCompressed   holds its gzip data, if diagrams are compressed
+ * @return  false if the position could not be converted (nothing more is written)
  **/
-char* generateNumberedFileName(int nDiagramNumber) {
+bool writeDiagram(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength,
+    int nOptions, int nDiagramNumber, ByteBuffer* bufDiagram, ByteBuffer* bufCompressed) {
+
+    /* PARSE FEN (once) */
+    PipelineStats* stsPipeline = (*wrtDiagram).Stats;
+    StageTimer tmrStage;
+    ChessBoard brdPosition;
+    startStage(stsPipeline, &tmrStage);
+    bool bValidPosition = readPosition(pFEN, nFENLength, &brdPosition);
+    endStage(stsPipeline, FEN_STAGE, &tmrStage);
+    if (!bValidPosition) {
+        countInStats(stsPipeline, REJECTED_FEN_COUNTER, 1);
+        /* Let the next diagrams of an archive be appended. */
+        writeDiagramOutput((*wrtDiagram).Output, nDiagramNumber, NULL, NULL, 0);
+        return false;
+    }
+
+    /* A SINGLE DIAGRAM, WITH THE OPTIONS OF THE POSITION */
+    bool bWritten = true;
+    if ((*wrtDiagram).VariantCount == 0) {
+        return writeDiagramVariant(wrtDiagram, pFEN, nFENLength, &brdPosition, nOptions, "",
+            nDiagramNumber, true, bufDiagram, bufCompressed, &bWritten) && bWritten;
+    }
+
+    /* ONE DIAGRAM PER VARIANT (an invalid options column stays invalid: -1 | options) */
+    bool bReturnValue = true;
+    for (int nVariant = 0; nVariant < (*wrtDiagram).VariantCount; nVariant++) {
+        const OutputVariant* varCurrent = &(*wrtDiagram).Variants[nVariant];
+        if (!writeDiagramVariant(wrtDiagram, pFEN, nFENLength, &brdPosition,
+            nOptions | (*varCurrent).Options, (*varCurrent).Suffix, nDiagramNumber,
+            nVariant == (*wrtDiagram).VariantCount - 1, bufDiagram, bufCompressed,
+            &bWritten)) {
+            return false;
+        }
+        bReturnValue = bReturnValue && bWritten;
+    }
+
+    return bReturnValue;
+}
+
 
-    /* ALLOCATE MEMORY FOR STRING */
-    char* sReturnValue = (char*) malloc(12*sizeof(char)+1);   /* 12 = length of "dia%05d.svg". */
-    if (!sReturnValue) {
-        printf("Unsuccessful malloc() in generateNumberedFileName(): halting.\n");
+DiagramQueue* createDiagramQueue(void) {
+
+    DiagramQueue* queReturnValue = (DiagramQueue*) malloc(1 * sizeof(DiagramQueue));
+    if (!queReturnValue) {
+        printf("Unsuccessful malloc() in createDiagramQueue(): halting.\n");
         exit(EXIT_FAILURE);
     }
 
-    /* */
-    if (!snprintf(sReturnValue, 13, NUMBERED_FILE_NAME_FORMAT, nDiagramNumber)) {
-        printf("Unsuccessful snprintf() in writeDiagramsToFiles(): halting.\n");
+    (*queReturnValue).First = 0;
+    (*queReturnValue).Count = 0;
+    (*queReturnValue).Busy = 0;
+    (*queReturnValue).Closed = false;
+    pthread_mutex_init(&(*queReturnValue).Mutex, NULL);
+    pthread_cond_init(&(*queReturnValue).NotEmpty, NULL);
+    pthread_cond_init(&(*queReturnValue).NotFull, NULL);
+    pthread_cond_init(&(*queReturnValue).Idle, NULL);
+
+    return queReturnValue;
+}
+
+
+/* Wait for a free slot, then queue a copy of the position (see pushDiagramJob()). */
+static void queueDiagramJob(DiagramQueue* queDiagram, const char* pFEN, size_t nFENLength,
+    int nOptions, int nDiagramNumber, bool bSkipped) {
+
+    pthread_mutex_lock(&(*queDiagram).Mutex);
+    while ((*queDiagram).Count == DIAGRAM_QUEUE_CAPACITY) {
+        pthread_cond_wait(&(*queDiagram).NotFull, &(*queDiagram).Mutex);
+    }
+
+    DiagramJob* jobNew = &(*queDiagram).Jobs[((*queDiagram).First + (*queDiagram).Count)
+        % DIAGRAM_QUEUE_CAPACITY];
+    (*jobNew).DiagramNumber = nDiagramNumber;
+    (*jobNew).Skipped = bSkipped;
+    (*jobNew).Options = nOptions;
+    copyFENExcerpt(pFEN, nFENLength, (*jobNew).FEN);
+    (*jobNew).FENLength = nFENLength < FEN_EXCERPT_LENGTH ? nFENLength : FEN_EXCERPT_LENGTH;
+    (*queDiagram).Count++;
+
+    pthread_cond_signal(&(*queDiagram).NotEmpty);
+    pthread_mutex_unlock(&(*queDiagram).Mutex);
+}
+
+
+/* Wait for a free slot, then queue a copy of the position. */
+void pushDiagramJob(DiagramQueue* queDiagram, const char* pFEN, size_t nFENLength, int nOptions,
+    int nDiagramNumber) {
+
+    queueDiagramJob(queDiagram, pFEN, nFENLength, nOptions, nDiagramNumber, false);
+}
+
+
+/* Queue the turn of a position converted by another shard, in the order of the others. */
+void pushSkippedJob(DiagramQueue* queDiagram, int nDiagramNumber) {
+
+    queueDiagramJob(queDiagram, "", 0, 0, nDiagramNumber, true);
+}
+
+
+/**
+ * Wait for a position; false once the queue is closed and empty. The job is busy until
+ * finishDiagramJob() is called.
+ **/
+bool popDiagramJob(DiagramQueue* queDiagram, DiagramJob* jobReceived) {
+
+    pthread_mutex_lock(&(*queDiagram).Mutex);
+    while ((*queDiagram).Count == 0 && !(*queDiagram).Closed) {
+        pthread_cond_wait(&(*queDiagram).NotEmpty, &(*queDiagram).Mutex);
+    }
+    if ((*queDiagram).Count == 0) {
+        pthread_mutex_unlock(&(*queDiagram).Mutex);
+        return false;
+    }
+
+    *jobReceived = (*queDiagram).Jobs[(*queDiagram).First];
+    (*queDiagram).First = ((*queDiagram).First + 1) % DIAGRAM_QUEUE_CAPACITY;
+    (*queDiagram).Count--;
+    (*queDiagram).Busy++;
+
+    pthread_cond_signal(&(*queDiagram).NotFull);
+    pthread_mutex_unlock(&(*queDiagram).Mutex);
+
+    return true;
+}
+
+
+/* Tell that the diagram of a job taken by popDiagramJob() is written. */
+void finishDiagramJob(DiagramQueue* queDiagram) {
+
+    pthread_mutex_lock(&(*queDiagram).Mutex);
+    (*queDiagram).Busy--;
+    if ((*queDiagram).Count == 0 && (*queDiagram).Busy == 0) {
+        pthread_cond_broadcast(&(*queDiagram).Idle);
+    }
+    pthread_mutex_unlock(&(*queDiagram).Mutex);
+}
+
+
+/* Wait for every job queued so far to be written (the queue stays open). */
+void waitForDiagramQueue(DiagramQueue* queDiagram) {
+
+    pthread_mutex_lock(&(*queDiagram).Mutex);
+    while ((*queDiagram).Count > 0 || (*queDiagram).Busy > 0) {
+        pthread_cond_wait(&(*queDiagram).Idle, &(*queDiagram).Mutex);
+    }
+    pthread_mutex_unlock(&(*queDiagram).Mutex);
+}
+
+
+/* Wake up every worker: remaining jobs are still served, then they stop. */
+void closeDiagramQueue(DiagramQueue* queDiagram) {
+
+    pthread_mutex_lock(&(*queDiagram).Mutex);
+    (*queDiagram).Closed = true;
+    pthread_cond_broadcast(&(*queDiagram).NotEmpty);
+    pthread_mutex_unlock(&(*queDiagram).Mutex);
+}
+
+
+void freeDiagramQueue(DiagramQueue** queDiagram) {
+
+    pthread_mutex_destroy(&(**queDiagram).Mutex);
+    pthread_cond_destroy(&(**queDiagram).NotEmpty);
+    pthread_cond_destroy(&(**queDiagram).NotFull);
+    pthread_cond_destroy(&(**queDiagram).Idle);
+    free(*queDiagram);
+    *queDiagram = NULL;
+}
+
+
+/**
+ * Body of a worker thread: convert queued positions until the queue is closed.
+ **/
+void* runDiagramWorker(void* pDiagramWriter) {
+
+    DiagramWriter* wrtDiagram = (DiagramWriter*) pDiagramWriter;
+    ByteBuffer* bufDiagram = createEmptyBuffer();     /* One per thread. */
+    ByteBuffer* bufCompressed = createEmptyBuffer();
+    DiagramJob jobCurrent;
+
+    while (popDiagramJob((*wrtDiagram).Queue, &jobCurrent)) {
+        if (jobCurrent.Skipped) {
+            skipDiagramOutput((*wrtDiagram).Output, jobCurrent.DiagramNumber, 1);
+        }
+        else {
+            writeDiagram(wrtDiagram, jobCurrent.FEN, jobCurrent.FENLength, jobCurrent.Options,
+                jobCurrent.DiagramNumber, bufDiagram, bufCompressed);
+        }
+        finishDiagramJob((*wrtDiagram).Queue);
+    }
+
+    freeBuffer(&bufDiagram);
+    freeBuffer(&bufCompressed);
+
+    return NULL;
+}
+
+
+/**
+ * Prepare sheet mode (--sheet): the beginning of every sheet (see buildSheetHeader()) is
+ * built once, for the default options.
+ *
+ * @param   wrtDiagram      writer whose default options and template are used
+ * @param   nColumns        diagrams per row
+ * @param   nRows           rows per sheet
+ * @return  the sheet, or NULL if the template is malformed
+ * @see     freeDiagramSheet()
+ **/
+DiagramSheet* createDiagramSheet(DiagramWriter* wrtDiagram, int nColumns, int nRows) {
+
+    const RenderContext* ctxRender = getRenderContext((*wrtDiagram).Renderers,
+        (*wrtDiagram).DefaultOptions);
+    if (!ctxRender) {
+        return NULL;
+    }
+    ByteBuffer* bufHeader = buildSheetHeader((*wrtDiagram).Renderers, ctxRender, nColumns, nRows);
+    if (!bufHeader) {
+        return NULL;
+    }
+
+    DiagramSheet* shtReturnValue = (DiagramSheet*) malloc(sizeof(DiagramSheet));
+    if (!shtReturnValue) {
+        printf("Unsuccessful malloc() in createDiagramSheet(): halting.\n");
         exit(EXIT_FAILURE);
     }
+    (*shtReturnValue).Columns = nColumns;
+    (*shtReturnValue).Rows = nRows;
+    (*shtReturnValue).Count = 0;
+    (*shtReturnValue).SheetNumber = 1;
+    (*shtReturnValue).Context = ctxRender;
+    (*shtReturnValue).Header = bufHeader;
+    /* Room for a whole sheet: it only grows once. */
+    (*shtReturnValue).Output = createEmptyBuffer();
+    reserveBuffer((*shtReturnValue).Output, (*bufHeader).Length
+        + (size_t) (nColumns * nRows) * SHEET_CELL_MAX_LENGTH + strlen(SVG_CLOSING_TAG));
+    appendToBuffer((*shtReturnValue).Output, (*bufHeader).Data, (*bufHeader).Length);
+
+    return shtReturnValue;
+}
 
-    /* */
-    return sReturnValue;
+
+/**
+ * Lay out one position on the current sheet, which is written down once full.
+ *
+ * @return  false if the position could not be converted (it takes no room on the sheet)
+ **/
+bool addToSheet(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength) {
+
+    DiagramSheet* shtDiagram = (*wrtDiagram).Sheet;
+    ByteBuffer* bufSheet = (*shtDiagram).Output;
+
+    PipelineStats* stsPipeline = (*wrtDiagram).Stats;
+    StageTimer tmrStage;
+    ChessBoard brdPosition;
+    startStage(stsPipeline, &tmrStage);
+    bool bValidPosition = readPosition(pFEN, nFENLength, &brdPosition);
+    endStage(stsPipeline, FEN_STAGE, &tmrStage);
+    if (!bValidPosition) {
+        countInStats(stsPipeline, REJECTED_FEN_COUNTER, 1);
+        return false;
+    }
+    startStage(stsPipeline, &tmrStage);
+    long nLength = renderSheetCell((*shtDiagram).Context, &brdPosition, (*shtDiagram).Count,
+        (*shtDiagram).Columns, (*bufSheet).Data + (*bufSheet).Length,
+        (*bufSheet).Capacity - (*bufSheet).Length);
+    endStage(stsPipeline, PIECES_STAGE, &tmrStage);
+    if (nLength < 0) {
+        fprintf(stderr, "\nERROR: cannot draw diagram of FEN string (%.*s).",
+            (int) nFENLength, pFEN);
+        return false;
+    }
+    (*bufSheet).Length += (size_t) nLength;
+    (*shtDiagram).Count++;
+
+    if ((*shtDiagram).Count == (*shtDiagram).Columns * (*shtDiagram).Rows) {
+        return writeSheet(wrtDiagram);
+    }
+
+    return true;
 }
 
 
- /** 
- * Create a list of pieces to add to an empty chessboard.
- * To do that it parse the FEN string received in input.
- * Each character of the string represents a chess piece.
- * Thus, each FEN character is converted to a SVG line (i.e. a drawing of a chess piece).
+/**
+ * Close the current sheet and write it down (nothing is written if it is empty), then start
+ * the next one.
  *
- * @param   lstPieces       an EMPTY list of SVG lines
- * @param   sFEN            FEN string representing the chess position
- * @param   bBorder         frame around the board requested?
- * @param   bCoordinates    coordinates for algebric notation around the board
- * @param   bMoveIndicator  little picture next to the board telling who is to move
- * @param   bRotateBoard    board orientation
- * @return  lstReturnValue  a filled list of SVG lines (a piece is drawn with SVG several lines)
- * @see     generateEmptyBoard()
- **/
-LinkedList* createPieces(char* sFEN, bool bBorder, bool bCoordinates, bool bMoveIndicator,
-    bool bRotateBoard) {
-
-    /* nSquareCount ranges from 0 to 63.
-     * File = nSquareCount % 8;
-     * Rank = nSquareCount / 8; (floor() seems better)
-     */
-/* Une conversion float -> int ne te garantit pas l'exactitude, d'ailleurs la Norme dit que la conversion peut hésiter entre la valaur supérieure et la valeur inférieure. */
-
-
-    /* INITIALIZE. */
-    char sBuffer[BUFFER_SIZE];  //TODO: initiliaser à '\0'?
-    char sFENPiece[] = "BbKkNnPpQqRr";
-    char* asSVGPiece[] = { "whitebishop", "blackbishop", "whiteking", "blackking", "whiteknight",
-                           "blackknight", "whitepawn", "blackpawn", "whitequeen", "blackqueen",
-                           "whiterook", "blackrook" };
-    int nTranslateX = 0;
-    int nTranslateY = 0;
-    bool bWhiteToPlay = true;
+ * @return  false if the sheet could not be written
+ **/
+bool writeSheet(DiagramWriter* wrtDiagram) {
 
-    /* */
-    LinkedList* lstReturnValue = createEmptyList();
+    DiagramSheet* shtDiagram = (*wrtDiagram).Sheet;
+    if ((*shtDiagram).Count == 0) {
+        return true;
+    }
+    ByteBuffer* bufWritten = (*shtDiagram).Output;
+    appendStringToBuffer(bufWritten, (*(*shtDiagram).Context).ClosingTag);
+
+    /* COMPRESS (every sheet starts with the same header: a single primed stream). */
+    if ((*wrtDiagram).Compressor) {
+        StageTimer tmrStage;
+        startStage((*wrtDiagram).Stats, &tmrStage);
+        bool bCompressed = compressDiagram((*wrtDiagram).Compressor, 0, (*shtDiagram).Header,
+            (*bufWritten).Data, (*bufWritten).Length, (*wrtDiagram).CompressedDiagram);
+        endStage((*wrtDiagram).Stats, COMPRESSION_STAGE, &tmrStage);
+        if (!bCompressed) {
+            fprintf(stderr, "\nERROR: cannot compress sheet %d.", (*shtDiagram).SheetNumber);
+            bufWritten = NULL;
+        }
+        else {
+            bufWritten = (*wrtDiagram).CompressedDiagram;
+        }
+    }
+
+    /* WRITE SHEET TO FILE (OR ARCHIVE). */
+    char sFileName[FILE_NAME_MAX_SIZE];
+    snprintf(sFileName, FILE_NAME_MAX_SIZE, (*wrtDiagram).Compressor ?
+        SHEET_FILE_NAME_FORMAT "z" : SHEET_FILE_NAME_FORMAT, (*shtDiagram).SheetNumber);
+    bool bReturnValue = bufWritten ?
+        writeCountedOutput(wrtDiagram, (*shtDiagram).SheetNumber, sFileName, bufWritten,
+            true) :
+        writeDiagramOutput((*wrtDiagram).Output, (*shtDiagram).SheetNumber, sFileName, NULL, 0);
+
+    /* NEXT SHEET */
+    (*shtDiagram).SheetNumber++;
+    (*shtDiagram).Count = 0;
+    clearBuffer((*shtDiagram).Output);
+    appendToBuffer((*shtDiagram).Output, (*(*shtDiagram).Header).Data,
+        (*(*shtDiagram).Header).Length);
+
+    return bReturnValue;
+}
 
-    /* DETERMINE WHICH SIDE IS TO MOVE */
-    bWhiteToPlay = isWhiteToPlay(sFEN);
 
-    /* COORDINATES */
-    if (bCoordinates) {
-        nTranslateX +=  VERTICAL_COORDINATES_WIDTH; /* Shift board to the right. */
+/* Free what createDiagramSheet() allocated. */
+void freeDiagramSheet(DiagramSheet** shtDiagram) {
+
+    freeBuffer(&(**shtDiagram).Header);
+    freeBuffer(&(**shtDiagram).Output);
+    free(*shtDiagram);
+    *shtDiagram = NULL;
+}
+
+
+/**
+ * Tell whether a position belongs to this run's shard (--shard): by rank in the input, or,
+ * when positions are file names (-p), by hash of that name, so that a position is always
+ * converted by the same shard, whatever its rank (and deduplicated there).
+ *
+ * @param   nDiagramNumber  number of the position
+ * @param   sFileName       its file name with -p, NULL otherwise (e.g. invalid position)
+ **/
+bool isInShard(const DiagramWriter* wrtDiagram, int nDiagramNumber, const char* sFileName) {
+
+    if ((*wrtDiagram).ShardCount == 1) {
+        return true;
     }
-    
-    /* BORDER */
-    if (bBorder) {
-        nTranslateX +=  BORDER_THICKNESS;
-        nTranslateY +=  BORDER_THICKNESS;
+    if (sFileName) {
+        return hashString(sFileName) % (unsigned long long) (*wrtDiagram).ShardCount
+            == (unsigned long long) (*wrtDiagram).ShardIndex;
     }
 
-    /* PARSE FEN. */
-    char cCurrentChar;
-    int nPos = 0;             /* Item currently read in the FEN string. */
-    int nSquareCount = 0;  /* Range from 0 to 63. */
-    while (sFEN[nPos]!= '\0' && sFEN[nPos]!= ' ' && nSquareCount<64) {
-        cCurrentChar = sFEN[nPos];
+    return (nDiagramNumber - 1) % (*wrtDiagram).ShardCount == (*wrtDiagram).ShardIndex;
+}
+
+
+/**
+ * Hand a position over: it is numbered, then converted at once, or queued for the worker
+ * threads if there are some.
+ * <p>
+ * Every position gets a number, even one that will turn out to be invalid: that way, a
+ * numbered file name only depends on the rank of the position in the input.
+ * <p>
+ * With shards (--shard), positions of the other shards are numbered all the same, then
+ * skipped: file names are those of a single run.
+ * <p>
+ * With deduplication (position as file name only), a position whose file name was already
+ * produced during this run (or, optionally, whose file already exists) is skipped.
+ **/
+void submitPosition(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength,
+    int nOptions) {
+
+    /* FILE NAME, IF MADE OF THE POSITION (an invalid one is left to writeDiagram() to report) */
+    ChessBoard brdPosition;
+    char sFileName[FILE_NAME_MAX_SIZE];
+    bool bNamed = (*wrtDiagram).PositionAsFileName
+        && ((*wrtDiagram).ProducedNames || (*wrtDiagram).ShardCount > 1)
+        && parseFEN(pFEN, nFENLength, &brdPosition, NULL) == FEN_OK;
+    if (bNamed) {
+        generateFileName(wrtDiagram, &brdPosition, 0, sFileName);
+    }
 
-        /* When a digit is found, jumps as many square as its value. */
-        if (cCurrentChar>'0' && cCurrentChar<'9') {
-            nSquareCount += (int) (cCurrentChar-'0');
+    /* SKIP POSITIONS OF OTHER SHARDS (giving up their turn in an archive or stream) */
+    if (!isInShard(wrtDiagram, (*wrtDiagram).DiagramNumber, bNamed ? sFileName : NULL)) {
+        int nDiagramNumber = (*wrtDiagram).DiagramNumber++;
+        if ((*(*wrtDiagram).Output).Mode == FILES_OUTPUT) {
+            return;
+        }
+        if ((*wrtDiagram).Queue) {
+            pushSkippedJob((*wrtDiagram).Queue, nDiagramNumber);
         }
         else {
-            /* Replace piece character (if found) by its SVG string. */
-            char* pFound = strchr(sFENPiece, cCurrentChar);
-            if (pFound) {
-                if (bWhiteToPlay || !bRotateBoard) {
-                    /* White at bottom. */
-                    if (!snprintf(sBuffer,
-                        BUFFER_SIZE,
-                        "    <use xlink:href = \"#%s\" x = \"%d\" y = \"%d\" />",
-                        asSVGPiece[pFound-sFENPiece],
-                        SQUARE_WIDTH*(nSquareCount%8)+nTranslateX,
-                        SQUARE_HEIGHT*(nSquareCount/8)+nTranslateY)) {
-                        printf("Unsuccessful snprintf() in fillBoard(): halting.\n");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                else {
-                    /* Black at bottom. */
-                    if (!snprintf(sBuffer,
-                        BUFFER_SIZE,
-                        "    <use xlink:href = \"#%s\" x = \"%d\" y = \"%d\" />",
-                        asSVGPiece[pFound-sFENPiece],
-                        SQUARE_WIDTH*(7-nSquareCount%8)+nTranslateX,
-                        SQUARE_HEIGHT*(7-nSquareCount/8)+nTranslateY)) {
-                        printf("Unsuccessful snprintf() in fillBoard(): halting.\n");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                appendToList(lstReturnValue, sBuffer);
-                nSquareCount++;
-            }
-            else if (cCurrentChar == '/') {
-                /* Use of nSquareCount/8 allows to simply ignore this char. */
+            skipDiagramOutput((*wrtDiagram).Output, nDiagramNumber, 1);
+        }
+        return;
+    }
+    countInStats((*wrtDiagram).Stats, POSITION_COUNTER, 1);
+
+    /* SKIP REPEATED POSITIONS (with variants, the file of the first one tells) */
+    if ((*wrtDiagram).ProducedNames && bNamed) {
+        if ((*wrtDiagram).VariantCount > 0) {
+            addFileNameSuffix(sFileName, (*wrtDiagram).Variants[0].Suffix);
+        }
+        if (!addToStringSet((*wrtDiagram).ProducedNames, sFileName)
+            || ((*wrtDiagram).CheckExistingFiles && access(sFileName, F_OK) == 0)) {
+            (*wrtDiagram).DuplicateHits++;
+            return;
+        }
+        (*wrtDiagram).DuplicateMisses++;
+    }
+
+    int nDiagramNumber = (*wrtDiagram).DiagramNumber++;
+
+    if ((*wrtDiagram).Sheet) {
+        addToSheet(wrtDiagram, pFEN, nFENLength);
+    }
+    else if ((*wrtDiagram).Queue) {
+        pushDiagramJob((*wrtDiagram).Queue, pFEN, nFENLength, nOptions, nDiagramNumber);
+    }
+    else {
+        writeDiagram(wrtDiagram, pFEN, nFENLength, nOptions, nDiagramNumber,
+            (*wrtDiagram).Diagram, (*wrtDiagram).CompressedDiagram);
+    }
+}
+
+
+/**
+ * Read the next position of a FEN file: its first FEN_EXCERPT_LENGTH characters (only
+ * those are useful) go to sFENExcerpt, which must hold FEN_EXCERPT_LENGTH+1 chars.
+ * <p>
+ * Blank lines are skipped. Lines longer than BUFFER_SIZE are truncated, the remainder
+ * being discarded rather than read as another position.
+ * <p>
+ * Besides comments, a line may hold options for its position, in a tab-separated column
+ * starting with '-' (e.g. "-bcm", see getLineOptions()).
+ *
+ * @param   nDefaultOptions options of a line without options column
+ * @param   nOptions        receives the options of the line (-1 if a letter is unknown)
+ * @return  false once the end of the file is reached
+ **/
+bool readFENLine(FILE* fInputFile, char* sFENExcerpt, int nDefaultOptions, int* nOptions) {
+
+    char sFileLine[BUFFER_SIZE];
+    while (fgets(sFileLine, BUFFER_SIZE, fInputFile)) {
+        size_t nLineLength = strlen(sFileLine);
+
+        /* Skip the end of a line too long to fit in the buffer. */
+        if (nLineLength > 0 && sFileLine[nLineLength-1] != '\n') {
+            int cSkipped;
+            while ((cSkipped = fgetc(fInputFile)) != EOF && cSkipped != '\n') {
             }
-            else {
-                /* UNALLOWED CHARACTER. */
-                printf("\nERROR: unexpected character (%c) in piece placement of FEN string (%s).",
-                    sFEN[nPos], sFEN);
-                return false;
+        }
+
+        /* Remove trailing end of line ("\n" or "\r\n"). */
+        while (nLineLength > 0 && (sFileLine[nLineLength-1] == '\n'
+            || sFileLine[nLineLength-1] == '\r')) {
+            sFileLine[--nLineLength] = '\0';
+        }
+        if (nLineLength == 0) {
+            continue;
+        }
+
+        strncpy(sFENExcerpt, sFileLine, FEN_EXCERPT_LENGTH);    /* Only first chars are useful. */
+        sFENExcerpt[FEN_EXCERPT_LENGTH] = '\0';
+        *nOptions = getLineOptions(sFileLine, nLineLength, nDefaultOptions);
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * Measure the line of a block starting at pLine: same lines as readFENLine() ("\r\n" is
+ * accepted, lines longer than BUFFER_SIZE-1 are truncated).
+ *
+ * @param   pNextLine       receives the start of the next line (pEnd for the last one)
+ * @return  length of the line, end of line excluded (0: blank line)
+ **/
+static size_t measureFENLine(const char* pLine, const char* pEnd, const char** pNextLine) {
+
+    /* Vectorised by the C library: lines are found many bytes at a time. */
+    const char* pNewLine = memchr(pLine, '\n', (size_t) (pEnd - pLine));
+    *pNextLine = pNewLine ? pNewLine + 1 : pEnd;
+    size_t nLineLength = (size_t) ((pNewLine ? pNewLine : pEnd) - pLine);
+    if (nLineLength > BUFFER_SIZE-1) {
+        nLineLength = BUFFER_SIZE-1;
+    }
+    while (nLineLength > 0 && (pLine[nLineLength-1] == '\r' || pLine[nLineLength-1] == '\n')) {
+        nLineLength--;
+    }
+
+    return nLineLength;
+}
+
+
+/**
+ * Offset of the first line of a block starting at nOffset or after it (nLength if none).
+ **/
+size_t findLineStart(const char* pData, size_t nLength, size_t nOffset) {
+
+    if (nOffset == 0 || nOffset >= nLength) {
+        return nOffset < nLength ? nOffset : nLength;
+    }
+    if (pData[nOffset-1] == '\n') {
+        return nOffset;
+    }
+    const char* pNewLine = memchr(pData + nOffset, '\n', nLength - nOffset);
+
+    return pNewLine ? (size_t) (pNewLine + 1 - pData) : nLength;
+}
+
+
+/**
+ * Count the positions of a block, i.e. the diagram numbers its lines take (see
+ * readFENBlock()), without reading them.
+ **/
+long countFENLines(const char* pData, size_t nLength) {
+
+    const char* pEnd = pData + nLength;
+    const char* pLine = pData;
+    long nReturnValue = 0;
+    while (pLine < pEnd) {
+        const char* pNextLine;
+        if (measureFENLine(pLine, pEnd, &pNextLine) > 0) {
+            nReturnValue++;
+        }
+        pLine = pNextLine;
+    }
+
+    return nReturnValue;
+}
+
+
+/**
+ * Read FEN positions from a block of memory (e.g. a mapped file) and write down a diagram
+ * as soon as a line is found. Lines are handed over as views of the block: there is neither
+ * copy nor allocation per line.
+ * <p>
+ * Same lines as readFENLine(): blank lines are skipped, "\r\n" is accepted and lines longer
+ * than BUFFER_SIZE-1 are truncated.
+ * <p>
+ * When the block is part of a FEN file being checkpointed (see saveCheckpoint()), progress
+ * is saved every Interval positions.
+ **/
+void readFENBlock(const char* pData, size_t nLength, DiagramWriter* wrtDiagram) {
+
+    RunCheckpoint* ckpRun = (*wrtDiagram).Checkpoint;
+    const char* pEnd = pData + nLength;
+    const char* pLine = pData;
+    while (pLine < pEnd) {
+        const char* pNextLine;
+        size_t nLineLength = measureFENLine(pLine, pEnd, &pNextLine);
+
+        if (nLineLength > 0) {
+            submitPosition(wrtDiagram, pLine,
+                nLineLength < FEN_EXCERPT_LENGTH ? nLineLength : FEN_EXCERPT_LENGTH,
+                getLineOptions(pLine, nLineLength, (*wrtDiagram).DefaultOptions));
+            if (ckpRun && (*ckpRun).Input && ++(*ckpRun).Positions >= (*ckpRun).Interval) {
+                saveCheckpoint(wrtDiagram, (size_t) (pNextLine - (*ckpRun).Input));
             }
         }
-        nPos++;
-    }
-
-    /* SET UP MOVE INDICATOR */
-    if (bMoveIndicator) {
-        /* Setting move indicator. */
-        nTranslateX = 0;
-        nTranslateY = 0;
-        if (bCoordinates) {
-            nTranslateX +=  VERTICAL_COORDINATES_WIDTH; /* Shift board to the right. */
-        }
-        if (bBorder) {
-            nTranslateX +=  BORDER_THICKNESS;
-            nTranslateX +=  BORDER_THICKNESS;
-            nTranslateY +=  BORDER_THICKNESS;
-        }
-        if (bWhiteToPlay) {
-            if (!snprintf(
-                sBuffer,
-                BUFFER_SIZE,
-                "    <use xlink:href = \"#moveindicator\" fill = \"white\" x = \"%d\" "
-                    "y = \"%d\" />",
-                SQUARE_WIDTH*8+nTranslateX,
-                SQUARE_HEIGHT*7+nTranslateY)) {
-                printf("Unsuccessful snprintf() in fillBoard(): halting.\n");
+        pLine = pNextLine;
+    }
+}
+
+
+/** Parse the games of a chunk of a PGN file (thread entry point, see readPGNBlock()). **/
+void* runPGNExtraction(void* pPGNChunk) {
+
+    PGNChunk* chkGames = (PGNChunk*) pPGNChunk;
+    StageTimer tmrStage;
+    startStage((*chkGames).Stats, &tmrStage);
+    extractGamePositions((*chkGames).Data, (*chkGames).Length, (*chkGames).Offset,
+        (*chkGames).Selection, (*chkGames).Positions, (*chkGames).Errors);
+    endStage((*chkGames).Stats, PGN_STAGE, &tmrStage);
+
+    return NULL;
+}
+
+
+/**
+ * Read the games of a block of a PGN file (whole games only) and write down the diagrams of
+ * their selected positions.
+ * <p>
+ * The block is split into chunks of about PGN_CHUNK_SIZE bytes, at game boundaries: up to
+ * ExtractionThreads chunks are parsed at a time, each by its own thread, into FEN lines.
+ * Those are then read in chunk order (see readFENBlock()), so that diagrams are numbered as
+ * if games had been parsed one after another.
+ *
+ * @param   nOffset         offset of pData in its file (for error messages)
+ **/
+void readPGNBlock(const char* pData, size_t nLength, size_t nOffset, DiagramWriter* wrtDiagram) {
+
+    int nThreads = (*wrtDiagram).ExtractionThreads;
+    PGNChunk* achkGames = (PGNChunk*) malloc(nThreads * sizeof(PGNChunk));
+    pthread_t* athrExtractors = (pthread_t*) malloc(nThreads * sizeof(pthread_t));
+    if (!achkGames || !athrExtractors) {
+        printf("Unsuccessful malloc() in readPGNBlock(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int nChunk = 0; nChunk < nThreads; nChunk++) {
+        achkGames[nChunk].Selection = &(*wrtDiagram).Selection;
+        achkGames[nChunk].Stats = (*wrtDiagram).Stats;
+        achkGames[nChunk].Positions = createEmptyBuffer();
+        achkGames[nChunk].Errors = createEmptyBuffer();
+    }
+
+    size_t nFrom = 0;
+    while (nFrom < nLength) {
+        /* 1 - SPLIT INTO CHUNKS AT GAME BOUNDARIES */
+        int nChunks = 0;
+        while (nChunks < nThreads && nFrom < nLength) {
+            size_t nTo = (nLength - nFrom > PGN_CHUNK_SIZE) ?
+                findNextGame(pData, nLength, nFrom + PGN_CHUNK_SIZE) : nLength;
+            achkGames[nChunks].Data = pData + nFrom;
+            achkGames[nChunks].Length = nTo - nFrom;
+            achkGames[nChunks].Offset = nOffset + nFrom;
+            clearBuffer(achkGames[nChunks].Positions);
+            clearBuffer(achkGames[nChunks].Errors);
+            nChunks++;
+            nFrom = nTo;
+        }
+
+        /* 2 - PARSE THEM IN PARALLEL (the first one on the current thread) */
+        for (int nChunk = 1; nChunk < nChunks; nChunk++) {
+            if (pthread_create(&athrExtractors[nChunk], NULL, runPGNExtraction,
+                &achkGames[nChunk]) != 0) {
+                printf("Unsuccessful pthread_create() in readPGNBlock(): halting.\n");
                 exit(EXIT_FAILURE);
             }
         }
-        else {
-            if (!snprintf(
-                sBuffer,
-                BUFFER_SIZE,
-                "    <use xlink:href = \"#moveindicator\" fill = \"black\" x = \"%d\" "
-                    "y = \"%d\" />",
-                SQUARE_WIDTH*8+nTranslateX,
-                SQUARE_HEIGHT*7+nTranslateY)) {
-                printf("Unsuccessful snprintf() in fillBoard(): halting.\n");
-                exit(EXIT_FAILURE);
-            }
+        runPGNExtraction(&achkGames[0]);
+        for (int nChunk = 1; nChunk < nChunks; nChunk++) {
+            pthread_join(athrExtractors[nChunk], NULL);
+        }
+
+        /* 3 - WRITE DOWN THEIR POSITIONS, IN ORDER */
+        for (int nChunk = 0; nChunk < nChunks; nChunk++) {
+            fwrite((*achkGames[nChunk].Errors).Data, 1, (*achkGames[nChunk].Errors).Length,
+                stderr);
+            readFENBlock((*achkGames[nChunk].Positions).Data,
+                (*achkGames[nChunk].Positions).Length, wrtDiagram);
         }
-        appendToList(lstReturnValue, sBuffer);
     }
 
-    return lstReturnValue;
+    for (int nChunk = 0; nChunk < nThreads; nChunk++) {
+        freeBuffer(&achkGames[nChunk].Positions);
+        freeBuffer(&achkGames[nChunk].Errors);
+    }
+    free(achkGames);
+    free(athrExtractors);
 }
 
 
 /**
- * Transfert FEN positions from file to linked list.
+ * Read the games of a PGN stream (e.g. a pipe), which cannot be mapped: it is read in
+ * blocks, each one handed over up to its last game boundary (see readPGNBlock()), the
+ * remainder being kept for the next one.
  **/
-bool readFENFile(char* sFileName, LinkedList* lstFENString) {
-    
+void readPGNStream(FILE* fInputFile, DiagramWriter* wrtDiagram) {
+
+    ByteBuffer* bufPending = createEmptyBuffer();
+    size_t nOffset = 0;
+    size_t nBatchSize = (size_t) (*wrtDiagram).ExtractionThreads * PGN_CHUNK_SIZE;
+
+    for (;;) {
+        reserveBuffer(bufPending, PGN_CHUNK_SIZE);
+        size_t nRead = fread((*bufPending).Data + (*bufPending).Length, 1, PGN_CHUNK_SIZE,
+            fInputFile);
+        (*bufPending).Length += nRead;
+        if (nRead == 0) {
+            break;
+        }
+        if ((*bufPending).Length < nBatchSize) {
+            continue;
+        }
 
-    FILE* fInputFile = fopen(sFileName, "rt") ;
-    if (fInputFile == NULL) {
-        printf("Error: cannot open input file (%s).\n", sFileName);
-        return false;
+        /* LAST GAME BOUNDARY (the game after it may not be complete yet) */
+        size_t nBoundary = 0;
+        for (size_t nNext; (nNext = findNextGame((*bufPending).Data, (*bufPending).Length,
+            nBoundary)) < (*bufPending).Length; ) {
+            nBoundary = nNext;
+        }
+        if (nBoundary > 0) {
+            readPGNBlock((*bufPending).Data, nBoundary, nOffset, wrtDiagram);
+            memmove((*bufPending).Data, (*bufPending).Data + nBoundary,
+                (*bufPending).Length - nBoundary);
+            (*bufPending).Length -= nBoundary;
+            nOffset += nBoundary;
+        }
     }
+    readPGNBlock((*bufPending).Data, (*bufPending).Length, nOffset, wrtDiagram);
 
-    /* BROWSE FILE LINE BY LINE */
-    char sFENExcerpt[FEN_EXCERPT_LENGTH];
-    char sFileLine[BUFFER_SIZE];
-    while (fgets(sFileLine, BUFFER_SIZE, fInputFile)) {
-        strncpy(sFENExcerpt, sFileLine, FEN_EXCERPT_LENGTH);    /* Only first chars are useful. */
-        sFENExcerpt[FEN_EXCERPT_LENGTH] = '\0';
-        appendToList(lstFENString, sFENExcerpt);
+    freeBuffer(&bufPending);
+}
+
+
+/**
+ * Is a file to be read as PGN (--pgn, or PGN_FILE_EXTENSION)? Other files, EPD ones
+ * included, are read as FEN lines: parseFEN() ignores the EPD operations after the en
+ * passant square, as it does move counters.
+ **/
+bool isPGNFile(const char* sFileName, const DiagramWriter* wrtDiagram) {
+
+    size_t nNameLength = strlen(sFileName);
+    size_t nExtensionLength = strlen(PGN_FILE_EXTENSION);
+    if ((*wrtDiagram).PGNInput) {
+        return true;
     }
-    
-    /* CLOSE FILE */
-    if (!fclose(fInputFile)) {
+    if (nNameLength <= nExtensionLength) {
         return false;
     }
-    
+    for (size_t nChar = 0; nChar < nExtensionLength; nChar++) {
+        if (tolower((unsigned char) sFileName[nNameLength - nExtensionLength + nChar])
+            != PGN_FILE_EXTENSION[nChar]) {
+            return false;
+        }
+    }
 
     return true;
 }
 
 
-/** 
- * Reads SVG definitions from file and puts every line in a linked list.
- * <p>
- * The template is a SVG file that contains only definitions ("<defs/>").
- * For a definition item to be visible, it has to be used ("<use/>").
- *
- * @param   sFileName       name of the SVG
- * @return  lstEmptyBoard   an unsorted linked list of SVG lines
- * @see     generateEmptyBoard()
+/**
+ * Read the positions of a mapped FEN file (see readFENBlock()): only the lines starting in
+ * the range (--range), numbered as if every line before them had been read, and, when
+ * resuming (--resume), only those after the checkpoint.
  **/
-LinkedList* readTemplate(char* sFileName) {    //TODO: vérifier si la ligne lue > BUFFER_SIZE
+static void readMappedFENFile(const char* pData, size_t nLength, DiagramWriter* wrtDiagram) {
+
+    RunCheckpoint* ckpRun = (*wrtDiagram).Checkpoint;
+
+    /* 1 - FIRST AND LAST LINES */
+    size_t nStart = findLineStart(pData, nLength, (*wrtDiagram).RangeStart);
+    size_t nEnd = findLineStart(pData, nLength, (*wrtDiagram).RangeEnd);
+    if (ckpRun && (*ckpRun).InputIndex == (*ckpRun).ResumeInput) {
+        /* The checkpoint numbered every diagram before its offset. */
+        nStart = (*ckpRun).ResumeOffset;
+        if (nStart > nEnd) {
+            nStart = nEnd;
+        }
+    }
+    else {
+        int nSkipped = (int) countFENLines(pData, nStart);
+        skipDiagramOutput((*wrtDiagram).Output, (*wrtDiagram).DiagramNumber, nSkipped);
+        (*wrtDiagram).DiagramNumber += nSkipped;
+    }
 
-    LinkedList* lstReturnValue = createEmptyList();
+    /* 2 - READ THEM (saving progress against the whole file) */
+    if (ckpRun) {
+        (*ckpRun).Input = pData;
+        (*ckpRun).Positions = 0;
+    }
+    readFENBlock(pData + nStart, nEnd - nStart, wrtDiagram);
+    if (ckpRun) {
+        saveCheckpoint(wrtDiagram, nEnd);
+        (*ckpRun).Input = NULL;
+    }
+}
 
-    FILE* fInputFile;
-    char sBuffer[BUFFER_SIZE];
 
-    /* OPEN FILE */
-    fInputFile = fopen(sFileName, "rt") ;
-    if (fInputFile == NULL) {
-        printf("Error: cannot open input file (%s).", sFileName);
+/**
+ * Map a regular file in memory and read its positions (see readMappedFENFile()), or its
+ * games (see readPGNBlock()).
+ *
+ * @return  false if the file cannot be mapped (e.g. a pipe): it is then to be read as a stream
+ **/
+static bool readMappedFile(FILE* fInputFile, bool bPGN, DiagramWriter* wrtDiagram) {
+
+#ifdef _WIN32
+    (void) fInputFile;
+    (void) bPGN;
+    (void) wrtDiagram;
+    return false;
+#else
+    int nDescriptor = fileno(fInputFile);
+    struct stat sttInput;
+    if (fstat(nDescriptor, &sttInput) != 0 || !S_ISREG(sttInput.st_mode)
+        || lseek(nDescriptor, 0, SEEK_CUR) != 0) {
         return false;
     }
-
-    /* BROWSE FILE LINE BY LINE */
-    while (fgets(sBuffer, BUFFER_SIZE, fInputFile)) { // fgets() + sscanf() > fscanf() !?
-        /* Remove trailing '\n'. */
-        if (sBuffer) {
-            int nBufferLastChar = strlen(sBuffer)-1;
-            if (sBuffer[nBufferLastChar] == '\n') {
-                sBuffer[nBufferLastChar] = '\0';
-            }
-        }
-        /* Add line to list. */
-        appendToList(lstReturnValue, sBuffer);
+    if (sttInput.st_size == 0) {
+        return true;                        /* Nothing to read (nor to map). */
     }
+    void* pMapping = mmap(NULL, (size_t) sttInput.st_size, PROT_READ, MAP_PRIVATE, nDescriptor,
+        0);
+    if (pMapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(pMapping, (size_t) sttInput.st_size, MADV_SEQUENTIAL);
 
-    /* CLOSE FILE */
-    fclose(fInputFile);
+    if (bPGN) {
+        readPGNBlock((const char*) pMapping, (size_t) sttInput.st_size, 0, wrtDiagram);
+    }
+    else {
+        readMappedFENFile((const char*) pMapping, (size_t) sttInput.st_size, wrtDiagram);
+    }
 
-    return lstReturnValue;
+    munmap(pMapping, (size_t) sttInput.st_size);
+    return true;
+#endif
 }
 
 
-/** Append SVG length and width to opening tag ("<svg>") and
- * suppress closing tag (which will be recreated upon SVG completion).
+/**
+ * Read FEN positions from a file (or from the standard input if the file name is "-")
+ * and write down a diagram as soon as a line is read. PGN files (see isPGNFile()) are
+ * read game after game instead.
  * <p>
- * Lengths of the diagram varies with presence of borders, coordinates and move indicator.
+ * Regular files are mapped in memory; pipes and terminals are read line by line (PGN ones,
+ * block by block).
  * <p>
- * This step could be done during template loading. However the goal
- * here is to keep loading separated for reusability and maintenance.
- *
- * @param   bBorder         frame around the board
- * @param   bCoordinates    coordinates for algebric notation around the board
- * @param   bMoveIndicator  little picture next to the board telling who is to move
- * @param   lstSVGTemplate  each item of the list is a SVG line
- * @return  lstSVGTemplate
- * @see     createPieces()
- **/
-bool addLengthsToTemplate(LinkedList lstSVGTemplate, bool bBorder, bool bCoordinates,
-    bool bMoveIndicator) {
-
-    char sBuffer[BUFFER_SIZE];          /* Holds length variations. */
-
-    /* POINT TO START OF THE LIST. */
-    ListItem* itmCurrentItem = lstSVGTemplate.First;
-
-    /* APPEND WIDTH AND LENGTH TO STARTING TAG. */
-    if (itmCurrentItem && itmCurrentItem->Value) {
-        if (strncmp("<svg", itmCurrentItem->Value, 4) == 0) {
-            if (!snprintf(
-                sBuffer,
-                BUFFER_SIZE,
-                "<svg width = \"%d\" height = \"%d\" version = \"1.1\"\n",
-                computeWholeDrawingWidth(bCoordinates,bBorder, bMoveIndicator),
-                computeWholeDrawingHeight(bCoordinates, bBorder))) {
-                printf("Unsuccessful snprintf() in addLengthsToTemplate(): halting.\n");
-                exit(EXIT_FAILURE);
-            }
-            modifyItemValue(itmCurrentItem, sBuffer);
-        }
-        else {
-            printf("Template first line is not '<svg' <> '%s': halting.\n", itmCurrentItem->Value);
-            return false;
-        }
+ * Only mapped FEN files can be checkpointed (--checkpoint) or read in part (--range): their
+ * lines can be reached by offset.
+ **/
+bool readFENFile(char* sFileName, DiagramWriter* wrtDiagram) {
+
+    FILE* fInputFile = NULL;
+    bool bStandardInput = (strcmp(sFileName, "-") == 0);
+    bool bPGN = isPGNFile(sFileName, wrtDiagram);
+    bool bSeekable = (*wrtDiagram).Checkpoint || (*wrtDiagram).RangeStart > 0
+        || (*wrtDiagram).RangeEnd != NO_RANGE_END;
+
+    /* Inputs read to the end before the checkpoint. */
+    if ((*wrtDiagram).Checkpoint
+        && (*(*wrtDiagram).Checkpoint).InputIndex < (*(*wrtDiagram).Checkpoint).ResumeInput) {
+        return true;
     }
-    else {
-        printf("Template first line not found : halting.\n"); //TODO: mettre un exit_failure
+    if (bSeekable && bPGN) {
+        fprintf(stderr, "Error: cannot checkpoint nor split PGN file (%s).\n", sFileName);
         return false;
     }
 
-    /* REACH THE LAST ITEM. */
-    while(itmCurrentItem->Next) { /* itmCurrentItem always exist. */
-        itmCurrentItem = itmCurrentItem->Next;
-    }
-
-    /* DELETE CLOSING TAG. */
-    if (itmCurrentItem && itmCurrentItem->Value) {
-        if (strncmp("</svg>", itmCurrentItem->Value,
-            strlen("</svg>")) == 0) {
-            modifyItemValue(itmCurrentItem, "\n");
-        }
-        else {
-            printf("Template last line is not '</svg>' <> '%s': halting.\n",
-                itmCurrentItem->Value);
-            return false;
-        }
+    /* OPEN FILE */
+    if (bStandardInput) {
+        fInputFile = stdin;
     }
     else {
-        printf("Template last line not found or empty: halting.");
+        fInputFile = fopen(sFileName, "rt");
+    }
+    if (fInputFile == NULL) {
+        fprintf(stderr, "Error: cannot open input file (%s).\n", sFileName);
         return false;
     }
-        
-    return true;
-}
 
-
-/** 
- * Return a list of uses of SVG definitions to represent an empty chess board.
- * The colour of the square may vary, the board can have a border, coordinates, ...
- * <p>
- * This empty chessboard is intented to act as a template to create a board filled with chess
- * pieces later.
- *
- * @param   bBorder         frame around the board requested?
- * @param   bCoordinates    coordinates for algebric notation around the board
- * @param   bMoveIndicator  little picture next to the board telling who is to move
- * @param   bWhiteAtBottom  board orientation
- * @return  lstEmptyBoard   an unsorted linked list of SVG lines
- * @see     fillBoard()
- **/
-LinkedList* generateEmptyBoard(bool bBorder, bool bCoordinates, bool bMoveIndicator,
-    bool bWhiteAtBottom) {
-
-    LinkedList* lstEmptyBoard = createEmptyList();
-
-    /* INITIALIZE ITEM LOCATION ON THE SVG DRAWING. */
-    /* Location of an item is defined by (nX+nTranslateX, nY+nTranslateY). */
-    int nX = 0;                /* Location on a stripped board. */
-    int nY = 0;
-    int nTranslateX = 0;    /* Allows to insert item(s) before current one. */
-    int nTranslateY = 0;
-
-    /* SET UP LIGHT AND DARK SQUARES. */
-    if (bCoordinates) {
-        nTranslateX +=  VERTICAL_COORDINATES_WIDTH;  /* Shift board to the right. */
-    }
-    if (bBorder) {
-        nTranslateX +=  BORDER_THICKNESS;
-        nTranslateY +=  BORDER_THICKNESS;
-    }
-    char sBuffer[BUFFER_SIZE];             /* Holds length variations. */
-    bool bLightSquare = true;               /* alternates between dark and light squares*/
-    for (nY = 0; nY<8; nY++) {                /* Eight rows. */
-        for (nX = 0; nX<8; nX++) {            /* Eight columns. */
-            if (bLightSquare) {
-                if (!snprintf(sBuffer, BUFFER_SIZE,
-                         "    <use xlink:href = \"#lightsquare\" x = \"%d\" y = \"%d\" />",
-                         nX*SQUARE_WIDTH+nTranslateX,
-                         nY*SQUARE_HEIGHT+nTranslateY)) {
-                    printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                    exit(EXIT_FAILURE);
-                }
-                appendToList(lstEmptyBoard, sBuffer);
-            }
-            else {
-                if (!snprintf(sBuffer,
-                    BUFFER_SIZE,
-                    "    <use xlink:href = \"#darksquare\" x = \"%d\" y = \"%d\" />",
-                    nX*SQUARE_WIDTH+nTranslateX,
-                    nY*SQUARE_HEIGHT+nTranslateY)) {
-                        printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                        exit(EXIT_FAILURE);
-                }
-                appendToList(lstEmptyBoard, sBuffer);
-            }
-            bLightSquare = !bLightSquare;    /* Switch square color. */
-        }
-        bLightSquare = !bLightSquare;
-    }
-
-    /* SET UP BORDERS. */
-    if (bBorder) {
-        /* Initialize. */
-        nX = 0;
-        nTranslateX = 0;
-        if (bCoordinates) {
-            nTranslateX +=  VERTICAL_COORDINATES_WIDTH; /* Shift board to the right. */
-        }
-        /* Generate XML line. */
-        if (!snprintf(
-            sBuffer,
-            BUFFER_SIZE,
-            "    <use xlink:href = \"#borders\" x = \"%d\" y = \"0\" />",
-            nX+nTranslateX)) {
-            printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-            exit(EXIT_FAILURE);
-        }
-        /* Append line to XML list for output file. */
-        appendToList(lstEmptyBoard, sBuffer);
-    }
-
-    /* SET UP COORDINATES. */
-    if (bCoordinates) {
-        /* Vertical coordinates (from '8' to '1'). */
-        nY = 0;
-        nTranslateY = BORDER_THICKNESS;
-        if (bWhiteAtBottom) {
-            /* White on bottom. */
-            for(char cCoordinate = '8'; cCoordinate > '0'; cCoordinate -= '1'-'0') {
-                /* Generate SVG line. */
-                if (!snprintf(sBuffer, BUFFER_SIZE,
-                         "    <use xlink:href = \"#coordinate%c\" x = \"0\" y = \"%d\" />",
-                         cCoordinate, nY+nTranslateY)) {
-                    printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                    exit(EXIT_FAILURE);
-                 }
-                /* Append line to list for output file. */
-                appendToList(lstEmptyBoard, sBuffer);
-                nY +=  SQUARE_HEIGHT;
-            }
-        }
-        else {
-            /* Black on bottom. */
-            for(char cCoordinate = '1'; cCoordinate < '9'; cCoordinate += '1'-'0') {
-                /* Generate SVG line. */
-                if(!snprintf(sBuffer, BUFFER_SIZE, 
-                         "    <use xlink:href = \"#coordinate%c\" x = \"0\" y = \"%d\" />",
-                         cCoordinate, nY+nTranslateY)) {
-                    printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                    exit(EXIT_FAILURE);
-                 }
-                /* Append line to list for output file. */
-                appendToList(lstEmptyBoard, sBuffer);
-                nY +=  SQUARE_HEIGHT;
+    /* BROWSE FILE LINE BY LINE (unless it can be mapped) */
+    if (!readMappedFile(fInputFile, bPGN, wrtDiagram)) {
+        if (bSeekable) {
+            fprintf(stderr, "Error: cannot checkpoint nor split input stream (%s).\n",
+                sFileName);
+            if (!bStandardInput) {
+                fclose(fInputFile);
             }
+            return false;
         }
-        /* Horizontal coordinates (from 'a' to 'h') */
-        nX = 0;
-        nY = 8*SQUARE_HEIGHT;
-        nTranslateX = VERTICAL_COORDINATES_WIDTH;
-        nTranslateX +=  BORDER_THICKNESS;
-        nTranslateY = BORDER_THICKNESS;
-        nTranslateY +=  BORDER_THICKNESS;
-        if (bWhiteAtBottom) {
-            /* White at bottom. */
-            for(char cCoordinate = 'a'; cCoordinate<'i'; cCoordinate +=  'b'-'a') {
-                /* Generate SVG line. */
-                if (!snprintf(
-                    sBuffer,
-                    BUFFER_SIZE,
-                    "    <use xlink:href = \"#coordinate%c\" x = \"%d\" y = \"%d\" />",
-                    cCoordinate,
-                    nX+nTranslateX,
-                    nY+nTranslateY)) {
-                    printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                    exit(EXIT_FAILURE);
-                };
-                /* Append line to list for output file. */
-                appendToList(lstEmptyBoard, sBuffer);
-                nX +=  SQUARE_WIDTH;
-            }
+        else if (bPGN) {
+            readPGNStream(fInputFile, wrtDiagram);
         }
         else {
-            /* Black at bottom. */
-            for(char cCoordinate = 'h'; cCoordinate>='a'; cCoordinate -=  'b'-'a') {
-                /* Generate SVG line. */
-                if (!snprintf(
-                    sBuffer,
-                    BUFFER_SIZE,
-                    "    <use xlink:href = \"#coordinate%c\" x = \"%d\" y = \"%d\" />",
-                    cCoordinate,
-                    nX+nTranslateX,
-                    nY+nTranslateY)) {
-                    printf("Unsuccessful snprintf() in generateEmptyBoard(): halting.\n");
-                    exit(EXIT_FAILURE);
-                };
-                /* Append line to list for output file. */
-                appendToList(lstEmptyBoard, sBuffer);
-                nX +=  SQUARE_WIDTH;
+            char sFENExcerpt[FEN_EXCERPT_LENGTH+1];
+            int nOptions;
+            while (readFENLine(fInputFile, sFENExcerpt, (*wrtDiagram).DefaultOptions,
+                &nOptions)) {
+                submitPosition(wrtDiagram, sFENExcerpt, strlen(sFENExcerpt), nOptions);
             }
         }
     }
 
-    return lstEmptyBoard;
+    /* CLOSE FILE */
+    if (!bStandardInput && fclose(fInputFile) != 0) {
+        return false;
+    }
+
+    return true;
 }
 
 
 /**
- * Write SVG definitions, empty board and chess pieces to a file.
+ * Save the progress of the run (--checkpoint): the input being read, the offset of its next
+ * line and the number of the next diagram. Every diagram before is written first (queued
+ * ones, files written in the background), so that a run resumed from there misses none.
+ * <p>
+ * The checkpoint file is replaced at once (renamed from a temporary file): a run stopped
+ * meanwhile leaves either the previous checkpoint or the new one.
+ *
+ * @param   nOffset         offset in the input being read (see RunCheckpoint)
+ * @return  false if the checkpoint could not be written
  **/
-bool writeListsToFile(char* sOutputFile, LinkedList lstTemplate, LinkedList lstEmptyBoard,
-    LinkedList lstPieces) {
-
-    ListItem* itmSVGLine = NULL;
-    FILE* fOutputFile;
+bool saveCheckpoint(DiagramWriter* wrtDiagram, size_t nOffset) {
 
-    /* OPEN FILE */
-    fOutputFile = fopen(sOutputFile, "w");
-    if (fOutputFile  ==  NULL) {
-        printf("Error: cannot open output file (%s).", sOutputFile);
-        return false;
-    }
+    RunCheckpoint* ckpRun = (*wrtDiagram).Checkpoint;
+    (*ckpRun).Positions = 0;
 
-    /* WRITE TEMPLATE TO FILE.*/
-    itmSVGLine = lstTemplate.First;
-    while(itmSVGLine) {
-        if (itmSVGLine->Value) {
-            fprintf(fOutputFile, "%s\n", itmSVGLine->Value);
-        }
-        itmSVGLine = itmSVGLine->Next;
+    /* 1 - WAIT FOR EVERY DIAGRAM NUMBERED SO FAR */
+    if ((*wrtDiagram).Queue) {
+        waitForDiagramQueue((*wrtDiagram).Queue);
     }
-
-    /* WRITE EMPTY BOARD TO FILE.*/
-    itmSVGLine = lstEmptyBoard.First;
-    while(itmSVGLine) {
-        if (itmSVGLine->Value) {
-            fprintf(fOutputFile, "%s\n", itmSVGLine->Value);
-        }
-        itmSVGLine = itmSVGLine->Next;
+    flushDiagramOutput((*wrtDiagram).Output);   /* Failures were told file by file. */
+
+    /* 2 - WRITE THE CHECKPOINT BESIDE, THEN REPLACE THE FORMER ONE */
+    char sTemporaryName[FILE_NAME_MAX_SIZE];
+    snprintf(sTemporaryName, FILE_NAME_MAX_SIZE, "%s.tmp", (*ckpRun).FileName);
+    FILE* fCheckpoint = fopen(sTemporaryName, "w");
+    if (fCheckpoint) {
+        fprintf(fCheckpoint, "%s\ninput %d %s\noffset %zu\ndiagram %d\n", CHECKPOINT_HEADER,
+            (*ckpRun).InputIndex, (*ckpRun).InputName, nOffset, (*wrtDiagram).DiagramNumber);
     }
-
-    /* ADD PIECES TO FILE. */
-    itmSVGLine = lstPieces.First;
-    while(itmSVGLine) {
-        if (itmSVGLine->Value) {
-            fprintf(fOutputFile, "%s\n", itmSVGLine->Value);
-        }
-        itmSVGLine = itmSVGLine->Next;
+    if (!fCheckpoint || fclose(fCheckpoint) != 0
+        || rename(sTemporaryName, (*ckpRun).FileName) != 0) {
+        fprintf(stderr, "Error: cannot write checkpoint file (%s).\n", (*ckpRun).FileName);
+        return false;
     }
-    
-    /* WRITE SVG CLOSURE LINE. */
-    fprintf(fOutputFile, "</svg>\n");
 
-    /* CLOSE FILE */
-    fclose(fOutputFile);
+    return true;
 }
 
 
 /**
- * For each FEN:
- * 1. Store SVG definitions of board and pieces in a linked list.
- * 2. Use those definitions to define an empty board in a linked list.
- * 3. Use those definitions to fill the board with pieces in a linked list.
- * 4. Write down those three linked list to a file.
- **/ 
-bool writeDiagramsToFiles(LinkedList lstTemplate, LinkedList lstNormalEmptyBoard,
-    LinkedList lstReversedEmptyBoard, LinkedList lstFEN, bool bBorder, bool bCoordinates,
-    bool bMoveIndicator, bool bPositionAsFileName, bool bRotateBoard) {
+ * Read the checkpoint a run is resumed from (--resume, see saveCheckpoint()).
+ *
+ * @param   ckpRun          receives the input (ResumeInput, ResumeName) and offset to start
+ *                          from; they are left as they are if there is no checkpoint file yet
+ * @param   nDiagramNumber  receives the number of the next diagram
+ * @return  false if the checkpoint file cannot be read or is malformed
+ **/
+bool loadCheckpoint(RunCheckpoint* ckpRun, int* nDiagramNumber) {
 
+    FILE* fCheckpoint = fopen((*ckpRun).FileName, "r");
+    if (!fCheckpoint) {
+        if (errno == ENOENT) {
+            return true;                    /* Nothing done yet: start from the beginning. */
+        }
+        fprintf(stderr, "Error: cannot open checkpoint file (%s).\n", (*ckpRun).FileName);
+        return false;
+    }
 
-    /* */
-    LinkedList lstEmptyBoard;             /* Received as parameter. */
-    LinkedList* lstPieces = NULL;
-    ListItem* itmFEN = NULL;                /* Current item in the list of FEN position. */
-    char* sFileName = NULL;
-
-    /* BROWSE THE LIST OF FEN */
-    int nDiagramNumber = 1;
-    itmFEN = lstFEN.First;
-    while(itmFEN) {                  /*For each FEN... */
-        if (itmFEN->Value) {
-            
-            /* WHICH EMPTY BOARD TO USE (White or Black at bottom)? */
-            if (isWhiteToPlay(itmFEN->Value) || !bRotateBoard) {
-                lstEmptyBoard = lstNormalEmptyBoard;
-            }
-            else {
-                lstEmptyBoard = lstReversedEmptyBoard;
-            }
-            
-            /* FILL BOARD WITH PIECES. */
-            lstPieces = createPieces(itmFEN->Value, bBorder, bCoordinates, bMoveIndicator,
-                bRotateBoard);
-
-            /* GENERATE FILE NAME */
-            if (bPositionAsFileName) {
-                sFileName = generateFENFileName(itmFEN->Value);
-            }
-            else {
-                sFileName = generateNumberedFileName(nDiagramNumber++);
-            }
+    char sHeader[BUFFER_SIZE];
+    char sInput[BUFFER_SIZE];
+    int nInput = -1;
+    int nNameStart = 0;
+    size_t nOffset = 0;
+    bool bValid = fgets(sHeader, BUFFER_SIZE, fCheckpoint)
+        && strncmp(sHeader, CHECKPOINT_HEADER "\n", BUFFER_SIZE) == 0
+        && fgets(sInput, BUFFER_SIZE, fCheckpoint)
+        && sscanf(sInput, "input %d %n", &nInput, &nNameStart) == 1 && nNameStart > 0
+        && nInput >= 0
+        && fscanf(fCheckpoint, "offset %zu\n", &nOffset) == 1
+        && fscanf(fCheckpoint, "diagram %d\n", nDiagramNumber) == 1 && *nDiagramNumber >= 1;
+    fclose(fCheckpoint);
+    if (!bValid) {
+        fprintf(stderr, "Error: malformed checkpoint file (%s).\n", (*ckpRun).FileName);
+        return false;
+    }
 
-            /* WRITE BOARD AND PIECES TO FILE. */
-            writeListsToFile(sFileName, lstTemplate, lstEmptyBoard, *lstPieces);
-            
-            /* GET NEXT FEN */
-            free(sFileName);
-            freeList(&lstPieces);
-            itmFEN = itmFEN->Next;
-        }
+    /* Input name: the rest of its line. */
+    sInput[strcspn(sInput, "\r\n")] = '\0';
+    size_t nNameSize = strlen(sInput + nNameStart) + 1;
+    (*ckpRun).ResumeName = (char*) malloc(nNameSize * sizeof(char));
+    if (!(*ckpRun).ResumeName) {
+        printf("Unsuccessful malloc() in loadCheckpoint(): halting.\n");
+        exit(EXIT_FAILURE);
     }
-    
+    memcpy((*ckpRun).ResumeName, sInput + nNameStart, nNameSize);
+    (*ckpRun).ResumeInput = nInput;
+    (*ckpRun).ResumeOffset = nOffset;
 
     return true;
 }
 
 
+#ifndef FEN2SVG_NO_MAIN                     /* Other programs (e.g. bench.c) have their own. */
 /** Self-explanatory. **/
 int main(int argc, char *argv[]) {
 
@@ -832,6 +1529,33 @@ int main(int argc, char *argv[]) {
     bool bMoveIndicator = false;
     bool bRotateBoard = false;
     bool bPositionAsFileName = false;
+    int nWorkerThreads = 1;
+    enum OutputMode enuOutputMode = FILES_OUTPUT;
+    char* sArchiveName = NULL;
+    bool bDeduplicate = false;
+    bool bCheckExistingFiles = false;
+    char* sSocketPath = NULL;
+    bool bCompact = false;
+    bool bCompress = false;
+    char* sSpriteFile = NULL;
+    char* sTemplateFile = NULL;             /* NULL: template built into the program. */
+    bool bGameSequence = false;
+    int nSheetColumns = 0;                  /* 0: one diagram per SVG document. */
+    int nPNGSquareSize = 0;                 /* 0: SVG. */
+    int nSquareSize = SQUARE_WIDTH;         /* Displayed size of SVG squares. */
+    int nSheetRows = 0;
+    bool bPGNInput = false;
+    PositionSelection selPositions = { FINAL_POSITION, 0 };
+    char* sStatsFile = NULL;                /* NULL: no statistics. */
+    bool bAsynchronousFiles = false;
+    RunCheckpoint ckpRun = { NULL, DEFAULT_CHECKPOINT_INTERVAL, 0, 0, NULL, NULL, -1, NULL, 0 };
+    bool bResume = false;
+    size_t nRangeStart = 0;
+    size_t nRangeEnd = NO_RANGE_END;
+    int nShardIndex = 1;
+    int nShardCount = 1;
+    OutputVariant aVariants[MAX_OUTPUT_VARIANTS];
+    int nVariantCount = 0;                  /* 0: a single diagram per position. */
 
     /* 1 - PARSE COMMAND LINE ARGUMENTS */
     /* No argument? */
@@ -841,8 +1565,27 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
     /* Process arguments one by one. */
+    static struct option aoptLongOptions[] = {
+        {"compact", no_argument, NULL, COMPACT_LONG_OPTION},
+        {"sprite", required_argument, NULL, SPRITE_LONG_OPTION},
+        {"sheet", required_argument, NULL, SHEET_LONG_OPTION},
+        {"png", required_argument, NULL, PNG_LONG_OPTION},
+        {"template", required_argument, NULL, TEMPLATE_LONG_OPTION},
+        {"pgn", no_argument, NULL, PGN_LONG_OPTION},
+        {"positions", required_argument, NULL, POSITIONS_LONG_OPTION},
+        {"stats", required_argument, NULL, STATS_LONG_OPTION},
+        {"async", no_argument, NULL, ASYNC_LONG_OPTION},
+        {"checkpoint", required_argument, NULL, CHECKPOINT_LONG_OPTION},
+        {"checkpoint-every", required_argument, NULL, CHECKPOINT_EVERY_LONG_OPTION},
+        {"resume", no_argument, NULL, RESUME_LONG_OPTION},
+        {"range", required_argument, NULL, RANGE_LONG_OPTION},
+        {"shard", required_argument, NULL, SHARD_LONG_OPTION},
+        {"size", required_argument, NULL, SIZE_LONG_OPTION},
+        {"variants", required_argument, NULL, VARIANTS_LONG_OPTION},
+        {NULL, 0, NULL, 0}
+    };
     int c;
-    while ( (c = getopt(argc, argv, "hbcmprfs")) != -1) {
+    while ( (c = getopt_long(argc, argv, "hbcmprfsj:a:0dDS:zg", aoptLongOptions, NULL)) != -1) {
         switch (c) {
             case 'h':
                 /* Display help */
@@ -856,18 +1599,89 @@ int main(int argc, char *argv[]) {
                 printf("License GPLv3+: GNU GPL version 3 or later \n");
                 printf("<http://gnu.org/licenses/gpl.html>\n");
                 printf("\n");
-                fprintf(stderr, "Usage: %s [-bcmrfs] file(s) or string(s)\n",
+                fprintf(stderr, "Usage: %s [-bcmpdDrfs0zg] [--compact] [--sprite file] [--sheet CxR] [--png size] [--size N] [--template file] [--pgn] [--positions S] [--stats file] [--async] [--checkpoint file [--checkpoint-every N] [--resume]] [--range S:E] [--shard i/N] [--variants list] [-j threads] [-a archive] file(s) or string(s)\n",
+                    argv[0]);
+                fprintf(stderr, "       %s [-bcmr] [--compact] [--template file] -S socket\n",
                     argv[0]);
                 printf("    -b\tborders\n");
                 printf("    -c\texternal coordinates\n");
                 printf("    -m\tmove indicator\n");
                 printf("    -p\tposition (i.e. FEN) as file name\n");
+                printf("    -d\twith -p, skip positions whose file was already produced\n");
+                printf("    -D\tsame as -d, also skipping files already in the directory\n");
                 printf("    -r\trotate board (i.e. side to move below)\n");
+                printf("    --compact\tminified SVG (no indentation, short ids)\n");
+                printf("    --sprite F\twrite the definitions once, to the file F, and reference "
+                    "them\n");
+                printf("    \tfrom every diagram (e.g. xlink:href=\"F#whiteknight\")\n");
+                printf("    --sheet CxR\tlay out positions C per row, R rows per SVG document "
+                    "(\"sheet00001.svg\"...),\n");
+                printf("    \tevery board using a single empty board (options column "
+                    "ignored)\n");
+                printf("    --png N\twrite PNG files instead of SVG, squares being N pixels "
+                    "wide (%d to %d;\n", RASTER_MIN_SQUARE_SIZE, RASTER_MAX_SQUARE_SIZE);
+                printf("    \t72 is the size of the SVG diagrams)\n");
+                printf("    --size N\tSVG diagrams whose squares are displayed N pixels wide "
+                    "(%d to %d;\n", MIN_SQUARE_SIZE, MAX_SQUARE_SIZE);
+                printf("    \tdefault: %d, as drawn in the template)\n", SQUARE_WIDTH);
+                printf("    --template F\tdraw boards and pieces with the definitions of the SVG "
+                    "file F\n");
+                printf("    \t(default: %s, as built into the program)\n", SVG_TEMPLATE);
+                printf("    --pgn\tread every file as PGN (default: only \"%s\" files; EPD "
+                    "files are\n", PGN_FILE_EXTENSION);
+                printf("    \tread as FEN files)\n");
+                printf("    --positions S\tpositions drawn from each PGN game: \"final\" "
+                    "(default), \"ply:N\"\n");
+                printf("    \t(after N half-moves) or \"every:N\" (every N half-moves, start "
+                    "included)\n");
+                printf("    --stats F\twrite timings of each stage and counters to the file F, "
+                    "as JSON\n");
+                printf("    \t(\"-\" for standard error)\n");
+                printf("    --variants L\tdraw every position once per variant of the list L, "
+                    "parsing it once\n");
+                printf("    \t(e.g. plain,c,r,m: \"dia00001.svg\", \"dia00001_c.svg\"...), "
+                    "options added to its own\n");
+                printf("    -j N\tconvert positions with N worker threads (default: 1); PGN "
+                    "games are\n");
+                printf("    \tparsed by N threads too\n");
+                printf("    -g\tgame sequence: positions follow one another, only changed "
+                    "squares are\n");
+                printf("    \tredrawn (pieces are laid out in fixed-size, space-padded "
+                    "slots)\n");
+                printf("    --async\twrite files in the background, many at a time (io_uring, "
+                    "else a writer thread)\n");
+                printf("    --checkpoint F\tsave the progress of the run to the file F: input, "
+                    "offset and next\n");
+                printf("    \tdiagram number, once every diagram before is written (FEN files, "
+                    "files output)\n");
+                printf("    --checkpoint-every N\tsave progress every N positions (default: "
+                    "%d)\n", DEFAULT_CHECKPOINT_INTERVAL);
+                printf("    --resume\twith the same arguments, start from the checkpoint "
+                    "(if any) instead of the\n");
+                printf("    \tbeginning\n");
+                printf("    --range S:E\tonly read the lines of the FEN file starting at byte "
+                    "S to E (excluded;\n");
+                printf("    \t\"S:\": to the end), numbered as if the lines before had been "
+                    "read\n");
+                printf("    --shard i/N\tonly convert the positions of shard i (1 to N): every "
+                    "Nth position,\n");
+                printf("    \tor with -p, by hash of the file name; file names are those of a "
+                    "single run\n");
+                printf("    -a F\twrite every diagram into the tar archive F (\"-\" for "
+                    "standard output)\n");
+                printf("    -0\twrite every diagram to standard output, as \"name\\0svg\\0\" "
+                    "entries\n");
+                printf("    -z\tgzip diagrams (.svgz files or archive entries; with -0, the "
+                    "whole stream)\n");
                 printf("    -f\tfile mode (default):\n");
-                printf("    \tFEN positions are contained in a file\n");
+                printf("    \tFEN positions are contained in a file (\"-\" for standard "
+                    "input)\n");
                 printf("    -s\tstring mode:\n");
                 printf("    \tFEN posititions are passed directly in the command "
                     "line\n");
+                printf("    -S F\tserver mode: answer requests on the Unix socket F, until "
+                    "stopped\n");
+                printf("    \t(one FEN line per request, -bcmr being the default options)\n");
                 return EXIT_SUCCESS;
                 break;
             case 'b':
@@ -885,6 +1699,147 @@ int main(int argc, char *argv[]) {
             case 'p':
                 bPositionAsFileName = true;
                 break;
+            case 'D':
+                bCheckExistingFiles = true;
+                bDeduplicate = true;
+                break;
+            case 'd':
+                bDeduplicate = true;
+                break;
+            case 'a':
+                enuOutputMode = TAR_OUTPUT;
+                sArchiveName = optarg;
+                break;
+            case '0':
+                enuOutputMode = STREAM_OUTPUT;
+                break;
+            case 'z':
+                bCompress = true;
+                break;
+            case 'g':
+                bGameSequence = true;
+                break;
+            case 'S':
+                sSocketPath = optarg;
+                break;
+            case COMPACT_LONG_OPTION:
+                bCompact = true;
+                break;
+            case SPRITE_LONG_OPTION:
+                /* Referenced from every line: short, and nothing to escape. */
+                if (strlen(optarg) == 0 || strlen(optarg) > SPRITE_FILE_MAX_LENGTH
+                    || strpbrk(optarg, "\"#&<>")) {
+                    fprintf(stderr, "%s: sprite file name must be 1 to %d characters long, "
+                        "without any of '\"#&<>'\n", argv[0], SPRITE_FILE_MAX_LENGTH);
+                    exit(EXIT_FAILURE);
+                }
+                sSpriteFile = optarg;
+                break;
+            case TEMPLATE_LONG_OPTION:
+                sTemplateFile = optarg;
+                break;
+            case PGN_LONG_OPTION:
+                bPGNInput = true;
+                break;
+            case STATS_LONG_OPTION:
+                sStatsFile = optarg;
+                break;
+            case ASYNC_LONG_OPTION:
+                bAsynchronousFiles = true;
+                break;
+            case CHECKPOINT_LONG_OPTION:
+                ckpRun.FileName = optarg;
+                break;
+            case CHECKPOINT_EVERY_LONG_OPTION:
+                ckpRun.Interval = atol(optarg);
+                if (ckpRun.Interval < 1) {
+                    fprintf(stderr, "%s: checkpoint interval must be at least 1 position\n",
+                        argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case RESUME_LONG_OPTION:
+                bResume = true;
+                break;
+            case SHARD_LONG_OPTION: {
+                char cEnd = '\0';
+                if (sscanf(optarg, "%d/%d%c", &nShardIndex, &nShardCount, &cEnd) != 2
+                    || nShardCount < 1 || nShardIndex < 1 || nShardIndex > nShardCount) {
+                    fprintf(stderr, "%s: shard must be given as i/N, from 1/N to N/N (e.g. "
+                        "2/8)\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case RANGE_LONG_OPTION: {
+                char* pEnd = optarg;
+                if (isdigit((unsigned char) *optarg)) {
+                    nRangeStart = (size_t) strtoull(optarg, &pEnd, 10);
+                }
+                bool bValidRange = (pEnd != optarg && *pEnd == ':');
+                if (bValidRange && isdigit((unsigned char) pEnd[1])) {
+                    nRangeEnd = (size_t) strtoull(pEnd + 1, &pEnd, 10);
+                }
+                else if (bValidRange) {
+                    pEnd++;
+                }
+                if (!bValidRange || *pEnd != '\0' || nRangeEnd < nRangeStart) {
+                    fprintf(stderr, "%s: range must be given as start:end byte offsets "
+                        "(e.g. 0:1000000), end being optional\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case POSITIONS_LONG_OPTION:
+                if (!parsePositionSelection(optarg, &selPositions)) {
+                    fprintf(stderr, "%s: positions must be \"final\", \"ply:N\" (N >= 0) or "
+                        "\"every:N\" (N >= 1)\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case PNG_LONG_OPTION:
+                nPNGSquareSize = atoi(optarg);
+                if (nPNGSquareSize < RASTER_MIN_SQUARE_SIZE
+                    || nPNGSquareSize > RASTER_MAX_SQUARE_SIZE) {
+                    fprintf(stderr, "%s: square size of PNG files must range from %d to %d\n",
+                        argv[0], RASTER_MIN_SQUARE_SIZE, RASTER_MAX_SQUARE_SIZE);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case VARIANTS_LONG_OPTION:
+                nVariantCount = parseOutputVariants(optarg, aVariants);
+                if (nVariantCount == 0) {
+                    fprintf(stderr, "%s: variants must be different sets of options among b, "
+                        "c, m and r (\"plain\": none),\nseparated by commas (e.g. "
+                        "plain,c,r,m)\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case SIZE_LONG_OPTION:
+                nSquareSize = atoi(optarg);
+                if (nSquareSize < MIN_SQUARE_SIZE || nSquareSize > MAX_SQUARE_SIZE) {
+                    fprintf(stderr, "%s: square size of SVG diagrams must range from %d to "
+                        "%d\n", argv[0], MIN_SQUARE_SIZE, MAX_SQUARE_SIZE);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case SHEET_LONG_OPTION:
+                if (sscanf(optarg, "%dx%d", &nSheetColumns, &nSheetRows) != 2
+                    || nSheetColumns < 1 || nSheetRows < 1
+                    || nSheetColumns > SHEET_MAX_DIAGRAMS / nSheetRows) {
+                    fprintf(stderr, "%s: sheet must be given as columns x rows (e.g. 4x3), "
+                        "at most %d diagrams\n", argv[0], SHEET_MAX_DIAGRAMS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                nWorkerThreads = atoi(optarg);
+                if (nWorkerThreads < 1 || nWorkerThreads > MAX_WORKER_THREADS) {
+                    fprintf(stderr, "%s: number of threads must range from 1 to %d\n",
+                        argv[0], MAX_WORKER_THREADS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'f':
                 /* Store input file name */
                 if (enuInputMode!= UNKNOWN_MODE && enuInputMode!= FILE_MODE) {
@@ -926,9 +1881,83 @@ int main(int argc, char *argv[]) {
         enuInputMode = FILE_MODE;
     }
 
+    /* Deduplication relies on file names made of positions. */
+    if (bDeduplicate && !bPositionAsFileName) {
+        fprintf(stderr, "%s: deduplication (-d, -D) requires position as file name (-p)\n",
+            argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* A game sequence is drawn position after position, in order. */
+    if (bGameSequence && nWorkerThreads > 1) {
+        fprintf(stderr, "%s: game sequence mode (-g) requires a single thread\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* A sheet is filled position after position, in order, for the default options. */
+    if (nSheetColumns > 0 && (nWorkerThreads > 1 || bGameSequence)) {
+        fprintf(stderr, "%s: sheet mode (--sheet) requires a single thread, without game "
+            "sequence (-g)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Bitmaps are drawn from the template itself, one file per position. */
+    if (nPNGSquareSize > 0 && (bCompress || bGameSequence || sSpriteFile || nSheetColumns > 0)) {
+        fprintf(stderr, "%s: PNG files (--png) cannot be compressed (-z), nor drawn as a game "
+            "sequence (-g), sprite (--sprite) or sheet (--sheet)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (nPNGSquareSize > 0 && nSquareSize != SQUARE_WIDTH) {
+        fprintf(stderr, "%s: PNG files are sized by --png, not --size\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Checkpoints and ranges reach lines of FEN files by offset; a checkpoint can only
+     * tell written diagrams apart if each is a file of its own. */
+    bool bRange = nRangeStart > 0 || nRangeEnd != NO_RANGE_END;
+    if ((ckpRun.FileName || bRange) && (enuInputMode != FILE_MODE || nSheetColumns > 0)) {
+        fprintf(stderr, "%s: checkpoints (--checkpoint) and ranges (--range) require file mode "
+            "(-f), without sheet (--sheet)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (ckpRun.FileName && enuOutputMode != FILES_OUTPUT) {
+        fprintf(stderr, "%s: checkpoints (--checkpoint) require one file per diagram "
+            "(neither -a nor -0)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (bResume && !ckpRun.FileName) {
+        fprintf(stderr, "%s: resuming (--resume) requires a checkpoint file (--checkpoint)\n",
+            argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    /* A sheet is filled with consecutive positions. */
+    if (nShardCount > 1 && nSheetColumns > 0) {
+        fprintf(stderr, "%s: shards (--shard) cannot be laid out on sheets (--sheet)\n",
+            argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    /* Variants of a position are drawn one after the other, from its parsed board. */
+    if (nVariantCount > 0 && (bGameSequence || nSheetColumns > 0)) {
+        fprintf(stderr, "%s: variants (--variants) cannot be drawn as a game sequence (-g) nor "
+            "laid out on sheets (--sheet)\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (bRange && argc - optind != 1) {
+        fprintf(stderr, "%s: a range (--range) applies to a single input file\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Server mode: requests come from the socket, not from arguments. */
+    if (sSocketPath) {
+        return runDiagramServer(sSocketPath, sTemplateFile, combineOptions(bBorder, bCoordinates,
+            bMoveIndicator, bRotateBoard, bCompact)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /* Non-optional arguments (options are preceeded by a '-')
         Here FEN file(s) or string(s) are expected. */ 
-    LinkedList* lstArgument = createEmptyList();      /* File names or FEN strings */
+    /* Lists built at start-up are carved out of a single arena. */
+    ListArena* arnStartup = createListArena(STARTUP_ARENA_BLOCK_SIZE);
+    LinkedList* lstArgument = createArenaList(arnStartup);   /* File names or FEN strings */
     if (optind >= argc) {
         fprintf(stderr, "%s: no file or FEN string to process\n", argv[0]);
         fprintf(stderr, "Try '%s -h' for more information.\n", argv[0]);
@@ -940,54 +1969,183 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* 2 - READ SVG TEMPLATE (contains definitions for board items and pieces) */
-    LinkedList* lstTemplate = readTemplate(SVG_TEMPLATE);
-    if (!addLengthsToTemplate(*lstTemplate, bBorder, bCoordinates, bMoveIndicator)) {
-        freeList(&lstTemplate);
+    /* 2 - READ SVG TEMPLATE AND GENERATE TWO EMPTY CHESSBOARDS (same boards are used for
+     *     every position) */
+    PipelineStats* stsPipeline = sStatsFile ? createPipelineStats() : NULL;
+    StageTimer tmrTemplate;
+    startStage(stsPipeline, &tmrTemplate);
+    DiagramWriter wrtDiagram;
+    if (!setUpDiagramWriter(&wrtDiagram, sTemplateFile, bBorder, bCoordinates, bMoveIndicator,
+        bPositionAsFileName, bRotateBoard, bCompact, sSpriteFile, nSquareSize)) {
+        return EXIT_FAILURE;
+    }
+    endStage(stsPipeline, TEMPLATE_STAGE, &tmrTemplate);
+    wrtDiagram.Stats = stsPipeline;
+
+    /* 3 - READ INPUT FEN STRINGS, FILL AND WRITE DOWN SVG DIAGRAMS (one at a time). */
+    wrtDiagram.ProducedNames = bDeduplicate ? createStringSet() : NULL;
+    wrtDiagram.CheckExistingFiles = bCheckExistingFiles;
+    wrtDiagram.DuplicateHits = 0;
+    wrtDiagram.DuplicateMisses = 0;
+    wrtDiagram.PGNInput = bPGNInput;
+    wrtDiagram.Selection = selPositions;
+    wrtDiagram.ExtractionThreads = nWorkerThreads;
+    /* In stream mode, the stream as a whole is compressed, not each diagram. */
+    if (bCompress && enuOutputMode != STREAM_OUTPUT) {
+        wrtDiagram.Compressor = createDiagramCompressor(Z_BEST_COMPRESSION);
+    }
+    wrtDiagram.Frame = bGameSequence ? createGameFrame() : NULL;
+    wrtDiagram.RangeStart = nRangeStart;
+    wrtDiagram.RangeEnd = nRangeEnd;
+    wrtDiagram.ShardIndex = nShardIndex - 1;
+    wrtDiagram.ShardCount = nShardCount;
+    memcpy(wrtDiagram.Variants, aVariants, (size_t) nVariantCount * sizeof(OutputVariant));
+    wrtDiagram.VariantCount = nVariantCount;
+    if (ckpRun.FileName) {
+        wrtDiagram.Checkpoint = &ckpRun;
+    }
+    if (bResume) {
+        /* Same arguments as the checkpointed run: its input must be at the same rank. */
+        if (!loadCheckpoint(&ckpRun, &wrtDiagram.DiagramNumber)) {
+            return EXIT_FAILURE;
+        }
+        ListItem* lstResumed = (*lstArgument).First;
+        for (int nInput = 0; lstResumed && nInput < ckpRun.ResumeInput; nInput++) {
+            lstResumed = lstResumed->Next;
+        }
+        if (ckpRun.ResumeName && (!lstResumed
+            || strcmp(lstResumed->Value, ckpRun.ResumeName) != 0)) {
+            fprintf(stderr, "%s: input %d of the checkpoint (%s) is not among the arguments\n",
+                argv[0], ckpRun.ResumeInput + 1, ckpRun.ResumeName);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nPNGSquareSize > 0) {
+        ByteBuffer* bufTemplate = buildTemplateBlob(*(*wrtDiagram.Renderers).Template);
+        wrtDiagram.Rasterizer = createDiagramRasterizer(bufTemplate, nPNGSquareSize);
+        freeBuffer(&bufTemplate);
+        if (!wrtDiagram.Rasterizer) {
+            fprintf(stderr, "%s: template cannot be drawn as bitmaps (%s)\n", argv[0],
+                sTemplateFile ? sTemplateFile : SVG_TEMPLATE);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nSheetColumns > 0) {
+        wrtDiagram.Sheet = createDiagramSheet(&wrtDiagram, nSheetColumns, nSheetRows);
+        if (!wrtDiagram.Sheet) {
+            return EXIT_FAILURE;
+        }
+    }
+    wrtDiagram.Output = openDiagramOutput(enuOutputMode, sArchiveName, wrtDiagram.DiagramNumber,
+        bCompress, bAsynchronousFiles);
+    if (!wrtDiagram.Output) {
         return EXIT_FAILURE;
     }
-    /* 3 - GENERATE TWO EMPTY CHESSBOARDS (same boards are used for every position) */
-    /* White at bottom. */
-    LinkedList* lstNormalEmptyBoard = generateEmptyBoard(bBorder, bCoordinates, bMoveIndicator, WHITE_ON_BOTTOM);
-    /* Black at bottom. */
-    LinkedList* lstReversedEmptyBoard = generateEmptyBoard(bBorder, bCoordinates, bMoveIndicator, BLACK_ON_BOTTOM);
 
-    /* 3 - READ INPUT FEN STRINGS. */
-    LinkedList* lstFEN = createEmptyList();
-    
-    if (enuInputMode == FILE_MODE) {
-        /* Get FEN strings from one or several files. */
-        ListItem* lstCurrent = (*lstArgument).First;
-        while(lstCurrent) {
-            if (lstCurrent->Value) {
-                readFENFile(lstCurrent->Value, lstFEN);
+    /* Sprite file, before any diagram (first entry of an archive or stream). */
+    if (sSpriteFile) {
+        ByteBuffer* bufSprite = buildSprite(*(*wrtDiagram.Renderers).Template, bCompact);
+        bool bSpriteWritten = writeSharedOutput(wrtDiagram.Output, sSpriteFile,
+            (*bufSprite).Data, (*bufSprite).Length);
+        freeBuffer(&bufSprite);
+        if (!bSpriteWritten) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Worker threads, if requested (the current thread keeps on reading the input). */
+    pthread_t* athrWorkers = NULL;
+    if (nWorkerThreads > 1) {
+        wrtDiagram.Queue = createDiagramQueue();
+        athrWorkers = (pthread_t*) malloc(nWorkerThreads * sizeof(pthread_t));
+        if (!athrWorkers) {
+            printf("Unsuccessful malloc() in main(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int nThread = 0; nThread < nWorkerThreads; nThread++) {
+            if (pthread_create(&athrWorkers[nThread], NULL, runDiagramWorker, &wrtDiagram) != 0) {
+                printf("Unsuccessful pthread_create() in main(): halting.\n");
+                exit(EXIT_FAILURE);
             }
-            lstCurrent = lstCurrent->Next;
         }
     }
-    else {
-        /* Get FEN strings directly from the command line. */
-        ListItem* lstCurrent = (*lstArgument).First;
-        while(lstCurrent) {
-            if (lstCurrent->Value) {
-                appendToList(lstFEN, lstCurrent->Value);
+
+    ListItem* lstCurrent = (*lstArgument).First;
+    for (int nInput = 0; lstCurrent; nInput++) {
+        if (lstCurrent->Value) {
+            if (enuInputMode == FILE_MODE) {
+                /* Get FEN strings from one or several files ("-" for standard input). */
+                ckpRun.InputIndex = nInput;
+                ckpRun.InputName = lstCurrent->Value;
+                readFENFile(lstCurrent->Value, &wrtDiagram);
+            }
+            else {
+                /* Get FEN strings directly from the command line. */
+                submitPosition(&wrtDiagram, lstCurrent->Value, strlen(lstCurrent->Value),
+                    wrtDiagram.DefaultOptions);
             }
-            lstCurrent = lstCurrent->Next;
         }
+        lstCurrent = lstCurrent->Next;
+    }
+
+    /* Let the worker threads finish the queued positions. */
+    if (wrtDiagram.Queue) {
+        closeDiagramQueue(wrtDiagram.Queue);
+        for (int nThread = 0; nThread < nWorkerThreads; nThread++) {
+            pthread_join(athrWorkers[nThread], NULL);
+        }
+        free(athrWorkers);
+        freeDiagramQueue(&wrtDiagram.Queue);
+    }
+
+    /* Last sheet, even if not full. */
+    bool bOutputCompleted = true;
+    if (wrtDiagram.Sheet) {
+        bOutputCompleted = writeSheet(&wrtDiagram);
+    }
+
+    /* Complete the archive, if any. */
+    bOutputCompleted = closeDiagramOutput(&wrtDiagram.Output) && bOutputCompleted;
+
+    /* Deduplication report. */
+    if (wrtDiagram.ProducedNames) {
+        fprintf(stderr, "Deduplication: %ld hit(s) (skipped), %ld miss(es) (converted).\n",
+            wrtDiagram.DuplicateHits, wrtDiagram.DuplicateMisses);
+        freeStringSet(&wrtDiagram.ProducedNames);
+    }
+
+    /* Game sequence report. */
+    if (wrtDiagram.Frame) {
+        fprintf(stderr, "Game sequence: %ld square(s) redrawn for %d position(s).\n",
+            (*wrtDiagram.Frame).ChangedSquares, wrtDiagram.DiagramNumber - 1);
     }
-    /* Free memory. */
-    freeList(&lstArgument);
 
-    /* 4 - FILL AND WRITE DOWN SVG DIAGRAMS. */
-    writeDiagramsToFiles(*lstTemplate, *lstNormalEmptyBoard, *lstReversedEmptyBoard, *lstFEN,
-                  bBorder, bCoordinates, bMoveIndicator, bPositionAsFileName, bRotateBoard);
+    /* Statistics, once every diagram is written. */
+    if (stsPipeline) {
+        FILE* fStats = (strcmp(sStatsFile, "-") == 0) ? stderr : fopen(sStatsFile, "w");
+        if (fStats == stderr) {
+            fprintf(stderr, "\n");         /* Error messages do not end their line. */
+        }
+        if (fStats) {
+            writePipelineStats(stsPipeline, fStats);
+            if (fStats != stderr && fclose(fStats) != 0) {
+                bOutputCompleted = false;
+            }
+        }
+        else {
+            fprintf(stderr, "Error: cannot open statistics file (%s).\n", sStatsFile);
+            bOutputCompleted = false;
+        }
+        freePipelineStats(&stsPipeline);
+    }
 
-    /* 5 - FREE MEMORY. */
-    freeList(&lstTemplate);
-    freeList(&lstFEN);
-    freeList(&lstNormalEmptyBoard);
-    freeList(&lstReversedEmptyBoard);
+    /* 4 - FREE MEMORY. */
+    free(ckpRun.ResumeName);
+    freeList(&lstArgument);
+    freeListArena(&arnStartup);
+    tearDownDiagramWriter(&wrtDiagram);
     
-    /* 6 - RETURN "EVERYTHING WENT WELL". */
-    return EXIT_SUCCESS;
+    /* 5 - RETURN "EVERYTHING WENT WELL" (if the output could be completed). */
+    return bOutputCompleted ? EXIT_SUCCESS : EXIT_FAILURE;
 }
+#endif
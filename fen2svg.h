@@ -0,0 +1,244 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for fen2svg.c. It lets
+ * other programs (e.g. the benchmark harness, bench.c) reuse its functions.
+ **/
+
+#include <unistd.h>                         /* POSIX command line arguments parsing (getopt) */
+#include <getopt.h>                         /* Long options (getopt_long) */
+#include <pthread.h>                        /* Worker threads (-j) */
+#include "libfen2svg.h"                     /* Own work */
+#include "diagramoutput.h"                  /* Own work */
+#include "diagramserver.h"                  /* Own work */
+#include "diagramcompressor.h"              /* Own work */
+#include "diagramraster.h"                  /* Own work */
+#include "stringset.h"                      /* Own work */
+#include "pgnreader.h"                      /* Own work */
+#include "pipelinestats.h"                  /* Own work */
+
+#define FILE_NAME_MAX_SIZE 1024
+#define STARTUP_ARENA_BLOCK_SIZE 65536      /* Arguments usually fit in one block. */
+#define MAX_WORKER_THREADS 1024
+#define DIAGRAM_QUEUE_CAPACITY 4096         /* Positions waiting for a worker thread. */
+#define COMPACT_LONG_OPTION 256             /* --compact (no short form). */
+#define SPRITE_LONG_OPTION 257              /* --sprite (no short form). */
+#define SHEET_LONG_OPTION 258               /* --sheet (no short form). */
+#define PNG_LONG_OPTION 259                 /* --png (no short form). */
+#define TEMPLATE_LONG_OPTION 260            /* --template (no short form). */
+#define PGN_LONG_OPTION 261                 /* --pgn (no short form). */
+#define POSITIONS_LONG_OPTION 262           /* --positions (no short form). */
+#define STATS_LONG_OPTION 263               /* --stats (no short form). */
+#define ASYNC_LONG_OPTION 264               /* --async (no short form). */
+#define CHECKPOINT_LONG_OPTION 265          /* --checkpoint (no short form). */
+#define CHECKPOINT_EVERY_LONG_OPTION 266    /* --checkpoint-every (no short form). */
+#define RESUME_LONG_OPTION 267              /* --resume (no short form). */
+#define RANGE_LONG_OPTION 268               /* --range (no short form). */
+#define SHARD_LONG_OPTION 269               /* --shard (no short form). */
+#define SIZE_LONG_OPTION 270                /* --size (no short form). */
+#define VARIANTS_LONG_OPTION 271            /* --variants (no short form). */
+#define MAX_OUTPUT_VARIANTS 16              /* Every combination of -b, -c, -m and -r. */
+#define VARIANT_SUFFIX_SIZE 6               /* "_bcmr" and '\0'. */
+#define DEFAULT_CHECKPOINT_INTERVAL 100000  /* Positions between two checkpoints. */
+#define CHECKPOINT_HEADER "FEN2SVG checkpoint"
+#define NO_RANGE_END ((size_t) -1)          /* --range S: up to the end of the file. */
+#define PGN_FILE_EXTENSION ".pgn"           /* Read as PGN without --pgn. */
+#define SHEET_MAX_DIAGRAMS 1024             /* Columns x rows of a sheet. */
+
+#define NUMBERED_FILE_NAME_FORMAT   "dia%05d.svg"
+#define NUMBERED_FILE_NAME_PREFIX   "dia"       /* NUMBERED_FILE_NAME_FORMAT in three parts, */
+#define NUMBERED_FILE_NAME_DIGITS   5           /* written without snprintf(). */
+#define NUMBERED_FILE_NAME_SUFFIX   ".svg"
+#define SHEET_FILE_NAME_FORMAT      "sheet%05d.svg"
+
+
+/**
+ * A position waiting to be converted by a worker thread. Its number is given when it is
+ * read, so that numbered file names do not depend on which thread converts it.
+ **/
+typedef struct DiagramJob {
+    int DiagramNumber;
+    bool Skipped;                       /* Position of another shard: only its turn is given up. */
+    int Options;                        /* Drawing options (e.g. BORDER_OPTION). */
+    char FEN[FEN_EXCERPT_LENGTH+1];
+    size_t FENLength;
+} DiagramJob;
+
+/**
+ * Bounded FIFO of positions, between the thread reading the input and the worker threads.
+ * Slots are allocated once: queuing a position costs a copy, not an allocation.
+ **/
+typedef struct DiagramQueue {
+    DiagramJob Jobs[DIAGRAM_QUEUE_CAPACITY];
+    int First;                          /* Next job to be taken. */
+    int Count;                          /* Jobs waiting. */
+    int Busy;                           /* Jobs taken, whose diagram is not written yet. */
+    bool Closed;                        /* No more job will be queued. */
+    pthread_mutex_t Mutex;
+    pthread_cond_t NotEmpty;
+    pthread_cond_t NotFull;
+    pthread_cond_t Idle;                /* Signalled once no job is waiting nor busy. */
+} DiagramQueue;
+
+
+/**
+ * Sheet being filled (--sheet): positions are laid out row after row, then the sheet is
+ * written as one SVG document once full (or once the input is over).
+ **/
+typedef struct DiagramSheet {
+    int Columns;
+    int Rows;
+    int Count;                          /* Diagrams already on the current sheet. */
+    int SheetNumber;                    /* Number given to the current sheet. */
+    const RenderContext* Context;       /* Default options: the options column is ignored. */
+    ByteBuffer* Header;                 /* Template and empty boards, same for every sheet. */
+    ByteBuffer* Output;                 /* Current sheet. */
+} DiagramSheet;
+
+
+/**
+ * Games of a PGN file, parsed by one thread into FEN lines (see runPGNExtraction()). Data is
+ * a view of the file: chunks start and end at game boundaries (see findNextGame()).
+ **/
+typedef struct PGNChunk {
+    const char* Data;
+    size_t Length;
+    size_t Offset;                      /* Offset of Data in the file (for error messages). */
+    const PositionSelection* Selection;
+    ByteBuffer* Positions;              /* FEN lines of the selected positions. */
+    ByteBuffer* Errors;                 /* Messages, written once the chunk is parsed. */
+    PipelineStats* Stats;               /* NULL unless statistics are kept (--stats). */
+} PGNChunk;
+
+
+/**
+ * Progress of a run (--checkpoint), saved every Interval positions of FEN files: input,
+ * offset of the next line and number of the next diagram, every diagram before being
+ * written. A run given the same arguments and --resume starts from there.
+ **/
+typedef struct RunCheckpoint {
+    const char* FileName;               /* Where progress is saved. */
+    long Interval;                      /* Positions between two checkpoints. */
+    long Positions;                     /* Positions read since the last checkpoint. */
+    int InputIndex;                     /* Input (rank among the arguments) being read. */
+    const char* InputName;
+    const char* Input;                  /* Mapped FEN file being read, else NULL. */
+    int ResumeInput;                    /* --resume: input, its name and offset to start */
+    char* ResumeName;                   /*   from (inputs before ResumeInput are skipped), */
+    size_t ResumeOffset;                /*   else -1, NULL and 0. */
+} RunCheckpoint;
+
+
+/**
+ * One of the diagrams drawn from every position (--variants): options added to those of
+ * the position, and suffix of its file name, before the extension (e.g. "dia00001_c.svg";
+ * none for the plain variant).
+ **/
+typedef struct OutputVariant {
+    int Options;
+    char Suffix[VARIANT_SUFFIX_SIZE];
+} OutputVariant;
+
+
+/**
+ * Everything writing diagrams needs but FEN strings: rendering context, output and options.
+ * It is set up once and then shared by every position (and every worker thread, which
+ * only read it).
+ **/
+typedef struct DiagramWriter {
+    RenderCache* Renderers;             /* Empty boards and ready-made lines, per options. */
+    int DefaultOptions;                 /* Options of positions that have none of their own. */
+    ByteBuffer* Diagram;                /* Reused for every diagram: no allocation per position
+                                           (worker threads have their own). */
+    ByteBuffer* CompressedDiagram;      /* Same, for the gzip data of a diagram. */
+    DiagramCompressor* Compressor;      /* NULL: plain SVG (see -z). */
+    DiagramRasterizer* Rasterizer;      /* NULL: SVG, else PNG files (see --png). */
+    GameFrame* Frame;                   /* Game sequence (-g): previous diagram, else NULL. */
+    DiagramSheet* Sheet;                /* Sheet mode (--sheet): current sheet, else NULL. */
+    DiagramQueue* Queue;                /* NULL: positions are converted as soon as read. */
+    DiagramOutput* Output;              /* Files, archive or stream. */
+    StringSet* ProducedNames;           /* Deduplication (-d): names already produced. */
+    bool CheckExistingFiles;            /* Deduplication (-D): files already on disk count too. */
+    long DuplicateHits;                 /* Positions skipped by deduplication. */
+    long DuplicateMisses;               /* Positions converted despite deduplication. */
+    bool PositionAsFileName;
+    int DiagramNumber;                  /* Number given to the next numbered diagram. */
+    bool PGNInput;                      /* --pgn: every file is PGN, whatever its extension. */
+    PositionSelection Selection;        /* Positions drawn from each game of a PGN file. */
+    int ExtractionThreads;              /* Threads parsing chunks of a PGN file at a time. */
+    PipelineStats* Stats;               /* --stats: timings and counters, else NULL. */
+    RunCheckpoint* Checkpoint;          /* --checkpoint: progress saved, else NULL. */
+    size_t RangeStart;                  /* --range: only lines starting in [RangeStart, */
+    size_t RangeEnd;                    /*   RangeEnd) of the FEN file are read. */
+    int ShardIndex;                     /* --shard: only positions of shard ShardIndex (0 to */
+    int ShardCount;                     /*   ShardCount-1) are converted (1: every one). */
+    OutputVariant Variants[MAX_OUTPUT_VARIANTS];    /* --variants: diagrams of every */
+    int VariantCount;                   /*   position, parsed once (0: a single diagram). */
+} DiagramWriter;
+
+
+/* Methods */
+char* generateFENFileName(const ChessBoard* brdPosition, char* sReturnValue);
+char* generateNumberedFileName(int nDiagramNumber, char* sReturnValue);
+char* generateFileName(DiagramWriter* wrtDiagram, const ChessBoard* brdPosition,
+    int nDiagramNumber, char* sReturnValue);
+char* addFileNameSuffix(char* sFileName, const char* sSuffix);
+int parseOutputVariants(const char* sList, OutputVariant* aVariants);
+bool setUpDiagramWriter(DiagramWriter* wrtDiagram, char* sTemplateFile, bool bBorder,
+    bool bCoordinates, bool bMoveIndicator, bool bPositionAsFileName, bool bRotateBoard,
+    bool bCompact, const char* sSpriteFile, int nSquareSize);
+void tearDownDiagramWriter(DiagramWriter* wrtDiagram);
+void copyFENExcerpt(const char* pFEN, size_t nFENLength, char* sFENExcerpt);
+bool readPosition(const char* pFEN, size_t nFENLength, ChessBoard* brdPosition);
+bool renderDiagram(const RenderContext* ctxRender, const ChessBoard* brdPosition,
+    ByteBuffer* bufDiagram);
+bool renderBitmap(DiagramWriter* wrtDiagram, const RenderContext* ctxRender, int nOptions,
+    const ChessBoard* brdPosition, ByteBuffer* bufCanvas, ByteBuffer* bufPNG);
+bool writeDiagram(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength,
+    int nOptions, int nDiagramNumber, ByteBuffer* bufDiagram, ByteBuffer* bufCompressed);
+DiagramSheet* createDiagramSheet(DiagramWriter* wrtDiagram, int nColumns, int nRows);
+bool addToSheet(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength);
+bool writeSheet(DiagramWriter* wrtDiagram);
+void freeDiagramSheet(DiagramSheet** shtDiagram);
+DiagramQueue* createDiagramQueue(void);
+void pushDiagramJob(DiagramQueue* queDiagram, const char* pFEN, size_t nFENLength, int nOptions,
+    int nDiagramNumber);
+void pushSkippedJob(DiagramQueue* queDiagram, int nDiagramNumber);
+bool popDiagramJob(DiagramQueue* queDiagram, DiagramJob* jobReceived);
+void finishDiagramJob(DiagramQueue* queDiagram);
+void waitForDiagramQueue(DiagramQueue* queDiagram);
+void closeDiagramQueue(DiagramQueue* queDiagram);
+void freeDiagramQueue(DiagramQueue** queDiagram);
+void* runDiagramWorker(void* pDiagramWriter);
+bool isInShard(const DiagramWriter* wrtDiagram, int nDiagramNumber, const char* sFileName);
+void submitPosition(DiagramWriter* wrtDiagram, const char* pFEN, size_t nFENLength,
+    int nOptions);
+bool readFENLine(FILE* fInputFile, char* sFENExcerpt, int nDefaultOptions, int* nOptions);
+size_t findLineStart(const char* pData, size_t nLength, size_t nOffset);
+long countFENLines(const char* pData, size_t nLength);
+void readFENBlock(const char* pData, size_t nLength, DiagramWriter* wrtDiagram);
+void* runPGNExtraction(void* pPGNChunk);
+void readPGNBlock(const char* pData, size_t nLength, size_t nOffset, DiagramWriter* wrtDiagram);
+void readPGNStream(FILE* fInputFile, DiagramWriter* wrtDiagram);
+bool isPGNFile(const char* sFileName, const DiagramWriter* wrtDiagram);
+bool readFENFile(char* sFileName, DiagramWriter* wrtDiagram);
+bool saveCheckpoint(DiagramWriter* wrtDiagram, size_t nOffset);
+bool loadCheckpoint(RunCheckpoint* ckpRun, int* nDiagramNumber);
@@ -0,0 +1,216 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Fuzz targets of FEN2SVG: arbitrary bytes fed to what reads untrusted input.
+ * <p>
+ * By default, the input is a FEN file: its lines are counted and read (see countFENLines(),
+ * readFENLine()), then the whole input is parsed as one position (see parseFEN()), with its
+ * options column (see getLineOptions()), and drawn if valid, as a diagram and as a game
+ * sequence. Built with FUZZ_TEMPLATE, the input is a template: it is read (see
+ * readTemplateStream()), a context is built from it (see initRenderContextFromTemplate())
+ * and, if valid, a diagram is drawn with it.
+ * <p>
+ * Built with FUZZ_WITH_LIBFUZZER, this is a libFuzzer target (clang, "make fuzz"):
+ * ./fen2svg_libfuzzer_fen corpus/fen
+ * Otherwise it is a program replaying the files given as arguments, one input per file
+ * (e.g. "make perftest" replays the corpus under AddressSanitizer; with AFL, build it with
+ * afl-gcc and run "afl-fuzz -i corpus/fen -o findings ./fen2svg_fuzz_fen @@").
+ * It compiles fen2svg.c with FEN2SVG_NO_MAIN:
+ * gcc -g -O1 -fsanitize=address,undefined -pthread -DFEN2SVG_NO_MAIN fuzz.c fen2svg.c libfen2svg.c embeddedtemplate.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c diagramcompressor.c svgraster.c diagramraster.c stringset.c pgnreader.c pipelinestats.c asyncwriter.c -lz -lm -o fen2svg_fuzz_fen
+ **/
+
+
+#define _GNU_SOURCE                         /* fmemopen() */
+#include <stdint.h>                         /* uint8_t */
+#include "fen2svg.h"                        /* Own work */
+
+
+#define FUZZ_POSITION "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4"
+#define FUZZ_SQUARE_SIZE 24                 /* Sized templates (see --size). */
+
+
+int LLVMFuzzerTestOneInput(const uint8_t* pData, size_t nLength);
+
+
+#ifndef FUZZ_TEMPLATE
+/**
+ * Draw a valid position with the options of its line (none if they are invalid), as a
+ * diagram and as the next frame of a game. Contexts, empty boards and buffers are shared
+ * by every input.
+ **/
+static void drawPosition(const ChessBoard* brdPosition, int nOptions) {
+
+    static RenderCache* cchFuzz = NULL;
+    static ByteBuffer* bufDiagram = NULL;
+    static GameFrame* frmGame = NULL;
+    if (!cchFuzz) {
+        cchFuzz = createRenderCache(NULL, NULL, NULL);
+        bufDiagram = createEmptyBuffer();
+        frmGame = createGameFrame();
+    }
+
+    const RenderContext* ctxRender = getRenderContext(cchFuzz, nOptions < 0 ? 0 : nOptions);
+    if (ctxRender) {
+        clearBuffer(bufDiagram);
+        reserveBuffer(bufDiagram, getMaxDiagramLength(ctxRender));
+        if (renderBoard(ctxRender, brdPosition, (*bufDiagram).Data,
+            (*bufDiagram).Capacity) < 0) {
+            __builtin_trap();               /* Valid positions always fit. */
+        }
+        renderGameFrame(frmGame, ctxRender, brdPosition);
+    }
+}
+
+
+/**
+ * Read the input as a FEN file, then as a single position, each valid one being drawn.
+ **/
+static void fuzzFEN(const char* pData, size_t nLength) {
+
+    /* LINES, AS READ FROM A MAPPED FILE AND FROM A STREAM */
+    countFENLines(pData, nLength);
+    findLineStart(pData, nLength, nLength / 2);
+    if (nLength > 0) {
+        FILE* fInputFile = fmemopen((void*) pData, nLength, "r");
+        if (fInputFile) {
+            char sFENExcerpt[FEN_EXCERPT_LENGTH+1];
+            int nOptions;
+            ChessBoard brdLine;
+            while (readFENLine(fInputFile, sFENExcerpt, 0, &nOptions)) {
+                if (parseFEN(sFENExcerpt, strlen(sFENExcerpt), &brdLine, NULL) == FEN_OK) {
+                    drawPosition(&brdLine, nOptions);
+                }
+            }
+            fclose(fInputFile);
+        }
+    }
+
+    /* WHOLE INPUT, AS ONE POSITION AND ITS OPTIONS */
+    ChessBoard brdPosition;
+    size_t nErrorOffset = 0;
+    if (parseFEN(pData, nLength, &brdPosition, &nErrorOffset) != FEN_OK) {
+        if (nErrorOffset > nLength) {
+            __builtin_trap();               /* Errors must point inside the string. */
+        }
+        return;
+    }
+    char sFEN[FEN_EXCERPT_LENGTH+1];
+    formatFEN(&brdPosition, sFEN);
+    drawPosition(&brdPosition, getLineOptions(pData, nLength, 0));
+}
+#else
+/**
+ * Read the input as a template, build a context from it and draw a diagram with it. The
+ * options and square size of the context depend on the length of the input.
+ **/
+static void fuzzTemplate(const char* pData, size_t nLength) {
+
+    if (nLength == 0) {
+        return;
+    }
+    FILE* fInputFile = fmemopen((void*) pData, nLength, "r");
+    if (!fInputFile) {
+        return;
+    }
+    ListArena* arnTemplate = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    LinkedList* lstTemplate = readTemplateStream(fInputFile, arnTemplate);
+    fclose(fInputFile);
+
+    int nOptions = (int) (nLength % OPTION_COMBINATIONS);
+    int nSquareSize = (nLength / OPTION_COMBINATIONS) % 2 ? FUZZ_SQUARE_SIZE : SQUARE_WIDTH;
+    RenderContext ctxRender;
+    if (initRenderContextFromTemplate(&ctxRender, *lstTemplate, nOptions & BORDER_OPTION,
+        nOptions & COORDINATES_OPTION, nOptions & MOVE_INDICATOR_OPTION,
+        nOptions & ROTATE_BOARD_OPTION, nOptions & COMPACT_OPTION, NULL, nSquareSize)
+        == RENDER_OK) {
+        ChessBoard brdPosition;
+        parseFEN(FUZZ_POSITION, strlen(FUZZ_POSITION), &brdPosition, NULL);
+        ByteBuffer* bufDiagram = createEmptyBuffer();
+        reserveBuffer(bufDiagram, getMaxDiagramLength(&ctxRender));
+        if (renderBoard(&ctxRender, &brdPosition, (*bufDiagram).Data,
+            (*bufDiagram).Capacity) < 0) {
+            __builtin_trap();               /* Valid positions always fit. */
+        }
+        freeBuffer(&bufDiagram);
+        freeRenderContext(&ctxRender);
+    }
+    freeListArena(&arnTemplate);
+}
+#endif
+
+
+/** Entry point of libFuzzer: one input. **/
+int LLVMFuzzerTestOneInput(const uint8_t* pData, size_t nLength) {
+
+#ifndef FUZZ_TEMPLATE
+    fuzzFEN((const char*) pData, nLength);
+#else
+    fuzzTemplate((const char*) pData, nLength);
+#endif
+
+    return 0;
+}
+
+
+#ifndef FUZZ_WITH_LIBFUZZER
+/**
+ * Replay the files given as arguments, one input per file.
+ **/
+int main(int argc, char* argv[]) {
+
+    if (argc < 2) {
+        printf("Usage: %s file(s)\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ByteBuffer* bufInput = createEmptyBuffer();
+    for (int nArgument = 1; nArgument < argc; nArgument++) {
+        /* READ THE WHOLE FILE */
+        FILE* fInputFile = fopen(argv[nArgument], "rb");
+        if (fInputFile == NULL) {
+            printf("Error: cannot open input file (%s).\n", argv[nArgument]);
+            freeBuffer(&bufInput);
+            return EXIT_FAILURE;
+        }
+        clearBuffer(bufInput);
+        char sBuffer[BUFFER_SIZE];
+        size_t nRead;
+        while ((nRead = fread(sBuffer, 1, BUFFER_SIZE, fInputFile)) > 0) {
+            appendToBuffer(bufInput, sBuffer, nRead);
+        }
+        fclose(fInputFile);
+
+        /* FEED IT (a copy of its exact size, so that reading past it is caught) */
+        uint8_t* pInput = (uint8_t*) malloc((*bufInput).Length > 0 ? (*bufInput).Length : 1);
+        if (!pInput) {
+            printf("Unsuccessful malloc() in main(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(pInput, (*bufInput).Data, (*bufInput).Length);
+        LLVMFuzzerTestOneInput(pInput, (*bufInput).Length);
+        free(pInput);
+    }
+    freeBuffer(&bufInput);
+    printf("%d input(s) replayed.\n", argc - 1);
+
+    return EXIT_SUCCESS;
+}
+#endif
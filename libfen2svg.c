@@ -0,0 +1,2171 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Rendering core of FEN2SVG, usable as a library (e.g. by a service answering requests
+ * from memory):
+ *   - initRenderContext() loads the template once and builds the empty boards,
+ *   - renderFEN() turns a FEN string into a diagram in a caller-supplied buffer,
+ *     without file access nor allocation, errors being returned as negative codes (or
+ *     parseFEN() checks it into a board once, which renderBoard() and the others draw),
+ *   - freeRenderContext() frees the context.
+ * A cache (createRenderCache()) builds, when first needed, a context for every combination
+ * of options, reading the template only once, or joining the pieces of the template built
+ * into the program (see embeddedtemplate.h).
+ **/
+
+#include <stdint.h>                         /* SIZE_MAX */
+#ifdef __SSE2__
+#include <emmintrin.h>                      /* _mm_cmpeq_epi8() */
+#endif
+#include "libfen2svg.h"                     /* Own work */
+
+
+/**
+ * Width of the board drawing vary on the presence of coordinates, the width of the border, ...
+ **/
+int computeWholeDrawingWidth(bool bCoordinates, bool bBorder, bool bMoveIndicator) {
+        
+    int nDrawingWidth = 0;
+
+    if (bCoordinates) {
+        nDrawingWidth += VERTICAL_COORDINATES_WIDTH;
+    }
+    if (bBorder) {
+        nDrawingWidth += BORDER_THICKNESS;
+    }
+    nDrawingWidth += 8 * SQUARE_WIDTH;
+    if (bBorder) {
+        nDrawingWidth += BORDER_THICKNESS;
+    }
+    if (bMoveIndicator) {
+        nDrawingWidth += MOVE_INDICATOR_WIDTH;
+    }
+
+    return nDrawingWidth;
+}
+
+
+/**
+ * Height of the board drawing vary on the presence of coordinates, the width of the border, ...
+ **/
+int computeWholeDrawingHeight(bool bCoordinates, bool bBorder) {
+    
+    int nDrawingHeight = 0;
+
+    if (bBorder) {
+        nDrawingHeight += BORDER_THICKNESS;
+    }
+    nDrawingHeight += 8 * SQUARE_HEIGHT;
+    if (bBorder) {
+        nDrawingHeight += BORDER_THICKNESS;
+    }
+    if (bCoordinates) {
+        nDrawingHeight += HORIZONTAL_COORDINATES_HEIGHT;
+    }
+
+    return nDrawingHeight;
+}
+
+
+/**
+ * Lay out a board once and for all: the corner of every square (for both orientations),
+ * the frame, coordinates and move indicator, for given borders and coordinates.
+ *
+ * @param   geoBoard        receives the layout
+ * @param   bBorder         frame around the board requested?
+ * @param   bCoordinates    coordinates for algebric notation around the board
+ * @param   nSquareSize     displayed square size, in pixels (SQUARE_WIDTH: as drawn)
+ * @see     generateEmptyBoard(), createPieceTable()
+ **/
+void computeBoardGeometry(BoardGeometry* geoBoard, bool bBorder, bool bCoordinates,
+    int nSquareSize) {
+
+    int nCoordinatesWidth = bCoordinates ? VERTICAL_COORDINATES_WIDTH : 0;
+    int nBorder = bBorder ? BORDER_THICKNESS : 0;
+
+    (*geoBoard).Border = bBorder;
+    (*geoBoard).Coordinates = bCoordinates;
+    (*geoBoard).SquareSize = nSquareSize;
+    (*geoBoard).Width = computeWholeDrawingWidth(bCoordinates, bBorder, false);
+    (*geoBoard).Height = computeWholeDrawingHeight(bCoordinates, bBorder);
+
+    /* SQUARES (board shifted right by coordinates, inside the frame) */
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        int nColumn = nSquare % 8;
+        int nRow = nSquare / 8;
+        (*geoBoard).Squares[nSquare][WHITE_AT_BOTTOM_INDEX][0] = SQUARE_WIDTH*nColumn
+            + nCoordinatesWidth + nBorder;
+        (*geoBoard).Squares[nSquare][WHITE_AT_BOTTOM_INDEX][1] = SQUARE_HEIGHT*nRow + nBorder;
+        (*geoBoard).Squares[nSquare][BLACK_AT_BOTTOM_INDEX][0] = SQUARE_WIDTH*(7-nColumn)
+            + nCoordinatesWidth + nBorder;
+        (*geoBoard).Squares[nSquare][BLACK_AT_BOTTOM_INDEX][1] = SQUARE_HEIGHT*(7-nRow)
+            + nBorder;
+    }
+
+    /* FRAME */
+    (*geoBoard).Borders[0] = nCoordinatesWidth;
+    (*geoBoard).Borders[1] = 0;
+
+    /* COORDINATES (laid out as if there were a frame) */
+    for (int nLine = 0; nLine < 8; nLine++) {
+        (*geoBoard).RankCoordinates[nLine][0] = 0;
+        (*geoBoard).RankCoordinates[nLine][1] = SQUARE_HEIGHT*nLine + BORDER_THICKNESS;
+        (*geoBoard).FileCoordinates[nLine][0] = SQUARE_WIDTH*nLine + VERTICAL_COORDINATES_WIDTH
+            + BORDER_THICKNESS;
+        (*geoBoard).FileCoordinates[nLine][1] = SQUARE_HEIGHT*8 + 2*BORDER_THICKNESS;
+    }
+
+    /* MOVE INDICATOR (beside the last rank, past the frame) */
+    (*geoBoard).MoveIndicator[0] = SQUARE_WIDTH*8 + nCoordinatesWidth + 2*nBorder;
+    (*geoBoard).MoveIndicator[1] = SQUARE_HEIGHT*7 + nBorder;
+}
+
+
+/* FEN character -> piece index + 1 (see FEN_PIECES), 0 if it is not a piece. */
+static const unsigned char acBoardPieces[256] = {
+    ['B'] = 1, ['b'] = 2, ['K'] = 3, ['k'] = 4, ['N'] = 5, ['n'] = 6,
+    ['P'] = 7, ['p'] = 8, ['Q'] = 9, ['q'] = 10, ['R'] = 11, ['r'] = 12
+};
+
+
+/** Castling right of a character of a FEN string (0 if none). **/
+static const unsigned char acCastlingRights[256] = {
+    ['K'] = WHITE_KINGSIDE_CASTLING, ['Q'] = WHITE_QUEENSIDE_CASTLING,
+    ['k'] = BLACK_KINGSIDE_CASTLING, ['q'] = BLACK_QUEENSIDE_CASTLING
+};
+
+
+/** Blank space between two fields of a FEN string ("\r" too, left by a DOS line). **/
+static bool isFENBlank(char cCharacter) {
+
+    return cCharacter == ' ' || cCharacter == '\r';
+}
+
+
+/** Give up parsing: where it stopped goes to nErrorOffset (if not NULL). **/
+static int rejectFEN(int nStatus, size_t nPos, size_t* nErrorOffset) {
+
+    if (nErrorOffset) {
+        *nErrorOffset = nPos;
+    }
+
+    return nStatus;
+}
+
+
+/**
+ * What a piece placement character does: 0x10 if it has its place there, plus the squares it
+ * fills (8 at most).
+ **/
+static const unsigned char acPlacementSteps[256] = {
+    ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['/'] = 0x10,
+    ['B'] = 0x11, ['b'] = 0x11, ['K'] = 0x11, ['k'] = 0x11, ['N'] = 0x11, ['n'] = 0x11,
+    ['P'] = 0x11, ['p'] = 0x11, ['Q'] = 0x11, ['q'] = 0x11, ['R'] = 0x11, ['r'] = 0x11
+};
+
+
+#if !defined(__SSE2__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/** High bit set in the bytes of nWord equal to cByte (the lowest one is always right). **/
+static inline unsigned long long findEqualBytes(unsigned long long nWord, unsigned char cByte) {
+
+    unsigned long long nDifference = nWord ^ (0x0101010101010101ULL * cByte);
+
+    return (nDifference - 0x0101010101010101ULL) & ~nDifference & 0x8080808080808080ULL;
+}
+#endif
+
+
+/**
+ * Where the fields of a FEN excerpt end. With SSE2, 16 characters are classified at a time
+ * (the last ones from a copy padded with '\0'), else 8 at a time on little-endian machines.
+ *
+ * @param   sFEN            FEN string
+ * @param   nFENLength      at most nFENLength chars are read
+ * @param   nPlacementEnd   receives the end of the piece placement: first blank space, or the
+ *                          end of the string
+ * @return  end of the string: first '\0' or '\t', or nFENLength
+ **/
+static size_t findFENFieldEnds(const char* sFEN, size_t nFENLength, size_t* nPlacementEnd) {
+
+    size_t nPos = 0;
+    size_t nBlank = SIZE_MAX;
+#ifdef __SSE2__
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vTab = _mm_set1_epi8('\t');
+    const __m128i vSpace = _mm_set1_epi8(' ');
+    const __m128i vReturn = _mm_set1_epi8('\r');
+    for (; nPos < nFENLength; nPos += 16) {
+        __m128i vChars;
+        if (nFENLength - nPos >= 16) {
+            vChars = _mm_loadu_si128((const __m128i*) (sFEN + nPos));
+        }
+        else {
+            char acTail[16] = { 0 };
+            memcpy(acTail, sFEN + nPos, nFENLength - nPos);
+            vChars = _mm_loadu_si128((const __m128i*) acTail);
+        }
+        int nEndMask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(vChars, vZero),
+            _mm_cmpeq_epi8(vChars, vTab)));
+        if (nBlank == SIZE_MAX) {
+            int nBlankMask = nEndMask | _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(vChars, vSpace), _mm_cmpeq_epi8(vChars, vReturn)));
+            if (nBlankMask) {
+                nBlank = nPos + (size_t) __builtin_ctz((unsigned int) nBlankMask);
+            }
+        }
+        if (nEndMask) {
+            *nPlacementEnd = nBlank;
+            return nPos + (size_t) __builtin_ctz((unsigned int) nEndMask);
+        }
+    }
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; nPos + 8 <= nFENLength; nPos += 8) {
+        unsigned long long nWord;
+        memcpy(&nWord, sFEN + nPos, 8);
+        unsigned long long nEndBits = findEqualBytes(nWord, '\0') | findEqualBytes(nWord, '\t');
+        if (nBlank == SIZE_MAX) {
+            unsigned long long nBlankBits = nEndBits | findEqualBytes(nWord, ' ')
+                | findEqualBytes(nWord, '\r');
+            if (nBlankBits) {
+                nBlank = nPos + (size_t) __builtin_ctzll(nBlankBits) / 8;
+            }
+        }
+        if (nEndBits) {
+            *nPlacementEnd = nBlank;
+            return nPos + (size_t) __builtin_ctzll(nEndBits) / 8;
+        }
+    }
+#endif
+    for (; nPos < nFENLength && sFEN[nPos] != '\0' && sFEN[nPos] != '\t'; nPos++) {
+        if (nBlank == SIZE_MAX && isFENBlank(sFEN[nPos])) {
+            nBlank = nPos;
+        }
+    }
+    *nPlacementEnd = (nBlank < nPos) ? nBlank : nPos;
+
+    return nPos;
+}
+
+
+#ifdef __SSE2__
+/** Sums of the bytes of vBytes up to each of them. **/
+static inline __m128i sumBytesSoFar(__m128i vBytes) {
+
+    vBytes = _mm_add_epi8(vBytes, _mm_slli_si128(vBytes, 1));
+    vBytes = _mm_add_epi8(vBytes, _mm_slli_si128(vBytes, 2));
+    vBytes = _mm_add_epi8(vBytes, _mm_slli_si128(vBytes, 4));
+
+    return _mm_add_epi8(vBytes, _mm_slli_si128(vBytes, 8));
+}
+#endif
+
+
+/**
+ * Fill the squares from a piece placement in one pass without a branch per character (the
+ * rank lengths being checked at the slashes and at the end): a byte per square, packed at
+ * the end, so that no square waits for the one before. With SSE2, the squares of 16
+ * characters at a time are sums of the squares they fill, the last ones being left to the
+ * loop of the other machines.
+ *
+ * @return  true if it is right, else the placement is to be checked again by
+ *          parsePiecePlacement()
+ **/
+static bool fillPiecePlacement(const char* sFEN, size_t nPlacementEnd, ChessBoard* brdOutput) {
+
+    unsigned char acSquares[64] = { 0 };
+    unsigned int nErrors = 0;
+    unsigned int nSquare = 0;
+    unsigned int nRankEnd = 8;          /* First square of the next rank. */
+    size_t nPos = 0;
+#ifdef __SSE2__
+    /* Squares stay below 256 within a block: 64 before, 16 * 8 at most in it. */
+    for (; nPos + 16 <= nPlacementEnd && nSquare <= 64; nPos += 16) {
+        __m128i vChars = _mm_loadu_si128((const __m128i*) (sFEN + nPos));
+        __m128i vDigit = _mm_sub_epi8(vChars, _mm_set1_epi8('1'));
+        __m128i vIsDigit = _mm_cmpeq_epi8(_mm_min_epu8(vDigit, _mm_set1_epi8(7)), vDigit);
+        __m128i vLower = _mm_or_si128(vChars, _mm_set1_epi8(0x20));
+        __m128i vIsPiece = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(vLower, _mm_set1_epi8('b')),
+                _mm_cmpeq_epi8(vLower, _mm_set1_epi8('k'))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vLower, _mm_set1_epi8('n')),
+                _mm_cmpeq_epi8(vLower, _mm_set1_epi8('p'))),
+            _mm_or_si128(_mm_cmpeq_epi8(vLower, _mm_set1_epi8('q')),
+                _mm_cmpeq_epi8(vLower, _mm_set1_epi8('r')))));
+        __m128i vIsSlash = _mm_cmpeq_epi8(vChars, _mm_set1_epi8('/'));
+        nErrors |= 0xFFFF & ~(unsigned int) _mm_movemask_epi8(
+            _mm_or_si128(_mm_or_si128(vIsDigit, vIsPiece), vIsSlash));
+
+        /* SQUARE OF EVERY CHARACTER, AND WHERE ITS RANK ENDS. */
+        __m128i vSteps = _mm_or_si128(
+            _mm_and_si128(vIsDigit, _mm_add_epi8(vDigit, _mm_set1_epi8(1))),
+            _mm_and_si128(vIsPiece, _mm_set1_epi8(1)));
+        __m128i vStepsSoFar = sumBytesSoFar(vSteps);
+        __m128i vSquares = _mm_add_epi8(_mm_set1_epi8((char) nSquare),
+            _mm_sub_epi8(vStepsSoFar, vSteps));
+        __m128i vRankEndsSoFar = sumBytesSoFar(_mm_and_si128(vIsSlash, _mm_set1_epi8(8)));
+        __m128i vRankEnds = _mm_add_epi8(_mm_set1_epi8((char) (nRankEnd - 8)), vRankEndsSoFar);
+        nErrors |= (unsigned int) _mm_movemask_epi8(
+            _mm_andnot_si128(_mm_cmpeq_epi8(vSquares, vRankEnds), vIsSlash));
+
+        /* PIECES TO THEIR SQUARES. */
+        unsigned char acBlockSquares[16];
+        _mm_storeu_si128((__m128i*) acBlockSquares, vSquares);
+        for (int i = 0; i < 16; i++) {
+            acSquares[acBlockSquares[i] % 64] = acBoardPieces[(unsigned char) sFEN[nPos + i]];
+        }
+        nSquare += (unsigned int) _mm_extract_epi16(vStepsSoFar, 7) >> 8;
+        nRankEnd += (unsigned int) _mm_extract_epi16(vRankEndsSoFar, 7) >> 8;
+    }
+#endif
+    for (; nPos < nPlacementEnd; nPos++) {
+        unsigned char cCurrentChar = (unsigned char) sFEN[nPos];
+        unsigned int nStep = acPlacementSteps[cCurrentChar];
+        unsigned int bSlash = (cCurrentChar == '/');
+        nErrors |= (~nStep & 0x10) | (bSlash & (nSquare != nRankEnd));
+        nRankEnd += 8 * bSlash;
+        acSquares[nSquare % 64] = acBoardPieces[cCurrentChar];
+        nSquare += nStep & 0x0F;
+    }
+    if (nErrors || nSquare != 64 || nRankEnd != 64) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        (*brdOutput).Squares[i] = (unsigned char) (acSquares[2*i] | (acSquares[2*i+1] << 4));
+    }
+
+    return true;
+}
+
+
+/**
+ * Check a piece placement character after character (8 ranks of 8 squares, from a8 to h1)
+ * and fill the squares.
+ *
+ * @return  FEN_OK, or what is wrong and where (in nErrorOffset, if not NULL)
+ **/
+static int parsePiecePlacement(const char* sFEN, size_t nPlacementEnd, ChessBoard* brdOutput,
+    size_t* nErrorOffset) {
+
+    size_t nPos = 0;
+    int nSquare = 0;
+    int nRankEnd = 8;           /* First square of the next rank. */
+    while (nPos < nPlacementEnd) {
+        unsigned char cCurrentChar = (unsigned char) sFEN[nPos];
+        if (cCurrentChar > '0' && cCurrentChar < '9') {
+            nSquare += (int) (cCurrentChar-'0');
+            if (nSquare > nRankEnd) {
+                return rejectFEN(FEN_RANK_TOO_LONG, nPos, nErrorOffset);
+            }
+        }
+        else if (acBoardPieces[cCurrentChar]) {
+            if (nSquare == nRankEnd) {
+                return rejectFEN(FEN_RANK_TOO_LONG, nPos, nErrorOffset);
+            }
+            (*brdOutput).Squares[nSquare / 2] |= (unsigned char)
+                (acBoardPieces[cCurrentChar] << (4 * (nSquare % 2)));
+            nSquare++;
+        }
+        else if (cCurrentChar == '/') {
+            if (nSquare < nRankEnd) {
+                return rejectFEN(FEN_RANK_TOO_SHORT, nPos, nErrorOffset);
+            }
+            if (nRankEnd == 64) {
+                return rejectFEN(FEN_WRONG_RANK_COUNT, nPos, nErrorOffset);
+            }
+            nRankEnd += 8;
+        }
+        else {
+            return rejectFEN(FEN_UNEXPECTED_CHARACTER, nPos, nErrorOffset);
+        }
+        nPos++;
+    }
+    if (nSquare < nRankEnd) {
+        return rejectFEN(FEN_RANK_TOO_SHORT, nPos, nErrorOffset);
+    }
+    if (nRankEnd < 64) {
+        return rejectFEN(FEN_WRONG_RANK_COUNT, nPos, nErrorOffset);
+    }
+
+    return FEN_OK;
+}
+
+
+/**
+ * Parse a FEN string into a board, checking it on the way, over its first four fields: piece
+ * placement, side to move, castling and en passant square (where the fields end being found
+ * first, many characters at a time).
+ * The last three may be missing: White is then to move, neither side can castle and there
+ * is no en passant square. Move counters are not read (nor checked): they may have been cut
+ * off (see FEN_EXCERPT_LENGTH).
+ *
+ * @param   sFEN            FEN string representing the chess position (need not be '\0'
+ *                          terminated: it ends at '\0', at a tab or after nFENLength chars)
+ * @param   nFENLength      length of sFEN
+ * @param   brdOutput       receives the position
+ * @param   nErrorOffset    if not NULL, receives the offset of the faulty char, if any
+ * @return  FEN_OK, or what is wrong with the string (e.g. FEN_UNEXPECTED_CHARACTER)
+ * @see     describeFENStatus()
+ **/
+int parseFEN(const char* sFEN, size_t nFENLength, ChessBoard* brdOutput, size_t* nErrorOffset) {
+
+    memset((*brdOutput).Squares, 0, sizeof((*brdOutput).Squares));
+    (*brdOutput).WhiteToPlay = true;
+    (*brdOutput).Castling = 0;
+    (*brdOutput).EnPassant = NO_EN_PASSANT;
+
+    /* THE STRING ENDS AT '\0' OR AT THE NEXT COLUMN, THE PIECE PLACEMENT AT A BLANK SPACE. */
+    size_t nPlacementEnd;
+    size_t nEnd = findFENFieldEnds(sFEN, nFENLength, &nPlacementEnd);
+
+    /* PIECE PLACEMENT: in one pass, or again step by step to tell what is wrong. */
+    if (!fillPiecePlacement(sFEN, nPlacementEnd, brdOutput)) {
+        int nStatus = parsePiecePlacement(sFEN, nPlacementEnd, brdOutput, nErrorOffset);
+        if (nStatus != FEN_OK) {
+            return nStatus;
+        }
+    }
+    size_t nPos = nPlacementEnd;
+
+    /* SIDE TO MOVE ("w" or "b") */
+    while (nPos < nEnd && isFENBlank(sFEN[nPos])) {
+        nPos++;
+    }
+    if (nPos == nEnd) {
+        return FEN_OK;
+    }
+    if ((sFEN[nPos] != 'w' && sFEN[nPos] != 'b')
+        || (nPos+1 < nEnd && !isFENBlank(sFEN[nPos+1]))) {
+        return rejectFEN(FEN_INVALID_SIDE_TO_MOVE, nPos, nErrorOffset);
+    }
+    (*brdOutput).WhiteToPlay = (sFEN[nPos++] == 'w');
+
+    /* CASTLING ("-" or some of "KQkq") */
+    while (nPos < nEnd && isFENBlank(sFEN[nPos])) {
+        nPos++;
+    }
+    if (nPos == nEnd) {
+        return FEN_OK;
+    }
+    if (sFEN[nPos] == '-') {
+        nPos++;
+    }
+    else {
+        while (nPos < nEnd && !isFENBlank(sFEN[nPos])) {
+            unsigned char nRight = acCastlingRights[(unsigned char) sFEN[nPos]];
+            if (!nRight || ((*brdOutput).Castling & nRight)) {
+                return rejectFEN(FEN_INVALID_CASTLING, nPos, nErrorOffset);
+            }
+            (*brdOutput).Castling |= nRight;
+            nPos++;
+        }
+    }
+    if (nPos < nEnd && !isFENBlank(sFEN[nPos])) {
+        return rejectFEN(FEN_INVALID_CASTLING, nPos, nErrorOffset);
+    }
+
+    /* EN PASSANT ("-", or the square a pawn just skipped: rank 6 if White is to move) */
+    while (nPos < nEnd && isFENBlank(sFEN[nPos])) {
+        nPos++;
+    }
+    if (nPos == nEnd) {
+        return FEN_OK;
+    }
+    if (sFEN[nPos] == '-') {
+        nPos++;
+    }
+    else {
+        char cRank = (*brdOutput).WhiteToPlay ? '6' : '3';
+        if (nPos+1 >= nEnd || sFEN[nPos] < 'a' || sFEN[nPos] > 'h' || sFEN[nPos+1] != cRank) {
+            return rejectFEN(FEN_INVALID_EN_PASSANT, nPos, nErrorOffset);
+        }
+        (*brdOutput).EnPassant = (signed char) (('8' - cRank) * 8 + (sFEN[nPos] - 'a'));
+        nPos += 2;
+    }
+    if (nPos < nEnd && !isFENBlank(sFEN[nPos])) {
+        return rejectFEN(FEN_INVALID_EN_PASSANT, nPos, nErrorOffset);
+    }
+
+    return FEN_OK;
+}
+
+
+/** What is wrong with a FEN string, as told by parseFEN() (e.g. for error messages). **/
+const char* describeFENStatus(int nStatus) {
+
+    switch (nStatus) {
+        case FEN_OK:
+            return "valid position";
+        case FEN_UNEXPECTED_CHARACTER:
+            return "unexpected character in piece placement";
+        case FEN_RANK_TOO_LONG:
+            return "more than 8 squares in a rank";
+        case FEN_RANK_TOO_SHORT:
+            return "fewer than 8 squares in a rank";
+        case FEN_WRONG_RANK_COUNT:
+            return "not 8 ranks in piece placement";
+        case FEN_INVALID_SIDE_TO_MOVE:
+            return "side to move neither 'w' nor 'b'";
+        case FEN_INVALID_CASTLING:
+            return "invalid castling availability";
+        case FEN_INVALID_EN_PASSANT:
+            return "invalid en passant square";
+        default:
+            return "invalid FEN string";
+    }
+}
+
+
+/** Piece on a square of the board (index in FEN_PIECES), NO_PIECE if it is empty. **/
+int getBoardPiece(const ChessBoard* brdPosition, int nSquare) {
+
+    return (((*brdPosition).Squares[nSquare / 2] >> (4 * (nSquare % 2))) & 0x0F) - 1;
+}
+
+
+/** Put a piece (index in FEN_PIECES) on a square of the board, or empty it (NO_PIECE). **/
+void setBoardPiece(ChessBoard* brdPosition, int nSquare, int nPiece) {
+
+    int nShift = 4 * (nSquare % 2);
+    (*brdPosition).Squares[nSquare / 2] = (unsigned char) (((*brdPosition).Squares[nSquare / 2]
+        & ~(0x0F << nShift)) | ((nPiece + 1) << nShift));
+}
+
+
+/**
+ * Write a board as a FEN string, i.e. the four fields parseFEN() reads (without move
+ * counters), e.g. "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3".
+ *
+ * @param   brdPosition     chess position
+ * @param   sOutput         receives the string, '\0' terminated (FEN_EXCERPT_LENGTH+1 chars
+ *                          are enough)
+ * @return  length of the string
+ **/
+int formatFEN(const ChessBoard* brdPosition, char* sOutput) {
+
+    /* PIECE PLACEMENT, RUNS OF EMPTY SQUARES AS DIGITS */
+    int nLength = 0;
+    int nEmptySquares = 0;
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        int nPiece = getBoardPiece(brdPosition, nSquare);
+        if (nPiece == NO_PIECE) {
+            nEmptySquares++;
+        }
+        else {
+            if (nEmptySquares > 0) {
+                sOutput[nLength++] = (char) ('0' + nEmptySquares);
+                nEmptySquares = 0;
+            }
+            sOutput[nLength++] = FEN_PIECES[nPiece];
+        }
+        if (nSquare % 8 == 7) {
+            if (nEmptySquares > 0) {
+                sOutput[nLength++] = (char) ('0' + nEmptySquares);
+                nEmptySquares = 0;
+            }
+            sOutput[nLength++] = (nSquare < 63) ? '/' : ' ';
+        }
+    }
+
+    /* SIDE TO MOVE, CASTLING AND EN PASSANT */
+    sOutput[nLength++] = (*brdPosition).WhiteToPlay ? 'w' : 'b';
+    sOutput[nLength++] = ' ';
+    if ((*brdPosition).Castling == 0) {
+        sOutput[nLength++] = '-';
+    }
+    for (int nRight = 0; nRight < 4; nRight++) {
+        if ((*brdPosition).Castling & (1 << nRight)) {
+            sOutput[nLength++] = "KQkq"[nRight];
+        }
+    }
+    sOutput[nLength++] = ' ';
+    if ((*brdPosition).EnPassant == NO_EN_PASSANT) {
+        sOutput[nLength++] = '-';
+    }
+    else {
+        sOutput[nLength++] = (char) ('a' + (*brdPosition).EnPassant % 8);
+        sOutput[nLength++] = (char) ('8' - (*brdPosition).EnPassant / 8);
+    }
+    sOutput[nLength] = '\0';
+
+    return nLength;
+}
+
+
+/** "00" to "99": two digits of a number at a time. **/
+static const char acDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+/**
+ * Write a number in decimal (without '\0'), e.g. a coordinate or a diagram number, without
+ * a branch on its digits: all ten of them are computed, two at a time, and ten chars copied
+ * from the first significant one.
+ *
+ * @param   nValue          number to write
+ * @param   nMinDigits      leading zeros up to this number of digits (10 at most)
+ * @param   pOutput         receives the digits: 10 chars are written, those after the digits
+ *                          being left to the caller
+ * @return  number of digits
+ **/
+int formatDecimal(unsigned int nValue, int nMinDigits, char* pOutput) {
+
+    char acDigits[20] = { 0 };
+    unsigned int nRest = nValue;
+    for (int i = 8; i >= 0; i -= 2) {
+        memcpy(acDigits + i, acDigitPairs + 2 * (nRest % 100), 2);
+        nRest /= 100;
+    }
+    int nDigits = 1 + (nValue >= 10) + (nValue >= 100) + (nValue >= 1000) + (nValue >= 10000)
+        + (nValue >= 100000) + (nValue >= 1000000) + (nValue >= 10000000)
+        + (nValue >= 100000000) + (nValue >= 1000000000);
+    nDigits = (nDigits > nMinDigits) ? nDigits : nMinDigits;
+    memcpy(pOutput, acDigits + 10 - nDigits, 10);
+
+    return nDigits;
+}
+
+
+/* Definitions of the template and their short names (compact mode). */
+static const char* asSVGIds[][2] = {
+    { "darksquare", "d" }, { "lightsquare", "l" }, { "borders", "o" }, { "moveindicator", "i" },
+    { "whitepawn", "P" }, { "blackpawn", "p" }, { "whiteknight", "N" }, { "blackknight", "n" },
+    { "whitebishop", "B" }, { "blackbishop", "b" }, { "whiterook", "R" }, { "blackrook", "r" },
+    { "whitequeen", "Q" }, { "blackqueen", "q" }, { "whiteking", "K" }, { "blackking", "k" },
+    { "coordinate1", "c1" }, { "coordinate2", "c2" }, { "coordinate3", "c3" },
+    { "coordinate4", "c4" }, { "coordinate5", "c5" }, { "coordinate6", "c6" },
+    { "coordinate7", "c7" }, { "coordinate8", "c8" }, { "coordinatea", "ca" },
+    { "coordinateb", "cb" }, { "coordinatec", "cc" }, { "coordinated", "cd" },
+    { "coordinatee", "ce" }, { "coordinatef", "cf" }, { "coordinateg", "cg" },
+    { "coordinateh", "ch" }
+};
+
+
+/* Short name of a definition (nLength chars, not necessarily '\0' terminated), or NULL. */
+static const char* findShortSVGId(const char* pId, size_t nLength) {
+
+    for (size_t nId = 0; nId < sizeof(asSVGIds) / sizeof(asSVGIds[0]); nId++) {
+        if (strlen(asSVGIds[nId][0]) == nLength && memcmp(asSVGIds[nId][0], pId, nLength) == 0) {
+            return asSVGIds[nId][1];
+        }
+    }
+
+    return NULL;
+}
+
+
+/** Name of a definition of the template, shortened in compact mode. **/
+const char* getSVGId(const char* sId, bool bCompact) {
+
+    const char* sShortId = bCompact ? findShortSVGId(sId, strlen(sId)) : NULL;
+
+    return sShortId ? sShortId : sId;
+}
+
+
+/**
+ * Write the use of a definition at (nX, nY), e.g. a piece on its square:
+ * "    <use xlink:href = "#whitepawn" x = "72" y = "144" />\n", or in compact mode
+ * "<use xlink:href="#P" x="72" y="144"/>".
+ *
+ * @param   sSpriteFile     file holding the definitions, NULL if they are in the diagram
+ * @param   sId             definition, as named in the template
+ * @return  length of the line
+ **/
+int formatUseLine(char* sBuffer, size_t nSize, const char* sSpriteFile, const char* sId, int nX,
+    int nY, bool bCompact) {
+
+    int nLength = snprintf(sBuffer, nSize, bCompact ?
+        "<use xlink:href=\"%s#%s\" x=\"%d\" y=\"%d\"/>" :
+        "    <use xlink:href = \"%s#%s\" x = \"%d\" y = \"%d\" />\n",
+        sSpriteFile ? sSpriteFile : "", getSVGId(sId, bCompact), nX, nY);
+    if (nLength <= 0 || (size_t) nLength >= nSize) {
+        printf("Unsuccessful snprintf() in formatUseLine(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return nLength;
+}
+
+
+ /** 
+ * Prepare, once and for all, every SVG line a piece can be drawn with: for each piece, each
+ * square and each orientation of the board, plus both move indicators.
+ * <p>
+ * Those lines only depend on borders and coordinates (read from the layout of the board),
+ * so that converting a position is then only a matter of copying ready-made lines.
+ *
+ * @param   geoBoard        layout of the board (see computeBoardGeometry())
+ * @param   bCompact        minified lines
+ * @param   sSpriteFile     file holding the definitions, NULL if they are in the diagram
+ * @return  tblReturnValue  lines indexed by [piece][square][orientation]
+ * @see     createPieces()
+ **/
+PieceTable* createPieceTable(const BoardGeometry* geoBoard, bool bCompact,
+    const char* sSpriteFile) {
+
+    /* INITIALIZE (pieces in the order of FEN_PIECES). */
+    const char* asSVGPiece[] = { "whitebishop", "blackbishop", "whiteking", "blackking",
+                                 "whiteknight", "blackknight", "whitepawn", "blackpawn",
+                                 "whitequeen", "blackqueen", "whiterook", "blackrook" };
+    int nLength = 0;
+
+    PieceTable* tblReturnValue = (PieceTable*) malloc(1 * sizeof(PieceTable));
+    if (!tblReturnValue) {
+        printf("Unsuccessful malloc() in createPieceTable(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* PIECES (each orientation: white, then black at bottom) */
+    for (int nPiece = 0; nPiece < PIECE_KINDS; nPiece++) {
+        for (int nSquare = 0; nSquare < 64; nSquare++) {
+            for (int nOrientation = 0; nOrientation < 2; nOrientation++) {
+                SVGLine* lnCurrent = &(*tblReturnValue).Pieces[nPiece][nSquare][nOrientation];
+                const int* anCorner = (*geoBoard).Squares[nSquare][nOrientation];
+                nLength = formatUseLine((*lnCurrent).Text, SVG_LINE_MAX_LENGTH, sSpriteFile,
+                    asSVGPiece[nPiece], anCorner[0], anCorner[1], bCompact);
+                (*lnCurrent).Length = (unsigned char) nLength;
+            }
+        }
+    }
+
+    /* MOVE INDICATORS */
+    for (int nSide = 0; nSide < 2; nSide++) {
+        SVGLine* lnCurrent = &(*tblReturnValue).MoveIndicators[nSide];
+        nLength = snprintf((*lnCurrent).Text, SVG_LINE_MAX_LENGTH, bCompact ?
+            "<use xlink:href=\"%s#%s\" fill=\"%s\" x=\"%d\" y=\"%d\"/>" :
+            "    <use xlink:href = \"%s#%s\" fill = \"%s\" x = \"%d\" y = \"%d\" />\n",
+            sSpriteFile ? sSpriteFile : "", getSVGId("moveindicator", bCompact),
+            nSide == WHITE_TO_PLAY_INDEX ? "white" : "black",
+            (*geoBoard).MoveIndicator[0], (*geoBoard).MoveIndicator[1]);
+        if (nLength <= 0 || nLength >= SVG_LINE_MAX_LENGTH) {
+            printf("Unsuccessful snprintf() in createPieceTable(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        (*lnCurrent).Length = (unsigned char) nLength;
+    }
+
+    return tblReturnValue;
+}
+
+
+/**
+ * Copy a ready-made SVG line at nLength bytes into pOutput, then move nLength forward.
+ * When there is room for it, the whole fixed-size slot is copied (a constant-size copy is
+ * cheaper than a variable one), but only the actual line is kept.
+ *
+ * @return  false if pOutput cannot hold the line
+ **/
+static inline bool appendSVGLine(char* pOutput, size_t* nLength, size_t nCapacity,
+    const SVGLine* lnLine) {
+
+    if (nCapacity - *nLength >= SVG_LINE_MAX_LENGTH) {
+        memcpy(pOutput + *nLength, (*lnLine).Text, SVG_LINE_MAX_LENGTH);
+    }
+    else if (nCapacity - *nLength >= (*lnLine).Length) {
+        memcpy(pOutput + *nLength, (*lnLine).Text, (*lnLine).Length);
+    }
+    else {
+        return false;
+    }
+    *nLength += (*lnLine).Length;
+
+    return true;
+}
+
+
+/**
+ * Write the pieces of a chessboard to a block of memory.
+ * Each piece of the board is converted to a SVG line (i.e. a drawing of a chess piece), taken
+ * from the table of ready-made lines.
+ *
+ * @param   tblPieces       ready-made lines, for the current borders and coordinates
+ * @param   brdPosition     chess position (see parseFEN())
+ * @param   bMoveIndicator  little picture next to the board telling who is to move
+ * @param   bRotateBoard    board orientation
+ * @param   pOutput         SVG lines are written to it (a piece is drawn with one line)
+ * @param   nCapacity       bytes available in pOutput
+ * @return  number of bytes written, or RENDER_BUFFER_TOO_SMALL
+ * @see     createPieceTable()
+ **/
+long placePieces(const PieceTable* tblPieces, const ChessBoard* brdPosition,
+    bool bMoveIndicator, bool bRotateBoard, char* pOutput, size_t nCapacity) {
+
+    /* DETERMINE WHICH SIDE IS TO MOVE, THUS ORIENTATION */
+    bool bWhiteToPlay = (*brdPosition).WhiteToPlay;
+    int nOrientation = (bWhiteToPlay || !bRotateBoard) ? WHITE_AT_BOTTOM_INDEX :
+        BLACK_AT_BOTTOM_INDEX;
+
+    /* BROWSE BOARD (two squares a byte: empty pairs are skipped at once). */
+    size_t nLength = 0;       /* Bytes written so far. */
+    for (int nPair = 0; nPair < 32; nPair++) {
+        for (unsigned int cPair = (*brdPosition).Squares[nPair], nSquare = 2 * nPair; cPair;
+            cPair >>= 4, nSquare++) {
+            if ((cPair & 0x0F) && !appendSVGLine(pOutput, &nLength, nCapacity,
+                &(*tblPieces).Pieces[(cPair & 0x0F) - 1][nSquare][nOrientation])) {
+                return RENDER_BUFFER_TOO_SMALL;
+            }
+        }
+    }
+
+    /* SET UP MOVE INDICATOR */
+    if (bMoveIndicator) {
+        if (!appendSVGLine(pOutput, &nLength, nCapacity, &(*tblPieces).MoveIndicators[
+            bWhiteToPlay ? WHITE_TO_PLAY_INDEX : BLACK_TO_PLAY_INDEX])) {
+            return RENDER_BUFFER_TOO_SMALL;
+        }
+    }
+
+    return (long) nLength;
+}
+
+
+/**
+ * Add to a buffer the pieces of a chessboard (see placePieces()).
+ *
+ * @param   bufPieces       SVG lines are appended to it (a piece is drawn with one line)
+ * @return  true (room is reserved for every piece beforehand)
+ **/
+bool createPieces(const PieceTable* tblPieces, const ChessBoard* brdPosition,
+    bool bMoveIndicator, bool bRotateBoard, ByteBuffer* bufPieces) {
+
+    /* At most 64 pieces and a move indicator: reserve room for them once. */
+    reserveBuffer(bufPieces, (64+1) * SVG_LINE_MAX_LENGTH);
+
+    long nLength = placePieces(tblPieces, brdPosition, bMoveIndicator, bRotateBoard,
+        (*bufPieces).Data + (*bufPieces).Length, (*bufPieces).Capacity - (*bufPieces).Length);
+    if (nLength < 0) {
+        return false;
+    }
+    (*bufPieces).Length += (size_t) nLength;
+
+    return true;
+}
+
+
+/** 
+ * Reads SVG definitions from file and puts every line in a linked list.
+ * <p>
+ * The template is a SVG file that contains only definitions ("<defs/>").
+ * For a definition item to be visible, it has to be used ("<use/>").
+ *
+ * @param   sFileName       name of the SVG
+ * @param   arnArena        the list (and its lines) is allocated from it
+ * @return  lstEmptyBoard   an unsorted linked list of SVG lines, NULL if the file cannot be
+ *                          opened
+ * @see     readTemplateStream(), generateEmptyBoard()
+ **/
+LinkedList* readTemplate(char* sFileName, ListArena* arnArena) {
+
+    /* OPEN FILE */
+    FILE* fInputFile = fopen(sFileName, "rt") ;
+    if (fInputFile == NULL) {
+        return NULL;
+    }
+
+    LinkedList* lstReturnValue = readTemplateStream(fInputFile, arnArena);
+
+    /* CLOSE FILE */
+    fclose(fInputFile);
+
+    return lstReturnValue;
+}
+
+
+/**
+ * Read the lines of a template from an open stream (see readTemplate()): each line, whatever
+ * its length, is one item of the list, without its trailing '\n'.
+ *
+ * @param   fInputFile      stream, read to its end (left open)
+ * @param   arnArena        the list (and its lines) is allocated from it
+ * @return  an unsorted linked list of SVG lines
+ **/
+LinkedList* readTemplateStream(FILE* fInputFile, ListArena* arnArena) {
+
+    LinkedList* lstReturnValue = createArenaList(arnArena);
+    char sBuffer[BUFFER_SIZE];
+    ByteBuffer* bufLongLine = NULL;         /* Pieces of a line longer than the buffer. */
+
+    /* BROWSE FILE LINE BY LINE */
+    while (fgets(sBuffer, BUFFER_SIZE, fInputFile)) {
+        size_t nLength = strlen(sBuffer);
+        bool bLineEnd = nLength > 0 && sBuffer[nLength-1] == '\n';
+        /* Remove trailing '\n'. */
+        if (bLineEnd) {
+            sBuffer[--nLength] = '\0';
+        }
+        /* A line that does not fit in the buffer is joined piece after piece. */
+        if (!bLineEnd && !feof(fInputFile)) {
+            if (!bufLongLine) {
+                bufLongLine = createEmptyBuffer();
+            }
+            appendToBuffer(bufLongLine, sBuffer, nLength);
+            continue;
+        }
+        /* Add line to list. */
+        if (bufLongLine && (*bufLongLine).Length > 0) {
+            appendToBuffer(bufLongLine, sBuffer, nLength + 1);
+            appendToList(lstReturnValue, (*bufLongLine).Data);
+            clearBuffer(bufLongLine);
+        }
+        else {
+            appendToList(lstReturnValue, sBuffer);
+        }
+    }
+    /* Last line, cut short by the end of the file or a read error. */
+    if (bufLongLine) {
+        if ((*bufLongLine).Length > 0) {
+            appendToBuffer(bufLongLine, "", 1);
+            appendToList(lstReturnValue, (*bufLongLine).Data);
+        }
+        freeBuffer(&bufLongLine);
+    }
+
+    return lstReturnValue;
+}
+
+
+/**
+ * Write a length of the drawing (in template units) once displayed with squares of
+ * nSquareSize pixels, to at most two decimals (e.g. "192.67").
+ **/
+static void formatDisplayedLength(char* sBuffer, size_t nSize, int nLength, int nSquareSize) {
+
+    long nHundredths = ((long) nLength * nSquareSize * 100 + SQUARE_WIDTH/2) / SQUARE_WIDTH;
+    if (nHundredths % 100 == 0) {
+        snprintf(sBuffer, nSize, "%ld", nHundredths / 100);
+    }
+    else if (nHundredths % 10 == 0) {
+        snprintf(sBuffer, nSize, "%ld.%ld", nHundredths / 100, (nHundredths % 100) / 10);
+    }
+    else {
+        snprintf(sBuffer, nSize, "%ld.%02ld", nHundredths / 100, nHundredths % 100);
+    }
+}
+
+
+/**
+ * Replace the opening tag of a template ("<svg", or one whose lengths were already added)
+ * by one of the given width and height, in template units, displayed with squares of
+ * nSquareSize pixels: for another size than SQUARE_WIDTH, a view box maps the drawing onto
+ * the displayed width and height, so that no location of the template changes.
+ *
+ * @param   lstSVGTemplate  each item of the list is a SVG line
+ * @return  false if the template does not start with "<svg"
+ * @see     addLengthsToTemplate()
+ **/
+bool scaleTemplate(LinkedList lstSVGTemplate, int nWidth, int nHeight, int nSquareSize) {
+
+    char sBuffer[BUFFER_SIZE];          /* Holds length variations. */
+
+    /* POINT TO START OF THE LIST. */
+    ListItem* itmCurrentItem = lstSVGTemplate.First;
+
+    if (itmCurrentItem && itmCurrentItem->Value) {
+        if (strncmp("<svg", itmCurrentItem->Value, 4) == 0) {
+            int nLength;
+            if (nSquareSize == SQUARE_WIDTH) {
+                nLength = snprintf(sBuffer, BUFFER_SIZE,
+                    "<svg width = \"%d\" height = \"%d\" version = \"1.1\"\n",
+                    nWidth, nHeight);
+            }
+            else {
+                char sDisplayedWidth[32];
+                char sDisplayedHeight[32];
+                formatDisplayedLength(sDisplayedWidth, sizeof(sDisplayedWidth), nWidth,
+                    nSquareSize);
+                formatDisplayedLength(sDisplayedHeight, sizeof(sDisplayedHeight), nHeight,
+                    nSquareSize);
+                nLength = snprintf(sBuffer, BUFFER_SIZE,
+                    "<svg width = \"%s\" height = \"%s\" viewBox = \"0 0 %d %d\" "
+                    "version = \"1.1\"\n", sDisplayedWidth, sDisplayedHeight, nWidth, nHeight);
+            }
+            if (nLength <= 0) {
+                printf("Unsuccessful snprintf() in scaleTemplate(): halting.\n");
+                exit(EXIT_FAILURE);
+            }
+            modifyListItemValue(&lstSVGTemplate, itmCurrentItem, sBuffer);
+        }
+        else {
+            printf("Template first line is not '<svg' <> '%s': halting.\n", itmCurrentItem->Value);
+            return false;
+        }
+    }
+    else {
+        printf("Template first line not found : halting.\n"); //TODO: mettre un exit_failure
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Replace the opening tag of a template by one of the given width and height, displayed as
+ * drawn (see scaleTemplate()).
+ **/
+bool resizeTemplate(LinkedList lstSVGTemplate, int nWidth, int nHeight) {
+
+    return scaleTemplate(lstSVGTemplate, nWidth, nHeight, SQUARE_WIDTH);
+}
+
+
+/** Append SVG length and width to opening tag ("<svg>") and
+ * suppress closing tag (which will be recreated upon SVG completion).
+ * <p>
+ * Lengths of the diagram varies with presence of borders, coordinates and move indicator.
+ * <p>
+ * This step could be done during template loading. However the goal
+ * here is to keep loading separated for reusability and maintenance.
+ *
+ * @param   bBorder         frame around the board
+ * @param   bCoordinates    coordinates for algebric notation around the board
+ * @param   bMoveIndicator  little picture next to the board telling who is to move
+ * @param   lstSVGTemplate  each item of the list is a SVG line
+ * @return  lstSVGTemplate
+ * @see     createPieces()
+ **/
+bool addLengthsToTemplate(LinkedList lstSVGTemplate, bool bBorder, bool bCoordinates,
+    bool bMoveIndicator) {
+
+    /* APPEND WIDTH AND LENGTH TO STARTING TAG. */
+    if (!resizeTemplate(lstSVGTemplate,
+        computeWholeDrawingWidth(bCoordinates,bBorder, bMoveIndicator),
+        computeWholeDrawingHeight(bCoordinates, bBorder))) {
+        return false;
+    }
+
+    /* POINT TO START OF THE LIST. */
+    ListItem* itmCurrentItem = lstSVGTemplate.First;
+
+    /* REACH THE LAST ITEM. */
+    while(itmCurrentItem->Next) { /* itmCurrentItem always exist. */
+        itmCurrentItem = itmCurrentItem->Next;
+    }
+
+    /* DELETE CLOSING TAG. */
+    if (itmCurrentItem && itmCurrentItem->Value) {
+        if (strncmp("</svg>", itmCurrentItem->Value,
+            strlen("</svg>")) == 0) {
+            modifyListItemValue(&lstSVGTemplate, itmCurrentItem, "\n");
+        }
+        else {
+            printf("Template last line is not '</svg>' <> '%s': halting.\n",
+                itmCurrentItem->Value);
+            return false;
+        }
+    }
+    else {
+        printf("Template last line not found or empty: halting.");
+        return false;
+    }
+        
+    return true;
+}
+
+
+/**
+ * Join the lines of a template (once its lengths were added) into a single block of bytes,
+ * each line followed by '\n'.
+ * <p>
+ * The template is the same for every diagram: it is assembled once, then written down with a
+ * single call per diagram.
+ *
+ * @param   lstSVGTemplate  each item of the list is a SVG line
+ * @return  bufReturnValue  the whole template, ready to be written
+ * @see     addLengthsToTemplate()
+ **/
+ByteBuffer* buildTemplateBlob(LinkedList lstSVGTemplate) {
+
+    ByteBuffer* bufReturnValue = createEmptyBuffer();
+
+    ListItem* itmCurrentItem = lstSVGTemplate.First;
+    while(itmCurrentItem) {
+        if (itmCurrentItem->Value) {
+            appendLineToBuffer(bufReturnValue, itmCurrentItem->Value);
+        }
+        itmCurrentItem = itmCurrentItem->Next;
+    }
+
+    return bufReturnValue;
+}
+
+
+/**
+ * Remove the definitions of a template blob (once its lengths were added), from the line
+ * opening them ("<defs>") to its end: only the opening tag of the SVG is left.
+ **/
+static void removeDefinitions(ByteBuffer* bufTemplate) {
+
+    const char* pData = (*bufTemplate).Data;
+    const char* pDefinitions = NULL;
+    for (size_t nPos = 0; nPos + 5 <= (*bufTemplate).Length; nPos++) {
+        if (memcmp(pData + nPos, "<defs", 5) == 0) {
+            pDefinitions = pData + nPos;
+            break;
+        }
+    }
+    if (!pDefinitions) {
+        return;
+    }
+
+    /* Indentation of "<defs>" goes too. */
+    while (pDefinitions > pData && (pDefinitions[-1] == ' ' || pDefinitions[-1] == '\t')) {
+        pDefinitions--;
+    }
+    (*bufTemplate).Length = (size_t) (pDefinitions - pData);
+}
+
+
+/**
+ * Build the sprite file diagrams reference in sprite mode: the template itself, which is a
+ * SVG file made of definitions only (minified in compact mode, so that ids match).
+ *
+ * @param   lstTemplate     SVG definitions, as read
+ * @param   bCompact        minified SVG (see minifySVG())
+ * @return  bufReturnValue  the sprite file, ready to be written
+ **/
+ByteBuffer* buildSprite(LinkedList lstTemplate, bool bCompact) {
+
+    ByteBuffer* bufReturnValue = buildTemplateBlob(lstTemplate);
+    if (bCompact) {
+        ByteBuffer* bufMinified = minifySVG(bufReturnValue);
+        freeBuffer(&bufReturnValue);
+        bufReturnValue = bufMinified;
+    }
+
+    return bufReturnValue;
+}
+
+
+/**
+ * Minify SVG: whitespace between tags and comments are removed, whitespace inside a tag or
+ * a value is reduced to a single space where one is needed, and the definitions of the
+ * template get their short names (e.g. "whitepawn" becomes "P").
+ * <p>
+ * It only has to cope with well-formed SVG such as the template: it is not a parser.
+ *
+ * @param   bufSVG          e.g. the template, with its lengths added
+ * @return  bufReturnValue  the minified SVG
+ **/
+ByteBuffer* minifySVG(const ByteBuffer* bufSVG) {
+
+    ByteBuffer* bufReturnValue = createEmptyBuffer();
+    reserveBuffer(bufReturnValue, (*bufSVG).Length);
+
+    const char* pData = (*bufSVG).Data;
+    size_t nLength = (*bufSVG).Length;
+    bool bInTag = false;
+    char cQuote = '\0';                     /* Quote of the current value, if any. */
+    bool bPendingSpace = false;
+
+    for (size_t nPos = 0; nPos < nLength; nPos++) {
+        char cCurrent = pData[nPos];
+
+        /* SKIP COMMENTS. */
+        if (!bInTag && nLength - nPos >= 4 && memcmp(pData + nPos, "<!--", 4) == 0) {
+            const char* pEnd = NULL;
+            for (size_t nEnd = nPos + 4; nEnd + 3 <= nLength; nEnd++) {
+                if (memcmp(pData + nEnd, "-->", 3) == 0) {
+                    pEnd = pData + nEnd;
+                    break;
+                }
+            }
+            nPos = pEnd ? (size_t) (pEnd - pData) + 2 : nLength;
+            continue;
+        }
+
+        /* WHITESPACE IS ONLY WRITTEN ONCE THE NEXT CHARACTER IS KNOWN. */
+        if (cCurrent == ' ' || cCurrent == '\t' || cCurrent == '\n' || cCurrent == '\r') {
+            bPendingSpace = true;
+            continue;
+        }
+        if (bPendingSpace && (*bufReturnValue).Length > 0) {
+            char cLast = (*bufReturnValue).Data[(*bufReturnValue).Length-1];
+            bool bNeeded;
+            if (cQuote) {
+                /* Inside a value (e.g. path data), but not at its edges. */
+                bNeeded = (cLast != cQuote || pData[nPos-1] != cQuote) && cCurrent != cQuote;
+            }
+            else if (bInTag) {
+                /* Between attributes. */
+                bNeeded = !strchr("<=", cLast) && !strchr("=>/", cCurrent);
+            }
+            else {
+                /* Between words of a text, not between tags. */
+                bNeeded = (cLast != '>' && cCurrent != '<');
+            }
+            if (bNeeded) {
+                appendToBuffer(bufReturnValue, " ", 1);
+            }
+        }
+        bPendingSpace = false;
+
+        /* KEEP TRACK OF TAGS AND VALUES. */
+        if (cQuote) {
+            if (cCurrent == cQuote) {
+                cQuote = '\0';
+            }
+        }
+        else if (bInTag) {
+            if (cCurrent == '"' || cCurrent == '\'') {
+                cQuote = cCurrent;
+            }
+            else if (cCurrent == '>') {
+                bInTag = false;
+            }
+        }
+        else if (cCurrent == '<') {
+            bInTag = true;
+        }
+
+        /* SHORTEN NAMES OF DEFINITIONS (id="whitepawn", xlink:href="#whitepawn"). */
+        if (cQuote == '"' && cCurrent == '"') {
+            const char* pWritten = (*bufReturnValue).Data + (*bufReturnValue).Length;
+            size_t nWritten = (*bufReturnValue).Length;
+            bool bReference = (nPos + 1 < nLength && pData[nPos+1] == '#');
+            if ((!bReference && nWritten >= 4 && memcmp(pWritten - 4, " id=", 4) == 0)
+                || (bReference && nWritten >= 5 && memcmp(pWritten - 5, "href=", 5) == 0)) {
+                const char* pId = pData + nPos + 1 + (bReference ? 1 : 0);
+                const char* pIdEnd = memchr(pId, '"', nLength - (size_t) (pId - pData));
+                const char* sShortId = pIdEnd ? findShortSVGId(pId, (size_t) (pIdEnd - pId)) :
+                    NULL;
+                if (sShortId) {
+                    appendToBuffer(bufReturnValue, "\"#", bReference ? 2 : 1);
+                    appendStringToBuffer(bufReturnValue, sShortId);
+                    nPos = (size_t) (pIdEnd - pData) - 1;   /* Closing quote comes next. */
+                    continue;
+                }
+            }
+        }
+
+        appendToBuffer(bufReturnValue, &cCurrent, 1);
+    }
+
+    return bufReturnValue;
+}
+
+
+/** 
+ * Return the uses of SVG definitions that represent an empty chess board, as SVG lines
+ * (each one followed by '\n', unless compact) in a single buffer.
+ * The colour of the square may vary, the board can have a border, coordinates, ...
+ * <p>
+ * This empty chessboard is intented to act as a template to create a board filled with chess
+ * pieces later.
+ *
+ * @param   geoBoard        layout of the board (see computeBoardGeometry())
+ * @param   bWhiteAtBottom  board orientation
+ * @param   bCompact        minified lines
+ * @param   sSpriteFile     file holding the definitions, NULL if they are in the diagram
+ * @return  bufEmptyBoard   SVG lines, ready to be copied as a whole
+ * @see     fillBoard()
+ **/
+ByteBuffer* generateEmptyBoard(const BoardGeometry* geoBoard, bool bWhiteAtBottom,
+    bool bCompact, const char* sSpriteFile) {
+
+    ByteBuffer* bufEmptyBoard = createEmptyBuffer();
+
+    /* SET UP LIGHT AND DARK SQUARES (from the top left corner, whatever the orientation). */
+    char sBuffer[BUFFER_SIZE];             /* Holds length variations. */
+    char sCoordinateId[] = "coordinate?";
+    bool bLightSquare = true;               /* alternates between dark and light squares*/
+    for (int nY = 0; nY<8; nY++) {            /* Eight rows. */
+        for (int nX = 0; nX<8; nX++) {        /* Eight columns. */
+            const int* anCorner = (*geoBoard).Squares[8*nY + nX][WHITE_AT_BOTTOM_INDEX];
+            formatUseLine(sBuffer, BUFFER_SIZE, sSpriteFile,
+                bLightSquare ? "lightsquare" : "darksquare", anCorner[0], anCorner[1],
+                bCompact);
+            appendStringToBuffer(bufEmptyBoard, sBuffer);
+            bLightSquare = !bLightSquare;    /* Switch square color. */
+        }
+        bLightSquare = !bLightSquare;
+    }
+
+    /* SET UP BORDERS. */
+    if ((*geoBoard).Border) {
+        formatUseLine(sBuffer, BUFFER_SIZE, sSpriteFile, "borders", (*geoBoard).Borders[0],
+            (*geoBoard).Borders[1], bCompact);
+        appendStringToBuffer(bufEmptyBoard, sBuffer);
+    }
+
+    /* SET UP COORDINATES. */
+    if ((*geoBoard).Coordinates) {
+        /* Vertical coordinates (from '8' to '1' if White on bottom, from '1' to '8' else). */
+        for (int nRank = 0; nRank < 8; nRank++) {
+            sCoordinateId[strlen("coordinate")] = bWhiteAtBottom ? '8'-nRank : '1'+nRank;
+            formatUseLine(sBuffer, BUFFER_SIZE, sSpriteFile, sCoordinateId,
+                (*geoBoard).RankCoordinates[nRank][0], (*geoBoard).RankCoordinates[nRank][1],
+                bCompact);
+            appendStringToBuffer(bufEmptyBoard, sBuffer);
+        }
+        /* Horizontal coordinates (from 'a' to 'h' if White at bottom, from 'h' to 'a' else) */
+        for (int nFile = 0; nFile < 8; nFile++) {
+            sCoordinateId[strlen("coordinate")] = bWhiteAtBottom ? 'a'+nFile : 'h'-nFile;
+            formatUseLine(sBuffer, BUFFER_SIZE, sSpriteFile, sCoordinateId,
+                (*geoBoard).FileCoordinates[nFile][0], (*geoBoard).FileCoordinates[nFile][1],
+                bCompact);
+            appendStringToBuffer(bufEmptyBoard, sBuffer);
+        }
+    }
+
+    return bufEmptyBoard;
+}
+
+
+/**
+ * Join the template and an empty board: this is the part of a diagram that does not depend
+ * on the position, so that it can be copied with a single call for every diagram.
+ *
+ * @param   bufTemplate     SVG definitions, with lengths appended
+ * @param   geoBoard        layout of the board (see computeBoardGeometry())
+ * @param   bWhiteAtBottom  board orientation
+ * @param   bCompact        minified lines
+ * @param   sSpriteFile     file holding the definitions, NULL if they are in the diagram
+ * @return  bufReturnValue  template followed by the empty board
+ * @see     generateEmptyBoard()
+ **/
+ByteBuffer* buildEmptyDiagram(ByteBuffer bufTemplate, const BoardGeometry* geoBoard,
+    bool bWhiteAtBottom, bool bCompact, const char* sSpriteFile) {
+
+    ByteBuffer* bufReturnValue = createEmptyBuffer();
+    ByteBuffer* bufEmptyBoard = generateEmptyBoard(geoBoard, bWhiteAtBottom, bCompact,
+        sSpriteFile);
+
+    appendToBuffer(bufReturnValue, bufTemplate.Data, bufTemplate.Length);
+    appendToBuffer(bufReturnValue, (*bufEmptyBoard).Data, (*bufEmptyBoard).Length);
+
+    freeBuffer(&bufEmptyBoard);
+
+    return bufReturnValue;
+}
+
+
+/**
+ * Template the diagrams of given options start with: a copy of the template as read, with
+ * its lengths added and without closing tag, joined (see buildTemplateBlob()), and minified
+ * if compact.
+ *
+ * @param   lstTemplate     SVG definitions, as read (left untouched)
+ * @param   nSquareSize     displayed square size, in pixels (see scaleTemplate())
+ * @return  bufReturnValue  the sized template, NULL if the template is malformed
+ * @see     addLengthsToTemplate()
+ **/
+ByteBuffer* buildSizedTemplate(LinkedList lstTemplate, bool bBorder, bool bCoordinates,
+    bool bMoveIndicator, bool bCompact, int nSquareSize) {
+
+    /* COPY TEMPLATE, THEN ADD LENGTHS */
+    ListArena* arnTemplate = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    LinkedList* lstSized = createArenaList(arnTemplate);
+    for (ListItem* itmCurrent = lstTemplate.First; itmCurrent; itmCurrent = itmCurrent->Next) {
+        appendToList(lstSized, itmCurrent->Value);
+    }
+    if (!addLengthsToTemplate(*lstSized, bBorder, bCoordinates, bMoveIndicator)
+        || (nSquareSize != SQUARE_WIDTH && !scaleTemplate(*lstSized,
+        computeWholeDrawingWidth(bCoordinates, bBorder, bMoveIndicator),
+        computeWholeDrawingHeight(bCoordinates, bBorder), nSquareSize))) {
+        freeListArena(&arnTemplate);
+        return NULL;
+    }
+    /* Same bytes for every diagram: join them once and for all. */
+    ByteBuffer* bufReturnValue = buildTemplateBlob(*lstSized);
+    freeListArena(&arnTemplate);
+    if (bCompact) {
+        ByteBuffer* bufMinified = minifySVG(bufReturnValue);
+        freeBuffer(&bufReturnValue);
+        bufReturnValue = bufMinified;
+    }
+
+    return bufReturnValue;
+}
+
+
+/**
+ * Last steps of setting up a context, its layout computed and empty diagrams built: pieces
+ * and options.
+ **/
+static void finishRenderContext(RenderContext* ctxRender, bool bBorder, bool bCoordinates,
+    bool bMoveIndicator, bool bRotateBoard, bool bCompact, const char* sSpriteFile) {
+
+    (*ctxRender).Pieces = createPieceTable(&(*ctxRender).Geometry, bCompact, sSpriteFile);
+    (*ctxRender).ClosingTag = bCompact ? SVG_COMPACT_CLOSING_TAG : SVG_CLOSING_TAG;
+    (*ctxRender).Border = bBorder;
+    (*ctxRender).Coordinates = bCoordinates;
+    (*ctxRender).MoveIndicator = bMoveIndicator;
+    (*ctxRender).RotateBoard = bRotateBoard;
+    (*ctxRender).Compact = bCompact;
+}
+
+
+/**
+ * Prepare a context from a template already read (see readTemplate()): add its lengths,
+ * generate both empty boards and the table of ready-made piece lines.
+ * <p>
+ * The template is left untouched (lengths are added to a copy), so that contexts for
+ * other options can be built from it.
+ * <p>
+ * Once set up, a context is only read: any number of threads can render with it at once.
+ *
+ * @param   ctxRender       context to set up
+ * @param   lstTemplate     SVG definitions, as read
+ * @param   bBorder         frame around the board requested?
+ * @param   bCoordinates    coordinates for algebric notation around the board
+ * @param   bMoveIndicator  little picture next to the board telling who is to move
+ * @param   bRotateBoard    side to move at bottom
+ * @param   bCompact        minified SVG (see minifySVG())
+ * @param   sSpriteFile     file holding the definitions (see buildSprite()), NULL if they
+ *                          are in every diagram
+ * @param   nSquareSize     displayed square size, in pixels (SQUARE_WIDTH: as drawn)
+ * @return  RENDER_OK or RENDER_INVALID_TEMPLATE
+ * @see     freeRenderContext()
+ **/
+int initRenderContextFromTemplate(RenderContext* ctxRender, LinkedList lstTemplate,
+    bool bBorder, bool bCoordinates, bool bMoveIndicator, bool bRotateBoard, bool bCompact,
+    const char* sSpriteFile, int nSquareSize) {
+
+    /* SIZED TEMPLATE */
+    ByteBuffer* bufTemplate = buildSizedTemplate(lstTemplate, bBorder, bCoordinates,
+        bMoveIndicator, bCompact, nSquareSize);
+    if (!bufTemplate) {
+        return RENDER_INVALID_TEMPLATE;
+    }
+    /* Definitions are referenced from the sprite: only the opening tag is kept. */
+    if (sSpriteFile) {
+        removeDefinitions(bufTemplate);
+    }
+
+    /* GENERATE TWO EMPTY CHESSBOARDS (same boards are used for every position) */
+    computeBoardGeometry(&(*ctxRender).Geometry, bBorder, bCoordinates, nSquareSize);
+    /* White at bottom. */
+    (*ctxRender).NormalEmptyDiagram = buildEmptyDiagram(*bufTemplate, &(*ctxRender).Geometry,
+        WHITE_ON_BOTTOM, bCompact, sSpriteFile);
+    /* Black at bottom. */
+    (*ctxRender).ReversedEmptyDiagram = buildEmptyDiagram(*bufTemplate,
+        &(*ctxRender).Geometry, BLACK_ON_BOTTOM, bCompact, sSpriteFile);
+    freeBuffer(&bufTemplate);
+
+    /* PIECES AND OPTIONS */
+    finishRenderContext(ctxRender, bBorder, bCoordinates, bMoveIndicator, bRotateBoard,
+        bCompact, sSpriteFile);
+
+    return RENDER_OK;
+}
+
+
+#ifndef FEN2SVG_NO_EMBEDDED_TEMPLATE
+/**
+ * Put the lines of the template built into the program (see embedtemplate.c) in a linked
+ * list, as readTemplate() does from a file.
+ **/
+LinkedList* readEmbeddedTemplate(ListArena* arnArena) {
+
+    LinkedList* lstReturnValue = createArenaList(arnArena);
+    for (int i = 0; asEmbeddedTemplate[i]; i++) {
+        appendToList(lstReturnValue, asEmbeddedTemplate[i]);
+    }
+
+    return lstReturnValue;
+}
+
+
+/** Join the pieces of an empty diagram built into the program. **/
+static ByteBuffer* joinEmbeddedTexts(const EmbeddedText* etxHeader,
+    const EmbeddedText* etxDefinitions, const EmbeddedText* etxBoard) {
+
+    ByteBuffer* bufReturnValue = createEmptyBuffer();
+    reserveBuffer(bufReturnValue, (*etxHeader).Length + (*etxDefinitions).Length
+        + (*etxBoard).Length);
+    appendToBuffer(bufReturnValue, (*etxHeader).Data, (*etxHeader).Length);
+    appendToBuffer(bufReturnValue, (*etxDefinitions).Data, (*etxDefinitions).Length);
+    appendToBuffer(bufReturnValue, (*etxBoard).Data, (*etxBoard).Length);
+
+    return bufReturnValue;
+}
+
+
+/**
+ * Prepare a context from the template built into the program: its sized opening tags,
+ * definitions and empty boards were generated with the program, so that they are only
+ * joined (no file is read, nothing is parsed). Same result as
+ * initRenderContextFromTemplate() with the lines of the template, without sprite file.
+ *
+ * @param   nOptions        e.g. BORDER_OPTION | MOVE_INDICATOR_OPTION
+ **/
+void initRenderContextFromEmbedded(RenderContext* ctxRender, int nOptions) {
+
+    int nCompact = (nOptions & COMPACT_OPTION) ? 1 : 0;
+    const EmbeddedText* etxHeader = &aEmbeddedHeaders[nCompact][nOptions
+        & (BORDER_OPTION | COORDINATES_OPTION | MOVE_INDICATOR_OPTION)];
+    const EmbeddedText* etxDefinitions = &aEmbeddedDefinitions[nCompact];
+    int nBoard = nOptions & (BORDER_OPTION | COORDINATES_OPTION);
+    (*ctxRender).NormalEmptyDiagram = joinEmbeddedTexts(etxHeader, etxDefinitions,
+        &aEmbeddedBoards[nCompact][nBoard][WHITE_AT_BOTTOM_INDEX]);
+    (*ctxRender).ReversedEmptyDiagram = joinEmbeddedTexts(etxHeader, etxDefinitions,
+        &aEmbeddedBoards[nCompact][nBoard][BLACK_AT_BOTTOM_INDEX]);
+    computeBoardGeometry(&(*ctxRender).Geometry, nOptions & BORDER_OPTION,
+        nOptions & COORDINATES_OPTION, SQUARE_WIDTH);
+    finishRenderContext(ctxRender, nOptions & BORDER_OPTION, nOptions & COORDINATES_OPTION,
+        nOptions & MOVE_INDICATOR_OPTION, nOptions & ROTATE_BOARD_OPTION, nCompact, NULL);
+}
+#endif
+
+
+/**
+ * Prepare a context: read the template, then see initRenderContextFromTemplate().
+ *
+ * @param   sTemplateFile   SVG definitions (e.g. SVG_TEMPLATE)
+ * @return  RENDER_OK, RENDER_TEMPLATE_NOT_FOUND or RENDER_INVALID_TEMPLATE
+ * @see     freeRenderContext()
+ **/
+int initRenderContext(RenderContext* ctxRender, char* sTemplateFile, bool bBorder,
+    bool bCoordinates, bool bMoveIndicator, bool bRotateBoard, bool bCompact,
+    const char* sSpriteFile) {
+
+    /* READ SVG TEMPLATE (contains definitions for board items and pieces) */
+    ListArena* arnTemplate = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    LinkedList* lstTemplate = readTemplate(sTemplateFile, arnTemplate);
+    if (!lstTemplate) {
+        freeListArena(&arnTemplate);
+        return RENDER_TEMPLATE_NOT_FOUND;
+    }
+
+    int nStatus = initRenderContextFromTemplate(ctxRender, *lstTemplate, bBorder,
+        bCoordinates, bMoveIndicator, bRotateBoard, bCompact, sSpriteFile, SQUARE_WIDTH);
+    freeListArena(&arnTemplate);
+
+    return nStatus;
+}
+
+
+/* Free what initRenderContext() allocated. */
+void freeRenderContext(RenderContext* ctxRender) {
+
+    freeBuffer(&(*ctxRender).NormalEmptyDiagram);
+    freeBuffer(&(*ctxRender).ReversedEmptyDiagram);
+    free((*ctxRender).Pieces);
+    (*ctxRender).Pieces = NULL;
+}
+
+
+/**
+ * Size of the largest diagram a context can render: a buffer that large never gets
+ * RENDER_BUFFER_TOO_SMALL.
+ **/
+size_t getMaxDiagramLength(const RenderContext* ctxRender) {
+
+    size_t nEmptyLength = (*(*ctxRender).NormalEmptyDiagram).Length;
+    if ((*(*ctxRender).ReversedEmptyDiagram).Length > nEmptyLength) {
+        nEmptyLength = (*(*ctxRender).ReversedEmptyDiagram).Length;
+    }
+
+    /* At most 64 pieces and a move indicator. */
+    return nEmptyLength + (64+1) * SVG_LINE_MAX_LENGTH + strlen((*ctxRender).ClosingTag);
+}
+
+
+/**
+ * Template and empty board a diagram starts with: the normal one, or the reversed one if
+ * the board is rotated and Black is to move.
+ **/
+const ByteBuffer* getEmptyDiagram(const RenderContext* ctxRender,
+    const ChessBoard* brdPosition) {
+
+    if ((*brdPosition).WhiteToPlay || !(*ctxRender).RotateBoard) {
+        return (*ctxRender).NormalEmptyDiagram;
+    }
+
+    return (*ctxRender).ReversedEmptyDiagram;
+}
+
+
+/**
+ * Turn one position into a whole diagram, in a caller-supplied block of memory:
+ * 1. Choose the template and empty board matching the orientation.
+ * 2. Fill the board with pieces, copying ready-made lines.
+ * 3. Close the SVG.
+ * <p>
+ * There is neither file access nor allocation: only copies of ready-made bytes.
+ * The output is not '\0' terminated.
+ *
+ * @param   ctxRender       context set up by initRenderContext()
+ * @param   brdPosition     chess position (see parseFEN())
+ * @param   pOutput         receives the diagram
+ * @param   nCapacity       bytes available in pOutput (see getMaxDiagramLength())
+ * @return  number of bytes written, or RENDER_BUFFER_TOO_SMALL
+ **/
+long renderBoard(const RenderContext* ctxRender, const ChessBoard* brdPosition, char* pOutput,
+    size_t nCapacity) {
+
+    /* WHICH EMPTY BOARD TO USE (White or Black at bottom)? */
+    const ByteBuffer* bufEmptyDiagram = getEmptyDiagram(ctxRender, brdPosition);
+    if ((*bufEmptyDiagram).Length > nCapacity) {
+        return RENDER_BUFFER_TOO_SMALL;
+    }
+    memcpy(pOutput, (*bufEmptyDiagram).Data, (*bufEmptyDiagram).Length);
+    size_t nLength = (*bufEmptyDiagram).Length;
+
+    /* FILL BOARD WITH PIECES. */
+    long nPiecesLength = placePieces((*ctxRender).Pieces, brdPosition,
+        (*ctxRender).MoveIndicator, (*ctxRender).RotateBoard, pOutput + nLength,
+        nCapacity - nLength);
+    if (nPiecesLength < 0) {
+        return nPiecesLength;
+    }
+    nLength += (size_t) nPiecesLength;
+
+    /* CLOSE SVG. */
+    if (nCapacity - nLength < strlen((*ctxRender).ClosingTag)) {
+        return RENDER_BUFFER_TOO_SMALL;
+    }
+    memcpy(pOutput + nLength, (*ctxRender).ClosingTag, strlen((*ctxRender).ClosingTag));
+    nLength += strlen((*ctxRender).ClosingTag);
+
+    return (long) nLength;
+}
+
+
+/**
+ * Turn one FEN string into a whole diagram, in a caller-supplied block of memory: the
+ * string is parsed (see parseFEN()), then drawn (see renderBoard()).
+ *
+ * @param   ctxRender       context set up by initRenderContext()
+ * @param   sFEN            FEN string representing the chess position (need not be '\0'
+ *                          terminated)
+ * @param   nFENLength      length of sFEN
+ * @param   pOutput         receives the diagram
+ * @param   nCapacity       bytes available in pOutput (see getMaxDiagramLength())
+ * @return  number of bytes written, or RENDER_INVALID_FEN or RENDER_BUFFER_TOO_SMALL
+ **/
+long renderFEN(const RenderContext* ctxRender, const char* sFEN, size_t nFENLength,
+    char* pOutput, size_t nCapacity) {
+
+    ChessBoard brdPosition;
+    if (parseFEN(sFEN, nFENLength, &brdPosition, NULL) != FEN_OK) {
+        return RENDER_INVALID_FEN;
+    }
+
+    return renderBoard(ctxRender, &brdPosition, pOutput, nCapacity);
+}
+
+
+/** Drawing options as a single number (e.g. BORDER_OPTION | MOVE_INDICATOR_OPTION). **/
+int combineOptions(bool bBorder, bool bCoordinates, bool bMoveIndicator, bool bRotateBoard,
+    bool bCompact) {
+
+    return (bBorder ? BORDER_OPTION : 0)
+        | (bCoordinates ? COORDINATES_OPTION : 0)
+        | (bMoveIndicator ? MOVE_INDICATOR_OPTION : 0)
+        | (bRotateBoard ? ROTATE_BOARD_OPTION : 0)
+        | (bCompact ? COMPACT_OPTION : 0);
+}
+
+
+/**
+ * Drawing options of a line made of tab-separated columns: a FEN string, then possibly
+ * comments and options. The first column after the FEN string that starts with '-' holds
+ * options, as on the command line (e.g. "-bcm"; "-" alone for none).
+ * <p>
+ * Compact output is a matter of the whole run, not of a position: it is kept from the
+ * default options.
+ *
+ * @param   sLine           the line, not necessarily '\0' terminated
+ * @param   nLength         length of the line
+ * @param   nDefaultOptions returned if the line has no options column
+ * @return  options (e.g. BORDER_OPTION | MOVE_INDICATOR_OPTION), -1 if a letter is unknown
+ **/
+int getLineOptions(const char* sLine, size_t nLength, int nDefaultOptions) {
+
+    /* SKIP FEN STRING, THEN LOOK FOR A COLUMN STARTING WITH '-'. */
+    const char* pColumn = memchr(sLine, '\t', nLength);
+    while (pColumn) {
+        pColumn++;
+        size_t nRemaining = nLength - (size_t) (pColumn - sLine);
+        if (nRemaining > 0 && *pColumn == '-') {
+            /* READ OPTIONS ONE BY ONE. */
+            int nOptions = 0;
+            for (size_t nPos = 1; nPos < nRemaining && pColumn[nPos] != '\t'; nPos++) {
+                switch (pColumn[nPos]) {
+                    case 'b':
+                        nOptions |= BORDER_OPTION;
+                        break;
+                    case 'c':
+                        nOptions |= COORDINATES_OPTION;
+                        break;
+                    case 'm':
+                        nOptions |= MOVE_INDICATOR_OPTION;
+                        break;
+                    case 'r':
+                        nOptions |= ROTATE_BOARD_OPTION;
+                        break;
+                    default:
+                        return -1;
+                }
+            }
+            return nOptions | (nDefaultOptions & COMPACT_OPTION);
+        }
+        pColumn = memchr(pColumn, '\t', nRemaining);
+    }
+
+    return nDefaultOptions;
+}
+
+
+/**
+ * Create a cache of contexts, one per combination of options: the template is read once,
+ * then each context is only built the first time it is asked for (see getRenderContext()).
+ * <p>
+ * The context without options is built at once, so that a malformed template is reported
+ * here rather than while rendering.
+ *
+ * @param   sTemplateFile   SVG definitions (e.g. SVG_TEMPLATE), NULL for the template built
+ *                          into the program (see embeddedtemplate.h)
+ * @param   sSpriteFile     file diagrams reference the definitions in (see buildSprite()),
+ *                          NULL to embed them in every diagram; it must outlive the cache
+ * @param   nStatus         if not NULL, receives RENDER_OK, RENDER_TEMPLATE_NOT_FOUND or
+ *                          RENDER_INVALID_TEMPLATE
+ * @return  the cache, NULL on error
+ * @see     createSizedRenderCache(), freeRenderCache()
+ **/
+RenderCache* createRenderCache(char* sTemplateFile, const char* sSpriteFile, int* nStatus) {
+
+    return createSizedRenderCache(sTemplateFile, sSpriteFile, SQUARE_WIDTH, nStatus);
+}
+
+
+/**
+ * Create a cache of contexts whose diagrams show squares of nSquareSize pixels, rather
+ * than SQUARE_WIDTH as drawn in the template (see createRenderCache()).
+ *
+ * @param   nSquareSize     displayed square size, in pixels (see scaleTemplate())
+ * @return  the cache, NULL on error
+ **/
+RenderCache* createSizedRenderCache(char* sTemplateFile, const char* sSpriteFile,
+    int nSquareSize, int* nStatus) {
+
+    RenderCache* cchReturnValue = (RenderCache*) malloc(1 * sizeof(RenderCache));
+    if (!cchReturnValue) {
+        printf("Unsuccessful malloc() in createSizedRenderCache(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* READ SVG TEMPLATE, ONCE AND FOR ALL. */
+    (*cchReturnValue).TemplateArena = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    if (sTemplateFile) {
+        (*cchReturnValue).Template = readTemplate(sTemplateFile,
+            (*cchReturnValue).TemplateArena);
+    }
+    else {
+#ifndef FEN2SVG_NO_EMBEDDED_TEMPLATE
+        (*cchReturnValue).Template = readEmbeddedTemplate((*cchReturnValue).TemplateArena);
+#else
+        (*cchReturnValue).Template = NULL;
+#endif
+    }
+    (*cchReturnValue).EmbeddedTemplate = (sTemplateFile == NULL);
+    (*cchReturnValue).SpriteFile = sSpriteFile;
+    (*cchReturnValue).SquareSize = nSquareSize;
+    for (int nOptions = 0; nOptions < OPTION_COMBINATIONS; nOptions++) {
+        (*cchReturnValue).Contexts[nOptions] = NULL;
+    }
+    pthread_mutex_init(&(*cchReturnValue).Mutex, NULL);
+    int nCacheStatus = RENDER_TEMPLATE_NOT_FOUND;
+    if ((*cchReturnValue).Template) {
+        nCacheStatus = getRenderContext(cchReturnValue, 0) ? RENDER_OK : RENDER_INVALID_TEMPLATE;
+    }
+    if (nStatus) {
+        *nStatus = nCacheStatus;
+    }
+    if (nCacheStatus != RENDER_OK) {
+        freeRenderCache(&cchReturnValue);
+    }
+
+    return cchReturnValue;
+}
+
+
+/**
+ * Set up the context of a cache for a combination of options: from the template built into
+ * the program if possible, else from the lines of the template.
+ *
+ * @return  RENDER_OK or RENDER_INVALID_TEMPLATE
+ **/
+static int buildRenderContext(const RenderCache* cchRender, RenderContext* ctxRender,
+    int nOptions) {
+
+#ifndef FEN2SVG_NO_EMBEDDED_TEMPLATE
+    /* Sprite references hold the name of the sprite file, sizes are not: not built in. */
+    if ((*cchRender).EmbeddedTemplate && !(*cchRender).SpriteFile
+        && (*cchRender).SquareSize == SQUARE_WIDTH) {
+        initRenderContextFromEmbedded(ctxRender, nOptions);
+        return RENDER_OK;
+    }
+#endif
+
+    return initRenderContextFromTemplate(ctxRender, *(*cchRender).Template,
+        nOptions & BORDER_OPTION, nOptions & COORDINATES_OPTION,
+        nOptions & MOVE_INDICATOR_OPTION, nOptions & ROTATE_BOARD_OPTION,
+        nOptions & COMPACT_OPTION, (*cchRender).SpriteFile, (*cchRender).SquareSize);
+}
+
+
+/**
+ * Context for a combination of options, built the first time it is asked for.
+ * Any thread can call it: once built, contexts are only read.
+ *
+ * @param   nOptions        e.g. BORDER_OPTION | MOVE_INDICATOR_OPTION
+ * @return  the context, NULL if the options are unknown or the template is malformed
+ **/
+const RenderContext* getRenderContext(RenderCache* cchRender, int nOptions) {
+
+    if (nOptions < 0 || nOptions >= OPTION_COMBINATIONS) {
+        return NULL;
+    }
+
+    /* ALREADY BUILT? (no lock needed: a context is published once complete) */
+    RenderContext* ctxReturnValue = __atomic_load_n(&(*cchRender).Contexts[nOptions],
+        __ATOMIC_ACQUIRE);
+    if (ctxReturnValue) {
+        return ctxReturnValue;
+    }
+
+    /* BUILD IT (only one thread does). */
+    pthread_mutex_lock(&(*cchRender).Mutex);
+    ctxReturnValue = (*cchRender).Contexts[nOptions];
+    if (!ctxReturnValue) {
+        ctxReturnValue = (RenderContext*) malloc(1 * sizeof(RenderContext));
+        if (!ctxReturnValue) {
+            printf("Unsuccessful malloc() in getRenderContext(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (buildRenderContext(cchRender, ctxReturnValue, nOptions) != RENDER_OK) {
+            free(ctxReturnValue);
+            ctxReturnValue = NULL;
+        }
+        else {
+            __atomic_store_n(&(*cchRender).Contexts[nOptions], ctxReturnValue,
+                __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&(*cchRender).Mutex);
+
+    return ctxReturnValue;
+}
+
+
+/* Free a cache and every context it built. */
+void freeRenderCache(RenderCache** cchRender) {
+
+    for (int nOptions = 0; nOptions < OPTION_COMBINATIONS; nOptions++) {
+        if ((**cchRender).Contexts[nOptions]) {
+            freeRenderContext((**cchRender).Contexts[nOptions]);
+            free((**cchRender).Contexts[nOptions]);
+        }
+    }
+    freeListArena(&(**cchRender).TemplateArena);
+    pthread_mutex_destroy(&(**cchRender).Mutex);
+    free(*cchRender);
+    *cchRender = NULL;
+}
+
+
+GameFrame* createGameFrame(void) {
+
+    GameFrame* frmReturnValue = (GameFrame*) malloc(1 * sizeof(GameFrame));
+    if (!frmReturnValue) {
+        printf("Unsuccessful malloc() in createGameFrame(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*frmReturnValue).Context = NULL;
+    (*frmReturnValue).Output = createEmptyBuffer();
+    (*frmReturnValue).ChangedSquares = 0;
+
+    return frmReturnValue;
+}
+
+
+/**
+ * Write a line into its slot: the line, padded with spaces (before its '\n', if any), or only
+ * spaces if lnLine is NULL (empty square).
+ **/
+static void writeFrameSlot(GameFrame* frmGame, int nSlot, const SVGLine* lnLine) {
+
+    char* pSlot = (*(*frmGame).Output).Data + (*frmGame).SlotsOffset
+        + (size_t) nSlot * (*frmGame).SlotWidth;
+    bool bNewLine = !(*(*frmGame).Context).Compact;
+    size_t nTextLength = 0;
+
+    if (lnLine) {
+        nTextLength = (*lnLine).Length - (bNewLine ? 1 : 0);
+        memcpy(pSlot, (*lnLine).Text, nTextLength);
+    }
+    memset(pSlot + nTextLength, ' ', (*frmGame).SlotWidth - nTextLength);
+    if (bNewLine) {
+        pSlot[(*frmGame).SlotWidth - 1] = '\n';
+    }
+}
+
+
+/**
+ * Lay the slots out again, for another context or orientation: empty diagram, 64 blank
+ * squares, blank move indicator and closing tag.
+ **/
+static void layOutGameFrame(GameFrame* frmGame, const RenderContext* ctxRender,
+    const ByteBuffer* bufEmptyDiagram, int nOrientation) {
+
+    /* SLOT WIDTH: LONGEST LINE OF THE CONTEXT. */
+    const PieceTable* tblPieces = (*ctxRender).Pieces;
+    size_t nSlotWidth = 1;
+    for (int nPiece = 0; nPiece < PIECE_KINDS; nPiece++) {
+        for (int nSquare = 0; nSquare < 64; nSquare++) {
+            for (int nSide = 0; nSide < 2; nSide++) {
+                if ((*tblPieces).Pieces[nPiece][nSquare][nSide].Length > nSlotWidth) {
+                    nSlotWidth = (*tblPieces).Pieces[nPiece][nSquare][nSide].Length;
+                }
+            }
+        }
+    }
+    for (int nSide = 0; nSide < 2; nSide++) {
+        if ((*tblPieces).MoveIndicators[nSide].Length > nSlotWidth) {
+            nSlotWidth = (*tblPieces).MoveIndicators[nSide].Length;
+        }
+    }
+
+    (*frmGame).Context = ctxRender;
+    (*frmGame).Orientation = nOrientation;
+    (*frmGame).SlotWidth = nSlotWidth;
+    (*frmGame).SlotsOffset = (*bufEmptyDiagram).Length;
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        (*frmGame).Board[nSquare] = -1;
+    }
+    (*frmGame).SideToPlay = -1;
+
+    clearBuffer((*frmGame).Output);
+    appendToBuffer((*frmGame).Output, (*bufEmptyDiagram).Data, (*bufEmptyDiagram).Length);
+    reserveBuffer((*frmGame).Output, (64+1) * nSlotWidth);
+    (*(*frmGame).Output).Length += (64+1) * nSlotWidth;
+    for (int nSlot = 0; nSlot < 64+1; nSlot++) {
+        writeFrameSlot(frmGame, nSlot, NULL);
+    }
+    appendStringToBuffer((*frmGame).Output, (*ctxRender).ClosingTag);
+}
+
+
+/**
+ * Turn the next position of a game into a whole diagram, rewriting only the slots of the
+ * squares that differ from the previous position (all of them if the context or the board
+ * orientation changed).
+ *
+ * @param   frmGame         previous diagram of the game (see createGameFrame())
+ * @param   ctxRender       context set up by initRenderContext()
+ * @param   brdPosition     chess position (see parseFEN())
+ * @return  length of the diagram, in (*frmGame).Output
+ **/
+long renderGameFrame(GameFrame* frmGame, const RenderContext* ctxRender,
+    const ChessBoard* brdPosition) {
+
+    /* SAME LAYOUT AS THE PREVIOUS POSITION? */
+    const PieceTable* tblPieces = (*ctxRender).Pieces;
+    const ByteBuffer* bufEmptyDiagram = getEmptyDiagram(ctxRender, brdPosition);
+    int nOrientation = (bufEmptyDiagram == (*ctxRender).NormalEmptyDiagram) ?
+        WHITE_AT_BOTTOM_INDEX : BLACK_AT_BOTTOM_INDEX;
+    if ((*frmGame).Context != ctxRender || (*frmGame).Orientation != nOrientation) {
+        layOutGameFrame(frmGame, ctxRender, bufEmptyDiagram, nOrientation);
+    }
+
+    /* REWRITE CHANGED SQUARES ONLY. */
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        int nPiece = getBoardPiece(brdPosition, nSquare);
+        if (nPiece != (*frmGame).Board[nSquare]) {
+            writeFrameSlot(frmGame, nSquare, nPiece == NO_PIECE ? NULL :
+                &(*tblPieces).Pieces[nPiece][nSquare][nOrientation]);
+            (*frmGame).Board[nSquare] = (signed char) nPiece;
+            (*frmGame).ChangedSquares++;
+        }
+    }
+    if ((*ctxRender).MoveIndicator) {
+        int nSideToPlay = (*brdPosition).WhiteToPlay ? WHITE_TO_PLAY_INDEX : BLACK_TO_PLAY_INDEX;
+        if (nSideToPlay != (*frmGame).SideToPlay) {
+            writeFrameSlot(frmGame, 64, &(*tblPieces).MoveIndicators[nSideToPlay]);
+            (*frmGame).SideToPlay = nSideToPlay;
+        }
+    }
+
+    return (long) (*(*frmGame).Output).Length;
+}
+
+
+/* Free a frame and its diagram. */
+void freeGameFrame(GameFrame** frmGame) {
+
+    freeBuffer(&(**frmGame).Output);
+    free(*frmGame);
+    *frmGame = NULL;
+}
+
+
+/** Size of a sheet of nColumns x nRows diagrams (SHEET_MARGIN between them). **/
+static void computeSheetSize(const RenderContext* ctxRender, int nColumns, int nRows,
+    int* nWidth, int* nHeight) {
+
+    int nCellWidth = computeWholeDrawingWidth((*ctxRender).Coordinates, (*ctxRender).Border,
+        (*ctxRender).MoveIndicator);
+    int nCellHeight = computeWholeDrawingHeight((*ctxRender).Coordinates, (*ctxRender).Border);
+
+    *nWidth = nColumns * nCellWidth + (nColumns - 1) * SHEET_MARGIN;
+    *nHeight = nRows * nCellHeight + (nRows - 1) * SHEET_MARGIN;
+}
+
+
+/**
+ * Build the beginning of a sheet: the template, sized for nColumns x nRows diagrams, then
+ * both empty boards as groups ("board" and "reversedboard"), so that each diagram of the
+ * sheet uses one of them rather than repeating its 64 squares.
+ *
+ * @param   cchRender       template and sprite file, if any
+ * @param   ctxRender       context of every diagram of the sheet
+ * @param   nColumns        diagrams per row
+ * @param   nRows           rows per sheet
+ * @return  bufReturnValue  beginning of every sheet, ready to be copied; NULL if the
+ *                          template is malformed
+ * @see     renderSheetCell()
+ **/
+ByteBuffer* buildSheetHeader(const RenderCache* cchRender, const RenderContext* ctxRender,
+    int nColumns, int nRows) {
+
+    bool bCompact = (*ctxRender).Compact;
+
+    /* TEMPLATE, SIZED FOR THE WHOLE SHEET */
+    ListArena* arnTemplate = createListArena(TEMPLATE_ARENA_BLOCK_SIZE);
+    LinkedList* lstSized = createArenaList(arnTemplate);
+    for (ListItem* itmCurrent = (*(*cchRender).Template).First; itmCurrent;
+        itmCurrent = itmCurrent->Next) {
+        appendToList(lstSized, itmCurrent->Value);
+    }
+    int nWidth;
+    int nHeight;
+    computeSheetSize(ctxRender, nColumns, nRows, &nWidth, &nHeight);
+    if (!addLengthsToTemplate(*lstSized, (*ctxRender).Border, (*ctxRender).Coordinates,
+        (*ctxRender).MoveIndicator)
+        || !scaleTemplate(*lstSized, nWidth, nHeight, (*ctxRender).Geometry.SquareSize)) {
+        freeListArena(&arnTemplate);
+        return NULL;
+    }
+    ByteBuffer* bufReturnValue = buildTemplateBlob(*lstSized);
+    freeListArena(&arnTemplate);
+    if (bCompact) {
+        ByteBuffer* bufMinified = minifySVG(bufReturnValue);
+        freeBuffer(&bufReturnValue);
+        bufReturnValue = bufMinified;
+    }
+    if ((*cchRender).SpriteFile) {
+        removeDefinitions(bufReturnValue);
+    }
+
+    /* EMPTY BOARDS, AS GROUPS (a second block of definitions) */
+    appendStringToBuffer(bufReturnValue, bCompact ? "<defs>" : "    <defs>\n");
+    for (int nOrientation = 0; nOrientation < 2; nOrientation++) {
+        ByteBuffer* bufEmptyBoard = generateEmptyBoard(&(*ctxRender).Geometry,
+            nOrientation == WHITE_AT_BOTTOM_INDEX, bCompact, (*cchRender).SpriteFile);
+        appendStringToBuffer(bufReturnValue, nOrientation == WHITE_AT_BOTTOM_INDEX ?
+            (bCompact ? "<g id=\"board\">" : "    <g id = \"board\">\n") :
+            (bCompact ? "<g id=\"reversedboard\">" : "    <g id = \"reversedboard\">\n"));
+        appendToBuffer(bufReturnValue, (*bufEmptyBoard).Data, (*bufEmptyBoard).Length);
+        appendStringToBuffer(bufReturnValue, bCompact ? "</g>" : "    </g>\n");
+        freeBuffer(&bufEmptyBoard);
+    }
+    appendStringToBuffer(bufReturnValue, bCompact ? "</defs>" : "    </defs>\n");
+
+    return bufReturnValue;
+}
+
+
+/** Copy sText (without '\0') to pOutput, returning its length. **/
+static inline int copyText(char* pOutput, const char* sText) {
+
+    size_t nLength = strlen(sText);
+    memcpy(pOutput, sText, nLength);
+
+    return (int) nLength;
+}
+
+
+/**
+ * Write one diagram of a sheet: a group moved to its cell, using the empty board and
+ * holding the pieces. The sheet is closed by (*ctxRender).ClosingTag.
+ *
+ * @param   ctxRender       context the sheet header was built with
+ * @param   brdPosition     chess position (see parseFEN())
+ * @param   nCell           rank of the diagram on its sheet (row after row)
+ * @param   nColumns        diagrams per row
+ * @param   pOutput         receives the group
+ * @param   nCapacity       bytes available in pOutput (SHEET_CELL_MAX_LENGTH is enough)
+ * @return  number of bytes written, or RENDER_BUFFER_TOO_SMALL
+ * @see     buildSheetHeader()
+ **/
+long renderSheetCell(const RenderContext* ctxRender, const ChessBoard* brdPosition, int nCell,
+    int nColumns, char* pOutput, size_t nCapacity) {
+
+    /* OPEN GROUP, AT ITS CELL, WITH ITS EMPTY BOARD. */
+    int nCellWidth;
+    int nCellHeight;
+    computeSheetSize(ctxRender, 1, 1, &nCellWidth, &nCellHeight);
+    bool bReversed = (getEmptyDiagram(ctxRender, brdPosition)
+        == (*ctxRender).ReversedEmptyDiagram);
+    const char* sBoardId = bReversed ? "reversedboard" : "board";
+    char acOpening[128];
+    int nLength = copyText(acOpening, (*ctxRender).Compact ?
+        "<g transform=\"translate(" : "    <g transform = \"translate(");
+    nLength += formatDecimal((unsigned int) ((nCell % nColumns) * (nCellWidth + SHEET_MARGIN)), 1,
+        acOpening + nLength);
+    acOpening[nLength++] = ' ';
+    nLength += formatDecimal((unsigned int) ((nCell / nColumns) * (nCellHeight + SHEET_MARGIN)),
+        1, acOpening + nLength);
+    nLength += copyText(acOpening + nLength, (*ctxRender).Compact ?
+        ")\"><use xlink:href=\"#" : ")\">\n    <use xlink:href = \"#");
+    nLength += copyText(acOpening + nLength, sBoardId);
+    nLength += copyText(acOpening + nLength, (*ctxRender).Compact ? "\"/>" : "\" />\n");
+    if ((size_t) nLength >= nCapacity) {
+        return RENDER_BUFFER_TOO_SMALL;
+    }
+    memcpy(pOutput, acOpening, (size_t) nLength);
+
+    /* FILL BOARD WITH PIECES. */
+    long nPiecesLength = placePieces((*ctxRender).Pieces, brdPosition,
+        (*ctxRender).MoveIndicator, (*ctxRender).RotateBoard, pOutput + nLength,
+        nCapacity - (size_t) nLength);
+    if (nPiecesLength < 0) {
+        return nPiecesLength;
+    }
+    nLength += (int) nPiecesLength;
+
+    /* CLOSE GROUP. */
+    const char* sClosingTag = (*ctxRender).Compact ? "</g>" : "    </g>\n";
+    if (nCapacity - (size_t) nLength < strlen(sClosingTag)) {
+        return RENDER_BUFFER_TOO_SMALL;
+    }
+    memcpy(pOutput + nLength, sClosingTag, strlen(sClosingTag));
+    nLength += (int) strlen(sClosingTag);
+
+    return (long) nLength;
+}
@@ -0,0 +1,294 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for libfen2svg.c, the rendering core
+ * of FEN2SVG.
+ **/
+
+#ifndef LIBFEN2SVG_H
+#define LIBFEN2SVG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>                        /* Contexts of a cache are built by any thread. */
+#include "linkedlist.h"                     /* Own work */
+#include "bytebuffer.h"                     /* Own work */
+#ifndef FEN2SVG_NO_EMBEDDED_TEMPLATE
+#include "embeddedtemplate.h"               /* Generated from template.svg */
+#endif
+
+#define BUFFER_SIZE 1024                    /* Holds strings of variable length. */
+#define TEMPLATE_ARENA_BLOCK_SIZE 65536     /* The template usually fits in one block. */
+#define SVG_TEMPLATE "template.svg"
+#define SVG_CLOSING_TAG "</svg>\n"
+#define SVG_COMPACT_CLOSING_TAG "</svg>"
+#define FEN_EXCERPT_LENGTH 81               /* Only the 81st chars of FEN are really useful:
+                                               64 fillable squares + 7 row separators +
+                                               blank space + side to move + blank space +
+                                               castling (4) + blank space + en passant (2).
+                                               Must absolutely be greater than zero. */
+#define WHITE_ON_BOTTOM true
+#define BLACK_ON_BOTTOM false
+
+/* The SVG template must ABSOLUTELY respect following conventions: */
+#define SQUARE_WIDTH 72
+#define SQUARE_HEIGHT 72
+#define BORDER_THICKNESS 1                  /* Around the chessboard */
+#define HORIZONTAL_COORDINATES_HEIGHT 48    /* Horizontal coordinates */
+#define VERTICAL_COORDINATES_WIDTH 48       /* Vertical coordinates */
+#define MOVE_INDICATOR_WIDTH 72
+/* Diagrams can be displayed at another size (the drawing is scaled, see scaleTemplate()). */
+#define MIN_SQUARE_SIZE 8                   /* Pixels per square (--size). */
+#define MAX_SQUARE_SIZE 1024
+
+#define PIECE_KINDS 12                      /* "BbKkNnPpQqRr" */
+#define SVG_LINE_MAX_LENGTH 128             /* Longest ready-made line, '\n' and '\0' included. */
+#define SPRITE_FILE_MAX_LENGTH 40           /* Sprite reference, so that lines fit. */
+#define SHEET_MARGIN 36                     /* Between diagrams of a sheet (half a square). */
+#define SHEET_CELL_MAX_LENGTH ((64+1) * SVG_LINE_MAX_LENGTH + 256)  /* Group of a diagram. */
+#define WHITE_AT_BOTTOM_INDEX 0
+#define BLACK_AT_BOTTOM_INDEX 1
+#define WHITE_TO_PLAY_INDEX 0
+#define BLACK_TO_PLAY_INDEX 1
+
+/* Position parsed from a FEN string (see ChessBoard). */
+#define FEN_PIECES "BbKkNnPpQqRr"           /* Piece index -> FEN character. */
+#define NO_PIECE -1
+#define WHITE_KINGSIDE_CASTLING 1           /* 'K' */
+#define WHITE_QUEENSIDE_CASTLING 2          /* 'Q' */
+#define BLACK_KINGSIDE_CASTLING 4           /* 'k' */
+#define BLACK_QUEENSIDE_CASTLING 8          /* 'q' */
+#define NO_EN_PASSANT -1
+
+/* Drawing options, as bits of a single number (e.g. the index of a context among all). */
+#define BORDER_OPTION 1                     /* -b */
+#define COORDINATES_OPTION 2                /* -c */
+#define MOVE_INDICATOR_OPTION 4             /* -m */
+#define ROTATE_BOARD_OPTION 8               /* -r */
+#define COMPACT_OPTION 16                   /* --compact */
+#define OPTION_COMBINATIONS 32
+
+
+/**
+ * Return codes: renderFEN() returns a number of bytes, or one of these (all negative).
+ **/
+enum RenderStatus {
+    RENDER_OK = 0,
+    RENDER_INVALID_FEN = -1,            /* See parseFEN(). */
+    RENDER_BUFFER_TOO_SMALL = -2,       /* See getMaxDiagramLength(). */
+    RENDER_TEMPLATE_NOT_FOUND = -3,
+    RENDER_INVALID_TEMPLATE = -4        /* First line not "<svg" or last line not "</svg>". */
+};
+
+/**
+ * Return codes: parseFEN() returns FEN_OK, or what is wrong with the FEN string (see
+ * describeFENStatus()).
+ **/
+enum FENStatus {
+    FEN_OK = 0,
+    FEN_UNEXPECTED_CHARACTER = -1,      /* In piece placement. */
+    FEN_RANK_TOO_LONG = -2,             /* More than 8 squares. */
+    FEN_RANK_TOO_SHORT = -3,            /* Fewer than 8 squares. */
+    FEN_WRONG_RANK_COUNT = -4,          /* Not 8 ranks. */
+    FEN_INVALID_SIDE_TO_MOVE = -5,      /* Neither "w" nor "b". */
+    FEN_INVALID_CASTLING = -6,          /* Neither "-" nor some of "KQkq", each at most once. */
+    FEN_INVALID_EN_PASSANT = -7         /* Neither "-" nor a square of rank 6 (White to move)
+                                           or 3 (Black to move). */
+};
+
+
+/**
+ * A position, as parsed once from its FEN string: every later stage (file name, empty board,
+ * pieces) reads it rather than the string.
+ * Squares go from a8 (0) to h1 (63), as in the FEN string.
+ **/
+typedef struct ChessBoard {
+    unsigned char Squares[32];          /* Two squares a byte (even one in the low nibble):
+                                           piece index + 1 (see FEN_PIECES), 0 if empty. */
+    bool WhiteToPlay;                   /* Also if side to move is missing. */
+    unsigned char Castling;             /* E.g. WHITE_KINGSIDE_CASTLING, 0 if missing. */
+    signed char EnPassant;              /* Square, NO_EN_PASSANT if "-" or missing. */
+} ChessBoard;
+
+
+/**
+ * A ready-made SVG line, stored in a slot of fixed size.
+ **/
+typedef struct SVGLine {
+    unsigned char Length;               /* '\0' excluded. */
+    char Text[SVG_LINE_MAX_LENGTH];
+} SVGLine;
+
+/**
+ * Where everything of a board is drawn, for given borders and coordinates: computed once
+ * (see computeBoardGeometry()), then read by generateEmptyBoard() and createPieceTable().
+ * <p>
+ * Locations are in template units (SQUARE_WIDTH per square, as the definitions are drawn):
+ * the square size only scales the whole drawing (see scaleTemplate()).
+ **/
+typedef struct BoardGeometry {
+    bool Border;
+    bool Coordinates;
+    int SquareSize;                     /* Displayed square size, in pixels. */
+    int Width;                          /* Whole drawing, move indicator excluded. */
+    int Height;
+    int Squares[64][2][2];              /* [square][orientation][x, y]: top-left corner. */
+    int Borders[2];                     /* [x, y] */
+    int RankCoordinates[8][2];          /* [row from top][x, y] */
+    int FileCoordinates[8][2];          /* [column from left][x, y] */
+    int MoveIndicator[2];               /* [x, y] */
+} BoardGeometry;
+
+/**
+ * Every line a piece (or the move indicator) can be drawn with, for given borders and
+ * coordinates.
+ **/
+typedef struct PieceTable {
+    SVGLine Pieces[PIECE_KINDS][64][2]; /* [piece][square][orientation] */
+    SVGLine MoveIndicators[2];          /* [side to play] */
+} PieceTable;
+
+
+
+/**
+ * Everything a diagram needs but its FEN string: SVG definitions and empty boards (joined),
+ * ready-made piece lines and options.
+ * It is set up once, then only read: it can be shared by every thread.
+ **/
+typedef struct RenderContext {
+    ByteBuffer* NormalEmptyDiagram;     /* Template and empty board, white at bottom. */
+    ByteBuffer* ReversedEmptyDiagram;   /* Template and empty board, black at bottom. */
+    PieceTable* Pieces;                 /* Ready-made lines for pieces and move indicator. */
+    BoardGeometry Geometry;             /* Where the board and pieces were laid out. */
+    bool Border;
+    bool Coordinates;
+    bool MoveIndicator;
+    bool RotateBoard;
+    bool Compact;                       /* Minified SVG. */
+    const char* ClosingTag;             /* "</svg>\n", or "</svg>" if compact. */
+} RenderContext;
+
+/**
+ * A context for every combination of options, each one built when first needed, from a
+ * template read once.
+ **/
+typedef struct RenderCache {
+    ListArena* TemplateArena;
+    LinkedList* Template;               /* As read: lengths are added to copies. */
+    bool EmbeddedTemplate;              /* Template built into the program (no file given). */
+    const char* SpriteFile;             /* Definitions referenced from it, NULL if embedded. */
+    int SquareSize;                     /* Displayed square size of every context, in pixels. */
+    RenderContext* Contexts[OPTION_COMBINATIONS];   /* Indexed by options, NULL until built. */
+    pthread_mutex_t Mutex;              /* Held while a context is built. */
+} RenderCache;
+
+/**
+ * Last diagram of a game sequence, laid out in fixed-size slots (one per square, plus the
+ * move indicator), so that the next position of the game only rewrites the squares that
+ * changed. Slots are padded with spaces: the drawing is the same as with renderFEN().
+ * <p>
+ * A frame belongs to one thread.
+ **/
+typedef struct GameFrame {
+    const RenderContext* Context;       /* Context the slots were laid out for, NULL at first. */
+    int Orientation;                    /* WHITE_AT_BOTTOM_INDEX or BLACK_AT_BOTTOM_INDEX. */
+    signed char Board[64];              /* Piece index drawn on each square, -1 if empty. */
+    int SideToPlay;                     /* Move indicator drawn, -1 if none. */
+    size_t SlotWidth;                   /* Longest line of the context (padding included). */
+    size_t SlotsOffset;                 /* Slots start after the empty diagram. */
+    ByteBuffer* Output;                 /* Empty diagram, slots and closing tag. */
+    long ChangedSquares;                /* Slots rewritten so far (statistics). */
+} GameFrame;
+
+
+/* Methods */
+int computeWholeDrawingWidth(bool bCoordinates, bool bBorder, bool bMoveIndicator);
+int computeWholeDrawingHeight(bool bCoordinates, bool bBorder);
+void computeBoardGeometry(BoardGeometry* geoBoard, bool bBorder, bool bCoordinates,
+    int nSquareSize);
+int parseFEN(const char* sFEN, size_t nFENLength, ChessBoard* brdOutput, size_t* nErrorOffset);
+const char* describeFENStatus(int nStatus);
+int getBoardPiece(const ChessBoard* brdPosition, int nSquare);
+void setBoardPiece(ChessBoard* brdPosition, int nSquare, int nPiece);
+int formatFEN(const ChessBoard* brdPosition, char* sOutput);
+int formatDecimal(unsigned int nValue, int nMinDigits, char* pOutput);
+const char* getSVGId(const char* sId, bool bCompact);
+int formatUseLine(char* sBuffer, size_t nSize, const char* sSpriteFile, const char* sId, int nX,
+    int nY, bool bCompact);
+PieceTable* createPieceTable(const BoardGeometry* geoBoard, bool bCompact,
+    const char* sSpriteFile);
+long placePieces(const PieceTable* tblPieces, const ChessBoard* brdPosition,
+    bool bMoveIndicator, bool bRotateBoard, char* pOutput, size_t nCapacity);
+bool createPieces(const PieceTable* tblPieces, const ChessBoard* brdPosition,
+    bool bMoveIndicator, bool bRotateBoard, ByteBuffer* bufPieces);
+LinkedList* readTemplate(char* sFileName, ListArena* arnArena);
+LinkedList* readTemplateStream(FILE* fInputFile, ListArena* arnArena);
+bool scaleTemplate(LinkedList lstSVGTemplate, int nWidth, int nHeight, int nSquareSize);
+bool resizeTemplate(LinkedList lstSVGTemplate, int nWidth, int nHeight);
+bool addLengthsToTemplate(LinkedList lstSVGTemplate, bool bBorder, bool bCoordinates,
+    bool bMoveIndicator);
+ByteBuffer* buildTemplateBlob(LinkedList lstSVGTemplate);
+ByteBuffer* buildSprite(LinkedList lstTemplate, bool bCompact);
+ByteBuffer* minifySVG(const ByteBuffer* bufSVG);
+ByteBuffer* generateEmptyBoard(const BoardGeometry* geoBoard, bool bWhiteAtBottom,
+    bool bCompact, const char* sSpriteFile);
+ByteBuffer* buildEmptyDiagram(ByteBuffer bufTemplate, const BoardGeometry* geoBoard,
+    bool bWhiteAtBottom, bool bCompact, const char* sSpriteFile);
+ByteBuffer* buildSizedTemplate(LinkedList lstTemplate, bool bBorder, bool bCoordinates,
+    bool bMoveIndicator, bool bCompact, int nSquareSize);
+int initRenderContextFromTemplate(RenderContext* ctxRender, LinkedList lstTemplate,
+    bool bBorder, bool bCoordinates, bool bMoveIndicator, bool bRotateBoard, bool bCompact,
+    const char* sSpriteFile, int nSquareSize);
+int initRenderContext(RenderContext* ctxRender, char* sTemplateFile, bool bBorder,
+    bool bCoordinates, bool bMoveIndicator, bool bRotateBoard, bool bCompact,
+    const char* sSpriteFile);
+#ifndef FEN2SVG_NO_EMBEDDED_TEMPLATE
+LinkedList* readEmbeddedTemplate(ListArena* arnArena);
+void initRenderContextFromEmbedded(RenderContext* ctxRender, int nOptions);
+#endif
+void freeRenderContext(RenderContext* ctxRender);
+size_t getMaxDiagramLength(const RenderContext* ctxRender);
+int combineOptions(bool bBorder, bool bCoordinates, bool bMoveIndicator, bool bRotateBoard,
+    bool bCompact);
+int getLineOptions(const char* sLine, size_t nLength, int nDefaultOptions);
+RenderCache* createRenderCache(char* sTemplateFile, const char* sSpriteFile, int* nStatus);
+RenderCache* createSizedRenderCache(char* sTemplateFile, const char* sSpriteFile,
+    int nSquareSize, int* nStatus);
+const RenderContext* getRenderContext(RenderCache* cchRender, int nOptions);
+void freeRenderCache(RenderCache** cchRender);
+const ByteBuffer* getEmptyDiagram(const RenderContext* ctxRender,
+    const ChessBoard* brdPosition);
+long renderBoard(const RenderContext* ctxRender, const ChessBoard* brdPosition, char* pOutput,
+    size_t nCapacity);
+long renderFEN(const RenderContext* ctxRender, const char* sFEN, size_t nFENLength,
+    char* pOutput, size_t nCapacity);
+GameFrame* createGameFrame(void);
+long renderGameFrame(GameFrame* frmGame, const RenderContext* ctxRender,
+    const ChessBoard* brdPosition);
+void freeGameFrame(GameFrame** frmGame);
+ByteBuffer* buildSheetHeader(const RenderCache* cchRender, const RenderContext* ctxRender,
+    int nColumns, int nRows);
+long renderSheetCell(const RenderContext* ctxRender, const ChessBoard* brdPosition, int nCell,
+    int nColumns, char* pOutput, size_t nCapacity);
+
+#endif
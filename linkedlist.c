@@ -29,6 +29,81 @@
 #include<string.h>  /* strlen(), strcpy() */
 #include "linkedlist.h"
 
+#define ARENA_ALIGNMENT sizeof(void*)       /* ListItem only holds pointers. */
+
+
+/* Round a size up to the arena alignment. */
+static size_t alignArenaSize(size_t nSize) {
+    return (nSize + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+
+/* Add a block of at least nSize bytes after the current one. */
+static ListArenaBlock* addArenaBlock(ListArena* arnArena, size_t nSize) {
+
+    ListArenaBlock* blkNew = (ListArenaBlock*) malloc(1 * sizeof(ListArenaBlock));
+    if (!blkNew) {
+        printf("Unsuccessful malloc() in addArenaBlock(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*blkNew).Size = nSize > (*arnArena).BlockSize ? nSize : (*arnArena).BlockSize;
+    (*blkNew).Data = (char*) malloc((*blkNew).Size);
+    if (!(*blkNew).Data) {
+        printf("Unsuccessful malloc() in addArenaBlock(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*blkNew).Used = 0;
+
+    /* Insert it right after the current block, so that kept blocks stay reachable. */
+    if ((*arnArena).Current) {
+        (*blkNew).Next = (*(*arnArena).Current).Next;
+        (*(*arnArena).Current).Next = blkNew;
+    }
+    else {
+        (*blkNew).Next = NULL;
+        (*arnArena).First = blkNew;
+    }
+    (*arnArena).Current = blkNew;
+
+    return blkNew;
+}
+
+
+/* Hand out nSize bytes: most of the time, a mere pointer increment. */
+static void* allocateFromArena(ListArena* arnArena, size_t nSize) {
+
+    ListArenaBlock* blkCurrent = (*arnArena).Current;
+    nSize = alignArenaSize(nSize);
+
+    /* Reuse the blocks kept by a reset before adding new ones. */
+    while (blkCurrent && (*blkCurrent).Used + nSize > (*blkCurrent).Size) {
+        blkCurrent = (*blkCurrent).Next;
+        if (blkCurrent) {
+            (*blkCurrent).Used = 0;
+            (*arnArena).Current = blkCurrent;
+        }
+    }
+    if (!blkCurrent) {
+        blkCurrent = addArenaBlock(arnArena, nSize);
+    }
+
+    void* pReturnValue = (*blkCurrent).Data + (*blkCurrent).Used;
+    (*blkCurrent).Used += nSize;
+
+    return pReturnValue;
+}
+
+
+/* Copy a string into the arena. */
+static char* copyStringToArena(ListArena* arnArena, const char* sValue) {
+
+    size_t nLength = strlen(sValue);
+    char* sReturnValue = (char*) allocateFromArena(arnArena, nLength+1);
+    memcpy(sReturnValue, sValue, nLength+1);
+
+    return sReturnValue;
+}
+
 
 LinkedList* createEmptyList(void) {
     
@@ -41,26 +116,33 @@ LinkedList* createEmptyList(void) {
 
     (*lstList).First = NULL;
     (*lstList).Last = NULL;
+    (*lstList).Arena = NULL;
 
     return lstList;
 }
 
 
 /* Parameter itmFirstItem is not really needed. */
-void appendToList(LinkedList* lstList, char* sValue) {
+void appendToList(LinkedList* lstList, const char* sValue) {
     ListItem* itmNew;
 
-    /* CREATE ITEM */
-    itmNew = (ListItem*) malloc(1 * sizeof(ListItem));
-    if (itmNew == NULL) {
-        exit(EXIT_FAILURE);
+    /* CREATE ITEM (from the arena, if any: no malloc() at all) */
+    if ((*lstList).Arena) {
+        itmNew = (ListItem*) allocateFromArena((*lstList).Arena, sizeof(ListItem));
+        itmNew->Value = copyStringToArena((*lstList).Arena, sValue);
     }
-    /* Copy string value. */
-    itmNew->Value = (char*) malloc((strlen(sValue)+1)*sizeof(char));
-    if (!(itmNew->Value)) {
-        exit(EXIT_FAILURE); /* Memory allocation failed. */
+    else {
+        itmNew = (ListItem*) malloc(1 * sizeof(ListItem));
+        if (itmNew == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        /* Copy string value. */
+        itmNew->Value = (char*) malloc((strlen(sValue)+1)*sizeof(char));
+        if (!(itmNew->Value)) {
+            exit(EXIT_FAILURE); /* Memory allocation failed. */
+        }
+        strcpy(itmNew->Value, sValue);
     }
-    strcpy(itmNew->Value, sValue);
     /* Set next item. */
     itmNew->Next = NULL;
 
@@ -96,6 +178,24 @@ void modifyItemValue(ListItem* itmCurrent, char* sValue) {
     strcpy(itmCurrent->Value, sValue);
 }
 
+/* Same as modifyItemValue(), but also valid for items of an arena-backed list. */
+void modifyListItemValue(LinkedList* lstList, ListItem* itmCurrent, char* sValue) {
+
+    /* Did we received a NULL pointer? */
+    if (!itmCurrent) {
+        exit(EXIT_FAILURE);
+    }
+
+    if ((*lstList).Arena) {
+        /* Previous string stays in the arena until it is reset. */
+        itmCurrent->Value = copyStringToArena((*lstList).Arena, sValue);
+    }
+    else {
+        modifyItemValue(itmCurrent, sValue);
+    }
+}
+
+
 void displayList(LinkedList lstList) {
     
     ListItem* itmCurrent = lstList.First;
@@ -131,6 +231,14 @@ void freeList(LinkedList** lstList) {
     ListItem* itmCurrent;
     ListItem* itmStoreNext;
 
+    /* Items of an arena-backed list (and the list itself) are released with the arena. */
+    if ((**lstList).Arena) {
+        (**lstList).First = NULL;
+        (**lstList).Last = NULL;
+        *lstList = NULL;
+        return;
+    }
+
     itmCurrent = (**lstList).First;
     while (itmCurrent) {
         itmStoreNext = itmCurrent->Next;    /* Store next address, before it is unreachable. */
@@ -150,3 +258,58 @@ void freeList(LinkedList** lstList) {
 
     free(*lstList);                         /* Free list "entrance". */
 }
+
+
+ListArena* createListArena(size_t nBlockSize) {
+
+    ListArena* arnArena = (ListArena*) malloc(1 * sizeof(ListArena));
+    if (!arnArena) {
+        printf("Unsuccessful malloc() in createListArena(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*arnArena).First = NULL;
+    (*arnArena).Current = NULL;
+    (*arnArena).BlockSize = nBlockSize > 0 ? nBlockSize : 1;
+
+    return arnArena;
+}
+
+
+LinkedList* createArenaList(ListArena* arnArena) {
+
+    LinkedList* lstList = (LinkedList*) allocateFromArena(arnArena, sizeof(LinkedList));
+
+    (*lstList).First = NULL;
+    (*lstList).Last = NULL;
+    (*lstList).Arena = arnArena;
+
+    return lstList;
+}
+
+
+/* Every list of the arena becomes invalid, while its blocks are kept for reuse. */
+void resetListArena(ListArena* arnArena) {
+
+    (*arnArena).Current = (*arnArena).First;
+    if ((*arnArena).Current) {
+        (*(*arnArena).Current).Used = 0;
+    }
+}
+
+
+void freeListArena(ListArena** arnArena) {
+    ListArenaBlock* blkCurrent;
+    ListArenaBlock* blkStoreNext;
+
+    blkCurrent = (**arnArena).First;
+    while (blkCurrent) {
+        blkStoreNext = (*blkCurrent).Next;
+        free((*blkCurrent).Data);
+        free(blkCurrent);
+        blkCurrent = blkStoreNext;
+    }
+
+    free(*arnArena);
+    *arnArena = NULL;
+}
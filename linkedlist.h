@@ -23,21 +23,46 @@
  **/
 
 
+#include <stddef.h>                         /* size_t */
+
+
 /* Variables */
 typedef struct ListItem {
    char* Value;
    struct ListItem* Next;
 } ListItem;
 
+typedef struct ListArenaBlock {
+   struct ListArenaBlock* Next;
+   size_t Size;            /* Bytes available in Data. */
+   size_t Used;            /* Bytes already handed out. */
+   char* Data;
+} ListArenaBlock;
+
+typedef struct ListArena {
+   ListArenaBlock* First;  /* Blocks are kept from one reset to the next. */
+   ListArenaBlock* Current;
+   size_t BlockSize;       /* Size of every new block (bigger requests get their own). */
+} ListArena;
+
 typedef struct LinkedList {
    ListItem* First;        /* Browsing the list begins here. */
    ListItem* Last;         /* Adding items occurs faster. */
+   ListArena* Arena;       /* NULL: items are malloc()'d and free()'d one by one. */
 } LinkedList;
 
 /* Methods */
 LinkedList* createEmptyList(void);
-void appendToList(LinkedList* lstList, char* sValue);
+void appendToList(LinkedList* lstList, const char* sValue);
 void modifyItemValue(ListItem* itmCurrent, char* sValue);
-void displayList(LinkedList lstList);
+void modifyListItemValue(LinkedList* lstList, ListItem* itmCurrent, char* sValue);
+void displayList(LinkedList lstList);
 LinkedList* copyList(LinkedList lstSource);
-void freeList(LinkedList** lstList);
+void freeList(LinkedList** lstList);
+
+/* Arena-backed lists: items and strings are carved out of large blocks, and released all
+ * at once by resetListArena() or freeListArena(). */
+ListArena* createListArena(size_t nBlockSize);
+LinkedList* createArenaList(ListArena* arnArena);
+void resetListArena(ListArena* arnArena);
+void freeListArena(ListArena** arnArena);
@@ -0,0 +1,192 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Timing gate of FEN2SVG over a seeded corpus: every FEN file is scaled up to the same
+ * number of lines, then converted end to end (read, parsed, drawn and written as an archive
+ * to /dev/null, see readFENFile()), and its time per line is compared with that of the
+ * first file, the reference (e.g. lucas.fen). The gate fails if a file is more than a given
+ * factor slower per line: malformed, oversize or worst-case lines must not cost much more
+ * than ordinary ones. A floor of lines per second can be given too, for a known machine.
+ * <p>
+ * Run by "make perftest" (after the corpus is replayed by the fuzz targets, see fuzz.c).
+ * Usage: fen2svg_perftest [-n lines] [-s slowdown] [-m lines/s] reference.fen file(s)
+ * (the template is built into it; error messages about the lines are discarded).
+ * It compiles fen2svg.c with FEN2SVG_NO_MAIN:
+ * gcc -O2 -pthread -DFEN2SVG_NO_MAIN perftest.c fen2svg.c libfen2svg.c embeddedtemplate.c linkedlist.c bytebuffer.c diagramoutput.c diagramserver.c diagramcompressor.c svgraster.c diagramraster.c stringset.c pgnreader.c pipelinestats.c asyncwriter.c -lz -lm -o fen2svg_perftest
+ **/
+
+
+#include <time.h>                           /* clock_gettime() */
+#include <getopt.h>
+#include "fen2svg.h"                        /* Own work */
+
+
+#define PERFTEST_DEFAULT_LINES 200000       /* Lines converted per file. */
+#define PERFTEST_DEFAULT_SLOWDOWN 4.0       /* Times slower per line than the reference. */
+
+
+/** Self-explanatory. **/
+static double getSeconds(void) {
+
+    struct timespec tmsNow;
+    clock_gettime(CLOCK_MONOTONIC, &tmsNow);
+    return tmsNow.tv_sec + tmsNow.tv_nsec / 1e9;
+}
+
+
+/**
+ * Write the lines of a FEN file over and over to a new temporary file, until it holds at
+ * least nLines positions (blank lines are not counted, see countFENLines()).
+ *
+ * @param   sScaledFile     receives the name of the file (at least "/tmp/fen2svg_perfXXXXXX")
+ * @return  number of positions written, 0 on error (or if the file holds none)
+ **/
+static long writeScaledFile(const char* sFileName, char* sScaledFile, long nLines) {
+
+    /* READ SOURCE FILE */
+    FILE* fInputFile = fopen(sFileName, "rb");
+    if (fInputFile == NULL) {
+        printf("Error: cannot open input file (%s).\n", sFileName);
+        return 0;
+    }
+    ByteBuffer* bufSource = createEmptyBuffer();
+    char sBuffer[BUFFER_SIZE];
+    size_t nRead;
+    while ((nRead = fread(sBuffer, 1, BUFFER_SIZE, fInputFile)) > 0) {
+        appendToBuffer(bufSource, sBuffer, nRead);
+    }
+    fclose(fInputFile);
+    if ((*bufSource).Length > 0 && (*bufSource).Data[(*bufSource).Length - 1] != '\n') {
+        appendToBuffer(bufSource, "\n", 1);
+    }
+    long nSourceLines = countFENLines((*bufSource).Data, (*bufSource).Length);
+    if (nSourceLines == 0) {
+        printf("Error: no position in input file (%s).\n", sFileName);
+        freeBuffer(&bufSource);
+        return 0;
+    }
+
+    /* WRITE IT AGAIN AND AGAIN */
+    strcpy(sScaledFile, "/tmp/fen2svg_perfXXXXXX");
+    int nDescriptor = mkstemp(sScaledFile);
+    if (nDescriptor < 0) {
+        printf("Error: cannot write scaled input file.\n");
+        freeBuffer(&bufSource);
+        return 0;
+    }
+    FILE* fOutputFile = fdopen(nDescriptor, "wb");
+    long nWritten = 0;
+    while (nWritten < nLines) {
+        fwrite((*bufSource).Data, 1, (*bufSource).Length, fOutputFile);
+        nWritten += nSourceLines;
+    }
+    freeBuffer(&bufSource);
+    if (fclose(fOutputFile) != 0) {
+        printf("Error: cannot write scaled input file.\n");
+        remove(sScaledFile);
+        return 0;
+    }
+
+    return nWritten;
+}
+
+
+/**
+ * Convert every file, then compare their times per line with the reference.
+ **/
+int main(int argc, char* argv[]) {
+
+    /* 1 - ARGUMENTS */
+    long nLines = PERFTEST_DEFAULT_LINES;
+    double nMaxSlowdown = PERFTEST_DEFAULT_SLOWDOWN;
+    double nMinRate = 0;                    /* 0: no floor. */
+    int c;
+    while ((c = getopt(argc, argv, "n:s:m:")) != -1) {
+        switch (c) {
+            case 'n':
+                nLines = atol(optarg);
+                break;
+            case 's':
+                nMaxSlowdown = atof(optarg);
+                break;
+            case 'm':
+                nMinRate = atof(optarg);
+                break;
+            default:
+                nLines = 0;
+        }
+    }
+    if (nLines < 1 || nMaxSlowdown <= 0 || nMinRate < 0 || optind >= argc) {
+        printf("Usage: %s [-n lines] [-s slowdown] [-m lines/s] reference.fen file(s)\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    DiagramWriter wrtDiagram;
+    if (!setUpDiagramWriter(&wrtDiagram, NULL, false, false, false, false, false, false,
+        NULL, SQUARE_WIDTH)) {
+        return EXIT_FAILURE;
+    }
+    /* Messages about invalid lines are part of the cost, not of the report. */
+    if (!freopen("/dev/null", "w", stderr)) {
+        printf("Error: cannot discard error messages.\n");
+        return EXIT_FAILURE;
+    }
+    setvbuf(stderr, NULL, _IOFBF, BUFSIZ);
+
+    /* 2 - ONE END TO END RUN PER FILE */
+    double nReferenceTime = 0;              /* Seconds per line of the first file. */
+    bool bPassed = true;
+    for (int nFile = optind; nFile < argc; nFile++) {
+        char sScaledFile[FILE_NAME_MAX_SIZE];
+        long nWritten = writeScaledFile(argv[nFile], sScaledFile, nLines);
+        if (nWritten == 0) {
+            tearDownDiagramWriter(&wrtDiagram);
+            return EXIT_FAILURE;
+        }
+        wrtDiagram.DiagramNumber = 1;
+        wrtDiagram.Output = openDiagramOutput(TAR_OUTPUT, "/dev/null", 1, false, false);
+        double nStart = getSeconds();
+        readFENFile(sScaledFile, &wrtDiagram);
+        closeDiagramOutput(&wrtDiagram.Output);
+        double nSeconds = getSeconds() - nStart;
+        remove(sScaledFile);
+
+        /* TIME PER LINE AGAINST THE REFERENCE AND THE FLOOR */
+        double nLineTime = nSeconds / nWritten;
+        if (nFile == optind) {
+            nReferenceTime = nLineTime;
+        }
+        double nSlowdown = nLineTime / nReferenceTime;
+        bool bFileFailed = nSlowdown > nMaxSlowdown
+            || (nMinRate > 0 && 1 / nLineTime < nMinRate);
+        printf("%-32s %9ld lines in %7.3f s  %10.0f /s  %6.2fx  %s\n", argv[nFile], nWritten,
+            nSeconds, nWritten / nSeconds, nSlowdown, bFileFailed ? "FAILED" : "ok");
+        bPassed = bPassed && !bFileFailed;
+    }
+
+    /* 3 - FREE MEMORY */
+    tearDownDiagramWriter(&wrtDiagram);
+    printf("Performance gate %s (at most %.2fx the reference per line%s).\n",
+        bPassed ? "passed" : "FAILED", nMaxSlowdown, nMinRate > 0 ? ", and a floor" : "");
+
+    return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,744 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * PGN reader of FEN2SVG: games are replayed move after move (SAN, as in the PGN standard),
+ * from the starting position or from their FEN tag, and the selected positions (see
+ * PositionSelection) are written down as FEN lines, to be read as any FEN file.
+ * <p>
+ * Games do not depend on one another: a file is split into chunks at game boundaries
+ * (see findNextGame()), so that each chunk can be parsed by its own thread.
+ **/
+
+#include "pgnreader.h"                      /* Own work */
+
+
+/* Kinds of pieces, in the order of FEN_PIECES: a white piece is 2 * kind, a black one
+ * 2 * kind + 1. */
+enum PieceKind { BISHOP, KING, KNIGHT, PAWN, QUEEN, ROOK };
+
+/* Steps, as (file, row) moves: rows go from rank 8 (0) to rank 1 (7), as squares do. */
+static const int anKnightSteps[8][2] = {
+    { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 }
+};
+static const int anKingSteps[8][2] = {
+    { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+};
+
+
+/**
+ * A game being replayed. Squares are kept one a byte, rather than as nibbles (see
+ * ChessBoard), since moves read and write them many times.
+ **/
+typedef struct GameState {
+    signed char Squares[64];            /* Piece index (see FEN_PIECES), NO_PIECE if empty. */
+    bool WhiteToPlay;
+    unsigned char Castling;             /* E.g. WHITE_KINGSIDE_CASTLING. */
+    signed char EnPassant;              /* Square, NO_EN_PASSANT if none. */
+    int Ply;                            /* Half-moves played so far. */
+    bool MovesStarted;                  /* Movetext reached: tags are over. */
+    bool Broken;                        /* Illegal move or FEN tag: the rest is skipped. */
+} GameState;
+
+
+/** Piece of a kind and colour (index in FEN_PIECES). **/
+static int makePiece(int nKind, bool bWhite) {
+
+    return 2 * nKind + (bWhite ? 0 : 1);
+}
+
+
+/** Square at a file and row, -1 if off the board. **/
+static int getSquare(int nFile, int nRow) {
+
+    if (nFile < 0 || nFile > 7 || nRow < 0 || nRow > 7) {
+        return -1;
+    }
+
+    return nRow * 8 + nFile;
+}
+
+
+/** Set a game to a position (in its turn parsed from a FEN string). **/
+static void loadGameBoard(GameState* gamCurrent, const ChessBoard* brdPosition) {
+
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        (*gamCurrent).Squares[nSquare] = (signed char) getBoardPiece(brdPosition, nSquare);
+    }
+    (*gamCurrent).WhiteToPlay = (*brdPosition).WhiteToPlay;
+    (*gamCurrent).Castling = (*brdPosition).Castling;
+    (*gamCurrent).EnPassant = (*brdPosition).EnPassant;
+}
+
+
+/** New game, from the usual starting position (a FEN tag may replace it). **/
+static void startGame(GameState* gamCurrent) {
+
+    ChessBoard brdStart;
+    parseFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 52, &brdStart, NULL);
+    loadGameBoard(gamCurrent, &brdStart);
+    (*gamCurrent).Ply = 0;
+    (*gamCurrent).MovesStarted = false;
+    (*gamCurrent).Broken = false;
+}
+
+
+/** Is a square attacked by a side (whatever is on it)? **/
+static bool isAttacked(const GameState* gamCurrent, int nSquare, bool bByWhite) {
+
+    int nFile = nSquare % 8;
+    int nRow = nSquare / 8;
+    const signed char* acSquares = (*gamCurrent).Squares;
+
+    /* PAWNS (a white one attacks the row above it) */
+    int nPawnRow = bByWhite ? nRow + 1 : nRow - 1;
+    for (int nSide = -1; nSide <= 1; nSide += 2) {
+        int nFrom = getSquare(nFile + nSide, nPawnRow);
+        if (nFrom >= 0 && acSquares[nFrom] == makePiece(PAWN, bByWhite)) {
+            return true;
+        }
+    }
+
+    /* KNIGHTS AND KING */
+    for (int nStep = 0; nStep < 8; nStep++) {
+        int nFrom = getSquare(nFile + anKnightSteps[nStep][0], nRow + anKnightSteps[nStep][1]);
+        if (nFrom >= 0 && acSquares[nFrom] == makePiece(KNIGHT, bByWhite)) {
+            return true;
+        }
+        nFrom = getSquare(nFile + anKingSteps[nStep][0], nRow + anKingSteps[nStep][1]);
+        if (nFrom >= 0 && acSquares[nFrom] == makePiece(KING, bByWhite)) {
+            return true;
+        }
+    }
+
+    /* SLIDING PIECES (king steps give the 8 rays: even ones straight, odd ones diagonal) */
+    for (int nRay = 0; nRay < 8; nRay++) {
+        int nSlider = (nRay % 2 == 0) ? ROOK : BISHOP;
+        int nFrom = nSquare;
+        do {
+            nFrom = getSquare(nFrom % 8 + anKingSteps[nRay][0], nFrom / 8 + anKingSteps[nRay][1]);
+        } while (nFrom >= 0 && acSquares[nFrom] == NO_PIECE);
+        if (nFrom >= 0 && (acSquares[nFrom] == makePiece(nSlider, bByWhite)
+            || acSquares[nFrom] == makePiece(QUEEN, bByWhite))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/** Are the squares strictly between two squares of a line empty? **/
+static bool isPathClear(const GameState* gamCurrent, int nFrom, int nTo) {
+
+    int nFileStep = (nTo % 8 > nFrom % 8) - (nTo % 8 < nFrom % 8);
+    int nRowStep = (nTo / 8 > nFrom / 8) - (nTo / 8 < nFrom / 8);
+    for (int nSquare = getSquare(nFrom % 8 + nFileStep, nFrom / 8 + nRowStep); nSquare != nTo;
+        nSquare = getSquare(nSquare % 8 + nFileStep, nSquare / 8 + nRowStep)) {
+        if ((*gamCurrent).Squares[nSquare] != NO_PIECE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Can a piece of the side to play go from one square to another (its own king may then be
+ * in check: see isLegalMove())?
+ **/
+static bool canReach(const GameState* gamCurrent, int nKind, int nFrom, int nTo) {
+
+    int nFileDistance = abs(nTo % 8 - nFrom % 8);
+    int nRowDistance = abs(nTo / 8 - nFrom / 8);
+    bool bWhite = (*gamCurrent).WhiteToPlay;
+    int nTarget = (*gamCurrent).Squares[nTo];
+
+    if (nTarget != NO_PIECE && (nTarget % 2 == 0) == bWhite) {
+        return false;
+    }
+    switch (nKind) {
+        case KNIGHT:
+            return nFileDistance * nRowDistance == 2;
+        case KING:
+            return nFileDistance <= 1 && nRowDistance <= 1;
+        case ROOK:
+            return (nFileDistance == 0 || nRowDistance == 0) && isPathClear(gamCurrent, nFrom, nTo);
+        case BISHOP:
+            return nFileDistance == nRowDistance && isPathClear(gamCurrent, nFrom, nTo);
+        case QUEEN:
+            return (nFileDistance == 0 || nRowDistance == 0 || nFileDistance == nRowDistance)
+                && isPathClear(gamCurrent, nFrom, nTo);
+        default:
+            break;
+    }
+
+    /* PAWN: forward to an empty square (two from its starting row), or capture diagonally. */
+    int nForward = bWhite ? -1 : 1;
+    if (nTo % 8 == nFrom % 8) {
+        if (nTarget != NO_PIECE) {
+            return false;
+        }
+        if (nTo / 8 - nFrom / 8 == nForward) {
+            return true;
+        }
+        return nTo / 8 - nFrom / 8 == 2 * nForward && nFrom / 8 == (bWhite ? 6 : 1)
+            && (*gamCurrent).Squares[nFrom + 8 * nForward] == NO_PIECE;
+    }
+
+    return nFileDistance == 1 && nTo / 8 - nFrom / 8 == nForward
+        && (nTarget != NO_PIECE || nTo == (*gamCurrent).EnPassant);
+}
+
+
+/**
+ * Play a move already known to be possible (see canReach()): captures (en passant too),
+ * promotion, castling rights, en passant square and side to play are updated.
+ *
+ * @param   nPromotion      kind of the promoted piece, -1 if none (a pawn reaching the
+ *                          last row becomes a queen)
+ **/
+static void playPieceMove(GameState* gamCurrent, int nFrom, int nTo, int nPromotion) {
+
+    bool bWhite = (*gamCurrent).WhiteToPlay;
+    int nPiece = (*gamCurrent).Squares[nFrom];
+    int nKind = nPiece / 2;
+
+    /* EN PASSANT CAPTURE (the captured pawn is beside the pawn, not on its target) */
+    if (nKind == PAWN && nTo == (*gamCurrent).EnPassant && nTo % 8 != nFrom % 8) {
+        (*gamCurrent).Squares[nTo + (bWhite ? 8 : -8)] = NO_PIECE;
+    }
+
+    /* MOVE, OR PROMOTE */
+    if (nKind == PAWN && (nTo / 8 == 0 || nTo / 8 == 7)) {
+        nPiece = makePiece(nPromotion >= 0 ? nPromotion : QUEEN, bWhite);
+    }
+    (*gamCurrent).Squares[nTo] = (signed char) nPiece;
+    (*gamCurrent).Squares[nFrom] = NO_PIECE;
+
+    /* CASTLING RIGHTS (king moved, or a rook left or was taken on its corner) */
+    if (nKind == KING) {
+        (*gamCurrent).Castling &= bWhite ?
+            ~(WHITE_KINGSIDE_CASTLING | WHITE_QUEENSIDE_CASTLING) :
+            ~(BLACK_KINGSIDE_CASTLING | BLACK_QUEENSIDE_CASTLING);
+    }
+    for (int nSquare = nFrom; ; nSquare = nTo) {
+        if (nSquare == 63) {
+            (*gamCurrent).Castling &= ~WHITE_KINGSIDE_CASTLING;
+        }
+        else if (nSquare == 56) {
+            (*gamCurrent).Castling &= ~WHITE_QUEENSIDE_CASTLING;
+        }
+        else if (nSquare == 7) {
+            (*gamCurrent).Castling &= ~BLACK_KINGSIDE_CASTLING;
+        }
+        else if (nSquare == 0) {
+            (*gamCurrent).Castling &= ~BLACK_QUEENSIDE_CASTLING;
+        }
+        if (nSquare == nTo) {
+            break;
+        }
+    }
+
+    /* EN PASSANT SQUARE, IF A PAWN MOVED TWO SQUARES */
+    (*gamCurrent).EnPassant = (nKind == PAWN && abs(nTo - nFrom) == 16) ?
+        (signed char) ((nFrom + nTo) / 2) : NO_EN_PASSANT;
+
+    (*gamCurrent).WhiteToPlay = !bWhite;
+    (*gamCurrent).Ply++;
+}
+
+
+/** Does a move leave the king of the side playing it out of check? **/
+static bool isLegalMove(const GameState* gamCurrent, int nFrom, int nTo) {
+
+    GameState gamAfter = *gamCurrent;
+    playPieceMove(&gamAfter, nFrom, nTo, -1);
+
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        if (gamAfter.Squares[nSquare] == makePiece(KING, (*gamCurrent).WhiteToPlay)) {
+            return !isAttacked(&gamAfter, nSquare, gamAfter.WhiteToPlay);
+        }
+    }
+
+    return true;                        /* No king (e.g. a study): anything goes. */
+}
+
+
+/**
+ * Castle, if the king and the rook are on their squares, with nothing between them, and the
+ * king neither is in check nor goes through an attacked square. The castling field itself
+ * is not required (FEN tags often leave it out).
+ **/
+static bool castle(GameState* gamCurrent, bool bKingside) {
+
+    bool bWhite = (*gamCurrent).WhiteToPlay;
+    int nRow = bWhite ? 7 : 0;
+    int nKingFrom = getSquare(4, nRow);
+    int nKingTo = getSquare(bKingside ? 6 : 2, nRow);
+    int nRookFrom = getSquare(bKingside ? 7 : 0, nRow);
+    int nRookTo = getSquare(bKingside ? 5 : 3, nRow);
+
+    if ((*gamCurrent).Squares[nKingFrom] != makePiece(KING, bWhite)
+        || (*gamCurrent).Squares[nRookFrom] != makePiece(ROOK, bWhite)
+        || !isPathClear(gamCurrent, nKingFrom, nRookFrom)
+        || isAttacked(gamCurrent, nKingFrom, !bWhite) || isAttacked(gamCurrent, nRookTo, !bWhite)
+        || isAttacked(gamCurrent, nKingTo, !bWhite)) {
+        return false;
+    }
+
+    (*gamCurrent).Squares[nKingFrom] = NO_PIECE;
+    (*gamCurrent).Squares[nRookFrom] = NO_PIECE;
+    (*gamCurrent).Squares[nKingTo] = (signed char) makePiece(KING, bWhite);
+    (*gamCurrent).Squares[nRookTo] = (signed char) makePiece(ROOK, bWhite);
+    (*gamCurrent).Castling &= bWhite ? ~(WHITE_KINGSIDE_CASTLING | WHITE_QUEENSIDE_CASTLING) :
+        ~(BLACK_KINGSIDE_CASTLING | BLACK_QUEENSIDE_CASTLING);
+    (*gamCurrent).EnPassant = NO_EN_PASSANT;
+    (*gamCurrent).WhiteToPlay = !bWhite;
+    (*gamCurrent).Ply++;
+
+    return true;
+}
+
+
+/**
+ * Play a move given in SAN (e.g. "Nbxd7+", "exd6", "e8=Q", "O-O-O"; long algebraic
+ * notation, as "Ng1-f3", is read too).
+ *
+ * @param   sMove           the move, move number removed (need not be '\0' terminated)
+ * @param   nLength         length of sMove
+ * @return  false if the move is malformed, impossible or ambiguous (nothing is played)
+ **/
+static bool playSANMove(GameState* gamCurrent, const char* sMove, size_t nLength) {
+
+    /* CHECK, MATE AND ANNOTATIONS ARE NOT NEEDED. */
+    while (nLength > 0 && strchr("+#!?", sMove[nLength-1])) {
+        nLength--;
+    }
+
+    /* CASTLING */
+    if ((nLength == 3 || nLength == 5) && (strncmp(sMove, "O-O-O", nLength) == 0
+        || strncmp(sMove, "0-0-0", nLength) == 0)) {
+        return castle(gamCurrent, nLength == 3);
+    }
+
+    /* PIECE, PROMOTION AND TARGET SQUARE */
+    size_t nPos = 0;
+    int nKind = PAWN;
+    const char* pKind = (nLength > 0) ? memchr("BKNPQR", sMove[0], 6) : NULL;
+    if (pKind) {
+        nKind = (int) (pKind - "BKNPQR");
+        nPos++;
+    }
+    int nPromotion = -1;
+    const char* pPromotion = (nKind == PAWN && nLength > 0) ?
+        memchr("BNQR", sMove[nLength-1], 4) : NULL;
+    if (pPromotion) {
+        nPromotion = (int) (strchr("BKNPQR", *pPromotion) - "BKNPQR");
+        nLength -= (nLength > 1 && sMove[nLength-2] == '=') ? 2 : 1;
+    }
+    if (nLength < nPos + 2 || sMove[nLength-2] < 'a' || sMove[nLength-2] > 'h'
+        || sMove[nLength-1] < '1' || sMove[nLength-1] > '8') {
+        return false;
+    }
+    int nTo = getSquare(sMove[nLength-2] - 'a', '8' - sMove[nLength-1]);
+    if (nPromotion >= 0 && nTo / 8 != ((*gamCurrent).WhiteToPlay ? 0 : 7)) {
+        return false;
+    }
+
+    /* DISAMBIGUATION (file, rank or both), CAPTURE SIGN */
+    int nFromFile = -1;
+    int nFromRow = -1;
+    for (; nPos < nLength - 2; nPos++) {
+        if (sMove[nPos] >= 'a' && sMove[nPos] <= 'h') {
+            nFromFile = sMove[nPos] - 'a';
+        }
+        else if (sMove[nPos] >= '1' && sMove[nPos] <= '8') {
+            nFromRow = '8' - sMove[nPos];
+        }
+        else if (!strchr("x:-", sMove[nPos])) {
+            return false;
+        }
+    }
+
+    /* PIECE THAT CAN GO THERE (if several can, the one whose move is legal) */
+    int nPiece = makePiece(nKind, (*gamCurrent).WhiteToPlay);
+    int nCandidates = 0;
+    int nFrom = -1;
+    for (int nPass = 0; nPass < 2 && nCandidates != 1; nPass++) {
+        nCandidates = 0;
+        for (int nSquare = 0; nSquare < 64; nSquare++) {
+            if ((*gamCurrent).Squares[nSquare] == nPiece
+                && (nFromFile < 0 || nSquare % 8 == nFromFile)
+                && (nFromRow < 0 || nSquare / 8 == nFromRow)
+                && canReach(gamCurrent, nKind, nSquare, nTo)
+                && (nPass == 0 || isLegalMove(gamCurrent, nSquare, nTo))) {
+                nFrom = nSquare;
+                nCandidates++;
+            }
+        }
+        if (nCandidates == 0) {
+            return false;
+        }
+    }
+    if (nCandidates != 1) {
+        return false;
+    }
+
+    playPieceMove(gamCurrent, nFrom, nTo, nPromotion);
+
+    return true;
+}
+
+
+/** Append the current position of a game to the FEN lines. **/
+static void writeGamePosition(const GameState* gamCurrent, ByteBuffer* bufPositions) {
+
+    ChessBoard brdPosition;
+    memset(&brdPosition, 0, sizeof(brdPosition));
+    for (int nSquare = 0; nSquare < 64; nSquare++) {
+        setBoardPiece(&brdPosition, nSquare, (*gamCurrent).Squares[nSquare]);
+    }
+    brdPosition.WhiteToPlay = (*gamCurrent).WhiteToPlay;
+    brdPosition.Castling = (*gamCurrent).Castling;
+    brdPosition.EnPassant = (*gamCurrent).EnPassant;
+
+    char sFEN[FEN_EXCERPT_LENGTH+2];
+    int nLength = formatFEN(&brdPosition, sFEN);
+    sFEN[nLength++] = '\n';
+    appendToBuffer(bufPositions, sFEN, (size_t) nLength);
+}
+
+
+/** Is the current position of a game selected, now that it has moved (or started)? **/
+static bool isPositionSelected(const GameState* gamCurrent, const PositionSelection* selPositions) {
+
+    if ((*gamCurrent).Broken) {
+        return false;
+    }
+    if ((*selPositions).Mode == POSITION_AT_PLY) {
+        return (*gamCurrent).Ply == (*selPositions).Plies;
+    }
+    if ((*selPositions).Mode == EVERY_NTH_PLY) {
+        return (*gamCurrent).Ply % (*selPositions).Plies == 0;
+    }
+
+    return false;
+}
+
+
+/** Tags are over: the starting position is written down if selected. **/
+static void startMoves(GameState* gamCurrent, const PositionSelection* selPositions,
+    ByteBuffer* bufPositions) {
+
+    (*gamCurrent).MovesStarted = true;
+    if (isPositionSelected(gamCurrent, selPositions)) {
+        writeGamePosition(gamCurrent, bufPositions);
+    }
+}
+
+
+/** The game is over: its final position is written down if selected. **/
+static void finishGame(GameState* gamCurrent, const PositionSelection* selPositions,
+    ByteBuffer* bufPositions) {
+
+    if (!(*gamCurrent).MovesStarted) {
+        startMoves(gamCurrent, selPositions, bufPositions);
+    }
+    if ((*selPositions).Mode == FINAL_POSITION && !(*gamCurrent).Broken) {
+        writeGamePosition(gamCurrent, bufPositions);
+    }
+}
+
+
+/**
+ * Read a tag pair (e.g. [FEN "8/8/4k3/8/8/4K3/8/8 w - -"]): only the FEN tag matters, as the
+ * starting position of the game.
+ *
+ * @param   sTag            the tag, from '[' to ']' (need not be '\0' terminated)
+ * @return  false if the FEN tag is not a valid position
+ **/
+static bool readTag(GameState* gamCurrent, const char* sTag, size_t nLength) {
+
+    if (nLength < 6 || strncmp(sTag, "[FEN", 4) != 0 || (sTag[4] != ' ' && sTag[4] != '\t')) {
+        return true;
+    }
+    const char* pFirstQuote = memchr(sTag, '"', nLength);
+    if (!pFirstQuote) {
+        return false;
+    }
+    const char* pValue = pFirstQuote + 1;
+    const char* pLastQuote = memchr(pValue, '"', nLength - (size_t) (pValue - sTag));
+    if (!pLastQuote) {
+        return false;
+    }
+
+    ChessBoard brdStart;
+    if (parseFEN(pValue, (size_t) (pLastQuote - pValue), &brdStart, NULL) != FEN_OK) {
+        return false;
+    }
+    loadGameBoard(gamCurrent, &brdStart);
+
+    return true;
+}
+
+
+/** Result tokens, which end a game. **/
+static bool isResult(const char* sToken, size_t nLength) {
+
+    return (nLength == 1 && sToken[0] == '*')
+        || (nLength == 3 && (strncmp(sToken, "1-0", 3) == 0 || strncmp(sToken, "0-1", 3) == 0))
+        || (nLength == 7 && strncmp(sToken, "1/2-1/2", 7) == 0);
+}
+
+
+/** Record an error, with the offset in the file of what caused it. **/
+static void reportPGNError(ByteBuffer* bufErrors, const char* sMessage, const char* pToken,
+    size_t nLength, size_t nOffset) {
+
+    char sError[PGN_ERROR_MAX_LENGTH];
+    int nErrorLength = snprintf(sError, PGN_ERROR_MAX_LENGTH,
+        "\nERROR: %s (%.*s) at offset %zu of PGN file.", sMessage,
+        (int) (nLength < PGN_TOKEN_MAX_LENGTH ? nLength : PGN_TOKEN_MAX_LENGTH), pToken,
+        nOffset);
+    if (nErrorLength > 0) {
+        appendToBuffer(bufErrors, sError, (size_t) nErrorLength < PGN_ERROR_MAX_LENGTH ?
+            (size_t) nErrorLength : PGN_ERROR_MAX_LENGTH - 1);
+    }
+}
+
+
+/**
+ * Read the selection of positions (e.g. --positions), one of:
+ *   - "final": the final position of every game,
+ *   - "ply:N": the position after N half-moves (0: starting position),
+ *   - "every:N": every N half-moves, starting position included (1: every position).
+ *
+ * @return  false if the selection is malformed
+ **/
+bool parsePositionSelection(const char* sSelection, PositionSelection* selOutput) {
+
+    int nConsumed = 0;
+    if (strcmp(sSelection, "final") == 0) {
+        (*selOutput).Mode = FINAL_POSITION;
+        (*selOutput).Plies = 0;
+        return true;
+    }
+    if (sscanf(sSelection, "ply:%d%n", &(*selOutput).Plies, &nConsumed) == 1
+        && sSelection[nConsumed] == '\0' && (*selOutput).Plies >= 0) {
+        (*selOutput).Mode = POSITION_AT_PLY;
+        return true;
+    }
+    if (sscanf(sSelection, "every:%d%n", &(*selOutput).Plies, &nConsumed) == 1
+        && sSelection[nConsumed] == '\0' && (*selOutput).Plies >= 1) {
+        (*selOutput).Mode = EVERY_NTH_PLY;
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * Find where a game starts, at the earliest on the line after the one holding nFrom: a tag
+ * line ('[' at the start of a line) which does not follow another one. Blank lines are not
+ * taken into account.
+ *
+ * @return  offset of the game, nLength if no game starts after nFrom
+ **/
+size_t findNextGame(const char* pData, size_t nLength, size_t nFrom) {
+
+    size_t nLine = nFrom;
+    while (nLine > 0 && pData[nLine-1] != '\n') {
+        nLine--;
+    }
+
+    bool bAfterTag = false;
+    bool bFirstLine = true;
+    while (nLine < nLength) {
+        if (!bFirstLine && pData[nLine] == '[' && !bAfterTag) {
+            return nLine;
+        }
+        if (pData[nLine] != '\n' && pData[nLine] != '\r') {
+            bAfterTag = (pData[nLine] == '[');
+        }
+        bFirstLine = false;
+        const char* pNewLine = memchr(pData + nLine, '\n', nLength - nLine);
+        nLine = pNewLine ? (size_t) (pNewLine - pData) + 1 : nLength;
+    }
+
+    return nLength;
+}
+
+
+/**
+ * Replay every game of a block of PGN text (whole games only, see findNextGame()), writing
+ * down the selected positions as FEN lines.
+ * <p>
+ * Comments, variations, NAGs and escaped lines are skipped. A game with an illegal move is
+ * only replayed up to it (its final position is not written down).
+ *
+ * @param   pData           PGN text (need not be '\0' terminated)
+ * @param   nLength         length of pData
+ * @param   nOffset         offset of pData in its file (for error messages)
+ * @param   selPositions    which positions of each game are written down
+ * @param   bufPositions    FEN lines are appended to it
+ * @param   bufErrors       error messages are appended to it
+ * @return  number of games read
+ **/
+long extractGamePositions(const char* pData, size_t nLength, size_t nOffset,
+    const PositionSelection* selPositions, ByteBuffer* bufPositions, ByteBuffer* bufErrors) {
+
+    GameState gamCurrent;
+    bool bInGame = false;
+    long nGames = 0;
+    size_t nPos = 0;
+
+    while (nPos < nLength) {
+        char cCurrentChar = pData[nPos];
+
+        /* BLANKS (and stray closing signs), COMMENTS ({...}, ; up to the end of the line,
+         * % escaped line), NAGS AND RECURSIVE VARIATIONS */
+        if (cCurrentChar == ' ' || cCurrentChar == '\t' || cCurrentChar == '\r'
+            || cCurrentChar == '\n' || cCurrentChar == ')' || cCurrentChar == ']'
+            || cCurrentChar == '}') {
+            nPos++;
+            continue;
+        }
+        if (cCurrentChar == '{') {
+            const char* pEnd = memchr(pData + nPos, '}', nLength - nPos);
+            nPos = pEnd ? (size_t) (pEnd - pData) + 1 : nLength;
+            continue;
+        }
+        if (cCurrentChar == ';' || (cCurrentChar == '%' && (nPos == 0 || pData[nPos-1] == '\n'))) {
+            const char* pEnd = memchr(pData + nPos, '\n', nLength - nPos);
+            nPos = pEnd ? (size_t) (pEnd - pData) + 1 : nLength;
+            continue;
+        }
+        if (cCurrentChar == '$') {
+            do {
+                nPos++;
+            } while (nPos < nLength && pData[nPos] >= '0' && pData[nPos] <= '9');
+            continue;
+        }
+        if (cCurrentChar == '(') {
+            int nDepth = 0;
+            for (; nPos < nLength; nPos++) {
+                if (pData[nPos] == '{') {
+                    const char* pEnd = memchr(pData + nPos, '}', nLength - nPos);
+                    nPos = pEnd ? (size_t) (pEnd - pData) : nLength - 1;
+                }
+                else if (pData[nPos] == '(') {
+                    nDepth++;
+                }
+                else if (pData[nPos] == ')' && --nDepth == 0) {
+                    nPos++;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        /* TAG PAIR: a new game starts if moves were already read. */
+        if (cCurrentChar == '[') {
+            if (bInGame && gamCurrent.MovesStarted) {
+                finishGame(&gamCurrent, selPositions, bufPositions);
+                nGames++;
+                bInGame = false;
+            }
+            if (!bInGame) {
+                startGame(&gamCurrent);
+                bInGame = true;
+            }
+            size_t nEnd = nPos;
+            bool bQuoted = false;
+            while (nEnd < nLength && pData[nEnd] != '\n' && (bQuoted || pData[nEnd] != ']')) {
+                bQuoted ^= (pData[nEnd] == '"');
+                nEnd++;
+            }
+            if (!readTag(&gamCurrent, pData + nPos, nEnd - nPos)) {
+                reportPGNError(bufErrors, "invalid FEN tag", pData + nPos, nEnd - nPos,
+                    nOffset + nPos);
+                gamCurrent.Broken = true;
+            }
+            nPos = (nEnd < nLength && pData[nEnd] == ']') ? nEnd + 1 : nEnd;
+            continue;
+        }
+
+        /* MOVETEXT TOKEN: move (with its number, if any), move number or result */
+        size_t nStart = nPos;
+        while (nPos < nLength && !memchr(" \t\r\n{}()[];$", pData[nPos], 12)) {
+            nPos++;
+        }
+        const char* pToken = pData + nStart;
+        size_t nTokenLength = nPos - nStart;
+        if (!bInGame) {
+            startGame(&gamCurrent);
+            bInGame = true;
+        }
+        if (!gamCurrent.MovesStarted) {
+            startMoves(&gamCurrent, selPositions, bufPositions);
+        }
+        if (isResult(pToken, nTokenLength)) {
+            finishGame(&gamCurrent, selPositions, bufPositions);
+            nGames++;
+            bInGame = false;
+            continue;
+        }
+        if (pToken[0] != '0') {         /* "0-0" is castling, not a move number. */
+            size_t nDigits = 0;
+            while (nDigits < nTokenLength && pToken[nDigits] >= '0' && pToken[nDigits] <= '9') {
+                nDigits++;
+            }
+            if (nDigits == nTokenLength) {
+                continue;
+            }
+            if (pToken[nDigits] == '.') {
+                while (nDigits < nTokenLength && pToken[nDigits] == '.') {
+                    nDigits++;
+                }
+                pToken += nDigits;
+                nTokenLength -= nDigits;
+            }
+        }
+        if (nTokenLength == 0 || gamCurrent.Broken) {
+            continue;
+        }
+        if (nTokenLength > PGN_TOKEN_MAX_LENGTH
+            || !playSANMove(&gamCurrent, pToken, nTokenLength)) {
+            reportPGNError(bufErrors, "illegal move", pToken, nTokenLength,
+                nOffset + (size_t) (pToken - pData));
+            gamCurrent.Broken = true;
+            continue;
+        }
+        if (isPositionSelected(&gamCurrent, selPositions)) {
+            writeGamePosition(&gamCurrent, bufPositions);
+        }
+    }
+
+    /* LAST GAME, EVEN WITHOUT RESULT */
+    if (bInGame) {
+        finishGame(&gamCurrent, selPositions, bufPositions);
+        nGames++;
+    }
+
+    return nGames;
+}
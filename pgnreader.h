@@ -0,0 +1,54 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for pgnreader.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include "libfen2svg.h"
+#include "bytebuffer.h"
+
+#define PGN_CHUNK_SIZE (1 << 20)            /* Games are parsed a chunk (about 1 MB) a thread. */
+#define PGN_TOKEN_MAX_LENGTH 32             /* Longer movetext tokens are not moves. */
+#define PGN_ERROR_MAX_LENGTH 256
+
+
+/* Variables */
+enum PositionSelectionMode {
+   FINAL_POSITION,         /* Once the game is over (default). */
+   POSITION_AT_PLY,        /* After Plies half-moves (0: starting position). */
+   EVERY_NTH_PLY           /* Every Plies half-moves, starting position included. */
+};
+
+/**
+ * Which positions of a game are drawn.
+ **/
+typedef struct PositionSelection {
+   int Mode;               /* E.g. FINAL_POSITION. */
+   int Plies;
+} PositionSelection;
+
+/* Methods */
+bool parsePositionSelection(const char* sSelection, PositionSelection* selOutput);
+size_t findNextGame(const char* pData, size_t nLength, size_t nFrom);
+long extractGamePositions(const char* pData, size_t nLength, size_t nOffset,
+    const PositionSelection* selPositions, ByteBuffer* bufPositions, ByteBuffer* bufErrors);
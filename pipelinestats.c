@@ -0,0 +1,165 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code offers other programs timings and counters
+ * of the stages of a conversion, written down as JSON. Each stage costs two
+ * clock readings per thread clock (CPU time of a thread is a system call):
+ * nothing is measured unless statistics are requested. It is meant to be used
+ * by FEN2SVG.
+ **/
+
+
+#include<stdlib.h>  /* malloc(), free(), exit() */
+#include<stdio.h>   /* printf(), fprintf() */
+#include<string.h>  /* memset() */
+#ifndef _WIN32
+#include<sys/resource.h>    /* getrusage() */
+#endif
+#include "pipelinestats.h"
+#include "bytebuffer.h"     /* countBufferAllocations() */
+
+/* Names of the stages and counters in the JSON document, in the order of their enums. */
+static const char* asStageNames[PIPELINE_STAGE_COUNT] = {
+    "template", "board", "pgn", "fen", "pieces", "compression", "file_name", "write"
+};
+static const char* asCounterNames[PIPELINE_COUNTER_COUNT] = {
+    "positions", "diagrams", "rejected_fens", "bytes_written"
+};
+
+
+static long long getElapsedNanoseconds(const struct timespec* tmsFrom,
+    const struct timespec* tmsTo) {
+
+    return (long long) ((*tmsTo).tv_sec - (*tmsFrom).tv_sec) * 1000000000LL
+        + ((*tmsTo).tv_nsec - (*tmsFrom).tv_nsec);
+}
+
+
+PipelineStats* createPipelineStats(void) {
+
+    PipelineStats* stsReturnValue = (PipelineStats*) malloc(sizeof(PipelineStats));
+    if (!stsReturnValue) {
+        printf("Unsuccessful malloc() in createPipelineStats(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(stsReturnValue, 0, sizeof(PipelineStats));
+    clock_gettime(CLOCK_MONOTONIC, &(*stsReturnValue).Start);
+
+    return stsReturnValue;
+}
+
+
+/**
+ * A stage begins, on the current thread (nothing is done without statistics).
+ *
+ * @param   stsPipeline     statistics, NULL if none are kept
+ * @param   tmrStage        receives the wall and CPU clocks, for endStage()
+ **/
+void startStage(const PipelineStats* stsPipeline, StageTimer* tmrStage) {
+
+    if (stsPipeline) {
+        clock_gettime(CLOCK_MONOTONIC, &(*tmrStage).Wall);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &(*tmrStage).CPU);
+    }
+}
+
+
+/**
+ * A stage started by the current thread ends: its times are added to those of the stage.
+ *
+ * @param   nStage          e.g. FEN_STAGE
+ **/
+void endStage(PipelineStats* stsPipeline, int nStage, const StageTimer* tmrStage) {
+
+    if (!stsPipeline) {
+        return;
+    }
+    StageTimer tmrEnd;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tmrEnd.CPU);
+    clock_gettime(CLOCK_MONOTONIC, &tmrEnd.Wall);
+    __atomic_fetch_add(&(*stsPipeline).WallTime[nStage],
+        getElapsedNanoseconds(&(*tmrStage).Wall, &tmrEnd.Wall), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(*stsPipeline).CPUTime[nStage],
+        getElapsedNanoseconds(&(*tmrStage).CPU, &tmrEnd.CPU), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(*stsPipeline).Calls[nStage], 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Add to a counter (nothing is done without statistics).
+ *
+ * @param   nCounter        e.g. REJECTED_FEN_COUNTER
+ **/
+void countInStats(PipelineStats* stsPipeline, int nCounter, long long nAmount) {
+
+    if (stsPipeline) {
+        __atomic_fetch_add(&(*stsPipeline).Counters[nCounter], nAmount, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * Write down the statistics as a JSON object: whole wall and CPU times of the process,
+ * its peak resident set size, buffer allocations, counters, and calls and times of each
+ * stage (in seconds).
+ **/
+void writePipelineStats(const PipelineStats* stsPipeline, FILE* fOutput) {
+
+    struct timespec tmsNow;
+    clock_gettime(CLOCK_MONOTONIC, &tmsNow);
+    double dCPUSeconds = 0.0;
+    long nPeakRSS = 0;
+#ifndef _WIN32
+    struct rusage rsgProcess;
+    if (getrusage(RUSAGE_SELF, &rsgProcess) == 0) {
+        dCPUSeconds = (double) rsgProcess.ru_utime.tv_sec + rsgProcess.ru_utime.tv_usec / 1e6
+            + (double) rsgProcess.ru_stime.tv_sec + rsgProcess.ru_stime.tv_usec / 1e6;
+        nPeakRSS = rsgProcess.ru_maxrss;            /* Kilobytes, under Linux. */
+    }
+#endif
+
+    fprintf(fOutput, "{\n");
+    fprintf(fOutput, "  \"wall_seconds\": %.6f,\n",
+        getElapsedNanoseconds(&(*stsPipeline).Start, &tmsNow) / 1e9);
+    fprintf(fOutput, "  \"cpu_seconds\": %.6f,\n", dCPUSeconds);
+    fprintf(fOutput, "  \"peak_rss_kb\": %ld,\n", nPeakRSS);
+    fprintf(fOutput, "  \"buffer_allocations\": %ld,\n", countBufferAllocations());
+    for (int nCounter = 0; nCounter < PIPELINE_COUNTER_COUNT; nCounter++) {
+        fprintf(fOutput, "  \"%s\": %lld,\n", asCounterNames[nCounter],
+            (*stsPipeline).Counters[nCounter]);
+    }
+    fprintf(fOutput, "  \"stages\": {\n");
+    for (int nStage = 0; nStage < PIPELINE_STAGE_COUNT; nStage++) {
+        fprintf(fOutput, "    \"%s\": {\"calls\": %lld, \"wall_seconds\": %.6f, "
+            "\"cpu_seconds\": %.6f}%s\n", asStageNames[nStage], (*stsPipeline).Calls[nStage],
+            (*stsPipeline).WallTime[nStage] / 1e9, (*stsPipeline).CPUTime[nStage] / 1e9,
+            nStage < PIPELINE_STAGE_COUNT - 1 ? "," : "");
+    }
+    fprintf(fOutput, "  }\n");
+    fprintf(fOutput, "}\n");
+}
+
+
+void freePipelineStats(PipelineStats** stsPipeline) {
+
+    free(*stsPipeline);
+    *stsPipeline = NULL;
+}
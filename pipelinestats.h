@@ -0,0 +1,77 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for pipelinestats.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdio.h>                          /* FILE */
+#include <time.h>                           /* clock_gettime() */
+
+
+/* Variables */
+enum PipelineStage {
+   TEMPLATE_STAGE,         /* Template read and parsed (once). */
+   BOARD_STAGE,            /* Rendering context, empty boards built with its first position. */
+   PGN_STAGE,              /* PGN games replayed into FEN lines. */
+   FEN_STAGE,              /* FEN strings parsed. */
+   PIECES_STAGE,           /* Pieces placed on the board (SVG or bitmap). */
+   COMPRESSION_STAGE,      /* Gzip (-z). */
+   FILE_NAME_STAGE,        /* File names generated. */
+   WRITE_STAGE,            /* Diagrams written to files, archive or stream. */
+   PIPELINE_STAGE_COUNT
+};
+
+enum PipelineCounter {
+   POSITION_COUNTER,       /* Positions read (duplicates included). */
+   DIAGRAM_COUNTER,        /* Diagrams (or sheets) written. */
+   REJECTED_FEN_COUNTER,   /* Invalid FEN strings. */
+   WRITTEN_BYTE_COUNTER,   /* Bytes of the diagrams written. */
+   PIPELINE_COUNTER_COUNT
+};
+
+/**
+ * Time spent in each stage of the conversion, and counters, shared by every thread (updated
+ * atomically): times of several threads add up.
+ **/
+typedef struct PipelineStats {
+   long long WallTime[PIPELINE_STAGE_COUNT];       /* Nanoseconds. */
+   long long CPUTime[PIPELINE_STAGE_COUNT];        /* Nanoseconds, of the threads involved. */
+   long long Calls[PIPELINE_STAGE_COUNT];
+   long long Counters[PIPELINE_COUNTER_COUNT];
+   struct timespec Start;                          /* Creation, for the whole wall time. */
+} PipelineStats;
+
+/**
+ * Beginning of a stage, as seen by one thread (see startStage()).
+ **/
+typedef struct StageTimer {
+   struct timespec Wall;
+   struct timespec CPU;
+} StageTimer;
+
+/* Methods */
+PipelineStats* createPipelineStats(void);
+void startStage(const PipelineStats* stsPipeline, StageTimer* tmrStage);
+void endStage(PipelineStats* stsPipeline, int nStage, const StageTimer* tmrStage);
+void countInStats(PipelineStats* stsPipeline, int nCounter, long long nAmount);
+void writePipelineStats(const PipelineStats* stsPipeline, FILE* fOutput);
+void freePipelineStats(PipelineStats** stsPipeline);
@@ -0,0 +1,142 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code offers other programs a set of strings, that
+ * tells whether a string was already met. Strings are stored one after the
+ * other in a single buffer: adding one costs no allocation of its own. It is
+ * meant to be used by FEN2SVG.
+ **/
+
+
+#include<stdlib.h>  /* calloc(), free(), exit() */
+#include<stdio.h>   /* printf() */
+#include<string.h>  /* strlen(), strcmp() */
+#include "stringset.h"
+
+#define INITIAL_SLOTS 1024
+
+
+/* FNV-1a, 64 bits: the same on every machine (e.g. to share positions out, see --shard). */
+unsigned long long hashString(const char* sValue) {
+
+    unsigned long long nHash = 14695981039346656037ULL;
+    while (*sValue) {
+        nHash ^= (unsigned char) *sValue++;
+        nHash *= 1099511628211ULL;
+    }
+
+    return nHash;
+}
+
+
+static StringSetSlot* allocateSlots(size_t nCapacity) {
+
+    StringSetSlot* aslReturnValue = (StringSetSlot*) calloc(nCapacity, sizeof(StringSetSlot));
+    if (!aslReturnValue) {
+        printf("Unsuccessful calloc() in allocateSlots(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return aslReturnValue;
+}
+
+
+StringSet* createStringSet(void) {
+
+    StringSet* setStrings = (StringSet*) malloc(1 * sizeof(StringSet));
+    if (!setStrings) {
+        printf("Unsuccessful malloc() in createStringSet(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (*setStrings).Capacity = INITIAL_SLOTS;
+    (*setStrings).Slots = allocateSlots(INITIAL_SLOTS);
+    (*setStrings).Count = 0;
+    (*setStrings).Strings = createEmptyBuffer();
+
+    return setStrings;
+}
+
+
+/* Double the number of slots once half of them are used, so that probing stays short. */
+static void growStringSet(StringSet* setStrings) {
+
+    size_t nNewCapacity = (*setStrings).Capacity * 2;
+    StringSetSlot* aslNewSlots = allocateSlots(nNewCapacity);
+
+    for (size_t nSlot = 0; nSlot < (*setStrings).Capacity; nSlot++) {
+        StringSetSlot slCurrent = (*setStrings).Slots[nSlot];
+        if (slCurrent.Offset) {
+            size_t nNewSlot = (size_t) slCurrent.Hash & (nNewCapacity-1);
+            while (aslNewSlots[nNewSlot].Offset) {
+                nNewSlot = (nNewSlot+1) & (nNewCapacity-1);
+            }
+            aslNewSlots[nNewSlot] = slCurrent;
+        }
+    }
+
+    free((*setStrings).Slots);
+    (*setStrings).Slots = aslNewSlots;
+    (*setStrings).Capacity = nNewCapacity;
+}
+
+
+/**
+ * Add a string to the set.
+ *
+ * @return  false if the string was already in the set
+ **/
+bool addToStringSet(StringSet* setStrings, const char* sValue) {
+
+    unsigned long long nHash = hashString(sValue);
+    size_t nSlot = (size_t) nHash & ((*setStrings).Capacity-1);
+
+    /* LOOK FOR THE STRING (same hash first, then same characters). */
+    while ((*setStrings).Slots[nSlot].Offset) {
+        StringSetSlot slCurrent = (*setStrings).Slots[nSlot];
+        if (slCurrent.Hash == nHash
+            && strcmp((*(*setStrings).Strings).Data + slCurrent.Offset-1, sValue) == 0) {
+            return false;
+        }
+        nSlot = (nSlot+1) & ((*setStrings).Capacity-1);
+    }
+
+    /* STORE IT IN THE FREE SLOT FOUND */
+    (*setStrings).Slots[nSlot].Hash = nHash;
+    (*setStrings).Slots[nSlot].Offset = (*(*setStrings).Strings).Length + 1;
+    appendToBuffer((*setStrings).Strings, sValue, strlen(sValue)+1);
+    (*setStrings).Count++;
+
+    if (2 * (*setStrings).Count > (*setStrings).Capacity) {
+        growStringSet(setStrings);
+    }
+
+    return true;
+}
+
+
+void freeStringSet(StringSet** setStrings) {
+
+    free((**setStrings).Slots);
+    freeBuffer(&(**setStrings).Strings);
+    free(*setStrings);
+    *setStrings = NULL;
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ * 
+ * This file is part of FEN2SVG.
+ * 
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for stringset.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <stddef.h>                         /* size_t */
+#include "bytebuffer.h"
+
+
+/* Variables */
+typedef struct StringSetSlot {
+   unsigned long long Hash;
+   size_t Offset;          /* Position of the string in Strings, plus one (0: free slot). */
+} StringSetSlot;
+
+typedef struct StringSet {
+   StringSetSlot* Slots;   /* Open addressing, linear probing. */
+   size_t Capacity;        /* Always a power of two. */
+   size_t Count;
+   ByteBuffer* Strings;    /* Every string, '\0' terminated, one after the other. */
+} StringSet;
+
+/* Methods */
+unsigned long long hashString(const char* sValue);
+StringSet* createStringSet(void);
+bool addToStringSet(StringSet* setStrings, const char* sValue);
+void freeStringSet(StringSet** setStrings);
@@ -0,0 +1,1293 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code draws SVG into bitmaps, for FEN2SVG: only what the
+ * template is made of (paths, circles, groups and their painting attributes), and the
+ * "<use>" elements diagrams are made of.
+ * <p>
+ * Definitions are read once: every path is kept as a list of cubic curves (lines and arcs
+ * are turned into them), in template units. Drawing flattens the curves at the requested
+ * scale, then fills the polygons scanline by scanline, RASTER_SUBSAMPLES times per row of
+ * pixels, with exact horizontal coverage. Strokes are filled as the union of a quad per
+ * segment, plus joins and caps.
+ * <p>
+ * Neither transform, gradient, dash nor text: the template uses none.
+ **/
+
+
+#include <stdio.h>      /* printf() */
+#include <stdlib.h>     /* malloc(), realloc(), free(), exit(), strtof() */
+#include <string.h>     /* memcpy(), strncmp() */
+#include <math.h>       /* sqrtf(), cosf(), sinf(), tanf(), atan2f(), floorf(), ceilf() */
+#include "svgraster.h"
+
+#define RASTER_PI 3.14159265358979f
+#define RASTER_FLATNESS 0.1f                /* Largest distance between curve and polygon. */
+#define RASTER_MAX_CURVE_SEGMENTS 64
+#define RASTER_STYLE_DEPTH 16               /* Nested groups. */
+
+
+/* Variables */
+/** Flattened outline, in pixels. **/
+typedef struct RasterPolygon {
+   float* Points;          /* x, y pairs. */
+   int PointCount;
+   int PointCapacity;
+   int* Ends;              /* Index of the point after the last one, per contour. */
+   bool* Closed;           /* Per contour. */
+   int ContourCount;
+   int ContourCapacity;
+} RasterPolygon;
+
+/** Edge of a polygon, top to bottom. **/
+typedef struct RasterEdge {
+   float X0;
+   float Y0;
+   float X1;
+   float Y1;
+   int Direction;          /* +1 if the contour goes down along it, -1 otherwise. */
+} RasterEdge;
+
+/** Crossing of a scanline with an edge. **/
+typedef struct RasterCrossing {
+   float X;
+   int Direction;
+} RasterCrossing;
+
+
+/** Grow an array of nSize bytes items, so that it holds at least nCount of them. **/
+static void* growArray(void* pArray, int* nCapacity, int nCount, size_t nSize) {
+
+    if (nCount <= *nCapacity) {
+        return pArray;
+    }
+    int nNewCapacity = (*nCapacity > 0) ? *nCapacity : 16;
+    while (nNewCapacity < nCount) {
+        nNewCapacity *= 2;
+    }
+    void* pReturnValue = realloc(pArray, (size_t) nNewCapacity * nSize);
+    if (!pReturnValue) {
+        printf("Unsuccessful realloc() in growArray(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    *nCapacity = nNewCapacity;
+
+    return pReturnValue;
+}
+
+
+/******************************************************************************************
+ * PARSING
+ ******************************************************************************************/
+
+/**
+ * Find the value of an attribute among the attributes of an element (spaces are allowed
+ * around '=', as in the lines FEN2SVG writes).
+ *
+ * @param   pElement    first character of the element
+ * @param   pEnd        character after its last one
+ * @param   pValue      receives the first character of the value (quotes excluded)
+ * @param   nLength     receives the length of the value
+ * @return  false if the element has no such attribute
+ **/
+static bool findAttribute(const char* pElement, const char* pEnd, const char* sName,
+    const char** pValue, size_t* nLength) {
+
+    size_t nNameLength = strlen(sName);
+    for (const char* p = pElement + 1; p + nNameLength < pEnd; p++) {
+        if ((p[-1] != ' ' && p[-1] != '\n' && p[-1] != '\t') || strncmp(p, sName, nNameLength)
+            != 0) {
+            continue;
+        }
+        const char* q = p + nNameLength;
+        while (q < pEnd && (*q == ' ' || *q == '\n' || *q == '\t')) {
+            q++;
+        }
+        if (q >= pEnd || *q != '=') {
+            continue;
+        }
+        q++;
+        while (q < pEnd && (*q == ' ' || *q == '\n' || *q == '\t')) {
+            q++;
+        }
+        if (q >= pEnd || (*q != '"' && *q != '\'')) {
+            continue;
+        }
+        const char* pClosing = memchr(q + 1, *q, (size_t) (pEnd - q - 1));
+        if (!pClosing) {
+            return false;
+        }
+        *pValue = q + 1;
+        *nLength = (size_t) (pClosing - q - 1);
+        return true;
+    }
+
+    return false;
+}
+
+
+/** Value of a numeric attribute, or nDefault if the element has none. **/
+static float readNumericAttribute(const char* pElement, const char* pEnd, const char* sName,
+    float nDefault) {
+
+    const char* pValue;
+    size_t nLength;
+    if (!findAttribute(pElement, pEnd, sName, &pValue, &nLength)) {
+        return nDefault;
+    }
+
+    return strtof(pValue, NULL);
+}
+
+
+/**
+ * Read a colour: "#rgb", "#rrggbb", "black" or "white".
+ *
+ * @return  PAINT_NONE, or PAINT_COLOUR (unknown colours are black)
+ **/
+static enum RasterPaintState readColour(const char* pValue, size_t nLength,
+    unsigned int* nColour) {
+
+    *nColour = 0x000000;
+    if (nLength == 4 && strncmp(pValue, "none", 4) == 0) {
+        return PAINT_NONE;
+    }
+    if (nLength == 5 && strncmp(pValue, "white", 5) == 0) {
+        *nColour = 0xFFFFFF;
+    }
+    else if (nLength > 0 && pValue[0] == '#') {
+        char sDigits[7] = "";
+        if (nLength == 4) {
+            /* Every digit doubled: "#fa0" is "#ffaa00". */
+            for (int i = 0; i < 3; i++) {
+                sDigits[2*i] = sDigits[2*i+1] = pValue[1+i];
+            }
+            sDigits[6] = '\0';
+        }
+        else if (nLength == 7) {
+            memcpy(sDigits, pValue + 1, 6);
+            sDigits[6] = '\0';
+        }
+        *nColour = (unsigned int) strtoul(sDigits, NULL, 16);
+    }
+
+    return PAINT_COLOUR;
+}
+
+
+/** Painting attributes of an element, over those of its parent. **/
+static RasterStyle readStyle(const char* pElement, const char* pEnd, RasterStyle styParent) {
+
+    RasterStyle styReturnValue = styParent;
+    const char* pValue;
+    size_t nLength;
+
+    if (findAttribute(pElement, pEnd, "fill", &pValue, &nLength)) {
+        styReturnValue.FillState = readColour(pValue, nLength, &styReturnValue.Fill);
+    }
+    if (findAttribute(pElement, pEnd, "stroke", &pValue, &nLength)) {
+        styReturnValue.StrokeState = readColour(pValue, nLength, &styReturnValue.Stroke);
+    }
+    styReturnValue.FillOpacity = readNumericAttribute(pElement, pEnd, "fill-opacity",
+        styParent.FillOpacity);
+    styReturnValue.StrokeWidth = readNumericAttribute(pElement, pEnd, "stroke-width",
+        styParent.StrokeWidth);
+    if (findAttribute(pElement, pEnd, "fill-rule", &pValue, &nLength)) {
+        styReturnValue.EvenOdd = (nLength == 7 && strncmp(pValue, "evenodd", 7) == 0);
+    }
+    if (findAttribute(pElement, pEnd, "stroke-linecap", &pValue, &nLength)) {
+        styReturnValue.LineCap = (strncmp(pValue, "round", 5) == 0) ? ROUND_CAP :
+            (strncmp(pValue, "square", 6) == 0) ? SQUARE_CAP : BUTT_CAP;
+    }
+    if (findAttribute(pElement, pEnd, "stroke-linejoin", &pValue, &nLength)) {
+        styReturnValue.LineJoin = (strncmp(pValue, "round", 5) == 0) ? ROUND_JOIN :
+            (strncmp(pValue, "bevel", 5) == 0) ? BEVEL_JOIN : MITER_JOIN;
+    }
+
+    return styReturnValue;
+}
+
+
+/** SVG defaults for whatever no element set (but the fill, which a use may give). **/
+static RasterStyle resolveStyle(RasterStyle styShape) {
+
+    if (styShape.FillOpacity < 0) {
+        styShape.FillOpacity = 1;
+    }
+    if (styShape.EvenOdd < 0) {
+        styShape.EvenOdd = 0;
+    }
+    if (styShape.StrokeState == PAINT_INHERITED) {
+        styShape.StrokeState = PAINT_NONE;
+    }
+    if (styShape.StrokeWidth < 0) {
+        styShape.StrokeWidth = 1;
+    }
+    if (styShape.LineCap < 0) {
+        styShape.LineCap = BUTT_CAP;
+    }
+    if (styShape.LineJoin < 0) {
+        styShape.LineJoin = MITER_JOIN;
+    }
+
+    return styShape;
+}
+
+
+/** Append a command, and its points, to the outline of a shape. **/
+static void addPathCommand(RasterShape* shpPath, int* nPointCapacity, int* nCommandCapacity,
+    unsigned char cCommand, const float* aPoints, int nPoints) {
+
+    (*shpPath).Commands = growArray((*shpPath).Commands, nCommandCapacity,
+        (*shpPath).CommandCount + 1, sizeof(unsigned char));
+    (*shpPath).Commands[(*shpPath).CommandCount++] = cCommand;
+    (*shpPath).Points = growArray((*shpPath).Points, nPointCapacity,
+        (*shpPath).PointCount + 2 * nPoints, sizeof(float));
+    if (nPoints > 0) {
+        memcpy((*shpPath).Points + (*shpPath).PointCount, aPoints, 2 * nPoints * sizeof(float));
+        (*shpPath).PointCount += 2 * nPoints;
+    }
+}
+
+
+/** Outline being built, and where the pen is. **/
+typedef struct PathBuilder {
+   RasterShape* Shape;
+   int PointCapacity;
+   int CommandCapacity;
+   float X;                /* Current point. */
+   float Y;
+   float StartX;           /* First point of the current subpath. */
+   float StartY;
+   float ControlX;         /* Last control point (for "s"), reset by other commands. */
+   float ControlY;
+   bool Started;           /* A moveto was given. */
+} PathBuilder;
+
+
+static void moveTo(PathBuilder* bldPath, float nX, float nY) {
+
+    float aPoints[2] = {nX, nY};
+    addPathCommand((*bldPath).Shape, &(*bldPath).PointCapacity, &(*bldPath).CommandCapacity,
+        'M', aPoints, 1);
+    (*bldPath).X = (*bldPath).StartX = (*bldPath).ControlX = nX;
+    (*bldPath).Y = (*bldPath).StartY = (*bldPath).ControlY = nY;
+    (*bldPath).Started = true;
+}
+
+
+static void cubicTo(PathBuilder* bldPath, float nX1, float nY1, float nX2, float nY2, float nX,
+    float nY) {
+
+    float aPoints[6] = {nX1, nY1, nX2, nY2, nX, nY};
+    addPathCommand((*bldPath).Shape, &(*bldPath).PointCapacity, &(*bldPath).CommandCapacity,
+        'C', aPoints, 3);
+    (*bldPath).ControlX = nX2;
+    (*bldPath).ControlY = nY2;
+    (*bldPath).X = nX;
+    (*bldPath).Y = nY;
+}
+
+
+/** A line is a cubic curve whose control points lie on it. **/
+static void lineTo(PathBuilder* bldPath, float nX, float nY) {
+
+    float nX0 = (*bldPath).X;
+    float nY0 = (*bldPath).Y;
+    cubicTo(bldPath, nX0 + (nX - nX0) / 3, nY0 + (nY - nY0) / 3, nX0 + 2 * (nX - nX0) / 3,
+        nY0 + 2 * (nY - nY0) / 3, nX, nY);
+    (*bldPath).ControlX = nX;
+    (*bldPath).ControlY = nY;
+}
+
+
+static void closePath(PathBuilder* bldPath) {
+
+    addPathCommand((*bldPath).Shape, &(*bldPath).PointCapacity, &(*bldPath).CommandCapacity,
+        'Z', NULL, 0);
+    (*bldPath).X = (*bldPath).ControlX = (*bldPath).StartX;
+    (*bldPath).Y = (*bldPath).ControlY = (*bldPath).StartY;
+}
+
+
+/** Signed angle from vector (ux, uy) to vector (vx, vy). **/
+static float angleBetween(float nUX, float nUY, float nVX, float nVY) {
+
+    return atan2f(nUX * nVY - nUY * nVX, nUX * nVX + nUY * nVY);
+}
+
+
+/**
+ * Elliptical arc from the current point, as cubic curves of at most a quarter turn (see
+ * the implementation notes of the SVG specification, "conversion from endpoint to center
+ * parameterization").
+ **/
+static void arcTo(PathBuilder* bldPath, float nRX, float nRY, float nRotation, bool bLargeArc,
+    bool bSweep, float nX, float nY) {
+
+    float nX1 = (*bldPath).X;
+    float nY1 = (*bldPath).Y;
+    if (nX1 == nX && nY1 == nY) {
+        return;
+    }
+    nRX = fabsf(nRX);
+    nRY = fabsf(nRY);
+    if (nRX == 0 || nRY == 0) {
+        lineTo(bldPath, nX, nY);
+        return;
+    }
+
+    /* CENTER */
+    float nCos = cosf(nRotation * RASTER_PI / 180);
+    float nSin = sinf(nRotation * RASTER_PI / 180);
+    float nDX = (nX1 - nX) / 2;
+    float nDY = (nY1 - nY) / 2;
+    float nX1P = nCos * nDX + nSin * nDY;
+    float nY1P = -nSin * nDX + nCos * nDY;
+    float nLambda = (nX1P * nX1P) / (nRX * nRX) + (nY1P * nY1P) / (nRY * nRY);
+    if (nLambda > 1) {
+        nRX *= sqrtf(nLambda);
+        nRY *= sqrtf(nLambda);
+    }
+    float nNumerator = nRX * nRX * nRY * nRY - nRX * nRX * nY1P * nY1P
+        - nRY * nRY * nX1P * nX1P;
+    float nDenominator = nRX * nRX * nY1P * nY1P + nRY * nRY * nX1P * nX1P;
+    float nCoefficient = (nNumerator > 0 && nDenominator > 0) ?
+        sqrtf(nNumerator / nDenominator) : 0;
+    if (bLargeArc == bSweep) {
+        nCoefficient = -nCoefficient;
+    }
+    float nCXP = nCoefficient * nRX * nY1P / nRY;
+    float nCYP = -nCoefficient * nRY * nX1P / nRX;
+    float nCX = nCos * nCXP - nSin * nCYP + (nX1 + nX) / 2;
+    float nCY = nSin * nCXP + nCos * nCYP + (nY1 + nY) / 2;
+
+    /* ANGLES */
+    float nUX = (nX1P - nCXP) / nRX;
+    float nUY = (nY1P - nCYP) / nRY;
+    float nTheta = angleBetween(1, 0, nUX, nUY);
+    float nDelta = angleBetween(nUX, nUY, (-nX1P - nCXP) / nRX, (-nY1P - nCYP) / nRY);
+    if (!bSweep && nDelta > 0) {
+        nDelta -= 2 * RASTER_PI;
+    }
+    else if (bSweep && nDelta < 0) {
+        nDelta += 2 * RASTER_PI;
+    }
+
+    /* ONE CUBIC CURVE PER QUARTER TURN (at most) */
+    int nSegments = (int) ceilf(fabsf(nDelta) / (RASTER_PI / 2) - 0.001f);
+    if (nSegments < 1) {
+        nSegments = 1;
+    }
+    float nStep = nDelta / nSegments;
+    float nK = 4.0f / 3.0f * tanf(nStep / 4);
+    for (int i = 0; i < nSegments; i++) {
+        float nT1 = nTheta + i * nStep;
+        float nT2 = nT1 + nStep;
+        float nC1 = cosf(nT1), nS1 = sinf(nT1), nC2 = cosf(nT2), nS2 = sinf(nT2);
+        float nEX1 = nCX + nRX * nC1 * nCos - nRY * nS1 * nSin;
+        float nEY1 = nCY + nRX * nC1 * nSin + nRY * nS1 * nCos;
+        float nEX2 = nCX + nRX * nC2 * nCos - nRY * nS2 * nSin;
+        float nEY2 = nCY + nRX * nC2 * nSin + nRY * nS2 * nCos;
+        if (i == nSegments - 1) {
+            nEX2 = nX;
+            nEY2 = nY;
+        }
+        cubicTo(bldPath,
+            nEX1 + nK * (-nRX * nS1 * nCos - nRY * nC1 * nSin),
+            nEY1 + nK * (-nRX * nS1 * nSin + nRY * nC1 * nCos),
+            nEX2 - nK * (-nRX * nS2 * nCos - nRY * nC2 * nSin),
+            nEY2 - nK * (-nRX * nS2 * nSin + nRY * nC2 * nCos),
+            nEX2, nEY2);
+    }
+}
+
+
+/** Skip spaces and commas. **/
+static const char* skipSeparators(const char* p, const char* pEnd) {
+
+    while (p < pEnd && (*p == ' ' || *p == ',' || *p == '\n' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+
+    return p;
+}
+
+
+/** Read a number of path data (e.g. "-5.15", ".25" or "1e-3"), NULL if there is none. **/
+static const char* readPathNumber(const char* p, const char* pEnd, float* nValue) {
+
+    p = skipSeparators(p, pEnd);
+    if (p >= pEnd || !(*p == '-' || *p == '+' || *p == '.' || (*p >= '0' && *p <= '9'))) {
+        return NULL;
+    }
+    char* pNext;
+    *nValue = strtof(p, &pNext);
+
+    return (pNext > p && pNext <= pEnd) ? pNext : NULL;
+}
+
+
+/** Read an arc flag: a single '0' or '1', which may be followed by a number at once. **/
+static const char* readPathFlag(const char* p, const char* pEnd, bool* bValue) {
+
+    p = skipSeparators(p, pEnd);
+    if (p >= pEnd || (*p != '0' && *p != '1')) {
+        return NULL;
+    }
+    *bValue = (*p == '1');
+
+    return p + 1;
+}
+
+
+/**
+ * Read path data (the "d" attribute) into the outline of a shape.
+ *
+ * @return  false on malformed data (what was read so far is kept)
+ **/
+static bool readPathData(PathBuilder* bldPath, const char* p, const char* pEnd) {
+
+    char cCommand = '\0';
+    float a[7];
+    bool bLargeArc;
+    bool bSweep;
+
+    while ((p = skipSeparators(p, pEnd)) < pEnd) {
+        /* A new command, or the previous one repeated. */
+        if ((*p >= 'A' && *p <= 'Z' && *p != 'E') || (*p >= 'a' && *p <= 'z' && *p != 'e')) {
+            cCommand = *p++;
+        }
+        else if (cCommand == '\0') {
+            return false;
+        }
+        bool bRelative = (cCommand >= 'a');
+        float nOX = bRelative ? (*bldPath).X : 0;
+        float nOY = bRelative ? (*bldPath).Y : 0;
+        const char* q = p;
+        switch (cCommand) {
+            case 'M': case 'm':
+                if (!(q = readPathNumber(q, pEnd, &a[0])) || !(q = readPathNumber(q, pEnd, &a[1]))) {
+                    return false;
+                }
+                moveTo(bldPath, nOX + a[0], nOY + a[1]);
+                cCommand = bRelative ? 'l' : 'L';       /* Following pairs are lines. */
+                break;
+            case 'L': case 'l':
+                if (!(q = readPathNumber(q, pEnd, &a[0])) || !(q = readPathNumber(q, pEnd, &a[1]))) {
+                    return false;
+                }
+                lineTo(bldPath, nOX + a[0], nOY + a[1]);
+                break;
+            case 'H': case 'h':
+                if (!(q = readPathNumber(q, pEnd, &a[0]))) {
+                    return false;
+                }
+                lineTo(bldPath, nOX + a[0], (*bldPath).Y);
+                break;
+            case 'V': case 'v':
+                if (!(q = readPathNumber(q, pEnd, &a[0]))) {
+                    return false;
+                }
+                lineTo(bldPath, (*bldPath).X, nOY + a[0]);
+                break;
+            case 'C': case 'c':
+                for (int i = 0; i < 6; i++) {
+                    if (!(q = readPathNumber(q, pEnd, &a[i]))) {
+                        return false;
+                    }
+                }
+                cubicTo(bldPath, nOX + a[0], nOY + a[1], nOX + a[2], nOY + a[3], nOX + a[4],
+                    nOY + a[5]);
+                break;
+            case 'S': case 's':
+                for (int i = 0; i < 4; i++) {
+                    if (!(q = readPathNumber(q, pEnd, &a[i]))) {
+                        return false;
+                    }
+                }
+                /* First control point: reflection of the previous one. */
+                cubicTo(bldPath, 2 * (*bldPath).X - (*bldPath).ControlX,
+                    2 * (*bldPath).Y - (*bldPath).ControlY, nOX + a[0], nOY + a[1], nOX + a[2],
+                    nOY + a[3]);
+                break;
+            case 'Q': case 'q':
+                for (int i = 0; i < 4; i++) {
+                    if (!(q = readPathNumber(q, pEnd, &a[i]))) {
+                        return false;
+                    }
+                }
+                /* Same curve, as a cubic one. */
+                cubicTo(bldPath,
+                    (*bldPath).X + 2.0f / 3.0f * (nOX + a[0] - (*bldPath).X),
+                    (*bldPath).Y + 2.0f / 3.0f * (nOY + a[1] - (*bldPath).Y),
+                    nOX + a[2] + 2.0f / 3.0f * (a[0] - a[2]),
+                    nOY + a[3] + 2.0f / 3.0f * (a[1] - a[3]), nOX + a[2], nOY + a[3]);
+                break;
+            case 'A': case 'a':
+                if (!(q = readPathNumber(q, pEnd, &a[0])) || !(q = readPathNumber(q, pEnd, &a[1]))
+                    || !(q = readPathNumber(q, pEnd, &a[2])) || !(q = readPathFlag(q, pEnd, &bLargeArc))
+                    || !(q = readPathFlag(q, pEnd, &bSweep)) || !(q = readPathNumber(q, pEnd, &a[3]))
+                    || !(q = readPathNumber(q, pEnd, &a[4]))) {
+                    return false;
+                }
+                arcTo(bldPath, a[0], a[1], a[2], bLargeArc, bSweep, nOX + a[3], nOY + a[4]);
+                break;
+            case 'Z': case 'z':
+                closePath(bldPath);
+                break;
+            default:
+                /* Unsupported command (e.g. "T"). */
+                return false;
+        }
+        if (!(*bldPath).Started) {
+            return false;
+        }
+        p = q;
+    }
+
+    return true;
+}
+
+
+/** Open a new, empty shape at the end of a symbol. **/
+static RasterShape* addShape(RasterSymbol* symTarget, RasterStyle styShape) {
+
+    (*symTarget).Shapes = (RasterShape*) realloc((*symTarget).Shapes,
+        ((size_t) (*symTarget).ShapeCount + 1) * sizeof(RasterShape));
+    if (!(*symTarget).Shapes) {
+        printf("Unsuccessful realloc() in addShape(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    RasterShape* shpReturnValue = &(*symTarget).Shapes[(*symTarget).ShapeCount++];
+    (*shpReturnValue).Points = NULL;
+    (*shpReturnValue).Commands = NULL;
+    (*shpReturnValue).PointCount = 0;
+    (*shpReturnValue).CommandCount = 0;
+    (*shpReturnValue).Style = resolveStyle(styShape);
+
+    return shpReturnValue;
+}
+
+
+/** Give a symbol its id (the value of the "id" attribute of the element). **/
+static bool startSymbol(RasterDefinitions* defRaster, const char* pElement, const char* pEnd,
+    RasterSymbol** symStarted) {
+
+    const char* pValue;
+    size_t nLength;
+    if (!findAttribute(pElement, pEnd, "id", &pValue, &nLength)
+        || nLength >= RASTER_SYMBOL_ID_LENGTH || (*defRaster).SymbolCount >= RASTER_MAX_SYMBOLS) {
+        return false;
+    }
+    *symStarted = &(*defRaster).Symbols[(*defRaster).SymbolCount++];
+    memcpy((**symStarted).Id, pValue, nLength);
+    (**symStarted).Id[nLength] = '\0';
+    (**symStarted).Shapes = NULL;
+    (**symStarted).ShapeCount = 0;
+
+    return true;
+}
+
+
+/**
+ * Read the definitions of a template: every path, circle or group having an id, in its
+ * "<defs>" element, becomes a symbol.
+ *
+ * @param   pTemplate       the template, as read
+ * @param   nLength         its size
+ * @return  the definitions, NULL if the template has none or if a path is malformed
+ * @see     freeRasterDefinitions()
+ **/
+RasterDefinitions* parseRasterDefinitions(const char* pTemplate, size_t nLength) {
+
+    RasterDefinitions* defReturnValue = (RasterDefinitions*) malloc(1 * sizeof(RasterDefinitions));
+    if (!defReturnValue) {
+        printf("Unsuccessful malloc() in parseRasterDefinitions(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*defReturnValue).SymbolCount = 0;
+
+    RasterStyle astyStack[RASTER_STYLE_DEPTH];  /* Painting attributes of open groups. */
+    astyStack[0] = (RasterStyle) {PAINT_INHERITED, 0, -1, -1, PAINT_INHERITED, 0, -1, -1, -1};
+    int nDepth = 0;
+    int nSymbolDepth = -1;                      /* Depth the open group symbol started at. */
+    RasterSymbol* symGroup = NULL;
+    bool bInDefinitions = false;
+    bool bValid = true;
+
+    const char* pEnd = pTemplate + nLength;
+    const char* p = pTemplate;
+    while (bValid && (p = memchr(p, '<', (size_t) (pEnd - p))) != NULL) {
+        /* ELEMENT BOUNDS (values hold no '>') */
+        const char* pElementEnd = memchr(p, '>', (size_t) (pEnd - p));
+        if (!pElementEnd) {
+            break;
+        }
+        bool bClosing = (p[1] == '/');
+        bool bSelfClosing = (pElementEnd[-1] == '/');
+        const char* pName = p + (bClosing ? 2 : 1);
+        size_t nNameLength = strcspn(pName, " \n\t/>");
+
+        /* DEFINITIONS ONLY */
+        if (nNameLength == 4 && strncmp(pName, "defs", 4) == 0) {
+            bInDefinitions = !bClosing;
+        }
+        else if (bInDefinitions && nNameLength == 1 && pName[0] == 'g') {
+            if (bClosing) {
+                if (nDepth > 0) {
+                    nDepth--;
+                }
+                if (nDepth == nSymbolDepth) {
+                    symGroup = NULL;
+                    nSymbolDepth = -1;
+                }
+            }
+            else if (!bSelfClosing && nDepth < RASTER_STYLE_DEPTH - 1) {
+                if (!symGroup && startSymbol(defReturnValue, p, pElementEnd, &symGroup)) {
+                    nSymbolDepth = nDepth;
+                }
+                astyStack[nDepth + 1] = readStyle(p, pElementEnd, astyStack[nDepth]);
+                nDepth++;
+            }
+        }
+        else if (bInDefinitions && !bClosing && ((nNameLength == 4
+            && strncmp(pName, "path", 4) == 0) || (nNameLength == 6
+            && strncmp(pName, "circle", 6) == 0))) {
+            /* A shape of the open group, or a symbol on its own. */
+            RasterSymbol* symTarget = symGroup;
+            if (!symTarget && !startSymbol(defReturnValue, p, pElementEnd, &symTarget)) {
+                symTarget = NULL;
+            }
+            if (symTarget) {
+                PathBuilder bldPath = {addShape(symTarget, readStyle(p, pElementEnd,
+                    astyStack[nDepth])), 0, 0, 0, 0, 0, 0, 0, 0, false};
+                if (pName[0] == 'p') {
+                    const char* pValue;
+                    size_t nValueLength;
+                    bValid = findAttribute(p, pElementEnd, "d", &pValue, &nValueLength)
+                        && readPathData(&bldPath, pValue, pValue + nValueLength);
+                }
+                else {
+                    float nCX = readNumericAttribute(p, pElementEnd, "cx", 0);
+                    float nCY = readNumericAttribute(p, pElementEnd, "cy", 0);
+                    float nR = readNumericAttribute(p, pElementEnd, "r", 0);
+                    moveTo(&bldPath, nCX + nR, nCY);
+                    arcTo(&bldPath, nR, nR, 0, false, true, nCX - nR, nCY);
+                    arcTo(&bldPath, nR, nR, 0, false, true, nCX + nR, nCY);
+                    closePath(&bldPath);
+                }
+            }
+        }
+        p = pElementEnd + 1;
+    }
+
+    if (!bValid || (*defReturnValue).SymbolCount == 0) {
+        freeRasterDefinitions(&defReturnValue);
+        return NULL;
+    }
+
+    return defReturnValue;
+}
+
+
+/** Index of the symbol of a given id, -1 if there is none. **/
+int findRasterSymbol(const RasterDefinitions* defRaster, const char* sId, size_t nIdLength) {
+
+    for (int i = 0; i < (*defRaster).SymbolCount; i++) {
+        if (strlen((*defRaster).Symbols[i].Id) == nIdLength
+            && strncmp((*defRaster).Symbols[i].Id, sId, nIdLength) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Free what parseRasterDefinitions() allocated. */
+void freeRasterDefinitions(RasterDefinitions** defRaster) {
+
+    for (int i = 0; i < (**defRaster).SymbolCount; i++) {
+        RasterSymbol* symCurrent = &(**defRaster).Symbols[i];
+        for (int j = 0; j < (*symCurrent).ShapeCount; j++) {
+            free((*symCurrent).Shapes[j].Points);
+            free((*symCurrent).Shapes[j].Commands);
+        }
+        free((*symCurrent).Shapes);
+    }
+    free(*defRaster);
+    *defRaster = NULL;
+}
+
+
+/******************************************************************************************
+ * DRAWING
+ ******************************************************************************************/
+
+/** Transparent image. **/
+RasterImage* createRasterImage(int nWidth, int nHeight) {
+
+    RasterImage* imgReturnValue = (RasterImage*) malloc(1 * sizeof(RasterImage));
+    if (!imgReturnValue) {
+        printf("Unsuccessful malloc() in createRasterImage(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*imgReturnValue).Width = nWidth;
+    (*imgReturnValue).Height = nHeight;
+    (*imgReturnValue).Pixels = (unsigned char*) calloc((size_t) nWidth * nHeight, 4);
+    if (!(*imgReturnValue).Pixels) {
+        printf("Unsuccessful calloc() in createRasterImage(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return imgReturnValue;
+}
+
+
+/* Free what createRasterImage() allocated. */
+void freeRasterImage(RasterImage** imgRaster) {
+
+    free((**imgRaster).Pixels);
+    free(*imgRaster);
+    *imgRaster = NULL;
+}
+
+
+static void addPolygonPoint(RasterPolygon* polTarget, float nX, float nY) {
+
+    (*polTarget).Points = growArray((*polTarget).Points, &(*polTarget).PointCapacity,
+        (*polTarget).PointCount + 2, sizeof(float));
+    (*polTarget).Points[(*polTarget).PointCount++] = nX;
+    (*polTarget).Points[(*polTarget).PointCount++] = nY;
+}
+
+
+/** End the current contour (contours with no point are dropped). **/
+static void endPolygonContour(RasterPolygon* polTarget, bool bClosed) {
+
+    int nStart = ((*polTarget).ContourCount > 0) ?
+        (*polTarget).Ends[(*polTarget).ContourCount - 1] : 0;
+    if ((*polTarget).PointCount == nStart) {
+        return;
+    }
+    (*polTarget).Ends = growArray((*polTarget).Ends, &(*polTarget).ContourCapacity,
+        (*polTarget).ContourCount + 1, sizeof(int));
+    /* Same capacity for both arrays. */
+    int nClosedCapacity = (*polTarget).ContourCapacity;
+    (*polTarget).Closed = realloc((*polTarget).Closed, (size_t) nClosedCapacity * sizeof(bool));
+    if (!(*polTarget).Closed) {
+        printf("Unsuccessful realloc() in endPolygonContour(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    (*polTarget).Ends[(*polTarget).ContourCount] = (*polTarget).PointCount;
+    (*polTarget).Closed[(*polTarget).ContourCount] = bClosed;
+    (*polTarget).ContourCount++;
+}
+
+
+static void clearPolygon(RasterPolygon* polTarget) {
+
+    (*polTarget).PointCount = 0;
+    (*polTarget).ContourCount = 0;
+}
+
+
+static void freePolygon(RasterPolygon* polTarget) {
+
+    free((*polTarget).Points);
+    free((*polTarget).Ends);
+    free((*polTarget).Closed);
+}
+
+
+/** Outline of a shape as polygons, in pixels (curves flattened at the requested scale). **/
+static void flattenShape(const RasterShape* shpSource, float nX, float nY, float nScale,
+    RasterPolygon* polTarget) {
+
+    const float* pPoint = (*shpSource).Points;
+    float nPenX = 0;
+    float nPenY = 0;
+    for (int i = 0; i < (*shpSource).CommandCount; i++) {
+        switch ((*shpSource).Commands[i]) {
+            case 'M':
+                endPolygonContour(polTarget, false);
+                nPenX = nX + pPoint[0] * nScale;
+                nPenY = nY + pPoint[1] * nScale;
+                addPolygonPoint(polTarget, nPenX, nPenY);
+                pPoint += 2;
+                break;
+            case 'C': {
+                float nX1 = nX + pPoint[0] * nScale, nY1 = nY + pPoint[1] * nScale;
+                float nX2 = nX + pPoint[2] * nScale, nY2 = nY + pPoint[3] * nScale;
+                float nX3 = nX + pPoint[4] * nScale, nY3 = nY + pPoint[5] * nScale;
+                /* As many segments as the curvature needs (a single one for lines). */
+                float nDX1 = fabsf(nPenX - 2 * nX1 + nX2), nDY1 = fabsf(nPenY - 2 * nY1 + nY2);
+                float nDX2 = fabsf(nX1 - 2 * nX2 + nX3), nDY2 = fabsf(nY1 - 2 * nY2 + nY3);
+                float nCurvature = fmaxf(fmaxf(nDX1, nDY1), fmaxf(nDX2, nDY2));
+                int nSegments = (int) ceilf(sqrtf(0.75f * nCurvature / RASTER_FLATNESS));
+                if (nSegments < 1) {
+                    nSegments = 1;
+                }
+                else if (nSegments > RASTER_MAX_CURVE_SEGMENTS) {
+                    nSegments = RASTER_MAX_CURVE_SEGMENTS;
+                }
+                for (int j = 1; j <= nSegments; j++) {
+                    float t = (float) j / nSegments;
+                    float u = 1 - t;
+                    addPolygonPoint(polTarget,
+                        u*u*u * nPenX + 3*u*u*t * nX1 + 3*u*t*t * nX2 + t*t*t * nX3,
+                        u*u*u * nPenY + 3*u*u*t * nY1 + 3*u*t*t * nY2 + t*t*t * nY3);
+                }
+                nPenX = nX3;
+                nPenY = nY3;
+                pPoint += 6;
+                break;
+            }
+            case 'Z': {
+                /* Back to the first point of the contour, which goes on from there. */
+                int nStart = ((*polTarget).ContourCount > 0) ?
+                    (*polTarget).Ends[(*polTarget).ContourCount - 1] : 0;
+                if ((*polTarget).PointCount > nStart) {
+                    nPenX = (*polTarget).Points[nStart];
+                    nPenY = (*polTarget).Points[nStart + 1];
+                    endPolygonContour(polTarget, true);
+                    addPolygonPoint(polTarget, nPenX, nPenY);
+                }
+                break;
+            }
+        }
+    }
+    endPolygonContour(polTarget, false);
+}
+
+
+/** Add a span [nXA, nXB) of a scanline to the coverage of a row of pixels. **/
+static inline void addSpan(float* aCoverage, int nWidth, float nXA, float nXB, float nWeight) {
+
+    if (nXA < 0) {
+        nXA = 0;
+    }
+    if (nXB > nWidth) {
+        nXB = (float) nWidth;
+    }
+    if (nXB <= nXA) {
+        return;
+    }
+    int nA = (int) nXA;
+    int nB = (int) nXB;
+    if (nA == nB) {
+        aCoverage[nA] += (nXB - nXA) * nWeight;
+        return;
+    }
+    aCoverage[nA] += (nA + 1 - nXA) * nWeight;
+    for (int x = nA + 1; x < nB; x++) {
+        aCoverage[x] += nWeight;
+    }
+    if (nB < nWidth) {
+        aCoverage[nB] += (nXB - nB) * nWeight;
+    }
+}
+
+
+/**
+ * Paint the inside of a polygon (every contour closed), in a colour, over an image.
+ *
+ * @param   bEvenOdd    fill rule: even-odd, else nonzero
+ * @param   nColour     0xRRGGBB
+ * @param   nOpacity    from 0 to 1
+ **/
+static void fillPolygon(RasterImage* imgTarget, const RasterPolygon* polFilled, bool bEvenOdd,
+    unsigned int nColour, float nOpacity) {
+
+    /* EDGES, TOP TO BOTTOM, AND BOUNDS */
+    int nEdgeCount = 0;
+    RasterEdge* aedgEdges = (RasterEdge*) malloc(((size_t) (*polFilled).PointCount / 2 + 1)
+        * sizeof(RasterEdge));
+    if (!aedgEdges) {
+        printf("Unsuccessful malloc() in fillPolygon(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    float nTop = (float) (*imgTarget).Height;
+    float nBottom = 0;
+    float nLeft = (float) (*imgTarget).Width;
+    float nRight = 0;
+    int nStart = 0;
+    for (int c = 0; c < (*polFilled).ContourCount; c++) {
+        int nEnd = (*polFilled).Ends[c];
+        for (int i = nStart; i < nEnd; i += 2) {
+            int j = (i + 2 < nEnd) ? i + 2 : nStart;
+            float nX0 = (*polFilled).Points[i], nY0 = (*polFilled).Points[i + 1];
+            float nX1 = (*polFilled).Points[j], nY1 = (*polFilled).Points[j + 1];
+            nTop = fminf(nTop, nY0);
+            nBottom = fmaxf(nBottom, nY0);
+            nLeft = fminf(nLeft, nX0);
+            nRight = fmaxf(nRight, nX0);
+            if (nY0 == nY1) {
+                continue;
+            }
+            RasterEdge* edgNew = &aedgEdges[nEdgeCount++];
+            if (nY0 < nY1) {
+                *edgNew = (RasterEdge) {nX0, nY0, nX1, nY1, 1};
+            }
+            else {
+                *edgNew = (RasterEdge) {nX1, nY1, nX0, nY0, -1};
+            }
+        }
+        nStart = nEnd;
+    }
+    int nFirstRow = (int) fmaxf(0, floorf(nTop));
+    int nLastRow = (int) fminf((float) (*imgTarget).Height - 1, ceilf(nBottom));
+    int nFirstColumn = (int) fmaxf(0, floorf(nLeft));
+    int nLastColumn = (int) fminf((float) (*imgTarget).Width - 1, ceilf(nRight));
+    if (nEdgeCount == 0 || nFirstRow > nLastRow || nFirstColumn > nLastColumn) {
+        free(aedgEdges);
+        return;
+    }
+
+    float* aCoverage = (float*) calloc((size_t) (*imgTarget).Width, sizeof(float));
+    RasterCrossing* acrsCrossings = (RasterCrossing*) malloc((size_t) nEdgeCount
+        * sizeof(RasterCrossing));
+    if (!aCoverage || !acrsCrossings) {
+        printf("Unsuccessful malloc() in fillPolygon(): halting.\n");
+        exit(EXIT_FAILURE);
+    }
+    float nRed = (float) ((nColour >> 16) & 0xFF);
+    float nGreen = (float) ((nColour >> 8) & 0xFF);
+    float nBlue = (float) (nColour & 0xFF);
+
+    for (int y = nFirstRow; y <= nLastRow; y++) {
+        /* COVERAGE OF THE ROW, SCANLINE BY SCANLINE */
+        for (int s = 0; s < RASTER_SUBSAMPLES; s++) {
+            float nScanline = y + (s + 0.5f) / RASTER_SUBSAMPLES;
+            int nCrossings = 0;
+            for (int e = 0; e < nEdgeCount; e++) {
+                const RasterEdge* edgCurrent = &aedgEdges[e];
+                if (nScanline >= (*edgCurrent).Y0 && nScanline < (*edgCurrent).Y1) {
+                    float nX = (*edgCurrent).X0 + (nScanline - (*edgCurrent).Y0)
+                        * ((*edgCurrent).X1 - (*edgCurrent).X0)
+                        / ((*edgCurrent).Y1 - (*edgCurrent).Y0);
+                    /* Insertion sort: a handful of crossings per scanline. */
+                    int k = nCrossings++;
+                    while (k > 0 && acrsCrossings[k - 1].X > nX) {
+                        acrsCrossings[k] = acrsCrossings[k - 1];
+                        k--;
+                    }
+                    acrsCrossings[k] = (RasterCrossing) {nX, (*edgCurrent).Direction};
+                }
+            }
+            int nWinding = 0;
+            for (int k = 0; k + 1 < nCrossings; k++) {
+                nWinding += acrsCrossings[k].Direction;
+                if (bEvenOdd ? (nWinding & 1) : (nWinding != 0)) {
+                    addSpan(aCoverage, (*imgTarget).Width, acrsCrossings[k].X,
+                        acrsCrossings[k + 1].X, 1.0f / RASTER_SUBSAMPLES);
+                }
+            }
+        }
+
+        /* PAINT IT (source over, premultiplied alpha) */
+        unsigned char* pPixel = (*imgTarget).Pixels + ((size_t) y * (*imgTarget).Width
+            + nFirstColumn) * 4;
+        for (int x = nFirstColumn; x <= nLastColumn; x++, pPixel += 4) {
+            float nAlpha = fminf(aCoverage[x], 1) * nOpacity;
+            aCoverage[x] = 0;
+            if (nAlpha <= 0) {
+                continue;
+            }
+            pPixel[0] = (unsigned char) (nRed * nAlpha + pPixel[0] * (1 - nAlpha) + 0.5f);
+            pPixel[1] = (unsigned char) (nGreen * nAlpha + pPixel[1] * (1 - nAlpha) + 0.5f);
+            pPixel[2] = (unsigned char) (nBlue * nAlpha + pPixel[2] * (1 - nAlpha) + 0.5f);
+            pPixel[3] = (unsigned char) (255 * nAlpha + pPixel[3] * (1 - nAlpha) + 0.5f);
+        }
+    }
+
+    free(acrsCrossings);
+    free(aCoverage);
+    free(aedgEdges);
+}
+
+
+/** Add a closed contour, turning counterclockwise whatever the order of its points. **/
+static void addOrientedContour(RasterPolygon* polTarget, const float* aPoints, int nPoints) {
+
+    float nArea = 0;
+    for (int i = 0; i < nPoints; i++) {
+        int j = (i + 1) % nPoints;
+        nArea += aPoints[2*i] * aPoints[2*j+1] - aPoints[2*j] * aPoints[2*i+1];
+    }
+    for (int i = 0; i < nPoints; i++) {
+        int k = (nArea >= 0) ? i : nPoints - 1 - i;
+        addPolygonPoint(polTarget, aPoints[2*k], aPoints[2*k+1]);
+    }
+    endPolygonContour(polTarget, true);
+}
+
+
+/** Disc, for round joins and caps. **/
+static void addDisc(RasterPolygon* polTarget, float nX, float nY, float nRadius) {
+
+    float aPoints[2 * 64];
+    int nPoints = (int) ceilf(2 * RASTER_PI * nRadius / 1.5f);
+    if (nPoints < 8) {
+        nPoints = 8;
+    }
+    else if (nPoints > 64) {
+        nPoints = 64;
+    }
+    for (int i = 0; i < nPoints; i++) {
+        aPoints[2*i] = nX + nRadius * cosf(2 * RASTER_PI * i / nPoints);
+        aPoints[2*i+1] = nY + nRadius * sinf(2 * RASTER_PI * i / nPoints);
+    }
+    addOrientedContour(polTarget, aPoints, nPoints);
+}
+
+
+/**
+ * Outline of the stroke of a polygon: a quad per segment, then joins (miter, round or bevel)
+ * and caps (butt, round or square), all filled at once with the nonzero rule.
+ **/
+static void strokePolygon(const RasterPolygon* polPath, float nHalfWidth, int nLineCap,
+    int nLineJoin, RasterPolygon* polStroke) {
+
+    int nStart = 0;
+    for (int c = 0; c < (*polPath).ContourCount; c++) {
+        int nEnd = (*polPath).Ends[c];
+        bool bClosed = (*polPath).Closed[c];
+
+        /* POINTS, WITHOUT REPEATS (nor the closing one) */
+        int nCount = 0;
+        float* aPoints = (float*) malloc((size_t) (nEnd - nStart) * sizeof(float));
+        if (!aPoints) {
+            printf("Unsuccessful malloc() in strokePolygon(): halting.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = nStart; i < nEnd; i += 2) {
+            if (nCount == 0 || fabsf((*polPath).Points[i] - aPoints[2*nCount-2]) > 1e-4f
+                || fabsf((*polPath).Points[i+1] - aPoints[2*nCount-1]) > 1e-4f) {
+                aPoints[2*nCount] = (*polPath).Points[i];
+                aPoints[2*nCount+1] = (*polPath).Points[i+1];
+                nCount++;
+            }
+        }
+        if (bClosed && nCount > 1 && fabsf(aPoints[0] - aPoints[2*nCount-2]) <= 1e-4f
+            && fabsf(aPoints[1] - aPoints[2*nCount-1]) <= 1e-4f) {
+            nCount--;
+        }
+        nStart = nEnd;
+
+        /* A SINGLE POINT: ONLY ROUND AND SQUARE CAPS ARE DRAWN. */
+        if (nCount == 1) {
+            if (nLineCap == ROUND_CAP) {
+                addDisc(polStroke, aPoints[0], aPoints[1], nHalfWidth);
+            }
+            else if (nLineCap == SQUARE_CAP) {
+                float aSquare[8] = {aPoints[0] - nHalfWidth, aPoints[1] - nHalfWidth,
+                    aPoints[0] + nHalfWidth, aPoints[1] - nHalfWidth, aPoints[0] + nHalfWidth,
+                    aPoints[1] + nHalfWidth, aPoints[0] - nHalfWidth, aPoints[1] + nHalfWidth};
+                addOrientedContour(polStroke, aSquare, 4);
+            }
+            free(aPoints);
+            continue;
+        }
+
+        /* SEGMENTS */
+        int nSegments = bClosed ? nCount : nCount - 1;
+        for (int i = 0; i < nSegments; i++) {
+            float nAX = aPoints[2*i], nAY = aPoints[2*i+1];
+            float nBX = aPoints[2*((i+1) % nCount)], nBY = aPoints[2*((i+1) % nCount)+1];
+            float nLength = sqrtf((nBX - nAX) * (nBX - nAX) + (nBY - nAY) * (nBY - nAY));
+            float nDX = (nBX - nAX) / nLength, nDY = (nBY - nAY) / nLength;
+            if (!bClosed && nLineCap == SQUARE_CAP) {
+                if (i == 0) {
+                    nAX -= nDX * nHalfWidth;
+                    nAY -= nDY * nHalfWidth;
+                }
+                if (i == nSegments - 1) {
+                    nBX += nDX * nHalfWidth;
+                    nBY += nDY * nHalfWidth;
+                }
+            }
+            float nNX = -nDY * nHalfWidth, nNY = nDX * nHalfWidth;
+            float aQuad[8] = {nAX + nNX, nAY + nNY, nBX + nNX, nBY + nNY, nBX - nNX, nBY - nNY,
+                nAX - nNX, nAY - nNY};
+            addOrientedContour(polStroke, aQuad, 4);
+        }
+
+        /* JOINS */
+        for (int i = bClosed ? 0 : 1; i < (bClosed ? nCount : nCount - 1); i++) {
+            int nPrevious = (i + nCount - 1) % nCount;
+            int nNext = (i + 1) % nCount;
+            float nVX = aPoints[2*i], nVY = aPoints[2*i+1];
+            if (nLineJoin == ROUND_JOIN) {
+                addDisc(polStroke, nVX, nVY, nHalfWidth);
+                continue;
+            }
+            float nD1X = nVX - aPoints[2*nPrevious], nD1Y = nVY - aPoints[2*nPrevious+1];
+            float nD2X = aPoints[2*nNext] - nVX, nD2Y = aPoints[2*nNext+1] - nVY;
+            float nL1 = sqrtf(nD1X * nD1X + nD1Y * nD1Y), nL2 = sqrtf(nD2X * nD2X + nD2Y * nD2Y);
+            nD1X /= nL1; nD1Y /= nL1; nD2X /= nL2; nD2Y /= nL2;
+            float nCross = nD1X * nD2Y - nD1Y * nD2X;
+            if (fabsf(nCross) < 1e-4f) {
+                continue;                       /* Straight on: the quads meet. */
+            }
+            /* Outer side of the turn. */
+            float nSide = (nCross > 0) ? -nHalfWidth : nHalfWidth;
+            float nN1X = -nD1Y, nN1Y = nD1X, nN2X = -nD2Y, nN2Y = nD2X;
+            float nDot = nN1X * nN2X + nN1Y * nN2Y;
+            float nMiter = sqrtf(2 / (1 + nDot));   /* Miter length / stroke width. */
+            if (nLineJoin == MITER_JOIN && nMiter <= RASTER_MITER_LIMIT) {
+                float aMiter[8] = {nVX, nVY, nVX + nSide * nN1X, nVY + nSide * nN1Y,
+                    nVX + nSide * (nN1X + nN2X) / (1 + nDot),
+                    nVY + nSide * (nN1Y + nN2Y) / (1 + nDot),
+                    nVX + nSide * nN2X, nVY + nSide * nN2Y};
+                addOrientedContour(polStroke, aMiter, 4);
+            }
+            else {
+                float aBevel[6] = {nVX, nVY, nVX + nSide * nN1X, nVY + nSide * nN1Y,
+                    nVX + nSide * nN2X, nVY + nSide * nN2Y};
+                addOrientedContour(polStroke, aBevel, 3);
+            }
+        }
+
+        /* ROUND CAPS */
+        if (!bClosed && nLineCap == ROUND_CAP) {
+            addDisc(polStroke, aPoints[0], aPoints[1], nHalfWidth);
+            addDisc(polStroke, aPoints[2*nCount-2], aPoints[2*nCount-1], nHalfWidth);
+        }
+        free(aPoints);
+    }
+}
+
+
+/**
+ * Draw a symbol over an image: each of its shapes filled, then stroked.
+ *
+ * @param   nX              where the origin of the symbol goes, in pixels
+ * @param   nY
+ * @param   nScale          pixels per template unit
+ * @param   nInheritedFill  fill of shapes that set none (e.g. the "fill" attribute of a use),
+ *                          RASTER_NO_COLOUR for SVG default (black)
+ **/
+void drawRasterSymbol(RasterImage* imgTarget, const RasterSymbol* symDrawn, float nX, float nY,
+    float nScale, unsigned int nInheritedFill) {
+
+    RasterPolygon polPath = {NULL, 0, 0, NULL, NULL, 0, 0};
+    RasterPolygon polStroke = {NULL, 0, 0, NULL, NULL, 0, 0};
+    for (int i = 0; i < (*symDrawn).ShapeCount; i++) {
+        const RasterShape* shpCurrent = &(*symDrawn).Shapes[i];
+        RasterStyle styCurrent = (*shpCurrent).Style;
+        clearPolygon(&polPath);
+        flattenShape(shpCurrent, nX, nY, nScale, &polPath);
+
+        /* FILL */
+        if (styCurrent.FillState != PAINT_NONE) {
+            unsigned int nColour = (styCurrent.FillState == PAINT_COLOUR) ? styCurrent.Fill :
+                (nInheritedFill != RASTER_NO_COLOUR) ? nInheritedFill : 0x000000;
+            fillPolygon(imgTarget, &polPath, styCurrent.EvenOdd, nColour,
+                styCurrent.FillOpacity);
+        }
+
+        /* STROKE */
+        if (styCurrent.StrokeState == PAINT_COLOUR && styCurrent.StrokeWidth > 0) {
+            clearPolygon(&polStroke);
+            strokePolygon(&polPath, styCurrent.StrokeWidth * nScale / 2, styCurrent.LineCap,
+                styCurrent.LineJoin, &polStroke);
+            fillPolygon(imgTarget, &polStroke, false, styCurrent.Stroke, 1);
+        }
+    }
+    freePolygon(&polPath);
+    freePolygon(&polStroke);
+}
+
+
+/**
+ * Read a "<use>" element: which definition it draws ("#id", or "file#id" with a sprite
+ * file), where and, if given, in which fill.
+ *
+ * @param   pElement    its first character ('<')
+ * @param   pEnd        character after its last one
+ * @param   nFill       receives its fill, RASTER_NO_COLOUR if it gives none
+ * @return  false if it references nothing
+ **/
+bool readUseElement(const char* pElement, const char* pEnd, const char** pId, size_t* nIdLength,
+    float* nX, float* nY, unsigned int* nFill) {
+
+    const char* pValue;
+    size_t nLength;
+    if (!findAttribute(pElement, pEnd, "xlink:href", &pValue, &nLength)) {
+        return false;
+    }
+    const char* pHash = memchr(pValue, '#', nLength);
+    if (!pHash) {
+        return false;
+    }
+    *pId = pHash + 1;
+    *nIdLength = nLength - (size_t) (pHash + 1 - pValue);
+    *nX = readNumericAttribute(pElement, pEnd, "x", 0);
+    *nY = readNumericAttribute(pElement, pEnd, "y", 0);
+    *nFill = RASTER_NO_COLOUR;
+    if (findAttribute(pElement, pEnd, "fill", &pValue, &nLength)
+        && readColour(pValue, nLength, nFill) != PAINT_COLOUR) {
+        *nFill = RASTER_NO_COLOUR;
+    }
+
+    return true;
+}
+
+
+/**
+ * Draw every "<use>" element of SVG data (e.g. an empty board), in order. Each one is moved
+ * to a whole pixel, so that squares drawn side by side share their edges.
+ *
+ * @return  false if one of them references no definition
+ **/
+bool drawUseElements(RasterImage* imgTarget, const RasterDefinitions* defRaster,
+    const char* pData, size_t nLength, float nScale) {
+
+    const char* pEnd = pData + nLength;
+    const char* p = pData;
+    while ((p = memchr(p, '<', (size_t) (pEnd - p))) != NULL) {
+        const char* pElementEnd = memchr(p, '>', (size_t) (pEnd - p));
+        if (!pElementEnd) {
+            break;
+        }
+        if (pElementEnd - p > 4 && strncmp(p, "<use", 4) == 0) {
+            const char* pId;
+            size_t nIdLength;
+            float nX;
+            float nY;
+            unsigned int nFill;
+            if (!readUseElement(p, pElementEnd, &pId, &nIdLength, &nX, &nY, &nFill)) {
+                return false;
+            }
+            int nSymbol = findRasterSymbol(defRaster, pId, nIdLength);
+            if (nSymbol < 0) {
+                return false;
+            }
+            drawRasterSymbol(imgTarget, &(*defRaster).Symbols[nSymbol], roundf(nX * nScale),
+                roundf(nY * nScale), nScale, nFill);
+        }
+        p = pElementEnd + 1;
+    }
+
+    return true;
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright 2019-2023 Michaël I. F. George
+ *
+ * This file is part of FEN2SVG.
+ *
+ * FEN2SVG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FEN2SVG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar.  If not, see <https://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * As the name suggests, this code is the header file for svgraster.c,
+ * a helper file for FEN2SVG.
+ **/
+
+#include <stdbool.h>
+#include <stddef.h>                         /* size_t */
+
+#define RASTER_MAX_SYMBOLS 64               /* Definitions of the template (32 used). */
+#define RASTER_SYMBOL_ID_LENGTH 32
+#define RASTER_SUBSAMPLES 8                 /* Scanlines per row of pixels (antialiasing). */
+#define RASTER_MITER_LIMIT 4.0f             /* SVG default. */
+#define RASTER_NO_COLOUR 0xFFFFFFFFu        /* Inherited fill: none given by the use. */
+
+enum RasterPaintState {
+   PAINT_INHERITED,        /* Not set: the parent's, or the default (black fill, no stroke). */
+   PAINT_NONE,
+   PAINT_COLOUR
+};
+
+enum RasterLineCap {BUTT_CAP, ROUND_CAP, SQUARE_CAP};
+enum RasterLineJoin {MITER_JOIN, ROUND_JOIN, BEVEL_JOIN};
+
+
+/* Variables */
+typedef struct RasterStyle {
+   enum RasterPaintState FillState;
+   unsigned int Fill;      /* 0xRRGGBB */
+   float FillOpacity;      /* Negative: inherited. */
+   int EvenOdd;            /* Fill rule; negative: inherited. */
+   enum RasterPaintState StrokeState;
+   unsigned int Stroke;
+   float StrokeWidth;      /* Negative: inherited. */
+   int LineCap;            /* enum RasterLineCap; negative: inherited. */
+   int LineJoin;           /* enum RasterLineJoin; negative: inherited. */
+} RasterStyle;
+
+typedef struct RasterShape {
+   float* Points;          /* Absolute outline, in template units: moveto, then cubic curves
+                              (3 points each); arcs, lines and closings are turned into them. */
+   unsigned char* Commands;/* 'M', 'C' or 'Z', one per moveto or curve, 'Z' having no point. */
+   int PointCount;
+   int CommandCount;
+   RasterStyle Style;      /* Inherited values resolved, but the fill. */
+} RasterShape;
+
+typedef struct RasterSymbol {
+   char Id[RASTER_SYMBOL_ID_LENGTH];
+   RasterShape* Shapes;    /* Painted in order. */
+   int ShapeCount;
+} RasterSymbol;
+
+typedef struct RasterDefinitions {
+   RasterSymbol Symbols[RASTER_MAX_SYMBOLS];
+   int SymbolCount;
+} RasterDefinitions;
+
+typedef struct RasterImage {
+   int Width;
+   int Height;
+   unsigned char* Pixels;  /* RGBA, premultiplied alpha, row after row. */
+} RasterImage;
+
+/* Methods */
+RasterDefinitions* parseRasterDefinitions(const char* pTemplate, size_t nLength);
+int findRasterSymbol(const RasterDefinitions* defRaster, const char* sId, size_t nIdLength);
+void freeRasterDefinitions(RasterDefinitions** defRaster);
+RasterImage* createRasterImage(int nWidth, int nHeight);
+void freeRasterImage(RasterImage** imgRaster);
+void drawRasterSymbol(RasterImage* imgTarget, const RasterSymbol* symDrawn, float nX, float nY,
+    float nScale, unsigned int nInheritedFill);
+bool readUseElement(const char* pElement, const char* pEnd, const char** pId, size_t* nIdLength,
+    float* nX, float* nY, unsigned int* nFill);
+bool drawUseElements(RasterImage* imgTarget, const RasterDefinitions* defRaster,
+    const char* pData, size_t nLength, float nScale);